@@ -0,0 +1,947 @@
+// llm_trainer_server 微基准
+// 服务器是单文件实现，这里直接包含源文件（去掉main），测量内部函数的耗时和每次调用的堆分配次数。
+// 用法: llm_trainer_bench [--assert-zero-alloc] [过滤子串]
+//   --assert-zero-alloc  标记为hot的基准在稳态下只要有一次堆分配就返回非0
+//   --tokenizer-parity   只运行预分词与transformers的token id比对（见tokenizer_parity）
+
+#define LLM_TRAINER_NO_MAIN
+#define LLM_TRAINER_ALLOC_STATS
+#include "../llm_trainer_server.cpp"
+
+namespace bench {
+
+volatile size_t g_sink = 0;  // 防止被测代码被优化掉
+std::string g_filter;        // 只运行名称包含该子串的基准
+int g_check_failures = 0;    // 基准附带的正确性检查失败次数
+
+void check(bool ok, const std::string& what) {
+    if (ok) return;
+    std::cerr << "FAIL: " << what << std::endl;
+    g_check_failures++;
+}
+
+template <typename T>
+void consume(const T& value) {
+    g_sink = g_sink + value.size() + (value.empty() ? 0 : static_cast<unsigned char>(value[value.size() / 2]));
+}
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    double allocs_per_op;   // 最后一轮（稳态）的平均堆分配次数
+    bool hot;               // 高频端点，要求稳态下零分配
+};
+
+// 先估算单次耗时，再运行约target_ms毫秒取平均；被过滤掉的基准iterations为0
+template <typename Fn>
+Result run(const std::string& name, Fn fn, bool hot = false, double target_ms = 200) {
+    using clock = std::chrono::steady_clock;
+    if (!g_filter.empty() && name.find(g_filter) == std::string::npos) return {name, 0, 0, 0, hot};
+    size_t iterations = 1;
+    double elapsed_ns = 0;
+    unsigned long long allocations = 0;
+    while (true) {
+        unsigned long long allocations_before = thread_allocation_count();
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) fn();
+        elapsed_ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        allocations = thread_allocation_count() - allocations_before;
+        if (elapsed_ns >= target_ms * 1e6 || iterations >= (size_t(1) << 40)) break;
+        double scale = elapsed_ns > 0 ? target_ms * 1e6 / elapsed_ns : 100;
+        iterations = static_cast<size_t>(iterations * std::min(100.0, std::max(2.0, scale * 1.1)));
+    }
+    return {name, iterations, elapsed_ns / iterations, static_cast<double>(allocations) / iterations, hot};
+}
+
+// 原来的实现：每次请求用ostringstream拼接默认配置和CORS预检响应
+std::string legacy_default_config() {
+    std::ostringstream json;
+    json << "{";
+    json << "\"model_name_or_path\":\"/ckpt/ds\",";
+    json << "\"output_dir\":\"/output/your_task/lora\",";
+    json << "\"train_file\":\"/data/sample.jsonl\",";
+    json << "\"num_train_epochs\":3,";
+    json << "\"per_device_train_batch_size\":1,";
+    json << "\"gradient_accumulation_steps\":4,";
+    json << "\"learning_rate\":0.0002,";
+    json << "\"max_seq_length\":1024,";
+    json << "\"logging_steps\":1,";
+    json << "\"save_steps\":200,";
+    json << "\"save_total_limit\":3,";
+    json << "\"lr_scheduler_type\":\"constant_with_warmup\",";
+    json << "\"warmup_steps\":30,";
+    json << "\"lora_rank\":8,";
+    json << "\"lora_alpha\":16,";
+    json << "\"lora_dropout\":0.05,";
+    json << "\"gradient_checkpointing\":true,";
+    json << "\"optim\":\"adamw_torch\",";
+    json << "\"train_mode\":\"lora\",";
+    json << "\"seed\":42,";
+    json << "\"fp16\":false,";
+    json << "\"distributed\":false";
+    json << "}";
+    return json_response(json.str());
+}
+
+std::string legacy_cors_preflight() {
+    std::ostringstream response;
+    response << "HTTP/1.1 200 OK\r\n";
+    response << "Access-Control-Allow-Origin: *\r\n";
+    response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
+    response << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
+    response << "Access-Control-Max-Age: 86400\r\n";
+    response << "Content-Length: 0\r\n";
+    response << "\r\n";
+    return response.str();
+}
+
+void static_responses(std::vector<Result>& results) {
+    results.push_back(run("default_config/ostringstream+json_response", [] {
+        consume(legacy_default_config());
+    }));
+    results.push_back(run("default_config/json_response", [] {
+        consume(json_response(std::string(DEFAULT_CONFIG_JSON)));
+    }));
+    results.push_back(run("default_config/static", [] {
+        consume(find_static_response("GET", "/api/default-config"));
+    }, true));
+    results.push_back(run("cors_preflight/ostringstream", [] {
+        consume(legacy_cors_preflight());
+    }));
+    results.push_back(run("cors_preflight/static", [] {
+        consume(find_static_response("OPTIONS", "/api/config/save"));
+    }, true));
+}
+
+// 轮询任务状态：原有的handle_api_request路径与请求内存池路径
+void task_polling(std::vector<Result>& results) {
+    std::string task_id = g_task_registry.create("inference");
+    g_task_registry.update(task_id, TaskState::Running, 42, "Generating: 42%|████▏     | 42/100 [00:05<00:07]");
+    g_task_registry.append_result(task_id, std::string(2000, 'x') + "\n\"quoted\"\t模型输出");
+    std::string url = "/api/task/status?task_id=" + task_id;
+    std::string request = "GET " + url + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+    results.push_back(run("task_status/handle_api_request", [&] {
+        consume(handle_api_request(url, request, "GET"));
+    }));
+    results.push_back(run("task_status/arena", [&] {
+        consume(handle_arena_request("GET", url));
+        request_arena().reset();
+    }, true));
+    std::string ollama_url = "/api/ollama/status?task_id=" + task_id;
+    results.push_back(run("ollama_status/arena", [&] {
+        consume(handle_arena_request("GET", ollama_url));
+        request_arena().reset();
+    }, true));
+
+    std::string body;
+    check(task_polling_body(body, url) && handle_api_request(url, request, "GET") == std::string(handle_arena_request("GET", url)),
+          "任务状态的内存池响应和handle_api_request不一致");
+    request_arena().reset();
+
+    // 大响应撑大的内存池复位后回到默认大小，未超过高水位时保留合并后的块
+    RequestArena arena(4096);
+    arena.allocate(4096 * ARENA_HIGH_WATER_BLOCKS * 2);
+    arena.reset();
+    check(arena.bytes_reserved() == 4096, "请求内存池超过高水位后复位没有释放内存");
+    arena.allocate(3000);
+    arena.allocate(3000);
+    arena.reset();
+    check(arena.bytes_reserved() == 8192, "请求内存池复位没有保留合并后的块");
+}
+
+// 请求体解析与JSON转义：训练请求体、纯ASCII文本、带引号换行和中文的模型输出
+void json_helpers(std::vector<Result>& results) {
+    std::string train_body = std::string(DEFAULT_CONFIG_JSON);
+    results.push_back(run("parse_json/train_request", [&] {
+        g_sink = g_sink + parse_json(train_body).size();
+    }));
+    std::string ascii(2048, 'a');
+    std::string mixed;
+    while (mixed.size() < 2048) mixed += "Generating \"token\"\t42%|████▏ | 模型输出\n";
+    results.push_back(run("escape_json/ascii_2k", [&] {
+        consume(escape_json(ascii));
+    }));
+    results.push_back(run("escape_json/mixed_2k", [&] {
+        consume(escape_json(mixed));
+    }));
+    std::string body = "{\"success\":true,\"content\":\"" + escape_json(mixed) + "\"}";
+    results.push_back(run("json_response/2k", [&] {
+        consume(json_response(body));
+    }));
+}
+
+// 数据集预览：读取jsonl文件的前10行
+void file_preview(std::vector<Result>& results) {
+    const std::string path = "llm_trainer_bench_preview.jsonl";
+    {
+        std::ofstream out(path, std::ios::binary);
+        for (int i = 0; i < 1000; ++i) {
+            out << "{\"conversation\":[{\"human\":\"问题" << i << "\",\"assistant\":\"" << std::string(200, 'x') << "\"}]}\n";
+        }
+    }
+    results.push_back(run("read_file_preview/10_lines", [&] {
+        consume(read_file_preview(path, 10));
+    }));
+
+    // 文件被原地截断后，缓存的索引不再使用，重新取到的索引只包含截断后的内容
+    std::string full_path = get_current_dir() + "/" + path;
+    std::shared_ptr<const DatasetIndex> before = g_dataset_indexes.get(full_path);
+    check(before && before->record_count() == 1000 && before->unchanged(), "数据集索引记录数不对");
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "{\"conversation\":[]}\n";
+    }
+    std::shared_ptr<const DatasetIndex> after = g_dataset_indexes.get(full_path);
+    check(before && !before->unchanged() && after && after != before && after->record_count() == 1,
+          "数据集截断后仍在使用旧的索引和映射");
+    before.reset();
+    after.reset();
+    std::remove(path.c_str());
+    std::remove(dataset_index_sidecar_path(full_path).c_str());
+}
+
+// 路由：指标路由查找、静态响应查找未命中、API分发链走到末尾的404
+void routing(std::vector<Result>& results) {
+    results.push_back(run("routing/metric_route_index", [] {
+        g_sink = g_sink + metric_route_index("/api/train/logs");
+    }, true));
+    results.push_back(run("routing/static_miss", [] {
+        consume(find_static_response("GET", "/api/train/logs"));
+    }, true));
+    std::string request = "GET /api/not-found HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    results.push_back(run("routing/handle_api_request_404", [&] {
+        consume(handle_api_request("/api/not-found", request, "GET"));
+    }));
+}
+
+// 哈希：长度不是16的倍数时剩余部分（尤其9~15字节）只能读取范围内的字节；短响应体的ETag
+void hashing(std::vector<Result>& results) {
+    char a[64], b[64];
+    for (size_t length = 0; length < 32; ++length) {
+        // 范围后面的字节不同，哈希必须相同
+        std::memset(a, 'x', sizeof(a));
+        std::memset(b, 'y', sizeof(b));
+        std::memcpy(a, "0123456789abcdefghijklmnopqrstuv", length);
+        std::memcpy(b, "0123456789abcdefghijklmnopqrstuv", length);
+        check(hash_bytes64(a, length) == hash_bytes64(b, length), "hash_bytes64 读取了范围外的字节，长度 " + std::to_string(length));
+        if (length > 0) {
+            // 最后一个字节参与哈希
+            b[length - 1] ^= 1;
+            check(hash_bytes64(a, length) != hash_bytes64(b, length), "hash_bytes64 忽略了最后一个字节，长度 " + std::to_string(length));
+        }
+    }
+    results.push_back(run("hash_bytes64/tail_9_15", [] {
+        static const char text[] = "0123456789abcdef";
+        uint64_t h = 0;
+        for (size_t length = 9; length <= 15; length += 2) h ^= hash_bytes64(text, length);
+        g_sink = g_sink + static_cast<size_t>(h);
+    }, true));
+    // 条件请求的ETag：响应体很短（9~15字节）时同样走哈希的剩余部分
+    std::vector<std::string> responses;
+    for (size_t length = 9; length <= 15; ++length) {
+        responses.push_back("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n" + std::string(length, '7'));
+    }
+    std::string first_etag(body_etag(responses[0]));
+    request_arena().reset();
+    check(first_etag.size() == 20 && first_etag.compare(0, 3, "W/\"") == 0, "body_etag 格式错误: " + first_etag);
+    results.push_back(run("body_etag/short_bodies", [&] {
+        for (const std::string& response : responses) consume(body_etag(response));
+        request_arena().reset();
+    }, true));
+}
+
+// 合并请求缓存：键只含处理函数读取的参数，条目数有上限
+void response_cache() {
+    const CachedRoute* gpu = find_cached_route("GET", "/api/gpu/status?_=1700000000000");
+    check(gpu && response_cache_key("/api/gpu/status?_=1700000000000", *gpu) == "/api/gpu/status", "防缓存参数进入了缓存键");
+    const CachedRoute* files = find_cached_route("GET", "/api/data/files?limit=5&_=1&sort=size");
+    check(files && response_cache_key("/api/data/files?limit=5&_=1&sort=size", *files) == "/api/data/files?sort=size&limit=5",
+          "/api/data/files 的缓存键应只含sort/order/offset/limit");
+
+    SingleFlightCache<std::string> cache;
+    for (int i = 0; i < 1000; ++i) {
+        cache.get("/api/gpu/status?_=" + std::to_string(i), 0.0, [] { return std::string(4096, 'x'); });
+    }
+    check(cache.size() <= SINGLE_FLIGHT_MAX_ENTRIES, "SingleFlightCache 条目数没有上限: " + std::to_string(cache.size()));
+}
+
+// HPACK解码：RFC 7541附录C的示例，同一序列的头部块共用一个解码器（动态表跨块保留）。
+// C.5/C.6按256字节的动态表编码，第一个块前加上大小更新(0x3fe101)，第三个响应依赖正确的淘汰
+std::string unhex(std::string_view text) {
+    std::string out;
+    int high = -1;
+    for (char c : text) {
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (v < 0) continue;
+        if (high < 0) {
+            high = v;
+        } else {
+            out += static_cast<char>((high << 4) | v);
+            high = -1;
+        }
+    }
+    return out;
+}
+
+void hpack_vectors() {
+    const H2HeaderList request1 = {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+    H2HeaderList request2 = request1;
+    request2.emplace_back("cache-control", "no-cache");
+    const H2HeaderList request3 = {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"},
+                                   {":authority", "www.example.com"}, {"custom-key", "custom-value"}};
+    const H2HeaderList response1 = {{":status", "302"}, {"cache-control", "private"},
+                                    {"date", "Mon, 21 Oct 2013 20:13:21 GMT"}, {"location", "https://www.example.com"}};
+    H2HeaderList response2 = response1;
+    response2[0].second = "307";
+    const H2HeaderList response3 = {{":status", "200"}, {"cache-control", "private"}, {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+                                    {"location", "https://www.example.com"}, {"content-encoding", "gzip"},
+                                    {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}};
+    struct Sequence {
+        const char* name;
+        std::vector<std::pair<const char*, const H2HeaderList*>> blocks;
+    };
+    const std::vector<Sequence> sequences = {
+        {"C.3", {{"828684410f7777772e6578616d706c652e636f6d", &request1},
+                 {"828684be58086e6f2d6361636865", &request2},
+                 {"828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565", &request3}}},
+        {"C.4", {{"828684418cf1e3c2e5f23a6ba0ab90f4ff", &request1},
+                 {"828684be5886a8eb10649cbf", &request2},
+                 {"828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf", &request3}}},
+        {"C.5", {{"3fe101 4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032303a31333a323120474d54"
+                  "6e1768747470733a2f2f7777772e6578616d706c652e636f6d", &response1},
+                 {"4803333037c1c0bf", &response2},
+                 {"88c1611d4d6f6e2c203231204f637420323031332032303a31333a323220474d54c05a04677a69707738666f6f3d4153"
+                  "444a4b48514b425a584f5157454f50495541585157454f49553b206d61782d6167653d333630303b2076657273696f6e3d31", &response3}}},
+        {"C.6", {{"3fe101 488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae82ae43d3", &response1},
+                 {"4883640effc1c0bf", &response2},
+                 {"88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007", &response3}}},
+    };
+    for (const Sequence& sequence : sequences) {
+        HpackDecoder decoder;
+        for (size_t i = 0; i < sequence.blocks.size(); ++i) {
+            H2HeaderList headers;
+            bool ok = decoder.decode(unhex(sequence.blocks[i].first), headers);
+            check(ok && headers == *sequence.blocks[i].second,
+                  std::string("HPACK 解码与RFC 7541 ") + sequence.name + "." + std::to_string(i + 1) + " 不一致");
+        }
+        if (sequence.blocks.back().second != &response3) continue;
+        // 256字节的表在C.x.3之后只剩三个条目（RFC给出的动态表状态），索引65已被淘汰
+        H2HeaderList table;
+        H2HeaderList evicted;
+        check(decoder.decode(unhex("bebfc0"), table) && table.size() == 3 && table[0] == response3[5] &&
+              table[1] == response3[4] && table[2] == response3[2] && !decoder.decode(unhex("c1"), evicted),
+              std::string("HPACK 动态表在") + sequence.name + "之后没有按大小淘汰旧条目");
+    }
+
+    // 编码器与解码器往返：对端表大小256时同样要淘汰旧条目
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    encoder.set_peer_table_size(256);
+    for (const H2HeaderList* response : std::vector<const H2HeaderList*>{&response1, &response2, &response3}) {
+        std::string block;
+        encoder.begin_block(block);
+        for (const auto& header : *response) encoder.encode(header.first, header.second, block);
+        H2HeaderList headers;
+        check(decoder.decode(block, headers) && headers == *response, "HPACK 编码结果解码后与原头部不一致");
+    }
+
+    // 引用不存在的动态表条目、超过声明大小的表大小更新、截断的Huffman串都是解码错误
+    for (const char* block : {"be", "3fe21f", "418cf1e3c2e5f23a6ba0ab90f4"}) {
+        H2HeaderList headers;
+        check(!HpackDecoder().decode(unhex(block), headers), std::string("HPACK 没有拒绝无效的头部块 ") + block);
+    }
+}
+
+// 请求路径上的日志：级别未开启时的开销，以及格式化并入队的开销（队列满时丢弃）
+void logging(std::vector<Result>& results) {
+    std::string path = "/root/llm/ckpt/qwen";
+    results.push_back(run("log_event/filtered", [&] {
+        log_event(LogLevel::Debug, "bench.filtered").str("body", path);
+    }, true));
+    results.push_back(run("log_event/info", [&] {
+        log_event(LogLevel::Info, "bench.info").str("path", path).num("bytes", 4096);
+    }, true));
+}
+
+#ifndef _WIN32
+// 完整连接处理：通过socketpair发送请求，serve_connection读取、路由并写回响应
+void connection_roundtrip(std::vector<Result>& results) {
+    std::string task_id = g_task_registry.create("prepare");
+    // 结果较大的任务，带Accept-Encoding时响应在请求内存池中压缩
+    std::string log_task_id = g_task_registry.create("inference");
+    std::string log_lines;
+    for (int i = 0; i < 40; ++i) log_lines += " 45%|████▌     | 450/1000 [00:05<00:07, 6.00it/s]\n";
+    g_task_registry.append_result(log_task_id, log_lines);
+    struct Case {
+        const char* name;
+        std::string request;
+    };
+    std::vector<Case> cases = {
+        {"serve_connection/default_config", "GET /api/default-config HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n"},
+        {"serve_connection/cors_preflight", "OPTIONS /api/config/save HTTP/1.1\r\nHost: localhost\r\nOrigin: http://localhost:5173\r\n\r\n"},
+        {"serve_connection/task_status", "GET /api/task/status?task_id=" + task_id + " HTTP/1.1\r\nHost: localhost\r\n\r\n"},
+        {"serve_connection/task_status_gzip", "GET /api/task/status?task_id=" + log_task_id + " HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip, deflate, br\r\n\r\n"},
+    };
+    for (const Case& c : cases) {
+        const std::string& request = c.request;
+        results.push_back(run(c.name, [&request] {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return;
+            send_all(fds[0], request.data(), request.size());
+            serve_connection(fds[1]);
+            char buffer[4096];
+            size_t total = 0;
+            long n;
+            while ((n = sock_recv(fds[0], buffer, sizeof(buffer))) > 0) total += static_cast<size_t>(n);
+            close(fds[0]);
+            g_sink = g_sink + total;
+        }, true, 100));
+    }
+}
+#endif
+
+// 训练参数校验：类型、取值范围、可选值和路径在提交训练时被拒绝，不会启动训练进程
+void training_params() {
+    const std::vector<std::pair<std::string, std::string>> valid = {
+        {"model_name_or_path", "\"/ckpt/ds\""}, {"output_dir", "\"/output/bench/lora\""}, {"train_file", "\"data/sample.jsonl\""},
+        {"num_train_epochs", "\"3\""}, {"learning_rate", "2e-4"}, {"lora_dropout", "0.05"}, {"fp16", "false"}, {"optim", "\"adamw_torch\""},
+    };
+    auto body_with = [&](const std::string& name, const std::string& value) {
+        std::string body = "{";
+        for (const auto& param : valid) {
+            if (param.first == name && value.empty()) continue;
+            body += (body.size() > 1 ? "," : "") + ("\"" + param.first + "\":") + (param.first == name ? value : param.second);
+        }
+        if (!name.empty() && std::none_of(valid.begin(), valid.end(), [&](const auto& param) { return param.first == name; })) {
+            body += ",\"" + name + "\":" + value;
+        }
+        return body + "}";
+    };
+
+    JsonValue config;
+    std::string body = body_with("", "");
+    check(json_parse(body, config, nullptr), "训练参数测试的请求体不是有效的JSON");
+    ValidatedConfig validated = validate_training_config(config, true);
+    check(validated.ok() && validated.values["num_train_epochs"] == "3" && validated.values["learning_rate"] == "0.0002",
+          "有效的训练参数没有通过校验或没有规范化: " + config_issues_to_text(validated.issues));
+
+    const std::vector<std::pair<std::string, std::string>> rejected = {
+        {"num_train_epochs", "\"abc\""},                 // 类型
+        {"per_device_train_batch_size", "1.5"},          // 整数
+        {"learning_rate", "0"},                          // 开区间下界
+        {"lora_dropout", "1"},                           // 开区间上界
+        {"max_seq_length", "4"},                         // 闭区间下界
+        {"fp16", "\"yes\""},                             // 布尔
+        {"optim", "\"sgdx\""},                           // 可选值
+        {"output_dir", "\"../../etc/cron.d\""},          // 路径穿越
+        {"train_file", "\"data/..\\\\..\\\\x.jsonl\""},  // 反斜杠分隔的路径穿越
+        {"model_name_or_path", "\"/ckpt/ds;rm -rf ~\""}, // 命令行特殊字符
+        {"train_file", ""},                              // 缺少必要参数
+    };
+    for (const auto& param : rejected) {
+        std::string request_body = body_with(param.first, param.second);
+        std::string request = "POST /api/train HTTP/1.1\r\nContent-Length: " + std::to_string(request_body.size()) + "\r\n\r\n" + request_body;
+        std::string response = handle_api_request("/api/train", request, "POST");
+        check(response.find("\"success\":false") != std::string::npos &&
+              response.find("\"field\":\"" + param.first + "\"") != std::string::npos,
+              "/api/train 没有拒绝参数 " + param.first + "=" + param.second);
+    }
+}
+
+// 预分词与训练脚本的一致性：llm/data/sample.jsonl的token id须与transformers的结果相同。
+// 在仓库根目录运行；模型目录取ELIAN_PARITY_MODEL（文件系统路径），缺省为默认配置中的/ckpt/ds（llm/ckpt/ds）。
+// 没有模型、Python或transformers时返回77，ctest记为跳过
+int tokenizer_parity() {
+    const int skipped = 77;
+    const char* value = std::getenv("ELIAN_PARITY_MODEL");
+    std::string model_dir = value && *value ? std::string(value) : resolve_llm_path("/ckpt/ds");
+    std::string error;
+    std::shared_ptr<const BpeTokenizer> tokenizer = g_tokenizers.get(model_dir, error);
+    if (!tokenizer) {
+        std::cerr << "skip: " << error << std::endl;
+        return skipped;
+    }
+    std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(get_current_dir() + "/llm/data/sample.jsonl");
+    check(index && index->record_count() > 0, "llm/data/sample.jsonl 不存在或为空");
+    if (!index) return 1;
+
+    std::string report;
+    TokenizerParity parity = check_tokenizer_parity(*tokenizer, *index, model_dir, 1024,
+                                                    get_current_dir() + "/llm/data/.tokenizer_parity.json", report);
+    if (parity == TokenizerParity::Unavailable) {
+        std::cerr << "skip: " << report << std::endl;
+        return skipped;
+    }
+    check(parity == TokenizerParity::Match, "sample.jsonl 的预分词结果与transformers不一致: " + report);
+    if (parity == TokenizerParity::Match) std::cout << "tokenizer_parity: " << report << " 条记录一致" << std::endl;
+    return g_check_failures == 0 ? 0 : 1;
+}
+
+#ifdef __linux__
+// 慢客户端隔离：N个SO_REUSEPORT监听socket各跑一个事件循环，一个客户端发完请求头后停住，
+// 之后的连接按四元组散到各个循环上，都必须及时得到响应
+template <typename Loop>
+void slow_client_isolation(const char* backend) {
+    const size_t workers = 4;
+    const int requests = 32;
+    std::vector<int> listeners;
+    int first = open_listener(0, true, SOMAXCONN);
+    check(first >= 0, std::string(backend) + " 无法监听临时端口");
+    if (first < 0) return;
+    sockaddr_in address{};
+    socklen_t address_size = sizeof(address);
+    getsockname(first, reinterpret_cast<sockaddr*>(&address), &address_size);
+    int port = ntohs(address.sin_port);
+    listeners.push_back(first);
+    while (listeners.size() < workers) {
+        int fd = open_listener(port, true, SOMAXCONN);
+        check(fd >= 0, std::string(backend) + " 无法用SO_REUSEPORT监听第二个socket");
+        if (fd < 0) break;
+        listeners.push_back(fd);
+    }
+    for (int fd : listeners) {
+        Loop* loop = new Loop();  // 事件循环不返回，随进程结束
+        if (!loop->init(fd)) {
+            std::cerr << "skip: " << backend << " 不可用" << std::endl;
+            return;
+        }
+        std::thread([loop]() { loop->run(); }).detach();
+    }
+
+    auto connect_local = [port]() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in target{};
+        target.sin_family = AF_INET;
+        target.sin_port = htons(static_cast<uint16_t>(port));
+        target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        timeval timeout{2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, reinterpret_cast<sockaddr*>(&target), sizeof(target)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    };
+
+    // 请求体超过事件循环缓冲区，交给阻塞处理后停在读请求体上
+    int slow = connect_local();
+    std::string slow_request = "POST /api/config/save HTTP/1.1\r\nHost: localhost\r\nContent-Length: 100000\r\n\r\n{";
+    if (slow >= 0) send_all(slow, slow_request.data(), slow_request.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    static const char request[] = "GET /api/default-config HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    int answered = 0;
+    for (int i = 0; i < requests; ++i) {
+        int fd = connect_local();
+        if (fd < 0) continue;
+        send_all(fd, request, sizeof(request) - 1);
+        char buffer[64];
+        long n = sock_recv(fd, buffer, sizeof(buffer));
+        if (n >= 12 && std::memcmp(buffer, "HTTP/1.1 200", 12) == 0) answered++;
+        close(fd);
+    }
+    check(slow >= 0 && answered == requests, std::string(backend) + " 一个慢客户端拖住了其他连接：" + std::to_string(requests) +
+                                             " 个请求只有 " + std::to_string(answered) + " 个及时得到响应");
+    if (slow >= 0) close(slow);
+}
+
+// 会启动子进程或扫描整个数据集的请求交给工作线程，缓存命中时在事件循环上直接响应
+void blocking_routes() {
+    struct Case {
+        const char* request;
+        bool blocking;
+    };
+    auto blocking = [](const std::string& text) {
+        HttpRequestHead req;
+        parse_request_head(text, text.find("\r\n\r\n"), req);
+        return needs_blocking_io(req);
+    };
+    const Case cases[] = {
+        {"POST /api/train HTTP/1.1\r\nContent-Length: 2\r\n\r\n", true},
+        {"POST /api/data/prepare HTTP/1.1\r\nContent-Length: 2\r\n\r\n", true},
+        {"POST /api/data/dedup HTTP/1.1\r\nContent-Length: 2\r\n\r\n", true},
+        {"GET /api/data/stats?file=train.jsonl HTTP/1.1\r\n\r\n", true},
+        {"POST /api/inference HTTP/1.1\r\nContent-Length: 2\r\n\r\n", true},
+        {"GET /api/default-config HTTP/1.1\r\n\r\n", false},
+        {"GET /api/config/list HTTP/1.1\r\n\r\n", false},
+        {"POST /api/config/save HTTP/1.1\r\nContent-Length: 2\r\n\r\n", false},
+    };
+    for (const Case& c : cases) {
+        check(blocking(c.request) == c.blocking, std::string("needs_blocking_io 判断错误: ") + c.request);
+    }
+    // 日志没有变化的轮询直接回304，不占用工作线程
+    std::string logs = "GET /api/train/logs HTTP/1.1\r\nIf-None-Match: " + std::string(train_log_etag()) + "\r\n\r\n";
+    request_arena().reset();
+    check(!blocking(logs), "未变化的日志轮询应在事件循环上响应");
+    check(blocking("GET /api/train/logs?wait=5 HTTP/1.1\r\nIf-None-Match: \"x\"\r\n\r\n"), "挂起的日志长轮询应交给工作线程");
+    // 缓存未命中时要启动子进程，命中后不再交出去
+    const std::string info = "GET /api/system/info?_=1 HTTP/1.1\r\n\r\n";
+    check(blocking(info), "/api/system/info 缓存未命中时应交给工作线程");
+    g_response_cache.get("/api/system/info", 10.0, [] { return json_response("{}"); });
+    check(!blocking(info), "/api/system/info 缓存命中时应在事件循环上响应");
+}
+
+// 工作线程按类别限额：上传占满自己的限额后再来的上传被拒绝，其他请求不受影响
+void handoff_limits() {
+    HandoffPool* pool = new HandoffPool();   // 工作线程是detach的，不析构
+    // 请求体没有发完，工作线程停在读请求体上，直到关闭客户端一端
+    const std::string head = "POST /api/config/save HTTP/1.1\r\nContent-Length: 100\r\n\r\n";
+    std::vector<int> clients;
+    auto submit = [&](HandoffClass cls) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return false;
+        clients.push_back(fds[0]);
+        if (pool->submit(HandoffJob{fds[1], head, std::chrono::steady_clock::now(), cls})) return true;
+        close(fds[1]);
+        return false;
+    };
+    size_t limit = handoff_class_limit(HANDOFF_UPLOAD);
+    size_t accepted = 0;
+    for (size_t i = 0; i < limit; ++i) accepted += submit(HANDOFF_UPLOAD) ? 1 : 0;
+    check(accepted == limit, "上传限额内的连接被拒绝");
+    check(!submit(HANDOFF_UPLOAD), "上传超过限额后仍被接受");
+    check(submit(HANDOFF_STREAM), "上传占满限额后分块响应也被拒绝");
+    check(submit(HANDOFF_GENERAL), "上传占满限额后普通请求也被拒绝");
+    for (int fd : clients) close(fd);
+    for (int i = 0; i < 200 && pool->active_count(HANDOFF_UPLOAD) > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(pool->active_count(HANDOFF_UPLOAD) == 0, "上传连接结束后限额没有释放");
+}
+
+// 上传续传：第一次请求在一条记录中间断开，查询received后从该位置续传，被分开的记录拼接后校验通过；
+// 空闲的会话和服务重启前留下的.part文件被清理
+void upload_sessions() {
+    std::string llm_dir = get_current_dir() + "/llm";
+    std::string data_dir = llm_dir + "/data";
+    bool created_llm = !stat_file(llm_dir).exists;
+    bool created_data = !stat_file(data_dir).exists;
+    if (!create_directory(llm_dir) || !create_directory(data_dir)) return;
+    std::string final_path = data_dir + "/bench_upload.jsonl";
+    if (stat_file(final_path).exists) return;
+
+    std::string content = "{\"conversation\": [{\"human\": \"你好\", \"assistant\": \"你好！\"}]}\n"
+                          "{\"conversation\": [{\"human\": \"机器学习是什么？\", \"assistant\": \"让计算机从数据中学习。\"}]}\n"
+                          "{\"conversation\": [{\"human\": \"再见\", \"assistant\": \"再见！\"}]}\n";
+    size_t split = content.find("机器学习");   // 第二条记录中间
+    auto upload = [](const std::string& method, const std::string& url, size_t content_length, const std::string& body) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return std::string();
+        send_all(fds[0], body.data(), body.size());
+        shutdown(fds[0], SHUT_WR);  // 没发完声明的长度就断开
+        HttpRequestHead req;
+        req.method = method;
+        req.url = url;
+        req.content_length = content_length;
+        std::string response = handle_upload(fds[1], req);
+        close(fds[0]);
+        close(fds[1]);
+        return response;
+    };
+    std::string total = std::to_string(content.size());
+    upload("POST", "/api/data/upload?file=bench_upload.jsonl&offset=0&total=" + total, content.size(), content.substr(0, split));
+    std::string status = upload("GET", "/api/data/upload?file=bench_upload.jsonl", 0, "");
+    check(status.find("\"received\":" + std::to_string(split) + ",") != std::string::npos, "上传断开后received不是已写入的字节数");
+    std::string stale = upload("POST", "/api/data/upload?file=bench_upload.jsonl&offset=1&total=" + total, content.size() - 1, "");
+    check(stale.find("409 Conflict") != std::string::npos, "上传offset与received不一致时没有返回409");
+    std::string done = upload("POST", "/api/data/upload?file=bench_upload.jsonl&offset=" + std::to_string(split) + "&total=" + total,
+                              content.size() - split, content.substr(split));
+    check(done.find("\"complete\":true") != std::string::npos && done.find("\"records\":3,\"valid\":3,") != std::string::npos,
+          "续传后跨两次请求的记录没有拼接校验");
+    std::ifstream file(final_path, std::ios::binary);
+    std::string uploaded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    check(uploaded == content, "续传后的文件内容不一致");
+    std::remove(final_path.c_str());
+    std::remove(dataset_index_sidecar_path(final_path).c_str());
+
+    // 空闲会话连同.part删除；内存中没有会话的.part按修改时间删除
+    upload("POST", "/api/data/upload?file=bench_idle.jsonl&offset=0&total=100", 100, content.substr(0, 10));
+    std::string idle_part = data_dir + "/.bench_idle.jsonl.part";
+    std::string orphan_part = data_dir + "/.bench_orphan.jsonl.part";
+    atomic_write_file(orphan_part, "{");
+    check(stat_file(idle_part).exists, "上传中断后没有保留.part文件");
+    {
+        std::lock_guard<std::mutex> lock(g_upload_sessions_mtx);
+        expire_upload_sessions(data_dir, 0);
+        check(g_upload_sessions.count(data_dir + "/bench_idle.jsonl") == 0, "空闲的上传会话没有被删除");
+    }
+    check(!stat_file(idle_part).exists && !stat_file(orphan_part).exists, "空闲上传的.part文件没有被删除");
+
+    if (created_data) rmdir(data_dir.c_str());
+    if (created_llm) rmdir(llm_dir.c_str());
+}
+
+void event_loops() {
+    blocking_routes();
+    handoff_limits();
+    slow_client_isolation<EpollLoop>("epoll");
+#ifdef ELIAN_HAVE_IO_URING
+    slow_client_isolation<UringLoop>("uring");
+#endif
+}
+
+// HTTP/2帧解析：请求头部块拆成HEADERS和CONTINUATION并用Huffman编码，
+// 响应按帧头（长度、类型、标志、流ID）切分，HEADERS解码后得到:status 200，DATA的长度与content-length一致；
+// 超过H2_MAX_FRAME_SIZE的帧以FRAME_SIZE_ERROR关闭连接
+std::string h2_exchange(const std::string& frames) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return std::string();
+    std::string received;
+    std::thread reader([&received, fd = fds[0]] {
+        char buffer[16384];
+        long n;
+        while ((n = sock_recv(fd, buffer, sizeof(buffer))) > 0) received.append(buffer, static_cast<size_t>(n));
+    });
+    std::string out(H2_PREFACE);
+    send_all(fds[0], out.data(), out.size());
+    serve_connection(fds[1]);
+    send_all(fds[0], frames.data(), frames.size());
+    shutdown(fds[0], SHUT_WR);
+    reader.join();
+    close(fds[0]);
+    return received;
+}
+
+void http2_frames() {
+    std::string block;
+    const H2HeaderList request = {{":method", "GET"}, {":path", "/api/default-config"}, {":scheme", "http"}, {":authority", "www.example.com"}};
+    for (const auto& field : request) {
+        block += '\0';
+        for (const std::string& text : {field.first, field.second}) {
+            hpack_encode_integer(block, 0x80, 7, huffman_encoded_length(text));
+            huffman_encode(text, block);
+        }
+    }
+    std::string frames;
+    append_h2_frame(frames, H2_SETTINGS, 0, 0, std::string_view());
+    size_t split = block.size() / 2;
+    append_h2_frame(frames, H2_HEADERS, H2_FLAG_END_STREAM, 1, std::string_view(block).substr(0, split));
+    append_h2_frame(frames, H2_CONTINUATION, H2_FLAG_END_HEADERS, 1, std::string_view(block).substr(split));
+    std::string received = h2_exchange(frames);
+
+    HpackDecoder decoder;
+    H2HeaderList headers;
+    bool settings_first = false, settings_valid = true, headers_ok = true, end_stream = false;
+    size_t data_length = 0, frame_count = 0;
+    size_t pos = 0;
+    while (pos + 9 <= received.size()) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(received.data() + pos);
+        size_t length = (static_cast<size_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+        uint8_t type = p[3], flags = p[4];
+        uint32_t id = read_u32(p + 5) & 0x7FFFFFFF;
+        if (pos + 9 + length > received.size()) break;
+        std::string_view payload(received.data() + pos + 9, length);
+        if (frame_count++ == 0) settings_first = type == H2_SETTINGS && id == 0;
+        if (type == H2_SETTINGS && (id != 0 || length % 6 != 0)) settings_valid = false;
+        if (type == H2_HEADERS && id == 1) headers_ok = headers_ok && (flags & H2_FLAG_END_HEADERS) && decoder.decode(payload, headers);
+        if (type == H2_DATA && id == 1) {
+            data_length += length;
+            end_stream = end_stream || (flags & H2_FLAG_END_STREAM);
+        }
+        pos += 9 + length;
+    }
+    check(pos == received.size(), "HTTP/2 响应的帧长度与收到的字节数不一致");
+    check(settings_first && settings_valid, "HTTP/2 服务端的第一个帧不是流0上的SETTINGS");
+    auto header = [&](const std::string& name) {
+        for (const auto& item : headers) if (item.first == name) return item.second;
+        return std::string();
+    };
+    check(headers_ok && header(":status") == "200", "HTTP/2 拆分到CONTINUATION的Huffman头部块没有得到200响应");
+    check(end_stream && header("content-length") == std::to_string(data_length),
+          "HTTP/2 响应DATA的总长度与content-length不一致");
+
+    frames.clear();
+    append_h2_frame(frames, H2_SETTINGS, 0, 0, std::string_view());
+    std::string oversized(H2_MAX_FRAME_SIZE + 1, 'x');
+    append_h2_frame(frames, H2_DATA, 0, 1, oversized);
+    received = h2_exchange(frames);
+    uint32_t goaway_code = 0;
+    for (pos = 0; pos + 9 <= received.size();) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(received.data() + pos);
+        size_t length = (static_cast<size_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+        if (p[3] == H2_GOAWAY && length >= 8 && pos + 17 <= received.size()) goaway_code = read_u32(p + 13);
+        pos += 9 + length;
+    }
+    check(goaway_code == H2_FRAME_SIZE_ERROR, "HTTP/2 超过最大帧长度的帧没有以FRAME_SIZE_ERROR关闭连接");
+}
+
+// HTTP/2：窗口在收到DATA时就归还，一个连接上缓冲的请求体总量由H2_MAX_BUFFERED_BODY限制，
+// 两个流合计超过上限时后一个流被ENHANCE_YOUR_CALM重置
+void http2_body_limit() {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) return;
+    std::string out(H2_PREFACE);
+    std::string frames;
+    std::thread reader([&frames, fd = fds[0]] {
+        char buffer[16384];
+        long n;
+        while ((n = sock_recv(fd, buffer, sizeof(buffer))) > 0) frames.append(buffer, static_cast<size_t>(n));
+    });
+    send_all(fds[0], out.data(), out.size());
+    serve_connection(fds[1]);   // 读到前言后交给HTTP/2线程
+
+    out.clear();
+    append_h2_frame(out, H2_SETTINGS, 0, 0, std::string_view());
+    std::string block;
+    for (const char* field : {"\x07:method\x04POST", "\x05:path\x10/api/config/save", "\x07:scheme\x04http"}) {
+        block += '\0';
+        block += field;
+    }
+    append_h2_frame(out, H2_HEADERS, H2_FLAG_END_HEADERS, 1, block);
+    append_h2_frame(out, H2_HEADERS, H2_FLAG_END_HEADERS, 3, block);
+    send_all(fds[0], out.data(), out.size());
+    std::string chunk(H2_MAX_FRAME_SIZE, 'x');
+    size_t per_stream = H2_MAX_BUFFERED_BODY / 2 + H2_MAX_FRAME_SIZE * 4;
+    for (uint32_t id : {1u, 3u}) {
+        for (size_t sent = 0; sent < per_stream; sent += chunk.size()) {
+            out.clear();
+            append_h2_frame(out, H2_DATA, 0, id, chunk);
+            send_all(fds[0], out.data(), out.size());
+        }
+    }
+    shutdown(fds[0], SHUT_WR);
+    reader.join();
+    close(fds[0]);
+
+    uint32_t reset_code = 0;
+    bool stream1_reset = false;
+    for (size_t pos = 0; pos + 9 <= frames.size();) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(frames.data() + pos);
+        size_t length = (static_cast<size_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+        uint32_t id = read_u32(p + 5) & 0x7FFFFFFF;
+        if (p[3] == H2_RST_STREAM && length == 4 && pos + 13 <= frames.size()) {
+            if (id == 1) stream1_reset = true;
+            if (id == 3 && reset_code == 0) reset_code = read_u32(p + 9);
+        }
+        pos += 9 + length;
+    }
+    check(reset_code == H2_ENHANCE_YOUR_CALM, "HTTP/2 缓冲的请求体超过上限时没有以ENHANCE_YOUR_CALM重置流");
+    check(!stream1_reset, "HTTP/2 请求体上限内的流被重置");
+}
+
+// WebSocket：不读取的订阅者只在自己的输出缓冲里积压，其他连接照常收到推送；
+// 积压超过WS_MAX_PENDING后这个连接被断开
+void websocket_stalled_subscriber() {
+    std::string log_path = get_current_dir() + "/train_log.txt";
+    if (stat_file(log_path).exists) return;   // 不覆盖已有的训练日志
+    std::string chunk(WS_LOG_PUSH_LIMIT, 'x');
+    auto append_log = [&] {
+        FILE* file = fopen(log_path.c_str(), "ab");
+        fwrite(chunk.data(), 1, chunk.size(), file);
+        fclose(file);
+    };
+    append_log();
+    auto subscribe = [](int fd, const std::string& text) {
+        std::string frame = "\x81";
+        frame += static_cast<char>(0x80 | text.size());
+        frame.append(4, '\0');  // 全零掩码
+        frame += text;
+        send_all(fd, frame.data(), frame.size());
+    };
+    int stalled[2], live[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, stalled) != 0) return;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, live) != 0) return;
+    int small = 16 * 1024;
+    setsockopt(stalled[1], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    check(g_websocket_hub.adopt(stalled[1]) && g_websocket_hub.adopt(live[1]), "WebSocket连接没有被接管");
+    subscribe(stalled[0], "{\"op\":\"subscribe\",\"topic\":\"logs\"}");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    auto started = std::chrono::steady_clock::now();
+    subscribe(live[0], "{\"op\":\"subscribe\",\"topic\":\"job\",\"task_id\":\"bench\"}");
+    std::string received;
+    pollfd pfd = {live[0], POLLIN, 0};
+    while (received.find("\"topic\":\"job\"") == std::string::npos && poll(&pfd, 1, 1000) > 0) {
+        char buffer[4096];
+        long n = sock_recv(live[0], buffer, sizeof(buffer));
+        if (n <= 0) break;
+        received.append(buffer, static_cast<size_t>(n));
+    }
+    double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    check(received.find("\"topic\":\"job\"") != std::string::npos && waited < 1.0,
+          "WebSocket 不读取的订阅者拖慢了其他连接的推送");
+
+    // 日志持续增长，积压很快超过上限
+    for (size_t i = 0; i < WS_MAX_PENDING / WS_LOG_PUSH_LIMIT * 3; ++i) {
+        append_log();
+        std::this_thread::sleep_for(std::chrono::milliseconds(WS_TICK_MS / 2));
+    }
+    bool dropped = false;
+    pfd.fd = stalled[0];
+    while (poll(&pfd, 1, 2000) > 0) {
+        char buffer[65536];
+        long n = sock_recv(stalled[0], buffer, sizeof(buffer));
+        if (n <= 0) {
+            dropped = n == 0;
+            break;
+        }
+    }
+    check(dropped, "WebSocket 输出缓冲超过上限的连接没有被断开");
+    close(stalled[0]);
+    close(live[0]);
+    remove(log_path.c_str());
+}
+#endif
+
+}  // namespace bench
+
+int main(int argc, char** argv) {
+    bool assert_zero_alloc = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--assert-zero-alloc") {
+            assert_zero_alloc = true;
+        } else if (arg == "--tokenizer-parity") {
+            return bench::tokenizer_parity();
+        } else {
+            bench::g_filter = arg;
+        }
+    }
+
+    // 日志写到空设备，避免和结果表格混在一起
+#ifdef _WIN32
+    _putenv_s("ELIAN_LOG_FILE", "NUL");
+#else
+    setenv("ELIAN_LOG_FILE", "/dev/null", 0);
+#endif
+
+    std::vector<bench::Result> results;
+    bench::static_responses(results);
+    bench::task_polling(results);
+    bench::json_helpers(results);
+    bench::file_preview(results);
+    bench::routing(results);
+    bench::hashing(results);
+    bench::response_cache();
+    bench::hpack_vectors();
+    bench::training_params();
+    bench::logging(results);
+#ifndef _WIN32
+    bench::connection_roundtrip(results);
+#endif
+#ifdef __linux__
+    bench::http2_frames();
+    bench::http2_body_limit();
+    bench::websocket_stalled_subscriber();
+    bench::upload_sessions();
+    bench::event_loops();
+#endif
+
+    std::cout << std::left << std::setw(48) << "benchmark" << std::right << std::setw(14) << "iterations"
+              << std::setw(14) << "ns/op" << std::setw(12) << "allocs/op" << std::endl;
+    int failures = 0;
+    for (const auto& result : results) {
+        if (result.iterations == 0) continue;
+        std::cout << std::left << std::setw(48) << result.name << std::right << std::setw(14) << result.iterations
+                  << std::setw(14) << std::fixed << std::setprecision(1) << result.ns_per_op
+                  << std::setw(12) << std::setprecision(2) << result.allocs_per_op << std::endl;
+        if (assert_zero_alloc && result.hot && result.allocs_per_op > 0) {
+            std::cerr << "FAIL: " << result.name << " 稳态下每次调用分配 " << result.allocs_per_op << " 次" << std::endl;
+            failures++;
+        }
+    }
+    failures += bench::g_check_failures;
+    return failures == 0 ? 0 : 1;
+}
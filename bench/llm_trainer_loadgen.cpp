@@ -0,0 +1,373 @@
+// llm_trainer_server 压测工具
+// 对运行中的服务器按给定并发和端点比例持续发请求，结束后以JSON输出吞吐量和延迟分布，便于不同版本之间对比。
+// 服务器每个连接只处理一个请求，这里每个请求都新建连接，测得的延迟包含建连时间。
+// 用法: llm_trainer_loadgen [选项]
+//   --host 127.0.0.1          服务器地址（IPv4）
+//   --port 10171              端口
+//   --concurrency 8           并发连接数（每个连接一个线程）
+//   --duration 10             持续时间（秒）
+//   --requests 0              总请求数上限，0表示只按持续时间结束
+//   --endpoint "[方法] 路径 [权重]"  可重复，例如 --endpoint "/api/gpu/status 3" --endpoint "POST /api/data/preview 1"
+//   --body '{...}' 或 @文件    POST/PUT请求的请求体
+//   --timeout 5               单个请求的超时（秒）
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define close_socket closesocket
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+typedef int socket_t;
+#define close_socket close
+#endif
+
+struct Endpoint {
+    std::string method = "GET";
+    std::string path;
+    unsigned weight = 1;
+    std::string request;    // 预先拼好的完整请求
+};
+
+// 每个线程各自记录，结束后合并
+struct WorkerStats {
+    std::vector<std::vector<uint32_t>> latencies_us;   // 按端点分开
+    std::vector<uint64_t> errors;                       // 连接失败、超时或非2xx/3xx
+    uint64_t status_classes[6] = {0, 0, 0, 0, 0, 0};   // 下标0表示没有拿到状态码
+    uint64_t bytes_received = 0;
+};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 10171;
+    int concurrency = 8;
+    double duration = 10;
+    uint64_t requests = 0;
+    int timeout = 5;
+    std::string body;
+    std::vector<Endpoint> endpoints;
+};
+
+bool parse_endpoint(const std::string& spec, Endpoint& endpoint) {
+    std::istringstream in(spec);
+    std::vector<std::string> parts;
+    std::string part;
+    while (in >> part) parts.push_back(part);
+    if (parts.empty()) return false;
+    size_t i = 0;
+    if (parts[0][0] != '/') endpoint.method = parts[i++];
+    if (i >= parts.size() || parts[i][0] != '/') return false;
+    endpoint.path = parts[i++];
+    if (i < parts.size()) endpoint.weight = static_cast<unsigned>(std::max(1, std::atoi(parts[i].c_str())));
+    return true;
+}
+
+std::string build_request(const Options& options, const Endpoint& endpoint) {
+    std::ostringstream request;
+    request << endpoint.method << " " << endpoint.path << " HTTP/1.1\r\n";
+    request << "Host: " << options.host << ":" << options.port << "\r\n";
+    request << "User-Agent: llm_trainer_loadgen\r\n";
+    request << "Connection: close\r\n";
+    if (endpoint.method == "POST" || endpoint.method == "PUT") {
+        request << "Content-Type: application/json\r\n";
+        request << "Content-Length: " << options.body.size() << "\r\n\r\n" << options.body;
+    } else {
+        request << "\r\n";
+    }
+    return request.str();
+}
+
+void set_timeout(socket_t fd, int seconds) {
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(seconds * 1000);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#else
+    struct timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+// 发送一个请求并读到连接关闭，返回HTTP状态码，失败返回0
+int do_request(const sockaddr_in& address, const Options& options, const std::string& request, uint64_t& bytes) {
+    socket_t fd = socket(AF_INET, SOCK_STREAM, 0);
+#ifdef _WIN32
+    if (fd == INVALID_SOCKET) return 0;
+#else
+    if (fd < 0) return 0;
+#endif
+    set_timeout(fd, options.timeout);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close_socket(fd);
+        return 0;
+    }
+    size_t sent = 0;
+    while (sent < request.size()) {
+        int n = send(fd, request.data() + sent, static_cast<int>(request.size() - sent), 0);
+        if (n <= 0) {
+            close_socket(fd);
+            return 0;
+        }
+        sent += static_cast<size_t>(n);
+    }
+
+    char buffer[16384];
+    char status_line[16] = {0};
+    size_t status_size = 0;
+    while (true) {
+        int n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            close_socket(fd);
+            return 0;
+        }
+        if (n == 0) break;
+        bytes += static_cast<uint64_t>(n);
+        size_t copy = std::min(sizeof(status_line) - 1 - status_size, static_cast<size_t>(n));
+        std::memcpy(status_line + status_size, buffer, copy);
+        status_size += copy;
+    }
+    close_socket(fd);
+    // "HTTP/1.1 200 ..."
+    if (status_size < 12 || std::strncmp(status_line, "HTTP/1.", 7) != 0) return 0;
+    return std::atoi(status_line + 9);
+}
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(std::ceil(p * sorted.size()));
+    if (index > 0) index--;
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+std::string escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void print_usage() {
+    std::cerr << "用法: llm_trainer_loadgen [--host H] [--port P] [--concurrency N] [--duration S] [--requests N]\n"
+              << "                          [--endpoint \"[方法] 路径 [权重]\"]... [--body JSON|@文件] [--timeout S]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& value) {
+            if (i + 1 >= argc) return false;
+            value = argv[++i];
+            return true;
+        };
+        std::string value;
+        if (arg == "--help" || arg == "-h") {
+            print_usage();
+            return 0;
+        } else if (!next(value)) {
+            print_usage();
+            return 2;
+        } else if (arg == "--host") {
+            options.host = value;
+        } else if (arg == "--port") {
+            options.port = std::atoi(value.c_str());
+        } else if (arg == "--concurrency") {
+            options.concurrency = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (arg == "--requests") {
+            options.requests = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--timeout") {
+            options.timeout = std::max(1, std::atoi(value.c_str()));
+        } else if (arg == "--body") {
+            if (!value.empty() && value[0] == '@') {
+                std::ifstream file(value.substr(1), std::ios::binary);
+                if (!file) {
+                    std::cerr << "无法读取请求体文件: " << value.substr(1) << std::endl;
+                    return 2;
+                }
+                std::ostringstream content;
+                content << file.rdbuf();
+                options.body = content.str();
+            } else {
+                options.body = value;
+            }
+        } else if (arg == "--endpoint") {
+            Endpoint endpoint;
+            if (!parse_endpoint(value, endpoint)) {
+                std::cerr << "无效的端点: " << value << std::endl;
+                return 2;
+            }
+            options.endpoints.push_back(endpoint);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (options.endpoints.empty()) {
+        Endpoint endpoint;
+        endpoint.path = "/api/default-config";
+        options.endpoints.push_back(endpoint);
+    }
+    for (auto& endpoint : options.endpoints) endpoint.request = build_request(options, endpoint);
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "Failed to initialize Winsock" << std::endl;
+        return 1;
+    }
+#endif
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "无效的IPv4地址: " << options.host << std::endl;
+        return 2;
+    }
+
+    // 按权重展开成抽样表
+    std::vector<size_t> schedule;
+    for (size_t i = 0; i < options.endpoints.size(); ++i) {
+        for (unsigned w = 0; w < options.endpoints[i].weight; ++w) schedule.push_back(i);
+    }
+
+    std::vector<WorkerStats> stats(static_cast<size_t>(options.concurrency));
+    std::atomic<uint64_t> issued{0};
+    std::atomic<bool> stop{false};
+    auto started = std::chrono::steady_clock::now();
+    auto deadline = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.duration));
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < options.concurrency; ++w) {
+        workers.emplace_back([&, w] {
+            WorkerStats& local = stats[static_cast<size_t>(w)];
+            local.latencies_us.resize(options.endpoints.size());
+            local.errors.resize(options.endpoints.size());
+            std::mt19937 rng(static_cast<unsigned>(w) * 7919u + 17u);
+            std::uniform_int_distribution<size_t> pick(0, schedule.size() - 1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (options.requests > 0 && issued.fetch_add(1) >= options.requests) break;
+                if (std::chrono::steady_clock::now() >= deadline) break;
+                size_t e = schedule[pick(rng)];
+                auto begin = std::chrono::steady_clock::now();
+                int status = do_request(address, options, options.endpoints[e].request, local.bytes_received);
+                auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+                local.status_classes[status >= 100 && status < 600 ? status / 100 : 0]++;
+                if (status < 200 || status >= 400) {
+                    local.errors[e]++;
+                } else {
+                    local.latencies_us[e].push_back(static_cast<uint32_t>(std::min<long long>(elapsed, UINT32_MAX)));
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // 合并各线程的结果
+    std::vector<uint32_t> all;
+    std::vector<std::vector<uint32_t>> per_endpoint(options.endpoints.size());
+    std::vector<uint64_t> endpoint_errors(options.endpoints.size(), 0);
+    uint64_t status_classes[6] = {0, 0, 0, 0, 0, 0};
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    for (const auto& local : stats) {
+        for (size_t e = 0; e < local.latencies_us.size(); ++e) {
+            per_endpoint[e].insert(per_endpoint[e].end(), local.latencies_us[e].begin(), local.latencies_us[e].end());
+            endpoint_errors[e] += local.errors[e];
+            errors += local.errors[e];
+        }
+        for (int c = 0; c < 6; ++c) status_classes[c] += local.status_classes[c];
+        bytes += local.bytes_received;
+    }
+    for (auto& latencies : per_endpoint) {
+        std::sort(latencies.begin(), latencies.end());
+        all.insert(all.end(), latencies.begin(), latencies.end());
+    }
+    std::sort(all.begin(), all.end());
+    uint64_t completed = all.size();
+    double mean = 0;
+    for (uint32_t v : all) mean += v;
+    if (completed > 0) mean /= static_cast<double>(completed);
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1);
+    json << "{\n";
+    json << "  \"target\": \"" << escape(options.host) << ":" << options.port << "\",\n";
+    json << "  \"concurrency\": " << options.concurrency << ",\n";
+    json << "  \"duration_s\": " << std::setprecision(3) << elapsed_s << std::setprecision(1) << ",\n";
+    json << "  \"requests\": " << completed + errors << ",\n";
+    json << "  \"completed\": " << completed << ",\n";
+    json << "  \"errors\": " << errors << ",\n";
+    json << "  \"throughput_rps\": " << (elapsed_s > 0 ? completed / elapsed_s : 0) << ",\n";
+    json << "  \"bytes_received\": " << bytes << ",\n";
+    json << "  \"status\": {\"none\": " << status_classes[0];
+    for (int c = 1; c < 6; ++c) json << ", \"" << c << "xx\": " << status_classes[c];
+    json << "},\n";
+    json << "  \"latency_us\": {\"min\": " << (all.empty() ? 0 : all.front()) << ", \"mean\": " << mean
+         << ", \"p50\": " << percentile(all, 0.50) << ", \"p90\": " << percentile(all, 0.90)
+         << ", \"p99\": " << percentile(all, 0.99) << ", \"p999\": " << percentile(all, 0.999)
+         << ", \"max\": " << (all.empty() ? 0 : all.back()) << "},\n";
+    // 以2的幂为桶上界的延迟直方图，只输出非空桶
+    json << "  \"histogram_us\": [";
+    bool first = true;
+    size_t index = 0;
+    for (uint64_t upper = 1; index < all.size(); upper *= 2) {
+        size_t count = 0;
+        while (index < all.size() && all[index] <= upper) {
+            ++index;
+            ++count;
+        }
+        if (count == 0) continue;
+        json << (first ? "" : ", ") << "{\"le\": " << upper << ", \"count\": " << count << "}";
+        first = false;
+    }
+    json << "],\n";
+    json << "  \"endpoints\": [\n";
+    for (size_t e = 0; e < options.endpoints.size(); ++e) {
+        const auto& latencies = per_endpoint[e];
+        json << "    {\"method\": \"" << escape(options.endpoints[e].method) << "\", \"path\": \"" << escape(options.endpoints[e].path)
+             << "\", \"weight\": " << options.endpoints[e].weight << ", \"completed\": " << latencies.size()
+             << ", \"errors\": " << endpoint_errors[e] << ", \"p50_us\": " << percentile(latencies, 0.50)
+             << ", \"p99_us\": " << percentile(latencies, 0.99) << ", \"p999_us\": " << percentile(latencies, 0.999) << "}"
+             << (e + 1 < options.endpoints.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n";
+    json << "}\n";
+    std::cout << json.str();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return errors > 0 && completed == 0 ? 1 : 0;
+}
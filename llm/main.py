@@ -17,12 +17,32 @@ from transformers import (
 import os
 from models.transformers_model import load_model
 from mydataloader.loader_transformers import process_data
+from mydataloader.loader_prepared import load_prepared_dataset, PackedDataCollator
 from combin_weight import merge_lora_to_base_model
 import warnings
 warnings.simplefilter("ignore")
 warnings.filterwarnings("ignore", category=FutureWarning)
 warnings.filterwarnings("ignore", category=UserWarning)
 
+LLM_DIR = os.path.dirname(os.path.abspath(__file__))
+PATH_KEYS = ('model_name_or_path', 'output_dir', 'train_file')
+
+
+def default_config_path():
+    for path in (os.path.join(LLM_DIR, "configs", "default_config.json"),
+                 "C:\\Windows\\elianfactory\\default_config.json"):
+        if os.path.isfile(path):
+            return path
+    return None
+
+
+def resolve_llm_path(path):
+    """带盘符的绝对路径原样使用，其余路径去掉开头的斜杠后拼到llm目录下"""
+    if not path or (len(path) > 1 and path[1] == ':'):
+        return path
+    return os.path.join(LLM_DIR, path.lstrip('/\\'))
+
+
 def configuration_parameter():
     parser = argparse.ArgumentParser(description="LoRA fine-tuning for deepseek-r1 model @Elian")
     parser.add_argument('--config', type=str, help='配置文件路径')
@@ -114,16 +134,18 @@ def configuration_parameter():
         except Exception as e:
             print(f"加载配置文件时出错: {e}")
             exit(1)
-    with open("C:\Windows\elianfactory\default_config.json", 'r', encoding='utf-8') as f:
-        config_dict = json.load(f)
-    for key, value in config_dict.items():
-        # 跳过config参数本身
-        if key == 'config':
-            continue
-        if key in ['distributed', 'gradient_checkpointing', 'fp16']:
-            # 对于store_true参数，设置布尔值
-            setattr(args, key, value)
-        else:
+    # 服务端保存的默认配置在llm/configs下，兼容旧版本写在C:\Windows\elianfactory的配置
+    default_config = default_config_path()
+    if default_config:
+        with open(default_config, 'r', encoding='utf-8') as f:
+            config_dict = json.load(f)
+        for key, value in config_dict.items():
+            # 跳过config参数本身
+            if key == 'config':
+                continue
+            if key in PATH_KEYS and isinstance(value, str):
+                # 配置中保存的是界面输入的原始路径，按服务端规则解析到llm目录下
+                value = resolve_llm_path(value)
             setattr(args, key, value)
     
     args = parser.parse_args(remaining_argv, namespace=args)
@@ -151,13 +173,21 @@ def main():
     print("加载完毕!~...@Elian")
     print("🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟处理数据@Elian🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟")
     # 处理数据
-    data = pd.read_json(args.train_file, lines=True)
-    train_ds = Dataset.from_pandas(data)
-    train_dataset = train_ds.map(process_data,
-                                 fn_kwargs={"tokenizer": tokenizer, "max_seq_length": args.max_seq_length},
-                                 remove_columns=train_ds.column_names)
+    if args.train_file.endswith(".bin"):
+        # 服务端已完成分词的二进制分片，直接内存映射读取
+        train_dataset = load_prepared_dataset(args.train_file)
+    else:
+        data = pd.read_json(args.train_file, lines=True)
+        train_ds = Dataset.from_pandas(data)
+        train_dataset = train_ds.map(process_data,
+                                     fn_kwargs={"tokenizer": tokenizer, "max_seq_length": args.max_seq_length},
+                                     remove_columns=train_ds.column_names)
     print(f"☀️☀️☀️训练数据共{len(train_dataset)}条☀️☀️☀️")
-    data_collator = DataCollatorForSeq2Seq(tokenizer=tokenizer, padding=True, return_tensors="pt")
+    if getattr(train_dataset, "packed", False):
+        # 打包后的序列需要按样本边界构造注意力掩码
+        data_collator = PackedDataCollator(pad_token_id=train_dataset.eos_id, fp16=args.fp16)
+    else:
+        data_collator = DataCollatorForSeq2Seq(tokenizer=tokenizer, padding=True, return_tensors="pt")
     print("🌟🌟数据集处理完毕!~...@Elian")
     # 加载模型
     print("🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟训练@Elian🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟")
@@ -0,0 +1,114 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# @File    : loader_prepared.py
+# @Description: 读取服务端预分词生成的二进制分片(.bin)，格式见llm_trainer_server.cpp中的TokenShardHeader
+import numpy as np
+import torch
+from torch.utils.data import Dataset
+
+SHARD_MAGIC = b"ELSHARD1"
+SHARD_PACKED = 1
+HEADER_DTYPE = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("flags", "<u4"),
+    ("num_samples", "<u8"),
+    ("num_tokens", "<u8"),
+    ("max_seq_length", "<u4"),
+    ("eos_id", "<u4"),
+    ("dataset_hash", "<u8"),
+    ("tokenizer_hash", "<u8"),
+    ("ignore_label", "<u4"),
+    ("reserved", "<u4"),
+])
+
+
+class PreparedDataset(Dataset):
+    """按需从内存映射中取样本，不在Python中重新分词"""
+
+    def __init__(self, path):
+        header = np.fromfile(path, dtype=HEADER_DTYPE, count=1)
+        if len(header) != 1 or header["magic"][0] != SHARD_MAGIC:
+            raise ValueError(f"不是有效的预处理数据文件: {path}")
+        header = header[0]
+        self.num_samples = int(header["num_samples"])
+        self.max_seq_length = int(header["max_seq_length"])
+        self.ignore_label = int(header["ignore_label"])
+        self.eos_id = int(header["eos_id"])
+        self.packed = bool(int(header["flags"]) & SHARD_PACKED)
+        num_tokens = int(header["num_tokens"])
+
+        offset = HEADER_DTYPE.itemsize
+        self.offsets = np.memmap(path, dtype="<u8", mode="r", offset=offset, shape=(self.num_samples + 1,))
+        offset += 8 * (self.num_samples + 1)
+        self.input_ids = np.memmap(path, dtype="<u4", mode="r", offset=offset, shape=(num_tokens,))
+        offset += 4 * num_tokens
+        self.labels = np.memmap(path, dtype="<u4", mode="r", offset=offset, shape=(num_tokens,))
+        if self.packed:
+            # 每条序列由哪些原始样本拼成，用于重置位置编码和构造注意力掩码
+            offset += 4 * num_tokens
+            self.row_segments = np.memmap(path, dtype="<u8", mode="r", offset=offset, shape=(self.num_samples + 1,))
+            offset += 8 * (self.num_samples + 1)
+            self.segment_lengths = np.memmap(path, dtype="<u4", mode="r", offset=offset,
+                                             shape=(int(self.row_segments[-1]),))
+
+    def __len__(self):
+        return self.num_samples
+
+    def __getitem__(self, i):
+        begin, end = int(self.offsets[i]), int(self.offsets[i + 1])
+        input_ids = self.input_ids[begin:end].astype(np.int64)
+        labels = self.labels[begin:end].astype(np.int64)
+        labels[labels == self.ignore_label] = -100
+        if self.packed:
+            lengths = self.segment_lengths[int(self.row_segments[i]):int(self.row_segments[i + 1])].astype(np.int64)
+            return {
+                "input_ids": input_ids.tolist(),
+                "labels": labels.tolist(),
+                "position_ids": np.concatenate([np.arange(n) for n in lengths]).tolist(),
+                "segment_ids": np.repeat(np.arange(len(lengths)), lengths).tolist(),
+            }
+        return {
+            "input_ids": input_ids.tolist(),
+            "attention_mask": [1] * len(input_ids),
+            "labels": labels.tolist(),
+        }
+
+
+class PackedDataCollator:
+    """对打包序列做填充，并构造块对角的因果注意力掩码，同一序列中的不同样本互不可见"""
+
+    def __init__(self, pad_token_id, fp16=False):
+        self.pad_token_id = pad_token_id
+        self.dtype = torch.float16 if fp16 else torch.bfloat16
+
+    def __call__(self, features):
+        batch_size = len(features)
+        max_len = max(len(f["input_ids"]) for f in features)
+        input_ids = torch.full((batch_size, max_len), self.pad_token_id, dtype=torch.long)
+        labels = torch.full((batch_size, max_len), -100, dtype=torch.long)
+        position_ids = torch.zeros((batch_size, max_len), dtype=torch.long)
+        segment_ids = torch.full((batch_size, max_len), -1, dtype=torch.long)
+        for b, f in enumerate(features):
+            n = len(f["input_ids"])
+            input_ids[b, :n] = torch.tensor(f["input_ids"], dtype=torch.long)
+            labels[b, :n] = torch.tensor(f["labels"], dtype=torch.long)
+            position_ids[b, :n] = torch.tensor(f["position_ids"], dtype=torch.long)
+            segment_ids[b, :n] = torch.tensor(f["segment_ids"], dtype=torch.long)
+
+        causal = torch.tril(torch.ones((max_len, max_len), dtype=torch.bool))
+        allowed = (segment_ids[:, :, None] == segment_ids[:, None, :]) & causal & (segment_ids[:, :, None] >= 0)
+        allowed |= torch.eye(max_len, dtype=torch.bool)  # 填充位置至少能看到自己，避免softmax出现NaN
+        # 传入4D掩码时transformers要求使用加性形式：可见为0，屏蔽为dtype最小值
+        attention_mask = torch.zeros((batch_size, 1, max_len, max_len), dtype=self.dtype)
+        attention_mask.masked_fill_(~allowed[:, None], torch.finfo(self.dtype).min)
+        return {
+            "input_ids": input_ids,
+            "labels": labels,
+            "position_ids": position_ids,
+            "attention_mask": attention_mask,
+        }
+
+
+def load_prepared_dataset(path):
+    return PreparedDataset(path)
@@ -0,0 +1,33 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# @File    : tokenizer_parity.py
+# @Description: 服务端预分词的对照：用训练时相同的分词器和process_data()编码抽样记录，
+#               每条记录输出一行input_ids（JSON数组），由llm_trainer_server.cpp逐个比对。
+#               用法: python tokenizer_parity.py <任务文件>，任务文件为
+#               {"model_dir": ..., "max_seq_length": ..., "records": [JSONL行, ...]}
+import json
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from loader_transformers import process_data
+
+
+def main():
+    with open(sys.argv[1], encoding="utf-8") as f:
+        job = json.load(f)
+    try:
+        from transformers import AutoTokenizer
+        # 与main.py加载分词器的参数一致
+        tokenizer = AutoTokenizer.from_pretrained(job["model_dir"], trust_remote_code=True, use_fast=False)
+    except Exception as e:
+        print("PARITY_UNAVAILABLE " + str(e).replace("\n", " "))
+        return
+    for line in job["records"]:
+        sample = process_data(json.loads(line), tokenizer, job["max_seq_length"])
+        print(json.dumps(sample["input_ids"]))
+    sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -17,27 +18,70 @@
 #include <iomanip>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <deque>
+#include <cstdint>
+#include <cmath>
+#include <cstddef>
+#include <new>
 
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
+#include <io.h>
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define ELIAN_HAVE_IO_URING
 #endif
+#endif
+#endif
+
+#ifdef ELIAN_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ELIAN_HAVE_SSE2
+#endif
+#ifdef _WIN32
 std::wstring s2ws(const std::string& s) {
     int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
     std::wstring ws(len, 0);
     MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &ws[0], len);
     return ws;
 }
+
+std::string ws2s(const std::wstring& ws) {
+    int len = WideCharToMultiByte(CP_UTF8, 0, ws.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string s(len > 0 ? len - 1 : 0, 0);
+    if (len > 1) WideCharToMultiByte(CP_UTF8, 0, ws.c_str(), -1, &s[0], len, nullptr, nullptr);
+    return s;
+}
+#endif
 #if defined(_WIN32) || defined(__linux__)
 #define TRY_USE_CUDA
 #endif
@@ -112,6 +156,271 @@ std::unique_ptr<NvmlFunctions> loadNvml() {
 const int PORT = 10171;
 const std::string WEB_DIR = "./web"; // 前端服务地址 npm run build会自动构建到web目录下
 const std::string API_PREFIX = "/api"; // 训练请求api
+const int TASK_EXPIRE_SECONDS = 30 * 60; // 异步任务结束后在内存中保留的时间
+const size_t TASK_RESULT_LIMIT = 1024 * 1024; // 单个任务输出缓冲上限，超出后丢弃最早的输出
+
+// ==================== 服务指标 ====================
+// 每个线程一份计数器，只由所属线程写入（relaxed原子读写，无锁）；/metrics抓取时汇总所有线程。
+// 线程退出时把计数并入已退出线程的汇总，计数不会丢失。路由标签取自固定列表，
+// 不在列表中的API记为other，非API的静态文件记为static。
+
+const char* const METRIC_ROUTES[] = {
+    "/api/config/delete", "/api/config/list", "/api/config/load", "/api/config/save",
+    "/api/config/schema", "/api/config/versions", "/api/data/dedup", "/api/data/files",
+    "/api/data/prepare", "/api/data/prepared", "/api/data/preview", "/api/data/stats",
+    "/api/data/upload", "/api/debug/traces", "/api/default-config", "/api/gpu/status", "/api/gpus",
+    "/api/inference", "/api/inference/result", "/api/ollama/deploy", "/api/ollama/status",
+    "/api/system/info", "/api/task/status", "/api/train", "/api/train/logs", "/api/ws",
+    "/metrics", "other", "static",
+};
+const size_t METRIC_ROUTE_COUNT = sizeof(METRIC_ROUTES) / sizeof(METRIC_ROUTES[0]);
+const size_t METRIC_ROUTE_OTHER = METRIC_ROUTE_COUNT - 2;
+const size_t METRIC_ROUTE_STATIC = METRIC_ROUTE_COUNT - 1;
+
+// 请求耗时直方图的桶上界（秒），最后还有一个+Inf桶
+const double LATENCY_BUCKETS[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+const size_t LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]);
+
+const char* const STATUS_CLASSES[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+const size_t STATUS_CLASS_COUNT = 5;
+
+enum MetricCounter {
+    COUNTER_CONNECTIONS,        // 接受的连接
+    COUNTER_BAD_REQUESTS,       // 请求头读取或解析失败
+    COUNTER_BYTES_SENT,
+    COUNTER_SPAWN_COMMAND,      // exec_command启动的子进程
+    COUNTER_SPAWN_TASK,         // 后台任务启动的子进程
+    COUNTER_SPAWN_TRAIN,        // 训练进程
+    COUNTER_SOCKET_SYSCALLS,    // 连接处理发出的accept/recv/send/close/setsockopt及事件循环的等待调用
+    COUNTER_HANDOFF_REJECTED,   // 阻塞处理的工作线程已满、直接回503的连接
+    COUNTER_COUNT
+};
+
+std::atomic<const char*> g_io_backend{"blocking"};     // 实际使用的连接I/O实现，见事件驱动I/O
+
+struct ThreadMetrics {
+    std::atomic<uint64_t> requests[METRIC_ROUTE_COUNT][STATUS_CLASS_COUNT];
+    std::atomic<uint64_t> latency_buckets[METRIC_ROUTE_COUNT][LATENCY_BUCKET_COUNT + 1];
+    std::atomic<uint64_t> latency_sum_us[METRIC_ROUTE_COUNT];
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+};
+
+// 单写者计数：只有所属线程写入，读写都用relaxed，不需要带锁的原子加法
+inline void metric_add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+class MetricsRegistry {
+public:
+    MetricsRegistry() : retired(new ThreadMetrics()) {}
+
+    ThreadMetrics* attach() {
+        std::lock_guard<std::mutex> lock(mtx);
+        live.push_back(new ThreadMetrics());
+        return live.back();
+    }
+
+    // 线程退出：计数并入retired
+    void detach(ThreadMetrics* metrics) {
+        std::lock_guard<std::mutex> lock(mtx);
+        merge(*retired, *metrics);
+        live.erase(std::remove(live.begin(), live.end(), metrics), live.end());
+        delete metrics;
+    }
+
+    // 汇总所有线程的计数
+    void snapshot(ThreadMetrics& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        merge(out, *retired);
+        for (ThreadMetrics* metrics : live) merge(out, *metrics);
+    }
+
+private:
+    static void merge(ThreadMetrics& into, const ThreadMetrics& from) {
+        auto add = [](std::atomic<uint64_t>& a, const std::atomic<uint64_t>& b) {
+            a.fetch_add(b.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        };
+        for (size_t r = 0; r < METRIC_ROUTE_COUNT; ++r) {
+            for (size_t c = 0; c < STATUS_CLASS_COUNT; ++c) add(into.requests[r][c], from.requests[r][c]);
+            for (size_t b = 0; b <= LATENCY_BUCKET_COUNT; ++b) add(into.latency_buckets[r][b], from.latency_buckets[r][b]);
+            add(into.latency_sum_us[r], from.latency_sum_us[r]);
+        }
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) add(into.counters[i], from.counters[i]);
+    }
+
+    std::mutex mtx;
+    std::unique_ptr<ThreadMetrics> retired;
+    std::vector<ThreadMetrics*> live;
+};
+
+MetricsRegistry& metrics_registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+// 当前线程的计数器，首次使用时注册
+ThreadMetrics& thread_metrics() {
+    struct Holder {
+        ThreadMetrics* metrics = metrics_registry().attach();
+        ~Holder() { metrics_registry().detach(metrics); }
+    };
+    thread_local Holder holder;
+    return *holder.metrics;
+}
+
+void metrics_count(MetricCounter counter, uint64_t value = 1) {
+    metric_add(thread_metrics().counters[counter], value);
+}
+
+// URL（可带查询串）对应的路由标签下标
+size_t metric_route_index(std::string_view url) {
+    url = url.substr(0, url.find('?'));
+    if (url.substr(0, 5) != "/api/" && url != "/metrics") return METRIC_ROUTE_STATIC;
+    for (size_t i = 0; i < METRIC_ROUTE_OTHER; ++i) {
+        if (url == METRIC_ROUTES[i]) return i;
+    }
+    return METRIC_ROUTE_OTHER;
+}
+
+// 记录一次请求：status_line为响应开头（只看状态码），bytes为发送的字节数，耗时单位秒
+void metrics_observe_request(std::string_view url, std::string_view status_line, size_t bytes, double seconds) {
+    ThreadMetrics& metrics = thread_metrics();
+    size_t route = metric_route_index(url);
+    size_t status_class = 4;
+    if (status_line.size() > 9 && status_line[9] >= '1' && status_line[9] <= '5') status_class = static_cast<size_t>(status_line[9] - '1');
+    metric_add(metrics.requests[route][status_class], 1);
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT && seconds > LATENCY_BUCKETS[bucket]) ++bucket;
+    metric_add(metrics.latency_buckets[route][bucket], 1);
+    metric_add(metrics.latency_sum_us[route], static_cast<uint64_t>(seconds * 1e6));
+    metric_add(metrics.counters[COUNTER_BYTES_SENT], bytes);
+}
+
+void metrics_observe_request(std::string_view url, std::string_view response, double seconds) {
+    metrics_observe_request(url, response, response.size(), seconds);
+}
+
+// ==================== 请求追踪 ====================
+// RAII计时区间：TraceSpan构造时取单调时钟，析构时把区间写入当前线程的环形缓冲区。
+// 每个线程的缓冲区固定大小，写满后覆盖最旧的记录；线程退出后缓冲区保留到
+// TRACE_RETIRED_LIMIT个为止。/api/debug/traces按Chrome trace-event格式导出，
+// 可直接在Perfetto或chrome://tracing中打开。设置环境变量ELIAN_TRACE=0可关闭。
+
+const size_t TRACE_RING_SIZE = 2048;
+const size_t TRACE_RETIRED_LIMIT = 16;
+
+struct TraceEvent {
+    const char* name;       // 字符串常量，不复制
+    uint64_t start_ns;      // 相对进程启动的时间
+    uint64_t duration_ns;
+    char detail[64];        // 可选的附加信息（如请求路径），超长截断
+};
+
+struct TraceRing {
+    std::mutex mtx;         // 只在导出时有竞争
+    uint32_t thread_id;
+    std::vector<TraceEvent> events;
+    size_t next = 0;
+    size_t count = 0;
+
+    explicit TraceRing(uint32_t thread_id) : thread_id(thread_id), events(TRACE_RING_SIZE) {}
+
+    void push(const TraceEvent& event) {
+        std::lock_guard<std::mutex> lock(mtx);
+        events[next] = event;
+        next = (next + 1) % events.size();
+        if (count < events.size()) count++;
+    }
+};
+
+const std::chrono::steady_clock::time_point g_trace_epoch = std::chrono::steady_clock::now();
+
+uint64_t trace_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_trace_epoch).count());
+}
+
+bool tracing_enabled() {
+    static const bool enabled = [] {
+        const char* value = std::getenv("ELIAN_TRACE");
+        return value == nullptr || std::string(value) != "0";
+    }();
+    return enabled;
+}
+
+class TraceRegistry {
+public:
+    std::shared_ptr<TraceRing> attach() {
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.push_back(std::make_shared<TraceRing>(++next_thread_id));
+        return rings.back();
+    }
+
+    // 线程退出：缓冲区保留，超过上限时丢弃最早退出的线程
+    void detach(const std::shared_ptr<TraceRing>& ring) {
+        std::lock_guard<std::mutex> lock(mtx);
+        rings.erase(std::remove(rings.begin(), rings.end(), ring), rings.end());
+        retired.push_back(ring);
+        if (retired.size() > TRACE_RETIRED_LIMIT) retired.pop_front();
+    }
+
+    std::vector<std::shared_ptr<TraceRing>> all() {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<std::shared_ptr<TraceRing>> result(rings.begin(), rings.end());
+        result.insert(result.end(), retired.begin(), retired.end());
+        return result;
+    }
+
+private:
+    std::mutex mtx;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    std::deque<std::shared_ptr<TraceRing>> retired;
+    uint32_t next_thread_id = 0;
+};
+
+TraceRegistry& trace_registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+TraceRing& thread_trace_ring() {
+    struct Holder {
+        std::shared_ptr<TraceRing> ring = trace_registry().attach();
+        ~Holder() { trace_registry().detach(ring); }
+    };
+    thread_local Holder holder;
+    return *holder.ring;
+}
+
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, std::string_view detail = std::string_view())
+        : active(tracing_enabled()) {
+        if (!active) return;
+        event.name = name;
+        size_t length = std::min(detail.size(), sizeof(event.detail) - 1);
+        if (length > 0) std::memcpy(event.detail, detail.data(), length);
+        event.detail[length] = '\0';
+        event.start_ns = trace_now_ns();
+    }
+
+    ~TraceSpan() { finish(); }
+
+    // 提前结束区间，之后析构不再记录
+    void finish() {
+        if (!active) return;
+        active = false;
+        event.duration_ns = trace_now_ns() - event.start_ns;
+        thread_trace_ring().push(event);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    bool active;
+    TraceEvent event;
+};
 
 // GPU信息结构体
 struct GPUInfo {
@@ -126,6 +435,8 @@ struct GPUInfo {
 std::string exec_command(const std::string& cmd) {
     std::string result;
     char buffer[128];
+    metrics_count(COUNTER_SPAWN_COMMAND);
+    TraceSpan span("exec_command", cmd);
     
 #ifdef _WIN32
     FILE* pipe = _popen(cmd.c_str(), "r");
@@ -152,8 +463,91 @@ std::string exec_command(const std::string& cmd) {
     return result;
 }
 
+// 拼成日志和Windows命令行中显示的命令，每个参数加双引号（参数已经过字符校验，不含引号）
+std::string quote_command_args(const std::vector<std::string>& argv) {
+    std::string command;
+    for (const std::string& arg : argv) {
+        if (!command.empty()) command += ' ';
+        command += '"' + arg + '"';
+    }
+    return command;
+}
+
+#ifndef _WIN32
+// 不经过shell启动后台进程：参数原样传给execvp，标准输出和标准错误写到log_path。
+// candidates依次尝试，前一个程序不存在（ENOENT）时换下一个。两次fork让进程由init接管，
+// 不留僵尸进程；exec失败时子进程通过管道把errno带回来，error中返回
+bool spawn_detached(const std::vector<std::vector<std::string>>& candidates, const std::string& log_path, int& error) {
+    // fork之后只调用异步信号安全的函数，参数数组事先准备好
+    std::vector<std::vector<char*>> argvs;
+    for (const auto& args : candidates) {
+        std::vector<char*> argv;
+        for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        argvs.push_back(std::move(argv));
+    }
+    const char* log_file = log_path.c_str();
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        error = errno;
+        return false;
+    }
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    pid_t child = fork();
+    if (child < 0) {
+        error = errno;
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (child == 0) {
+        close(fds[0]);
+        pid_t grandchild = fork();
+        if (grandchild != 0) {
+            if (grandchild < 0) {
+                int e = errno;
+                ssize_t ignored = write(fds[1], &e, sizeof(e));
+                (void)ignored;
+            }
+            _exit(0);
+        }
+        setsid();
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd >= 0) dup2(null_fd, 0);
+        int log_fd = open(log_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log_fd >= 0) {
+            dup2(log_fd, 1);
+            dup2(log_fd, 2);
+        }
+        for (auto& argv : argvs) {
+            execvp(argv[0], argv.data());
+            if (errno != ENOENT) break;
+        }
+        int e = errno;
+        ssize_t ignored = write(fds[1], &e, sizeof(e));
+        (void)ignored;
+        _exit(127);
+    }
+
+    close(fds[1]);
+    while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {}
+    // exec成功时管道随exec关闭，读到EOF
+    int child_error = 0;
+    ssize_t n;
+    while ((n = read(fds[0], &child_error, sizeof(child_error))) < 0 && errno == EINTR) {}
+    close(fds[0]);
+    if (n == static_cast<ssize_t>(sizeof(child_error))) {
+        error = child_error;
+        return false;
+    }
+    return true;
+}
+#endif
+
 // 通过nvidia-smi命令获取GPU信息
 std::vector<GPUInfo> detect_gpus() {
+    TraceSpan span("detect_gpus");
     std::vector<GPUInfo> gpus;
     
     // 尝试执行nvidia-smi命令
@@ -411,31 +805,332 @@ int get_disk_space() {
     return disk_space;
 }
 
+// JSON响应的固定响应头（Content-Length之后），静态响应与json_response共用
+constexpr std::string_view JSON_RESPONSE_HEADERS =
+    "Content-Type: application/json; charset=utf-8\r\n"
+    "Access-Control-Allow-Origin: *\r\n"                            // 允许跨域
+    "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"          // 允许的请求方法
+    "Access-Control-Allow-Headers: Content-Type, Authorization\r\n" // 允许的请求头
+    "Cache-Control: no-cache, no-store, must-revalidate\r\n"        // 禁止缓存
+    "Pragma: no-cache\r\n"                                          // 兼容HTTP/1.0
+    "Expires: 0\r\n";                                               // 过期时间
+
 // 生成JSON响应
-std::string json_response(const std::string& json_content) {
-    std::ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n";
-    response << "Content-Type: application/json; charset=utf-8\r\n";
-    response << "Content-Length: " << json_content.length() << "\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";  // 允许跨域
-    response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";  // 允许的请求方法
-    response << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";  // 允许的请求头
-    response << "Cache-Control: no-cache, no-store, must-revalidate\r\n";  // 禁止缓存
-    response << "Pragma: no-cache\r\n";  // 兼容HTTP/1.0
-    response << "Expires: 0\r\n";  // 过期时间
-    response << "\r\n";
-    response << json_content;
-    return response.str();
+std::string json_response(const std::string& json_content, const char* status = "200 OK", const std::string& extra_headers = "") {
+    std::string length = std::to_string(json_content.length());
+    std::string response;
+    response.reserve(64 + length.length() + JSON_RESPONSE_HEADERS.size() + extra_headers.length() + json_content.length());
+    response.append("HTTP/1.1 ").append(status).append("\r\n");
+    response.append("Content-Length: ").append(length).append("\r\n");
+    response.append(JSON_RESPONSE_HEADERS.data(), JSON_RESPONSE_HEADERS.size());
+    response.append(extra_headers);  // 每行以\r\n结尾
+    response.append("\r\n");
+    response.append(json_content);
+    return response;
+}
+
+// ==================== 静态响应 ====================
+// 内容固定的响应（默认配置、CORS预检）在编译期拼好状态行、响应头和Content-Length，
+// 放在静态存储区中。请求到来时直接发送，不再逐次用ostringstream拼接。
+
+template <size_t N>
+struct StaticResponse {
+    char data[N];
+    constexpr std::string_view view() const { return std::string_view(data, N); }
+};
+
+constexpr size_t decimal_length(size_t value) {
+    size_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+constexpr std::string_view STATIC_STATUS_LINE = "HTTP/1.1 ";
+constexpr std::string_view STATIC_CONTENT_LENGTH = "Content-Length: ";
+
+constexpr size_t static_response_size(std::string_view status, std::string_view headers, std::string_view body) {
+    return STATIC_STATUS_LINE.size() + status.size() + 2 + STATIC_CONTENT_LENGTH.size() + decimal_length(body.size()) + 2 +
+           headers.size() + 2 + body.size();
+}
+
+// 编译期生成完整响应：状态行、Content-Length、headers（每行以\r\n结尾）、空行、body
+template <const std::string_view& Status, const std::string_view& Headers, const std::string_view& Body>
+constexpr StaticResponse<static_response_size(Status, Headers, Body)> build_static_response() {
+    StaticResponse<static_response_size(Status, Headers, Body)> response = {};
+    size_t pos = 0;
+    auto append = [&](std::string_view text) {
+        for (char c : text) response.data[pos++] = c;
+    };
+    append(STATIC_STATUS_LINE);
+    append(Status);
+    append("\r\n");
+    append(STATIC_CONTENT_LENGTH);
+    size_t digits = decimal_length(Body.size());
+    for (size_t i = 0, value = Body.size(); i < digits; ++i, value /= 10) {
+        response.data[pos + digits - 1 - i] = static_cast<char>('0' + value % 10);
+    }
+    pos += digits;
+    append("\r\n");
+    append(Headers);
+    append("\r\n");
+    append(Body);
+    return response;
+}
+
+constexpr std::string_view STATUS_200_OK = "200 OK";
+constexpr std::string_view NO_BODY = "";
+
+constexpr std::string_view DEFAULT_CONFIG_JSON =
+    "{"
+    "\"model_name_or_path\":\"/ckpt/ds\","
+    "\"output_dir\":\"/output/your_task/lora\","
+    "\"train_file\":\"/data/sample.jsonl\","
+    "\"num_train_epochs\":3,"
+    "\"per_device_train_batch_size\":1,"
+    "\"gradient_accumulation_steps\":4,"
+    "\"learning_rate\":0.0002,"
+    "\"max_seq_length\":1024,"
+    "\"logging_steps\":1,"
+    "\"save_steps\":200,"
+    "\"save_total_limit\":3,"
+    "\"lr_scheduler_type\":\"constant_with_warmup\","
+    "\"warmup_steps\":30,"
+    "\"lora_rank\":8,"
+    "\"lora_alpha\":16,"
+    "\"lora_dropout\":0.05,"
+    "\"gradient_checkpointing\":true,"
+    "\"optim\":\"adamw_torch\","
+    "\"train_mode\":\"lora\","
+    "\"seed\":42,"
+    "\"fp16\":false,"
+    "\"distributed\":false"
+    "}";
+
+constexpr std::string_view CORS_PREFLIGHT_HEADERS =
+    "Access-Control-Allow-Origin: *\r\n"
+    "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+    "Access-Control-Allow-Headers: Content-Type, Authorization, If-Match, If-None-Match\r\n"
+    "Access-Control-Max-Age: 86400\r\n";  // 预检请求结果缓存24小时
+
+constexpr auto DEFAULT_CONFIG_RESPONSE = build_static_response<STATUS_200_OK, JSON_RESPONSE_HEADERS, DEFAULT_CONFIG_JSON>();
+constexpr auto CORS_PREFLIGHT_RESPONSE = build_static_response<STATUS_200_OK, CORS_PREFLIGHT_HEADERS, NO_BODY>();
+
+struct StaticRoute {
+    std::string_view method;    // 为空时匹配任意方法
+    std::string_view url;       // 以/结尾时按前缀匹配
+    std::string_view response;
+};
+
+const StaticRoute STATIC_ROUTES[] = {
+    {"OPTIONS", "/api/", CORS_PREFLIGHT_RESPONSE.view()},
+    {"", "/api/default-config", DEFAULT_CONFIG_RESPONSE.view()},
+};
+
+// 查找静态响应，找不到时返回空
+std::string_view find_static_response(std::string_view method, std::string_view url) {
+    for (const StaticRoute& route : STATIC_ROUTES) {
+        if (!route.method.empty() && route.method != method) continue;
+        bool prefix = route.url.back() == '/';
+        if (prefix ? url.substr(0, route.url.size()) == route.url : url == route.url) {
+            return route.response;
+        }
+    }
+    return std::string_view();
+}
+
+// ==================== 请求内存池 ====================
+// 每个服务线程一个按块增长的线性分配器：请求头解析、路由和部分响应构建都从这里取内存，
+// 响应发出后整体复位。复位时若本次用了多个块，就合并成一个足够大的块，
+// 稳态下每个请求不再调用malloc。
+// 定义LLM_TRAINER_ALLOC_STATS时替换全部全局operator new/delete，按线程统计分配次数（基准程序使用）。
+
+#ifdef LLM_TRAINER_ALLOC_STATS
+thread_local unsigned long long t_allocation_count = 0;
+
+// 所有形式的new都从这里分配，对应的delete统一用free_counted释放，malloc与free始终成对
+void* allocate_counted(size_t size, size_t align) {
+    ++t_allocation_count;
+    if (size == 0) size = 1;
+    if (align <= alignof(std::max_align_t)) return std::malloc(size);
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, align, size) == 0 ? p : nullptr;
+#endif
+}
+
+void free_counted(void* p, size_t align) noexcept {
+#ifdef _WIN32
+    if (align > alignof(std::max_align_t)) {
+        _aligned_free(p);
+        return;
+    }
+#else
+    (void)align;
+#endif
+    std::free(p);
+}
+
+void* allocate_counted_or_throw(size_t size, size_t align) {
+    void* p = allocate_counted(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+const size_t DEFAULT_NEW_ALIGN = alignof(std::max_align_t);
+
+void* operator new(size_t size) { return allocate_counted_or_throw(size, DEFAULT_NEW_ALIGN); }
+void* operator new[](size_t size) { return allocate_counted_or_throw(size, DEFAULT_NEW_ALIGN); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate_counted(size, DEFAULT_NEW_ALIGN); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate_counted(size, DEFAULT_NEW_ALIGN); }
+void* operator new(size_t size, std::align_val_t align) { return allocate_counted_or_throw(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align) { return allocate_counted_or_throw(size, static_cast<size_t>(align)); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate_counted(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return allocate_counted(size, static_cast<size_t>(align)); }
+
+void operator delete(void* p) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete[](void* p) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete(void* p, size_t) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete[](void* p, size_t) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free_counted(p, DEFAULT_NEW_ALIGN); }
+void operator delete(void* p, std::align_val_t align) noexcept { free_counted(p, static_cast<size_t>(align)); }
+void operator delete[](void* p, std::align_val_t align) noexcept { free_counted(p, static_cast<size_t>(align)); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { free_counted(p, static_cast<size_t>(align)); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { free_counted(p, static_cast<size_t>(align)); }
+void operator delete(void* p, std::align_val_t align, const std::nothrow_t&) noexcept { free_counted(p, static_cast<size_t>(align)); }
+void operator delete[](void* p, std::align_val_t align, const std::nothrow_t&) noexcept { free_counted(p, static_cast<size_t>(align)); }
+
+unsigned long long thread_allocation_count() {
+    return t_allocation_count;
+}
+#endif
+
+const size_t ARENA_HIGH_WATER_BLOCKS = 4;  // 复位后最多保留的内存，以默认块大小计
+
+class RequestArena {
+public:
+    explicit RequestArena(size_t block_size = 128 * 1024) : block_size(block_size) {}
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        if (!blocks.empty()) {
+            size_t aligned = (offset + align - 1) & ~(align - 1);
+            if (aligned + size <= blocks.back().size) {
+                offset = aligned + size;
+                used += size;
+                return blocks.back().data.get() + aligned;
+            }
+        }
+        size_t size_needed = std::max(block_size, size + align);
+        blocks.push_back({std::unique_ptr<char[]>(new char[size_needed]), size_needed});
+        offset = 0;
+        return allocate(size, align);
+    }
+
+    // 复位：保留内存，多个块时合并成一个。偶尔的大响应把总量撑过ARENA_HIGH_WATER_BLOCKS个默认块时
+    // 释放掉，回到默认大小，避免每个线程一直占着峰值内存
+    void reset() {
+        size_t total = bytes_reserved();
+        if (total > block_size * ARENA_HIGH_WATER_BLOCKS) {
+            blocks.clear();
+            blocks.push_back({std::unique_ptr<char[]>(new char[block_size]), block_size});
+        } else if (blocks.size() > 1) {
+            blocks.clear();
+            blocks.push_back({std::unique_ptr<char[]>(new char[total]), total});
+        }
+        offset = 0;
+        used = 0;
+    }
+
+    size_t bytes_used() const { return used; }
+
+    size_t bytes_reserved() const {
+        size_t total = 0;
+        for (const auto& block : blocks) total += block.size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    size_t block_size;
+    std::vector<Block> blocks;
+    size_t offset = 0;
+    size_t used = 0;
+};
+
+// 当前线程的请求内存池
+RequestArena& request_arena() {
+    thread_local RequestArena arena;
+    return arena;
+}
+
+// 从请求内存池分配的STL分配器，释放为空操作，内存在复位时统一回收
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+    RequestArena* arena;
+
+    ArenaAllocator() : arena(&request_arena()) {}
+    explicit ArenaAllocator(RequestArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template <typename Out>
+void append_integer(Out& out, long long value) {
+    char buffer[24];
+    int length = snprintf(buffer, sizeof(buffer), "%lld", value);
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+// json_response的内存池版本，返回的响应在内存池复位前有效
+std::string_view arena_json_response(std::string_view json_content, std::string_view status = "200 OK") {
+    char length[24];
+    int length_size = snprintf(length, sizeof(length), "%zu", json_content.size());
+    size_t total = 9 + status.size() + 2 + 16 + static_cast<size_t>(length_size) + 2 + JSON_RESPONSE_HEADERS.size() + 2 + json_content.size();
+    char* data = static_cast<char*>(request_arena().allocate(total, 1));
+    char* p = data;
+    auto put = [&p](std::string_view text) {
+        if (text.empty()) return;
+        std::memcpy(p, text.data(), text.size());
+        p += text.size();
+    };
+    put("HTTP/1.1 ");
+    put(status);
+    put("\r\nContent-Length: ");
+    put(std::string_view(length, static_cast<size_t>(length_size)));
+    put("\r\n");
+    put(JSON_RESPONSE_HEADERS);
+    put("\r\n");
+    put(json_content);
+    return std::string_view(data, total);
 }
 
-bool ends_with(const std::string& str, const std::string& suffix) {
+bool ends_with(std::string_view str, std::string_view suffix) {
     if (str.length() < suffix.length()) {
         return false;
     }
     return (str.compare(str.length() - suffix.length(), suffix.length(), suffix) == 0);
 }
 
-bool starts_with(const std::string& str, const std::string& prefix) {
+bool starts_with(std::string_view str, std::string_view prefix) {
     if (str.length() < prefix.length()) {
         return false;
     }
@@ -509,6 +1204,7 @@ std::vector<std::string> list_files_in_directory(const std::string& directory, c
 
 // 检查文件或目录是否存在
 bool file_exists(const std::string& path) {
+    TraceSpan span("file_exists", path);
 #ifdef _WIN32
     // 将UTF-8路径转换为宽字符
     int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
@@ -524,6 +1220,131 @@ bool file_exists(const std::string& path) {
 #endif
 }
 
+// 获取当前工作目录（UTF-8编码，统一使用正斜杠）
+std::string get_current_dir() {
+    std::string current_dir;
+#ifdef _WIN32
+    wchar_t wbuffer[MAX_PATH];
+    if (GetCurrentDirectoryW(MAX_PATH, wbuffer)) {
+        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
+        std::vector<char> utf8_buffer(size_needed);
+        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
+        current_dir = std::string(utf8_buffer.data());
+        std::replace(current_dir.begin(), current_dir.end(), '\\', '/');
+    } else {
+        current_dir = ".";
+    }
+#else
+    char buffer[PATH_MAX];
+    if (getcwd(buffer, PATH_MAX) != NULL) {
+        current_dir = buffer;
+    } else {
+        current_dir = ".";
+    }
+#endif
+    return current_dir;
+}
+
+// 文件大小和修改时间，用于判断缓存是否失效
+struct FileStat {
+    bool exists;
+    unsigned long long size;
+    long long mtime;
+};
+
+FileStat stat_file(const std::string& path) {
+    FileStat result = {false, 0, 0};
+#ifdef _WIN32
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wpath(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), size_needed);
+
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (GetFileAttributesExW(wpath.data(), GetFileExInfoStandard, &attrs)) {
+        result.exists = true;
+        result.size = (static_cast<unsigned long long>(attrs.nFileSizeHigh) << 32) | attrs.nFileSizeLow;
+        // FILETIME为1601年起的100纳秒数，转换为Unix时间戳（秒）
+        unsigned long long filetime = (static_cast<unsigned long long>(attrs.ftLastWriteTime.dwHighDateTime) << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+        result.mtime = static_cast<long long>((filetime - 116444736000000000ULL) / 10000000ULL);
+    }
+#else
+    struct stat statbuf;
+    if (stat(path.c_str(), &statbuf) == 0) {
+        result.exists = true;
+        result.size = static_cast<unsigned long long>(statbuf.st_size);
+        result.mtime = static_cast<long long>(statbuf.st_mtime);
+    }
+#endif
+    return result;
+}
+
+FILE* open_file_utf8(const std::string& path, const char* mode) {
+#ifdef _WIN32
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wpath(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), size_needed);
+    std::wstring wmode(mode, mode + strlen(mode));
+    return _wfopen(wpath.data(), wmode.c_str());
+#else
+    return fopen(path.c_str(), mode);
+#endif
+}
+
+// 创建单级目录，已存在时也返回true
+bool create_directory(const std::string& path) {
+#ifdef _WIN32
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wpath(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), size_needed);
+    return CreateDirectoryW(wpath.data(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// 原子地写入整个文件：先写同目录下的临时文件并刷到磁盘，再重命名覆盖目标文件，
+// 其他读者要么看到旧内容，要么看到完整的新内容
+bool atomic_write_file(const std::string& path, const std::string& content) {
+    static std::atomic<unsigned long long> tmp_seq(0);
+    std::string tmp_path = path + ".tmp" + std::to_string(++tmp_seq);
+    FILE* out = open_file_utf8(tmp_path, "wb");
+    if (!out) return false;
+    bool ok = fwrite(content.data(), 1, content.size(), out) == content.size() && fflush(out) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(out)) == 0;
+#else
+    ok = ok && fsync(fileno(out)) == 0;
+#endif
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wpath(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), size_needed);
+    size_needed = MultiByteToWideChar(CP_UTF8, 0, tmp_path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wtmp(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, tmp_path.c_str(), -1, wtmp.data(), size_needed);
+    ok = MoveFileExW(wtmp.data(), wpath.data(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    ok = std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    if (ok) {
+        // 重命名本身也要落盘，否则掉电后目录项可能仍指向旧文件
+        size_t slash = path.find_last_of('/');
+        int dir_fd = open(slash == std::string::npos ? "." : path.substr(0, slash).c_str(), O_RDONLY);
+        if (dir_fd >= 0) {
+            fsync(dir_fd);
+            close(dir_fd);
+        }
+    }
+#endif
+    if (!ok) std::remove(tmp_path.c_str());
+    return ok;
+}
+
 // 读取文件前N行作为预览 N=10
 std::string read_file_preview(const std::string& file_path, int max_lines = 10) {
 #ifdef _WIN32
@@ -575,585 +1396,5058 @@ std::string read_file_preview(const std::string& file_path, int max_lines = 10)
 #endif
 }
 
-// 从HTTP请求中提取POST数据体
-std::string extract_post_data(const std::string& request) {
-    // 查找请求体开始的位置（在空行之后）
-    std::string delimiter = "\r\n\r\n";
-    size_t pos = request.find(delimiter);
-    
-    if (pos != std::string::npos) {
-        // 返回请求体部分
-        return request.substr(pos + delimiter.length());
+// ==================== 线程池 ====================
+// 固定数量的工作线程，用于数据集校验等可以按块并行的CPU密集型任务
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count) : stopping(false) {
+        if (thread_count == 0) thread_count = 1;
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers.emplace_back([this]() { worker_loop(); });
+        }
     }
-    
-    return "";
-}
 
-std::string extract_post_data_config(const std::string& request) {
-    // 查找正文开始的位置
-    size_t body_start = request.find("\r\n\r\n");
-    if (body_start == std::string::npos) {
-        return ""; // 没有找到正文
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
     }
 
-    // 跳过分隔符
-    body_start += 4;
+    size_t size() const {
+        return workers.size();
+    }
 
-    // 提取正文内容
-    return request.substr(body_start);
-}
-
-std::map<std::string, std::string> parse_config_json(const std::string& json_text) {
-    std::map<std::string, std::string> result;
-    
-    // 提取config_name
-    std::regex config_name_regex("\"config_name\"\\s*:\\s*\"([^\"]+)\"");
-    std::smatch config_name_match;
-    if (std::regex_search(json_text, config_name_match, config_name_regex)) {
-        result["config_name"] = config_name_match[1].str();
+    // 等待执行的任务数
+    size_t queue_depth() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return jobs.size();
     }
-    
-    // 查找config_data的起始位置
-    std::string start_marker = "\"config_data\":";
-    size_t start_pos = json_text.find(start_marker);
-    if (start_pos != std::string::npos) {
-        start_pos += start_marker.length();
-        
-        // 跳过空白字符
-        while (start_pos < json_text.length() && std::isspace(json_text[start_pos])) {
-            start_pos++;
-        }
-        
-        // 确保找到的是一个JSON对象
-        if (start_pos < json_text.length() && json_text[start_pos] == '{') {
-            // 查找匹配的结束括号
-            int brace_count = 1;
-            size_t end_pos = start_pos + 1;
-            
-            while (end_pos < json_text.length() && brace_count > 0) {
-                if (json_text[end_pos] == '{') brace_count++;
-                else if (json_text[end_pos] == '}') brace_count--;
-                end_pos++;
-            }
-            
-            if (brace_count == 0) {
-                // 提取完整的config_data对象
-                std::string config_data = json_text.substr(start_pos, end_pos - start_pos);
-                result["config_data"] = config_data;
-            }
+
+    std::future<void> submit(std::function<void()> job) {
+        auto task = std::make_shared<std::packaged_task<void()>>(std::move(job));
+        std::future<void> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.emplace_back([task]() { (*task)(); });
         }
+        cv.notify_one();
+        return result;
     }
-    
-    return result;
-}
 
-// 简单的JSON解析函数，将JSON文本转换为键值对
-std::map<std::string, std::string> parse_json(const std::string& json_text) {
-    std::map<std::string, std::string> result;
-    
-    // 非常简单的解析，仅用于演示
-    // 实际应用中应使用成熟的JSON解析库
-    std::regex key_value_regex("\"([^\"]+)\"\\s*:\\s*(\"[^\"]*\"|\\d+|true|false|null)");
-    std::smatch matches;
-    std::string::const_iterator search_start(json_text.cbegin());
-    
-    while (std::regex_search(search_start, json_text.cend(), matches, key_value_regex)) {
-        std::string key = matches[1].str();
-        std::string value = matches[2].str();
-        
-        // 如果值是字符串，去掉引号
-        if (value[0] == '"' && value[value.length() - 1] == '"') {
-            value = value.substr(1, value.length() - 2);
+    // 把[0, count)切成若干块并行执行fn(begin, end)，阻塞直到全部完成
+    void parallel_for(size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& fn) {
+        if (count == 0) return;
+        size_t chunk_count = std::max<size_t>(1, std::min(size() * 4, count / std::max<size_t>(1, min_chunk)));
+        size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+        std::vector<std::future<void>> pending;
+        for (size_t begin = 0; begin < count; begin += chunk_size) {
+            size_t end = std::min(begin + chunk_size, count);
+            pending.push_back(submit([&fn, begin, end]() { fn(begin, end); }));
         }
-        // 处理布尔值，统一转为小写形式，便于后续判断
-        else if (value == "true" || value == "false") {
-            std::transform(value.begin(), value.end(), value.begin(),
-                [](unsigned char c) { return std::tolower(c); });
+        for (auto& f : pending) {
+            f.get();
         }
-        
-        result[key] = value;
-        search_start = matches.suffix().first;
     }
-    
-    return result;
-}
 
-// JSON字符串转义函数，确保动态内容安全地嵌入到JSON中
-std::string escape_json(const std::string &s) {
-    std::ostringstream o;
-    for (auto c = s.cbegin(); c != s.cend(); c++) {
-        switch (*c) {
-        case '"': o << "\\\""; break;
-        case '\\': o << "\\\\"; break;
-        case '\b': o << "\\b"; break;
-        case '\f': o << "\\f"; break;
-        case '\n': o << "\\n"; break;
-        case '\r': o << "\\r"; break;
-        case '\t': o << "\\t"; break;
-        default:
-            if ('\x00' <= *c && *c <= '\x1f') {
-                o << "\\u"
-                  << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(*c);
-            } else {
-                o << *c;
+private:
+    void worker_loop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
             }
+            job();
         }
     }
-    return o.str();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping;
+};
+
+ThreadPool& worker_pool() {
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    return pool;
 }
 
-// 处理API请求
-std::string handle_api_request(const std::string& url, const std::string& request, const std::string& method) {
-    // 处理OPTIONS请求（CORS预检请求）
-    if (method == "OPTIONS") {
-        std::ostringstream response;
-        response << "HTTP/1.1 200 OK\r\n";
-        response << "Access-Control-Allow-Origin: *\r\n";
-        response << "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
-        response << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
-        response << "Access-Control-Max-Age: 86400\r\n";  // 预检请求结果缓存24小时
-        response << "Content-Length: 0\r\n";
-        response << "\r\n";
-        return response.str();
-    }
+// ==================== 数据集索引 ====================
+// 对llm/data下的JSONL文件做内存映射，并一次性建立每行起始偏移的数组，
+// 预览任意位置的记录只需O(1)定位，不再重复打开文件逐行读取。
+// 索引会写入同目录下的隐藏旁路文件(.xxx.jsonl.idx)，重启后按大小和修改时间校验复用。
 
-    if (url == "/api/gpu/status" || url == "/api/gpus") {
-        std::vector<GPUInfo> gpus = detect_gpus();
-        
-        std::ostringstream json;
-        json << "{";
-        
-        if (gpus.empty()) {
-            json << "\"success\": false, \"message\": \"没有检测到GPU\", \"data\": []";
-        } else {
-            json << "\"success\": true, \"data\": [";
-            
-            for (size_t i = 0; i < gpus.size(); ++i) {
-                const auto& gpu = gpus[i];
-                json << "{";
-                json << "\"name\": \"" << gpu.name << "\", ";
-                json << "\"memory_total\": " << gpu.memory_total << ", ";
-                json << "\"memory_free\": " << gpu.memory_free << ", ";
-                json << "\"utilization\": " << gpu.utilization << ", ";
-                json << "\"status\": \"" << gpu.status << "\"";
-                json << "}";
-                
-                if (i < gpus.size() - 1) {
-                    json << ", ";
-                }
-            }
-            
-            json << "]";
-        }
-        
-        json << "}";
-        return json_response(json.str());
-    } 
-    else if (url == "/api/system/info") {
-        // 获取实际系统信息
-        std::string python_version = get_python_version();
-        std::string pytorch_version = get_pytorch_version();
-        std::string transformers_version = get_transformers_version();
-        std::string cuda_version = get_cuda_version();
-        
-        std::pair<int, int> memory_info = get_system_memory();
-        int total_memory = memory_info.first;
-        int available_memory = memory_info.second;
-        
-        int disk_space = get_disk_space();
-        
-        // 清理版本字符串中的换行符
-        pytorch_version.erase(std::remove(pytorch_version.begin(), pytorch_version.end(), '\n'), pytorch_version.end());
-        pytorch_version.erase(std::remove(pytorch_version.begin(), pytorch_version.end(), '\r'), pytorch_version.end());
-        transformers_version.erase(std::remove(transformers_version.begin(), transformers_version.end(), '\n'), transformers_version.end());
-        transformers_version.erase(std::remove(transformers_version.begin(), transformers_version.end(), '\r'), transformers_version.end());
-        cuda_version.erase(std::remove(cuda_version.begin(), cuda_version.end(), '\n'), cuda_version.end());
-        cuda_version.erase(std::remove(cuda_version.begin(), cuda_version.end(), '\r'), cuda_version.end());
-        
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\": true, ";
-        json << "\"data\": {";
-        
-        // 操作系统信息
-        #ifdef _WIN32
-        json << "\"os\": \"Windows\", ";
-        #else
-        json << "\"os\": \"Linux/Unix\", ";
-        #endif
-        
-        // 实际检测到的信息
-        json << "\"python_version\": \"" << python_version << "\", ";
-        json << "\"pytorch_version\": \"" << pytorch_version << "\", ";
-        json << "\"transformers_version\": \"" << transformers_version << "\", ";
-        json << "\"cuda_version\": \"" << cuda_version << "\", ";
-        json << "\"cudnn_version\": \"自动随PyTorch安装\", ";
-        
-        // 系统资源信息
-        json << "\"memory_total\": " << total_memory << ", ";
-        json << "\"memory_available\": " << available_memory << ", ";
-        json << "\"disk_space\": " << disk_space;
-        
-        json << "}";
-        json << "}";
-        return json_response(json.str());
-    }
-    else if (url == "/api/default-config") {
-        // 返回默认配置
-        std::ostringstream json;
-        json << "{";
-        json << "\"model_name_or_path\":\"/ckpt/ds\",";
-        json << "\"output_dir\":\"/output/your_task/lora\",";
-        json << "\"train_file\":\"/data/sample.jsonl\",";
-        json << "\"num_train_epochs\":3,";
-        json << "\"per_device_train_batch_size\":1,";
-        json << "\"gradient_accumulation_steps\":4,";
-        json << "\"learning_rate\":0.0002,";
-        json << "\"max_seq_length\":1024,";
-        json << "\"logging_steps\":1,";
-        json << "\"save_steps\":200,";
-        json << "\"save_total_limit\":3,";
-        json << "\"lr_scheduler_type\":\"constant_with_warmup\",";
-        json << "\"warmup_steps\":30,";
-        json << "\"lora_rank\":8,";
-        json << "\"lora_alpha\":16,";
-        json << "\"lora_dropout\":0.05,";
-        json << "\"gradient_checkpointing\":true,";
-        json << "\"optim\":\"adamw_torch\",";
-        json << "\"train_mode\":\"lora\",";
-        json << "\"seed\":42,";
-        json << "\"fp16\":false,";
-        json << "\"distributed\":false";
-        json << "}";
-        return json_response(json.str());
-    }
-    else if (url == "/api/data/files") {
-        // 获取当前工作目录
-        std::string current_dir;
+// 只读内存映射文件
+struct MappedFile {
+    const char* data;
+    size_t size;
 #ifdef _WIN32
-        // 使用宽字符函数处理可能包含中文的路径
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-        
-        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
-        for (char &c : current_dir) {
-            if (c == '\\') c = '/';
-        }
+    HANDLE file_handle;
+    HANDLE mapping_handle;
+#endif
+
+    MappedFile() : data(nullptr), size(0)
+#ifdef _WIN32
+        , file_handle(INVALID_HANDLE_VALUE), mapping_handle(NULL)
+#endif
+    {}
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping_handle) CloseHandle(mapping_handle);
+        if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
 #else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
-        }
+        if (data) munmap(const_cast<char*>(data), size);
 #endif
-        // 列出data目录下的所有JSONL文件
-        std::string data_dir = current_dir + "/llm/data";
-        std::vector<std::string> files = list_files_in_directory(data_dir, ".jsonl");
-        
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":true,";
-        json << "\"files\":[";
-        
-        for (size_t i = 0; i < files.size(); ++i) {
-            json << "\"" << files[i] << "\"";
-            if (i < files.size() - 1) {
-                json << ",";
-            }
-        }
-        
-        json << "]}";
-        return json_response(json.str());
     }
-    else if (url.find("/api/data/preview?file=") == 0) {
-        // 获取当前工作目录
-        std::string current_dir;
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// 映射整个文件，失败返回nullptr；空文件返回data为空的对象
+std::shared_ptr<MappedFile> map_file(const std::string& path) {
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
 #ifdef _WIN32
-        // 使用宽字符函数处理可能包含中文的路径
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-        
-        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
-        for (char &c : current_dir) {
-            if (c == '\\') c = '/';
+    int size_needed = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::vector<wchar_t> wpath(size_needed);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wpath.data(), size_needed);
+
+    mapped->file_handle = CreateFileW(wpath.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                      NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (mapped->file_handle == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(mapped->file_handle, &file_size)) {
+        return nullptr;
+    }
+    mapped->size = static_cast<size_t>(file_size.QuadPart);
+    if (mapped->size == 0) {
+        return mapped;
+    }
+    mapped->mapping_handle = CreateFileMappingW(mapped->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapped->mapping_handle) {
+        return nullptr;
+    }
+    mapped->data = static_cast<const char*>(MapViewOfFile(mapped->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->data) {
+        return nullptr;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    mapped->size = static_cast<size_t>(statbuf.st_size);
+    if (mapped->size > 0) {
+        void* addr = mmap(nullptr, mapped->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            return nullptr;
         }
+        madvise(addr, mapped->size, MADV_SEQUENTIAL);
+        mapped->data = static_cast<const char*>(addr);
+    }
+    close(fd);
+#endif
+    return mapped;
+}
+
+// 扫描[data, data + size)中的换行符，把每个换行后的位置(base + 偏移)追加到offsets
+void scan_newlines(const char* data, size_t size, unsigned long long base, std::vector<unsigned long long>& offsets) {
+    size_t i = 0;
+#ifdef ELIAN_HAVE_SSE2
+    // SSE2一次比较16字节，命中时用位掩码逐个取出换行位置
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        while (mask != 0) {
+#ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
 #else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
+            unsigned int bit = static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+            offsets.push_back(base + i + bit + 1);
+            mask &= mask - 1;
         }
+    }
 #endif
+    while (i < size) {
+        const void* hit = memchr(data + i, '\n', size - i);
+        if (!hit) break;
+        i = static_cast<size_t>(static_cast<const char*>(hit) - data);
+        offsets.push_back(base + i + 1);
+        i++;
+    }
+}
 
-        // 获取文件内容预览
-        std::string file_param = url.substr(url.find("=") + 1);
-        // 进行URL解码
-        std::string filename;
-        for (size_t i = 0; i < file_param.length(); ++i) {
-            if (file_param[i] == '%' && i + 2 < file_param.length()) {
-                int value = 0;
-                if (sscanf(file_param.substr(i + 1, 2).c_str(), "%x", &value) == 1) {
-                    filename += static_cast<char>(value);
-                    i += 2;
-                }
-                else {
-                    filename += file_param[i];
+struct DatasetIndex {
+    std::string path;
+    unsigned long long file_size;
+    long long mtime;
+    std::shared_ptr<MappedFile> mapped;
+    // offsets[i]为第i行的起始位置，最后一个元素为文件末尾，记录数为offsets.size() - 1
+    std::vector<unsigned long long> offsets;
+
+    size_t record_count() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    // 取第i行内容（不含行尾的\r\n），结果指向映射的文件内容
+    std::string_view record_view(size_t i) const {
+        if (i >= record_count() || !mapped || !mapped->data) return std::string_view();
+        unsigned long long begin = offsets[i];
+        unsigned long long end = offsets[i + 1];
+        while (end > begin && (mapped->data[end - 1] == '\n' || mapped->data[end - 1] == '\r')) end--;
+        return std::string_view(mapped->data + begin, static_cast<size_t>(end - begin));
+    }
+
+    std::string record(size_t i) const {
+        return std::string(record_view(i));
+    }
+
+    // 文件是否仍是建立索引时的内容。文件被原地截断后再访问映射中超出末尾的页会触发SIGBUS，
+    // 长时间读取映射的任务在读取前后用它确认
+    bool unchanged() const {
+        FileStat st = stat_file(path);
+        return st.exists && st.size == file_size && st.mtime == mtime;
+    }
+};
+
+const char DATASET_INDEX_MAGIC[8] = {'E', 'L', 'I', 'D', 'X', '0', '0', '1'};
+
+std::string dataset_index_sidecar_path(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        return "." + path + ".idx";
+    }
+    return path.substr(0, slash + 1) + "." + path.substr(slash + 1) + ".idx";
+}
+
+// 旁路文件格式: magic[8] | file_size u64 | mtime i64 | count u64 | offsets u64[count]
+bool load_dataset_index_sidecar(DatasetIndex& index) {
+    std::ifstream in(dataset_index_sidecar_path(index.path), std::ios::binary);
+    if (!in.is_open()) return false;
+
+    char magic[8];
+    unsigned long long file_size = 0;
+    long long mtime = 0;
+    unsigned long long count = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&file_size), sizeof(file_size));
+    in.read(reinterpret_cast<char*>(&mtime), sizeof(mtime));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!in || memcmp(magic, DATASET_INDEX_MAGIC, sizeof(magic)) != 0 ||
+        file_size != index.file_size || mtime != index.mtime || count > file_size + 1) {
+        return false;
+    }
+
+    std::vector<unsigned long long> offsets(static_cast<size_t>(count));
+    in.read(reinterpret_cast<char*>(offsets.data()), static_cast<std::streamsize>(count * sizeof(unsigned long long)));
+    if (!in || offsets.empty() || offsets.back() != file_size) {
+        return false;
+    }
+    index.offsets.swap(offsets);
+    return true;
+}
+
+void save_dataset_index_sidecar(const DatasetIndex& index) {
+    std::string sidecar = dataset_index_sidecar_path(index.path);
+    std::string tmp_path = sidecar + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return;
+        unsigned long long count = index.offsets.size();
+        out.write(DATASET_INDEX_MAGIC, sizeof(DATASET_INDEX_MAGIC));
+        out.write(reinterpret_cast<const char*>(&index.file_size), sizeof(index.file_size));
+        out.write(reinterpret_cast<const char*>(&index.mtime), sizeof(index.mtime));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(index.offsets.data()), static_cast<std::streamsize>(count * sizeof(unsigned long long)));
+        if (!out) {
+            out.close();
+            std::remove(tmp_path.c_str());
+            return;
+        }
+    }
+    std::remove(sidecar.c_str());
+    std::rename(tmp_path.c_str(), sidecar.c_str());
+}
+
+class DatasetIndexCache {
+public:
+    // 获取文件索引，文件大小或修改时间变化时重建；文件不存在返回nullptr。
+    // 变化后旧索引立即移出缓存，即使重建失败也不会再用旧的映射读新文件
+    std::shared_ptr<const DatasetIndex> get(const std::string& path) {
+        FileStat st = stat_file(path);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = indexes.find(path);
+            if (it != indexes.end()) {
+                if (st.exists && it->second->file_size == st.size && it->second->mtime == st.mtime) {
+                    return it->second;
                 }
-            }
-            else if (file_param[i] == '+') {
-                filename += ' ';
-            }
-            else {
-                filename += file_param[i];
+                indexes.erase(it);
             }
         }
-        
-        // 安全检查，防止路径遍历攻击
-        if (filename.find("..") != std::string::npos) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"Invalid filename\"}";
-            return json_response(json.str());
+        if (!st.exists) return nullptr;
+
+        std::shared_ptr<DatasetIndex> index = build(path, st);
+        if (!index) return nullptr;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        indexes[path] = index;
+        return index;
+    }
+
+private:
+    std::shared_ptr<DatasetIndex> build(const std::string& path, const FileStat& st) {
+        std::shared_ptr<DatasetIndex> index(new DatasetIndex());
+        index->path = path;
+        index->file_size = st.size;
+        index->mtime = st.mtime;
+        index->mapped = map_file(path);
+        if (!index->mapped || index->mapped->size != st.size) return nullptr;
+
+        if (load_dataset_index_sidecar(*index)) {
+            return index;
         }
-        // 预览数据逻辑
-        std::string file_path = current_dir + "/llm/data/" + filename;
-        std::string preview = read_file_preview(file_path, 20); // 预览前20行
-        
-        // 将换行符转换为\n转义序列
-        std::string escaped_preview;
-        for (char c : preview) {
-            if (c == '\n') {
-                escaped_preview += "\\n";
-            } 
-            else if (c == '\r') {
-                // 忽略回车符
-            } 
-            else if (c == '"') {
-                escaped_preview += "\\\"";
-            } 
-            else if (c == '\\') {
-                escaped_preview += "\\\\";
-            } 
-            else {
-                escaped_preview += c;
-            }
+
+        index->offsets.reserve(static_cast<size_t>(st.size / 256) + 2);
+        index->offsets.push_back(0);
+        if (index->mapped->data) {
+            scan_newlines(index->mapped->data, index->mapped->size, 0, index->offsets);
         }
-        
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":true,";
-        json << "\"content\":\"" << escaped_preview << "\"";
-        json << "}";
-        return json_response(json.str());
+        if (index->offsets.back() != st.size) {
+            index->offsets.push_back(st.size); // 最后一行没有换行符
+        }
+        index->offsets.shrink_to_fit();
+        save_dataset_index_sidecar(*index);
+        return index;
     }
-    else if (url.find("/api/training/") == 0) {
-        // 训练API
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":true,";
-        json << "\"message\":\"训练请求已接收\",";
-        json << "\"data\":{";
-        json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
-        json << "\"status\":\"pending\"";
-        json << "}";
-        json << "}";
-        return json_response(json.str());
+
+    std::mutex mtx;
+    std::unordered_map<std::string, std::shared_ptr<DatasetIndex>> indexes;
+};
+
+DatasetIndexCache g_dataset_indexes;
+
+// ==================== 数据集目录缓存 ====================
+// /api/data/files 不再每次都遍历目录并逐个stat：目录内容缓存在内存中，
+// Linux下由inotify按文件增量更新，Windows下由目录变更通知触发重新扫描，
+// 其他平台退化为定时重新扫描。记录数来自数据集索引，在线程池中异步计算。
+
+struct DatasetFileEntry {
+    std::string name;
+    unsigned long long size;
+    long long mtime;
+    long long records;   // -1表示尚未统计
+    bool counting;       // 是否已提交记录数统计任务
+};
+
+const int DATASET_DIR_RESCAN_SECONDS = 2; // 没有目录监听时的重新扫描间隔
+
+bool is_dataset_file_name(const std::string& name) {
+    return !name.empty() && name[0] != '.' && ends_with(name, ".jsonl");
+}
+
+class DatasetDirectory {
+public:
+    DatasetDirectory() : started(false), watching(false), dirty(true), last_scan(0), version(0) {}
+
+    // 返回当前目录内容的快照，首次调用时开始监听目录
+    std::vector<DatasetFileEntry> snapshot(const std::string& data_dir) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!started || dir != data_dir) {
+            dir = data_dir;
+            started = true;
+            dirty = true;
+            start_watcher();
+        }
+        std::time_t now = std::time(nullptr);
+        if (dirty || (!watching && now - last_scan >= DATASET_DIR_RESCAN_SECONDS)) {
+            rescan();
+            last_scan = now;
+        }
+
+        std::vector<DatasetFileEntry> result;
+        result.reserve(entries.size());
+        for (auto& item : entries) {
+            if (item.second.records < 0 && !item.second.counting) {
+                schedule_record_count(item.second);
+            }
+            result.push_back(item.second);
+        }
+        return result;
     }
-    else if (url == "/api/train") {
-        // 读取POST数据体
-        std::string request_body = extract_post_data(request);
-        std::cout << "收到训练请求：" << request_body << std::endl;
-        
-        // 解析JSON配置
-        std::map<std::string, std::string> formData = parse_json(request_body);
-        
-        // 获取当前工作目录（程序运行的目录）
-        std::string current_dir;
-#ifdef _WIN32
-        // 使用宽字符函数处理可能包含中文的路径
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-#else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
+
+    // 目录内容每次变化时递增，可用于判断列表是否更新
+    unsigned long long current_version() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return version;
+    }
+
+private:
+    // 全量扫描（只在首次、监听失效或Windows收到变更通知时执行）
+    void rescan() {
+        std::map<std::string, DatasetFileEntry> fresh;
+        for (const auto& name : list_files_in_directory(dir, ".jsonl")) {
+            if (!is_dataset_file_name(name)) continue;
+            FileStat st = stat_file(dir + "/" + name);
+            if (!st.exists) continue;
+            DatasetFileEntry entry = {name, st.size, st.mtime, -1, false};
+            auto old = entries.find(name);
+            if (old != entries.end() && old->second.size == st.size && old->second.mtime == st.mtime) {
+                entry.records = old->second.records;
+                entry.counting = old->second.counting;
+            }
+            fresh[name] = entry;
         }
-#endif
+        if (fresh.size() != entries.size() || !std::equal(fresh.begin(), fresh.end(), entries.begin(),
+                [](const std::pair<const std::string, DatasetFileEntry>& a, const std::pair<const std::string, DatasetFileEntry>& b) {
+                    return a.first == b.first && a.second.size == b.second.size && a.second.mtime == b.second.mtime;
+                })) {
+            version++;
+        }
+        entries.swap(fresh);
+        dirty = false;
+    }
 
-        // 构建Python命令 开启训练脚本
-        std::wstring cmdCommand;
-        std::string cmd = "";
-        std::string error_message = "";
-        std::wstring main_py_path = L"./llm/main.py";
-        // 检查分布式设置
-        bool use_distributed = false;
-        if (formData.find("distributed") != formData.end()) {
-            use_distributed = (formData["distributed"] == "true");
+    // 单个文件变化时只更新对应条目（调用方持锁）
+    void refresh_entry(const std::string& name) {
+        if (!is_dataset_file_name(name)) return;
+        FileStat st = stat_file(dir + "/" + name);
+        auto it = entries.find(name);
+        if (!st.exists) {
+            if (it != entries.end()) {
+                entries.erase(it);
+                version++;
+            }
+            return;
         }
+        if (it != entries.end() && it->second.size == st.size && it->second.mtime == st.mtime) return;
+        entries[name] = DatasetFileEntry{name, st.size, st.mtime, -1, false};
+        version++;
+    }
 
-        // 根据distributed 构建不同的启动main.py的命令
-        if (use_distributed) {
-            // 获取GPU数量
-            std::vector<GPUInfo> gpus = detect_gpus();
-            int gpu_count = static_cast<int>(gpus.size());
-            if (gpu_count == 0) gpu_count = 1;
-            
-            // 使用torchrun启动分布式训练
-            #ifdef _WIN32
-            std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
-            std::string main_path = current_dir + "\\llm\\main.py";
-            std::replace(main_path.begin(), main_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
-            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set TORCHRUN_USE_LIBUV=0 && set PYTHONIOENCODING=utf-8 && chcp 65001 && torchrun --nproc_per_node="
-             + std::to_wstring(gpu_count) + L" " +  main_py_path + L" " + L" > ./train_log.txt 2>&1\"";
-            #else
-            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set TORCHRUN_USE_LIBUV=0 && set PYTHONIOENCODING=utf-8 && chcp 65001 && torchrun --nproc_per_node="
-             + std::to_wstring(gpu_count) + L" " +  main_py_path + L"\"";
-            #endif
-        } else {
-            // 使用普通python命令
-            #ifdef _WIN32
-            std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
-            std::string main_path = current_dir + "\\llm\\main.py";
-            std::replace(main_path.begin(), main_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
-            cmdCommand = L"start /B cmd.exe /C \""
-             L"conda activate elianfactory && "
-             L"set PYTHONIOENCODING=utf-8 && "
-             L"chcp 65001 > nul && "
-             L"python " + main_py_path + L" > \"./train_log.txt\" 2>&1\"";
-            #else
-            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set PYTHONIOENCODING=utf-8 && chcp 65001 && python ./llm/main.py \"";
-            #endif
+    // 在线程池中通过数据集索引统计记录数（调用方持锁）
+    void schedule_record_count(DatasetFileEntry& entry) {
+        entry.counting = true;
+        std::string name = entry.name;
+        std::string path = dir + "/" + name;
+        worker_pool().submit([this, name, path]() {
+            std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(path);
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = entries.find(name);
+            if (it == entries.end()) return;
+            it->second.counting = false;
+            if (index && index->file_size == it->second.size && index->mtime == it->second.mtime) {
+                it->second.records = static_cast<long long>(index->record_count());
+                version++;
+            }
+        });
+    }
+
+    void start_watcher() {
+#if defined(__linux__)
+        int fd = inotify_init1(IN_CLOEXEC);
+        if (fd < 0) return;
+        uint32_t mask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO |
+                        IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+        if (inotify_add_watch(fd, dir.c_str(), mask) < 0) {
+            close(fd);
+            return;
         }
-        
-        // 添加训练参数
-        // 基础模型路径
-        if (formData.find("model_name_or_path") != formData.end()) {
-            std::string model_path = formData["model_name_or_path"];
-            if (model_path.size() > 2 && model_path[0] == '"' && model_path[model_path.size() - 1] == '"') {
-                model_path = model_path.substr(1, model_path.size() - 2);
+        watching = true;
+        std::thread([this, fd]() {
+            alignas(struct inotify_event) char buffer[16384];
+            while (true) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n < 0 && errno == EINTR) continue;
+                std::lock_guard<std::mutex> lock(mtx);
+                if (n <= 0) {
+                    watching = false; // 监听失效，退化为定时扫描
+                    dirty = true;
+                    close(fd);
+                    return;
+                }
+                for (char* p = buffer; p < buffer + n;) {
+                    struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        dirty = true; // 事件丢失，下次访问时全量扫描
+                    } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        watching = false; // 目录本身被删除或移走
+                        dirty = true;
+                    } else if (event->len > 0) {
+                        refresh_entry(event->name);
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+                if (!watching) {
+                    close(fd);
+                    return;
+                }
             }
-            
-            // 处理路径：添加基础目录
-            if (model_path.size() <= 1 || model_path[1] != ':') { // 非绝对路径
-                if (model_path[0] == '/' || model_path[0] == '\\') {
-                    model_path = model_path.substr(1);
+        }).detach();
+#elif defined(_WIN32)
+        int size_needed = MultiByteToWideChar(CP_UTF8, 0, dir.c_str(), -1, NULL, 0);
+        std::vector<wchar_t> wdir(size_needed);
+        MultiByteToWideChar(CP_UTF8, 0, dir.c_str(), -1, wdir.data(), size_needed);
+        HANDLE change = FindFirstChangeNotificationW(wdir.data(), FALSE,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (change == INVALID_HANDLE_VALUE) return;
+        watching = true;
+        std::thread([this, change]() {
+            while (WaitForSingleObject(change, INFINITE) == WAIT_OBJECT_0) {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    dirty = true;
                 }
-                #ifdef _WIN32
-                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
-                model_path = current_dir + "\\llm\\" + model_path;
-                std::replace(model_path.begin(), model_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
-                
-                // 创建模型路径目录
-                std::string model_dir = model_path.substr(0, model_path.find_last_of('\\'));
-                if (!file_exists(model_dir)) {
-                    std::cout << "创建模型目录: " << model_dir << std::endl;
-                    // 递归创建目录
-                    std::string path_so_far;
-                    std::istringstream path_stream(model_dir);
-                    std::string folder;
-                    while (std::getline(path_stream, folder, '\\')) {
-                        if (path_so_far.empty()) {
-                            path_so_far = folder;
+                if (!FindNextChangeNotification(change)) break;
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            watching = false;
+            dirty = true;
+            FindCloseChangeNotification(change);
+        }).detach();
+#endif
+    }
+
+    std::mutex mtx;
+    std::string dir;
+    std::map<std::string, DatasetFileEntry> entries;
+    bool started;
+    bool watching;
+    bool dirty;
+    std::time_t last_scan;
+    unsigned long long version;
+};
+
+DatasetDirectory g_dataset_directory;
+
+// ==================== 数据集校验与统计 ====================
+// 在训练开始前检查每条记录是否为合法JSON，且包含process_data()需要的
+// conversation[0].human / conversation[0].assistant 字符串，同时统计文本长度分布。
+// 结果按文件大小和修改时间缓存。
+
+const int LENGTH_HIST_BUCKETS = 14; // <16, <32, ... , <65536, >=65536
+
+struct TextLengthStats {
+    unsigned long long count;
+    unsigned long long total_bytes;
+    unsigned long long total_tokens;
+    unsigned long long max_bytes;
+    unsigned long long max_tokens;
+    unsigned long long byte_hist[LENGTH_HIST_BUCKETS];
+    unsigned long long token_hist[LENGTH_HIST_BUCKETS];
+
+    TextLengthStats() : count(0), total_bytes(0), total_tokens(0), max_bytes(0), max_tokens(0) {
+        std::fill(byte_hist, byte_hist + LENGTH_HIST_BUCKETS, 0ULL);
+        std::fill(token_hist, token_hist + LENGTH_HIST_BUCKETS, 0ULL);
+    }
+
+    static int bucket_of(unsigned long long value) {
+        int bucket = 0;
+        unsigned long long bound = 16;
+        while (bucket < LENGTH_HIST_BUCKETS - 1 && value >= bound) {
+            bound <<= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    void add(unsigned long long bytes, unsigned long long tokens) {
+        count++;
+        total_bytes += bytes;
+        total_tokens += tokens;
+        max_bytes = std::max(max_bytes, bytes);
+        max_tokens = std::max(max_tokens, tokens);
+        byte_hist[bucket_of(bytes)]++;
+        token_hist[bucket_of(tokens)]++;
+    }
+
+    void merge(const TextLengthStats& other) {
+        count += other.count;
+        total_bytes += other.total_bytes;
+        total_tokens += other.total_tokens;
+        max_bytes = std::max(max_bytes, other.max_bytes);
+        max_tokens = std::max(max_tokens, other.max_tokens);
+        for (int i = 0; i < LENGTH_HIST_BUCKETS; ++i) {
+            byte_hist[i] += other.byte_hist[i];
+            token_hist[i] += other.token_hist[i];
+        }
+    }
+};
+
+// JSON字符串解码后的长度信息
+struct TextMeasure {
+    unsigned long long bytes;       // UTF-8字节数
+    unsigned long long ascii;       // ASCII字符数
+    unsigned long long multibyte;   // 非ASCII码点数（中文等）
+
+    // 近似token数：英文约4字节一个token，中文等约一个字一个token
+    unsigned long long approx_tokens() const {
+        return (ascii + 3) / 4 + multibyte;
+    }
+};
+
+// 只做校验的轻量JSON解析器，不构建DOM
+struct JsonValidator {
+    const char* p;
+    const char* end;
+    const char* error;
+
+    JsonValidator(const char* begin, const char* finish) : p(begin), end(finish), error(nullptr) {}
+
+    bool fail(const char* message) {
+        if (!error) error = message;
+        return false;
+    }
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+
+    // 解析字符串；measure非空时统计解码后的长度，raw_begin/raw_end非空时返回未解码的原始内容（用于比较键名）
+    bool parse_string(TextMeasure* measure, const char** raw_begin, const char** raw_end) {
+        skip_ws();
+        if (p >= end || *p != '"') return fail("此处应为字符串");
+        p++;
+        const char* begin = p;
+        while (p < end && *p != '"') {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c < 0x20) return fail("字符串中包含未转义的控制字符");
+            if (c == '\\') {
+                if (++p >= end) return fail("字符串未结束");
+                if (*p == 'u') {
+                    if (end - p < 5) return fail("无效的\\u转义");
+                    unsigned int code = 0;
+                    for (int i = 1; i <= 4; ++i) {
+                        char h = p[i];
+                        code <<= 4;
+                        if (h >= '0' && h <= '9') code |= static_cast<unsigned int>(h - '0');
+                        else if (h >= 'a' && h <= 'f') code |= static_cast<unsigned int>(h - 'a' + 10);
+                        else if (h >= 'A' && h <= 'F') code |= static_cast<unsigned int>(h - 'A' + 10);
+                        else return fail("无效的\\u转义");
+                    }
+                    p += 5;
+                    if (measure) {
+                        if (code < 0x80) {
+                            measure->bytes += 1;
+                            measure->ascii += 1;
+                        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                            measure->bytes += 2; // 代理对后半部分，与前半部分合计4字节
                         } else {
-                            path_so_far += "\\" + folder;
-                        }
-                        if (!path_so_far.empty() && !file_exists(path_so_far)) {
-                            if (!CreateDirectoryA(path_so_far.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
-                                error_message = "无法创建模型目录: " + path_so_far + ", 错误码: " + std::to_string(GetLastError());
-                                break;
-                            }
+                            measure->bytes += code < 0x800 ? 2 : (code >= 0xD800 && code <= 0xDBFF ? 2 : 3);
+                            measure->multibyte += 1;
                         }
                     }
+                    continue;
                 }
-                #else
-                model_path = current_dir + "/llm/" + model_path;
-                #endif
+                if (strchr("\"\\/bfnrt", *p) == nullptr) return fail("无效的转义字符");
+                p++;
+                if (measure) {
+                    measure->bytes += 1;
+                    measure->ascii += 1;
+                }
+                continue;
             }
-            
-            // 检查模型路径是否存在
-            if (!file_exists(model_path) && error_message.empty()) {
-                error_message = "模型路径不存在: " + model_path;
+            if (measure) {
+                measure->bytes += 1;
+                if (c < 0x80) measure->ascii += 1;
+                else if ((c & 0xC0) != 0x80) measure->multibyte += 1; // UTF-8首字节
             }
-            
-            cmd += " --model_name_or_path \"" + model_path + "\"";
-        } else {
-            error_message = "缺少必要参数: model_name_or_path";
+            p++;
         }
-        
-        // 微调输出权重路径
-        if (formData.find("output_dir") != formData.end() && error_message.empty()) {
-            std::string output_path = formData["output_dir"];
-            if (output_path.size() > 2 && output_path[0] == '"' && output_path[output_path.size() - 1] == '"') {
-                output_path = output_path.substr(1, output_path.size() - 2);
-            }
-            
-            // 处理路径：添加基础目录
-            if (output_path.size() <= 1 || output_path[1] != ':') { // 非绝对路径
-                if (output_path[0] == '/' || output_path[0] == '\\') {
-                    output_path = output_path.substr(1);
-                }
-                #ifdef _WIN32
-                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
-                output_path = current_dir + "\\llm\\" + output_path;
-                std::replace(output_path.begin(), output_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
-                
-                // 创建输出目录
-                std::string output_dir = output_path;
-                #else
-                output_path = current_dir + "/llm/" + output_path;
-                #endif
-            }
-            
-            cmd += " --output_dir \"" + output_path + "\"";
-        } else if (error_message.empty()) {
-            error_message = "缺少必要参数: output_dir";
+        if (p >= end) return fail("字符串未结束");
+        if (raw_begin) *raw_begin = begin;
+        if (raw_end) *raw_end = p;
+        p++;
+        return true;
+    }
+
+    bool parse_number() {
+        const char* start = p;
+        if (p < end && *p == '-') p++;
+        if (p >= end || !isdigit(static_cast<unsigned char>(*p))) return fail("无效的数字");
+        while (p < end && isdigit(static_cast<unsigned char>(*p))) p++;
+        if (p < end && *p == '.') {
+            p++;
+            if (p >= end || !isdigit(static_cast<unsigned char>(*p))) return fail("无效的数字");
+            while (p < end && isdigit(static_cast<unsigned char>(*p))) p++;
         }
-        
-        // 训练文件路径
-        if (formData.find("train_file") != formData.end() && error_message.empty()) {
-            std::string train_file = formData["train_file"];
-            if (train_file.size() > 2 && train_file[0] == '"' && train_file[train_file.size() - 1] == '"') {
-                train_file = train_file.substr(1, train_file.size() - 2);
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p < end && (*p == '+' || *p == '-')) p++;
+            if (p >= end || !isdigit(static_cast<unsigned char>(*p))) return fail("无效的数字");
+            while (p < end && isdigit(static_cast<unsigned char>(*p))) p++;
+        }
+        return p > start;
+    }
+
+    bool parse_literal(const char* word) {
+        size_t len = strlen(word);
+        if (static_cast<size_t>(end - p) < len || memcmp(p, word, len) != 0) return fail("无效的JSON值");
+        p += len;
+        return true;
+    }
+
+    bool parse_value(int depth) {
+        if (depth > 64) return fail("JSON嵌套层级过深");
+        skip_ws();
+        if (p >= end) return fail("JSON不完整");
+        switch (*p) {
+        case '"': return parse_string(nullptr, nullptr, nullptr);
+        case '{': {
+            p++;
+            if (consume('}')) return true;
+            do {
+                if (!parse_string(nullptr, nullptr, nullptr)) return false;
+                if (!consume(':')) return fail("对象中缺少冒号");
+                if (!parse_value(depth + 1)) return false;
+            } while (consume(','));
+            return consume('}') || fail("对象未正确结束");
+        }
+        case '[': {
+            p++;
+            if (consume(']')) return true;
+            do {
+                if (!parse_value(depth + 1)) return false;
+            } while (consume(','));
+            return consume(']') || fail("数组未正确结束");
+        }
+        case 't': return parse_literal("true");
+        case 'f': return parse_literal("false");
+        case 'n': return parse_literal("null");
+        default: return parse_number();
+        }
+    }
+
+    static bool key_equals(const char* begin, const char* finish, const char* key) {
+        size_t len = strlen(key);
+        return static_cast<size_t>(finish - begin) == len && memcmp(begin, key, len) == 0;
+    }
+
+    // 解析conversation[0]对象，提取human/assistant的长度
+    bool parse_turn(TextMeasure& human, TextMeasure& assistant, bool& has_human, bool& has_assistant) {
+        if (!consume('{')) return fail("conversation[0]不是对象");
+        if (consume('}')) return true;
+        do {
+            const char* key_begin = nullptr;
+            const char* key_end = nullptr;
+            if (!parse_string(nullptr, &key_begin, &key_end)) return false;
+            if (!consume(':')) return fail("对象中缺少冒号");
+            skip_ws();
+            bool is_human = key_equals(key_begin, key_end, "human");
+            bool is_assistant = key_equals(key_begin, key_end, "assistant");
+            if ((is_human || is_assistant) && p < end && *p == '"') {
+                if (!parse_string(is_human ? &human : &assistant, nullptr, nullptr)) return false;
+                (is_human ? has_human : has_assistant) = true;
+            } else if (!parse_value(1)) {
+                return false;
             }
-            
-            // 处理路径：添加基础目录
-            if (train_file.size() <= 1 || train_file[1] != ':') { // 非绝对路径
-                if (train_file[0] == '/' || train_file[0] == '\\') {
-                    train_file = train_file.substr(1);
+        } while (consume(','));
+        return consume('}') || fail("对象未正确结束");
+    }
+
+    // 校验一条训练记录
+    bool parse_record(TextMeasure& human, TextMeasure& assistant) {
+        bool has_conversation = false;
+        bool has_human = false;
+        bool has_assistant = false;
+
+        if (!consume('{')) return fail("记录不是JSON对象");
+        if (!consume('}')) {
+            do {
+                const char* key_begin = nullptr;
+                const char* key_end = nullptr;
+                if (!parse_string(nullptr, &key_begin, &key_end)) return false;
+                if (!consume(':')) return fail("对象中缺少冒号");
+                skip_ws();
+                if (key_equals(key_begin, key_end, "conversation") && p < end && *p == '[') {
+                    p++;
+                    has_conversation = true;
+                    if (!consume(']')) {
+                        if (!parse_turn(human, assistant, has_human, has_assistant)) return false;
+                        while (consume(',')) {
+                            if (!parse_value(2)) return false;
+                        }
+                        if (!consume(']')) return fail("数组未正确结束");
+                    }
+                } else if (!parse_value(1)) {
+                    return false;
                 }
-                #ifdef _WIN32
-                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
+            } while (consume(','));
+            if (!consume('}')) return fail("对象未正确结束");
+        }
+        skip_ws();
+        if (p != end) return fail("记录末尾存在多余内容");
+        if (!has_conversation) return fail("缺少conversation字段");
+        if (!has_human) return fail("缺少conversation[0].human");
+        if (!has_assistant) return fail("缺少conversation[0].assistant");
+        return true;
+    }
+};
+
+const size_t DATASET_STATS_MAX_INVALID = 100; // 最多列出的无效行数
+
+struct DatasetStats {
+    unsigned long long file_size;
+    long long mtime;
+    size_t records;
+    size_t valid;
+    size_t invalid_count;
+    std::vector<std::pair<size_t, std::string>> invalid_lines; // 行号(从1开始)和原因
+    TextLengthStats human;
+    TextLengthStats assistant;
+    std::vector<std::pair<uint32_t, uint32_t>> sample_tokens; // 每条有效记录的近似token数(human, assistant)，用于估算打包效率
+    double elapsed_ms;
+};
+
+// 校验一行记录（行号从1开始）并累计到stats，line_end可以包含行尾的\r\n
+void validate_dataset_line(const char* line_begin, const char* line_end, size_t line_no, DatasetStats& stats) {
+    while (line_end > line_begin && (line_end[-1] == '\n' || line_end[-1] == '\r')) line_end--;
+
+    TextMeasure human = {0, 0, 0};
+    TextMeasure assistant = {0, 0, 0};
+    JsonValidator validator(line_begin, line_end);
+    if (line_begin == line_end) {
+        validator.fail("空行");
+    } else {
+        validator.parse_record(human, assistant);
+    }
+
+    stats.records++;
+    if (validator.error) {
+        stats.invalid_count++;
+        if (stats.invalid_lines.size() < DATASET_STATS_MAX_INVALID) {
+            stats.invalid_lines.emplace_back(line_no, validator.error);
+        }
+    } else {
+        stats.valid++;
+        stats.human.add(human.bytes, human.approx_tokens());
+        stats.assistant.add(assistant.bytes, assistant.approx_tokens());
+        stats.sample_tokens.emplace_back(static_cast<uint32_t>(std::min<unsigned long long>(human.approx_tokens(), UINT32_MAX)),
+                                         static_cast<uint32_t>(std::min<unsigned long long>(assistant.approx_tokens(), UINT32_MAX)));
+    }
+}
+
+DatasetStats compute_dataset_stats(const DatasetIndex& index) {
+    auto started = std::chrono::steady_clock::now();
+
+    std::vector<DatasetStats> partials;
+    std::mutex partials_mtx;
+    size_t records = index.record_count();
+
+    worker_pool().parallel_for(records, 256, [&](size_t begin, size_t end) {
+        DatasetStats local;
+        local.records = 0;
+        local.valid = 0;
+        local.invalid_count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            validate_dataset_line(index.mapped->data + index.offsets[i], index.mapped->data + index.offsets[i + 1], i + 1, local);
+        }
+        std::lock_guard<std::mutex> lock(partials_mtx);
+        partials.push_back(std::move(local));
+    });
+
+    DatasetStats stats;
+    stats.file_size = index.file_size;
+    stats.mtime = index.mtime;
+    stats.records = records;
+    stats.valid = 0;
+    stats.invalid_count = 0;
+    for (const auto& part : partials) {
+        stats.valid += part.valid;
+        stats.invalid_count += part.invalid_count;
+        stats.invalid_lines.insert(stats.invalid_lines.end(), part.invalid_lines.begin(), part.invalid_lines.end());
+        stats.human.merge(part.human);
+        stats.assistant.merge(part.assistant);
+        stats.sample_tokens.insert(stats.sample_tokens.end(), part.sample_tokens.begin(), part.sample_tokens.end());
+    }
+    std::sort(stats.invalid_lines.begin(), stats.invalid_lines.end());
+    if (stats.invalid_lines.size() > DATASET_STATS_MAX_INVALID) {
+        stats.invalid_lines.resize(DATASET_STATS_MAX_INVALID);
+    }
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+class DatasetStatsCache {
+public:
+    // 获取文件统计结果，cached返回是否命中缓存；文件不存在返回nullptr
+    std::shared_ptr<const DatasetStats> get(const std::string& path, bool* cached) {
+        std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(path);
+        if (!index) return nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = results.find(path);
+            if (it != results.end() && it->second->file_size == index->file_size && it->second->mtime == index->mtime) {
+                if (cached) *cached = true;
+                return it->second;
+            }
+        }
+
+        std::shared_ptr<const DatasetStats> stats = std::make_shared<DatasetStats>(compute_dataset_stats(*index));
+        if (cached) *cached = false;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        results[path] = stats;
+        return stats;
+    }
+
+    // 写入外部已算好的统计结果（如上传时边接收边校验的结果）
+    void put(const std::string& path, const DatasetStats& stats) {
+        std::lock_guard<std::mutex> lock(mtx);
+        results[path] = std::make_shared<DatasetStats>(stats);
+    }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<std::string, std::shared_ptr<const DatasetStats>> results;
+};
+
+DatasetStatsCache g_dataset_stats;
+
+std::string text_length_stats_to_json(const TextLengthStats& stats) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"count\":" << stats.count << ",";
+    json << "\"avg_bytes\":" << (stats.count ? stats.total_bytes / stats.count : 0) << ",";
+    json << "\"max_bytes\":" << stats.max_bytes << ",";
+    json << "\"avg_tokens\":" << (stats.count ? stats.total_tokens / stats.count : 0) << ",";
+    json << "\"max_tokens\":" << stats.max_tokens << ",";
+    json << "\"total_tokens\":" << stats.total_tokens << ",";
+
+    // 直方图每个桶用上界表示，最后一个桶le为null表示无上界
+    const unsigned long long* hists[2] = {stats.byte_hist, stats.token_hist};
+    const char* names[2] = {"bytes_histogram", "tokens_histogram"};
+    for (int h = 0; h < 2; ++h) {
+        json << "\"" << names[h] << "\":[";
+        unsigned long long bound = 16;
+        for (int i = 0; i < LENGTH_HIST_BUCKETS; ++i) {
+            if (i > 0) json << ",";
+            json << "{\"le\":";
+            if (i == LENGTH_HIST_BUCKETS - 1) json << "null";
+            else json << bound;
+            json << ",\"count\":" << hists[h][i] << "}";
+            bound <<= 1;
+        }
+        json << "]";
+        if (h == 0) json << ",";
+    }
+    json << "}";
+    return json.str();
+}
+
+// 从HTTP请求中提取POST数据体
+std::string extract_post_data(const std::string& request) {
+    // 查找请求体开始的位置（在空行之后）
+    std::string delimiter = "\r\n\r\n";
+    size_t pos = request.find(delimiter);
+    
+    if (pos != std::string::npos) {
+        // 返回请求体部分
+        return request.substr(pos + delimiter.length());
+    }
+    
+    return "";
+}
+
+// 简单的JSON解析函数，将JSON文本转换为键值对
+std::map<std::string, std::string> parse_json(const std::string& json_text) {
+    std::map<std::string, std::string> result;
+    
+    // 非常简单的解析，仅用于演示
+    // 实际应用中应使用成熟的JSON解析库
+    std::regex key_value_regex("\"([^\"]+)\"\\s*:\\s*(\"[^\"]*\"|\\d+|true|false|null)");
+    std::smatch matches;
+    std::string::const_iterator search_start(json_text.cbegin());
+    
+    while (std::regex_search(search_start, json_text.cend(), matches, key_value_regex)) {
+        std::string key = matches[1].str();
+        std::string value = matches[2].str();
+        
+        // 如果值是字符串，去掉引号
+        if (value[0] == '"' && value[value.length() - 1] == '"') {
+            value = value.substr(1, value.length() - 2);
+        }
+        // 处理布尔值，统一转为小写形式，便于后续判断
+        else if (value == "true" || value == "false") {
+            std::transform(value.begin(), value.end(), value.begin(),
+                [](unsigned char c) { return std::tolower(c); });
+        }
+        
+        result[key] = value;
+        search_start = matches.suffix().first;
+    }
+    
+    return result;
+}
+
+// JSON字符串转义函数，确保动态内容安全地嵌入到JSON中
+// 把转义后的JSON字符串内容追加到out（std::string或ArenaString）
+template <typename Out>
+void append_json_escaped(Out& out, std::string_view s) {
+    static const char hex[] = "0123456789abcdef";
+    size_t run_start = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        const char* escaped = nullptr;
+        switch (c) {
+        case '"': escaped = "\\\""; break;
+        case '\\': escaped = "\\\\"; break;
+        case '\b': escaped = "\\b"; break;
+        case '\f': escaped = "\\f"; break;
+        case '\n': escaped = "\\n"; break;
+        case '\r': escaped = "\\r"; break;
+        case '\t': escaped = "\\t"; break;
+        default:
+            if ('\x00' <= c && c <= '\x1f') {
+                out.append(s.data() + run_start, i - run_start);
+                char unicode[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xF], hex[c & 0xF]};
+                out.append(unicode, sizeof(unicode));
+                run_start = i + 1;
+            }
+            continue;
+        }
+        out.append(s.data() + run_start, i - run_start);
+        out.append(escaped);
+        run_start = i + 1;
+    }
+    out.append(s.data() + run_start, s.size() - run_start);
+}
+
+std::string escape_json(const std::string &s) {
+    std::string o;
+    o.reserve(s.length() + s.length() / 8);
+    append_json_escaped(o, s);
+    return o;
+}
+
+// ==================== 异步日志 ====================
+// 请求路径上的日志只把字段格式化到栈上的缓冲区，再通过无锁的有界队列交给后台线程，
+// 由后台线程批量写出JSON Lines。队列满时丢弃并计数，不阻塞请求。
+// 级别由环境变量ELIAN_LOG_LEVEL（debug/info/warn/error）控制，默认info；
+// 请求体、提示词和完整命令行只在debug级别输出。设置ELIAN_LOG_FILE时追加写入该文件，否则写到标准输出。
+
+enum class LogLevel { Debug, Info, Warn, Error };
+
+const size_t LOG_QUEUE_SIZE = 1024;     // 必须是2的幂
+const size_t LOG_FIELDS_SIZE = 480;
+const char* const LOG_LEVEL_NAMES[] = {"debug", "info", "warn", "error"};
+
+LogLevel log_level_from_env() {
+    const char* value = std::getenv("ELIAN_LOG_LEVEL");
+    if (value == nullptr) return LogLevel::Info;
+    for (int i = 0; i < 4; ++i) {
+        if (std::strcmp(value, LOG_LEVEL_NAMES[i]) == 0) return static_cast<LogLevel>(i);
+    }
+    return LogLevel::Info;
+}
+
+const LogLevel g_log_level = log_level_from_env();
+
+inline bool log_enabled(LogLevel level) {
+    return level >= g_log_level;
+}
+
+// 定长的字段缓冲区，写满后截断；截断不会拆开转义序列和UTF-8字符
+struct LogFields {
+    static const size_t RESERVED = 20;   // 留给截断后补的引号和truncated标记
+    char data[LOG_FIELDS_SIZE];
+    size_t size = 0;
+    bool truncated = false;
+
+    void append(const char* s, size_t n) {
+        if (truncated) return;
+        size_t room = sizeof(data) - RESERVED - size;
+        if (n <= room) {
+            std::memcpy(data + size, s, n);
+            size += n;
+            return;
+        }
+        truncated = true;
+        if (s[0] == '\\') return;
+        size_t keep = room;
+        while (keep > 0 && (static_cast<unsigned char>(s[keep]) & 0xC0) == 0x80) --keep;
+        std::memcpy(data + size, s, keep);
+        size += keep;
+    }
+
+    void append(const char* s) { append(s, std::strlen(s)); }
+
+    // 写入预留区，不检查长度
+    void raw(const char* s, size_t n) {
+        std::memcpy(data + size, s, n);
+        size += n;
+    }
+};
+
+class AsyncLogger {
+public:
+    AsyncLogger() : slots(new Slot[LOG_QUEUE_SIZE]) {
+        for (size_t i = 0; i < LOG_QUEUE_SIZE; ++i) slots[i].sequence.store(i, std::memory_order_relaxed);
+        const char* path = std::getenv("ELIAN_LOG_FILE");
+        if (path != nullptr && *path != '\0') output = fopen(path, "ab");
+        if (output == nullptr) output = stdout;
+        writer = std::thread([this] { run(); });
+    }
+
+    ~AsyncLogger() {
+        stopping.store(true);
+        writer.join();
+        if (output != stdout) fclose(output);
+    }
+
+    // 多个生产者通过CAS领取槽位，槽位的sequence表示是否可写/可读
+    void push(LogLevel level, const char* event, const LogFields& fields) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & (LOG_QUEUE_SIZE - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        slot->level = level;
+        slot->event = event;
+        slot->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        slot->size = fields.size;
+        std::memcpy(slot->fields, fields.data, fields.size);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        const char* event;
+        long long time_us;
+        size_t size;
+        char fields[LOG_FIELDS_SIZE];
+    };
+
+    // 单消费者：取出所有已就绪的记录，格式化后一次写出
+    bool drain(std::string& out) {
+        out.clear();
+        while (true) {
+            Slot& slot = slots[dequeue_pos & (LOG_QUEUE_SIZE - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) break;
+            format(out, slot.level, slot.event, slot.time_us, std::string_view(slot.fields, slot.size));
+            slot.sequence.store(dequeue_pos + LOG_QUEUE_SIZE, std::memory_order_release);
+            ++dequeue_pos;
+        }
+        size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            std::string fields = ",\"dropped\":";
+            append_integer(fields, static_cast<long long>(lost));
+            long long now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            format(out, LogLevel::Warn, "log.dropped", now, fields);
+        }
+        if (out.empty()) return false;
+        fwrite(out.data(), 1, out.size(), output);
+        fflush(output);
+        return true;
+    }
+
+    static void format(std::string& out, LogLevel level, const char* event, long long time_us, std::string_view fields) {
+        time_t seconds = static_cast<time_t>(time_us / 1000000);
+        struct tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        char stamp[64];
+        snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%06lldZ",
+                 utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+                 time_us % 1000000);
+        out += "{\"ts\":\"";
+        out += stamp;
+        out += "\",\"level\":\"";
+        out += LOG_LEVEL_NAMES[static_cast<int>(level)];
+        out += "\",\"event\":\"";
+        out += event;
+        out += "\"";
+        out.append(fields.data(), fields.size());
+        out += "}\n";
+    }
+
+    void run() {
+        std::string out;
+        while (true) {
+            bool stop = stopping.load();
+            if (!drain(out)) {
+                if (stop) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> enqueue_pos{0};
+    size_t dequeue_pos = 0;
+    std::atomic<size_t> dropped{0};
+    std::atomic<bool> stopping{false};
+    FILE* output = nullptr;
+    std::thread writer;
+};
+
+AsyncLogger& async_logger() {
+    static AsyncLogger logger;
+    return logger;
+}
+
+// 一条日志：log_event(...).str(...).num(...)，语句结束时入队；级别未开启时什么都不做
+class LogLine {
+public:
+    LogLine(LogLevel level, const char* event) : level(level), event(event), active(log_enabled(level)) {}
+
+    ~LogLine() {
+        if (!active) return;
+        if (fields.truncated) fields.raw(",\"truncated\":true", 17);
+        async_logger().push(level, event, fields);
+    }
+
+    // 字符串值放不下时截断并补上引号，键放不下时整个字段丢弃
+    LogLine& str(const char* key, std::string_view value) {
+        if (!active || fields.truncated) return *this;
+        size_t start = fields.size;
+        fields.append(",\"");
+        fields.append(key);
+        fields.append("\":\"");
+        if (fields.truncated) {
+            fields.size = start;
+            return *this;
+        }
+        append_json_escaped(fields, value);
+        fields.append("\"");
+        if (fields.truncated) fields.raw("\"", 1);
+        return *this;
+    }
+
+    LogLine& num(const char* key, long long value) {
+        if (!active || fields.truncated) return *this;
+        size_t start = fields.size;
+        fields.append(",\"");
+        fields.append(key);
+        fields.append("\":");
+        append_integer(fields, value);
+        if (fields.truncated) fields.size = start;
+        return *this;
+    }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+private:
+    LogLevel level;
+    const char* event;
+    bool active;
+    LogFields fields;
+};
+
+inline LogLine log_event(LogLevel level, const char* event) {
+    return LogLine(level, event);
+}
+
+// ==================== JSON DOM解析 ====================
+// parse_json只能处理扁平的键值对，需要嵌套结构时（tokenizer.json、配置文件等）使用JsonValue
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0;
+    std::string str;    // 字符串内容；数字时保存原始文本
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members; // 保持键的原始顺序
+
+    bool is_null() const { return type == Null; }
+    bool is_bool() const { return type == Bool; }
+    bool is_number() const { return type == Number; }
+    bool is_string() const { return type == String; }
+    bool is_array() const { return type == Array; }
+    bool is_object() const { return type == Object; }
+
+    const JsonValue* find(const std::string& key) const {
+        if (type != Object) return nullptr;
+        for (const auto& member : members) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+struct JsonDomParser {
+    const char* p;
+    const char* end;
+    std::string error;
+
+    bool fail(const std::string& message) {
+        if (error.empty()) error = message;
+        return false;
+    }
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+
+    static void append_utf8(std::string& out, unsigned int cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool parse_hex4(unsigned int& cp) {
+        if (end - p < 4) return fail("无效的\\u转义");
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            char h = *p++;
+            cp <<= 4;
+            if (h >= '0' && h <= '9') cp |= static_cast<unsigned int>(h - '0');
+            else if (h >= 'a' && h <= 'f') cp |= static_cast<unsigned int>(h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') cp |= static_cast<unsigned int>(h - 'A' + 10);
+            else return fail("无效的\\u转义");
+        }
+        return true;
+    }
+
+    bool parse_string(std::string& out) {
+        if (p >= end || *p != '"') return fail("此处应为字符串");
+        p++;
+        while (p < end && *p != '"') {
+            // 连续的普通字符整段拷贝
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\') p++;
+            out.append(run, p);
+            if (p >= end || *p == '"') break;
+
+            if (++p >= end) return fail("字符串未结束");
+            char c = *p++;
+            switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned int cp;
+                if (!parse_hex4(cp)) return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    p += 2;
+                    unsigned int low;
+                    if (!parse_hex4(low)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return fail("无效的转义字符");
+            }
+        }
+        if (p >= end) return fail("字符串未结束");
+        p++;
+        return true;
+    }
+
+    bool parse_value(JsonValue& value, int depth) {
+        if (depth > 128) return fail("JSON嵌套层级过深");
+        skip_ws();
+        if (p >= end) return fail("JSON不完整");
+        switch (*p) {
+        case '"':
+            value.type = JsonValue::String;
+            return parse_string(value.str);
+        case '{':
+            value.type = JsonValue::Object;
+            p++;
+            skip_ws();
+            if (p < end && *p == '}') {
+                p++;
+                return true;
+            }
+            while (true) {
+                skip_ws();
+                value.members.emplace_back();
+                if (!parse_string(value.members.back().first)) return false;
+                skip_ws();
+                if (p >= end || *p != ':') return fail("对象中缺少冒号");
+                p++;
+                if (!parse_value(value.members.back().second, depth + 1)) return false;
+                skip_ws();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == '}') {
+                    p++;
+                    return true;
+                }
+                return fail("对象未正确结束");
+            }
+        case '[':
+            value.type = JsonValue::Array;
+            p++;
+            skip_ws();
+            if (p < end && *p == ']') {
+                p++;
+                return true;
+            }
+            while (true) {
+                value.items.emplace_back();
+                if (!parse_value(value.items.back(), depth + 1)) return false;
+                skip_ws();
+                if (p < end && *p == ',') {
+                    p++;
+                    continue;
+                }
+                if (p < end && *p == ']') {
+                    p++;
+                    return true;
+                }
+                return fail("数组未正确结束");
+            }
+        case 't':
+        case 'f':
+        case 'n': {
+            const char* word = *p == 't' ? "true" : (*p == 'f' ? "false" : "null");
+            size_t len = strlen(word);
+            if (static_cast<size_t>(end - p) < len || memcmp(p, word, len) != 0) return fail("无效的JSON值");
+            p += len;
+            value.type = *word == 'n' ? JsonValue::Null : JsonValue::Bool;
+            value.boolean = *word == 't';
+            return true;
+        }
+        default: {
+            const char* start = p;
+            if (p < end && *p == '-') p++;
+            while (p < end && (isdigit(static_cast<unsigned char>(*p)) || *p == '.' || *p == 'e' || *p == 'E' || *p == '+' || *p == '-')) p++;
+            if (p == start) return fail("无效的JSON值");
+            value.type = JsonValue::Number;
+            value.str.assign(start, p);
+            char* parsed_end = nullptr;
+            value.number = std::strtod(value.str.c_str(), &parsed_end);
+            if (parsed_end == value.str.c_str() || *parsed_end != '\0') return fail("无效的数字");
+            return true;
+        }
+        }
+    }
+};
+
+// 解析完整的JSON文本，失败时error返回原因
+bool json_parse(const char* begin, const char* end, JsonValue& out, std::string* error) {
+    JsonDomParser parser;
+    parser.p = begin;
+    parser.end = end;
+    out = JsonValue();
+    bool ok = parser.parse_value(out, 0);
+    if (ok) {
+        parser.skip_ws();
+        if (parser.p != end) ok = parser.fail("JSON末尾存在多余内容");
+    }
+    if (!ok && error) *error = parser.error;
+    return ok;
+}
+
+bool json_parse(const std::string& text, JsonValue& out, std::string* error) {
+    return json_parse(text.data(), text.data() + text.length(), out, error);
+}
+
+// 序列化为JSON文本，indent大于0时按该缩进格式化输出；数字保持解析时的原始写法
+void json_serialize(const JsonValue& value, std::string& out, int indent = 0, int depth = 0) {
+    auto newline = [&](int level) {
+        if (indent <= 0) return;
+        out += '\n';
+        out.append(static_cast<size_t>(indent * level), ' ');
+    };
+    switch (value.type) {
+    case JsonValue::Null: out += "null"; break;
+    case JsonValue::Bool: out += value.boolean ? "true" : "false"; break;
+    case JsonValue::Number: out += value.str; break;
+    case JsonValue::String: out += "\"" + escape_json(value.str) + "\""; break;
+    case JsonValue::Array:
+        out += '[';
+        for (size_t i = 0; i < value.items.size(); ++i) {
+            if (i > 0) out += ',';
+            newline(depth + 1);
+            json_serialize(value.items[i], out, indent, depth + 1);
+        }
+        if (!value.items.empty()) newline(depth);
+        out += ']';
+        break;
+    case JsonValue::Object:
+        out += '{';
+        for (size_t i = 0; i < value.members.size(); ++i) {
+            if (i > 0) out += ',';
+            newline(depth + 1);
+            out += "\"" + escape_json(value.members[i].first) + "\":";
+            if (indent > 0) out += ' ';
+            json_serialize(value.members[i].second, out, indent, depth + 1);
+        }
+        if (!value.members.empty()) newline(depth);
+        out += '}';
+        break;
+    }
+}
+
+// URL解码（%XX 和 +）
+std::string url_decode(const std::string& value) {
+    std::string decoded;
+    decoded.reserve(value.length());
+    for (size_t i = 0; i < value.length(); ++i) {
+        if (value[i] == '%' && i + 2 < value.length()) {
+            int hex = 0;
+            if (sscanf(value.substr(i + 1, 2).c_str(), "%x", &hex) == 1) {
+                decoded += static_cast<char>(hex);
+                i += 2;
+            } else {
+                decoded += value[i];
+            }
+        } else if (value[i] == '+') {
+            decoded += ' ';
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+// 从URL查询字符串中取出指定参数（已URL解码），不存在时返回空字符串
+// 查询参数的原始值（未做URL解码），不存在时返回空
+std::string_view get_query_param_raw(std::string_view url, std::string_view key) {
+    size_t query_start = url.find('?');
+    if (query_start == std::string_view::npos) {
+        return std::string_view();
+    }
+
+    size_t pos = query_start + 1;
+    while (pos <= url.length()) {
+        size_t amp = url.find('&', pos);
+        if (amp == std::string_view::npos) amp = url.length();
+        size_t eq_pos = url.find('=', pos);
+        if (eq_pos != std::string_view::npos && eq_pos < amp && url.substr(pos, eq_pos - pos) == key) {
+            return url.substr(eq_pos + 1, amp - eq_pos - 1);
+        }
+        pos = amp + 1;
+    }
+    return std::string_view();
+}
+
+std::string get_query_param(std::string_view url, std::string_view key) {
+    return url_decode(std::string(get_query_param_raw(url, key)));
+}
+
+// 不区分大小写地查找请求头（head可以是包含请求体的完整请求），不存在返回空
+std::string_view get_header_view(std::string_view head, std::string_view name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < head.length()) {
+        size_t line_start = pos + 2;
+        size_t line_end = head.find("\r\n", line_start);
+        if (line_end == std::string::npos) line_end = head.length();
+        if (line_end == line_start) break; // 空行之后是请求体
+        size_t colon = head.find(':', line_start);
+        if (colon != std::string::npos && colon < line_end && colon - line_start == name.length()) {
+            bool match = true;
+            for (size_t i = 0; i < name.length(); ++i) {
+                if (std::tolower(static_cast<unsigned char>(head[line_start + i])) != std::tolower(static_cast<unsigned char>(name[i]))) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match) {
+                size_t value_start = head.find_first_not_of(" \t", colon + 1);
+                if (value_start == std::string::npos || value_start > line_end) return std::string_view();
+                return head.substr(value_start, line_end - value_start);
+            }
+        }
+        pos = line_end;
+    }
+    return std::string_view();
+}
+
+std::string get_header(std::string_view head, std::string_view name) {
+    return std::string(get_header_view(head, name));
+}
+
+// ==================== 状态版本 ====================
+// 长轮询等待的几类状态各有一个递增的版本号，状态变化时递增版本并唤醒等待线程。
+// GPU、训练日志没有变化通知，配置文件也可能被直接修改，这些由等待线程按间隔重新检查。
+
+enum StateTopic { TOPIC_GPU, TOPIC_CONFIG, TOPIC_TASKS, TOPIC_LOGS, TOPIC_COUNT };
+
+std::atomic<uint64_t> g_state_versions[TOPIC_COUNT];
+std::mutex g_state_mutex;
+std::condition_variable g_state_cv;
+std::atomic<size_t> g_state_waiters{0};   // 挂起的长轮询请求数，为0时不必唤醒
+
+void notify_state_changed(StateTopic topic) {
+    g_state_versions[topic].fetch_add(1, std::memory_order_release);
+    if (g_state_waiters.load(std::memory_order_acquire) == 0) return;
+    { std::lock_guard<std::mutex> lock(g_state_mutex); }
+    g_state_cv.notify_all();
+}
+
+// ==================== 异步任务注册表 ====================
+// 推理、Ollama部署等后台任务的状态、进度和输出统一保存在内存中，
+// 前端轮询时直接查表返回，不再依赖工作目录下以时间戳命名的临时文件。
+// 设置环境变量 ELIAN_TASK_DIR 后，任务状态变化时会同步写入该目录便于排查。
+
+enum class TaskState { Pending, Running, Completed, Failed };
+
+const char* task_state_name(TaskState state) {
+    switch (state) {
+    case TaskState::Pending: return "pending";
+    case TaskState::Running: return "running";
+    case TaskState::Completed: return "completed";
+    case TaskState::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+struct AsyncTask {
+    std::string id;
+    std::string kind;        // inference / ollama / prepare / dedup
+    TaskState state;
+    int progress;            // 0-100
+    std::string message;     // 最近一行进度输出或错误信息
+    std::string result;      // 任务输出缓冲
+    std::time_t created_at;
+    std::time_t updated_at;
+    std::time_t expires_at;  // 任务结束后才设置，0表示不过期
+};
+
+class TaskRegistry {
+public:
+    void set_persist_dir(const std::string& dir) {
+        std::lock_guard<std::mutex> lock(mtx);
+        persist_dir = dir;
+    }
+
+    // 创建任务并返回唯一ID（同一秒内的多个请求也不会冲突）
+    std::string create(const std::string& kind) {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::time_t now = std::time(nullptr);
+        sweep_expired(now);
+
+        AsyncTask task;
+        task.id = kind + "_" + std::to_string(now) + "_" + std::to_string(++next_seq);
+        task.kind = kind;
+        task.state = TaskState::Pending;
+        task.progress = 0;
+        task.created_at = now;
+        task.updated_at = now;
+        task.expires_at = 0;
+        persist(task);
+        std::string id = task.id;
+        tasks.emplace(id, std::move(task));
+        notify_state_changed(TOPIC_TASKS);
+        return id;
+    }
+
+    // 更新运行状态和进度，progress小于0时保持原进度
+    void update(const std::string& id, TaskState state, int progress, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return;
+        bool state_changed = it->second.state != state;
+        it->second.state = state;
+        if (progress >= 0) it->second.progress = std::min(progress, 100);
+        if (!message.empty()) it->second.message = message;
+        it->second.updated_at = std::time(nullptr);
+        if (state_changed) persist(it->second);
+        notify_state_changed(TOPIC_TASKS);
+    }
+
+    void append_result(const std::string& id, const std::string& chunk) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return;
+        std::string& result = it->second.result;
+        result += chunk;
+        if (result.length() > TASK_RESULT_LIMIT) {
+            result.erase(0, result.length() - TASK_RESULT_LIMIT);
+        }
+        it->second.updated_at = std::time(nullptr);
+        notify_state_changed(TOPIC_TASKS);
+    }
+
+    void finish(const std::string& id, bool ok, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return;
+        std::time_t now = std::time(nullptr);
+        it->second.state = ok ? TaskState::Completed : TaskState::Failed;
+        if (ok) it->second.progress = 100;
+        if (!message.empty()) it->second.message = message;
+        it->second.updated_at = now;
+        it->second.expires_at = now + TASK_EXPIRE_SECONDS;
+        persist(it->second);
+        notify_state_changed(TOPIC_TASKS);
+    }
+
+    // 按ID查找任务，拷贝一份快照返回，避免持锁序列化
+    // 按类型和状态统计任务数
+    std::map<std::pair<std::string, TaskState>, size_t> count_by_state() {
+        std::lock_guard<std::mutex> lock(mtx);
+        sweep_expired(std::time(nullptr));
+        std::map<std::pair<std::string, TaskState>, size_t> counts;
+        for (const auto& item : tasks) counts[{item.second.kind, item.second.state}]++;
+        return counts;
+    }
+
+    // 持锁访问任务而不复制，fn(const AsyncTask&)
+    template <typename Fn>
+    bool visit(const std::string& id, Fn fn) {
+        std::lock_guard<std::mutex> lock(mtx);
+        sweep_expired(std::time(nullptr));
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    bool lookup(const std::string& id, AsyncTask& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        sweep_expired(std::time(nullptr));
+        auto it = tasks.find(id);
+        if (it == tasks.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+private:
+    void sweep_expired(std::time_t now) {
+        for (auto it = tasks.begin(); it != tasks.end();) {
+            if (it->second.expires_at != 0 && it->second.expires_at <= now) {
+                if (!persist_dir.empty()) {
+                    std::remove((persist_dir + "/" + it->first + ".json").c_str());
+                }
+                it = tasks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void persist(const AsyncTask& task);
+
+    std::mutex mtx;
+    std::unordered_map<std::string, AsyncTask> tasks;
+    std::string persist_dir;
+    unsigned long long next_seq = 0;
+};
+
+TaskRegistry g_task_registry;
+
+// 将任务序列化为JSON对象（不含外层success字段）
+template <typename Out>
+void append_task_json(Out& out, const AsyncTask& task, bool include_result) {
+    out.append("{\"task_id\":\"");
+    append_json_escaped(out, task.id);
+    out.append("\",\"kind\":\"").append(task.kind.data(), task.kind.size());
+    out.append("\",\"status\":\"").append(task_state_name(task.state));
+    out.append("\",\"progress\":");
+    append_integer(out, task.progress);
+    out.append(",\"detail\":\"");
+    append_json_escaped(out, task.message);
+    out.append("\",\"created_at\":");
+    append_integer(out, static_cast<long long>(task.created_at));
+    out.append(",\"updated_at\":");
+    append_integer(out, static_cast<long long>(task.updated_at));
+    if (include_result) {
+        out.append(",\"result\":\"");
+        append_json_escaped(out, task.result);
+        out.append("\"");
+    }
+    out.append("}");
+}
+
+std::string task_to_json(const AsyncTask& task, bool include_result) {
+    std::string json;
+    append_task_json(json, task, include_result);
+    return json;
+}
+
+void TaskRegistry::persist(const AsyncTask& task) {
+    if (persist_dir.empty()) return;
+    std::ofstream out(persist_dir + "/" + task.id + ".json", std::ios::out | std::ios::trunc);
+    if (out.is_open()) {
+        out << task_to_json(task, true);
+    }
+}
+
+// 从一行输出中提取最后出现的百分比（如tqdm的" 45%|"），没有时返回-1
+int parse_progress_percent(const std::string& line) {
+    int percent = -1;
+    for (size_t i = 0; i < line.length(); ++i) {
+        if (line[i] != '%' || i == 0 || !isdigit(static_cast<unsigned char>(line[i - 1]))) continue;
+        size_t start = i;
+        while (start > 0 && i - start < 3 && isdigit(static_cast<unsigned char>(line[start - 1]))) start--;
+        percent = std::atoi(line.substr(start, i - start).c_str());
+    }
+    return percent;
+}
+
+// 在后台线程执行命令，把输出写入任务注册表，退出码决定任务成败。
+// result_marker非空时，标记行之前的输出只用于进度展示，之后的输出才作为任务结果。
+void run_task_command(const std::string& task_id, const std::string& cmd, const std::string& result_marker) {
+    std::thread([task_id, cmd, result_marker]() {
+        g_task_registry.update(task_id, TaskState::Running, 0, "任务正在进行中");
+        metrics_count(COUNTER_SPAWN_TASK);
+
+#ifdef _WIN32
+        FILE* pipe = _popen(cmd.c_str(), "r");
+#else
+        FILE* pipe = popen(cmd.c_str(), "r");
+#endif
+        if (!pipe) {
+            g_task_registry.finish(task_id, false, "执行命令失败");
+            return;
+        }
+
+        bool in_result = result_marker.empty();
+        std::string pending;
+        std::string last_line;
+        char buffer[4096];
+        size_t bytes_read;
+
+        while ((bytes_read = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+            if (result_marker.empty()) {
+                g_task_registry.append_result(task_id, std::string(buffer, bytes_read));
+            }
+            pending.append(buffer, bytes_read);
+            if (in_result && !result_marker.empty()) {
+                g_task_registry.append_result(task_id, pending);
+                pending.clear();
+                continue;
+            }
+
+            // 按行解析进度（\r用于进度条原地刷新）
+            size_t start = 0;
+            size_t pos;
+            while (!pending.empty() && (pos = pending.find_first_of("\r\n", start)) != std::string::npos) {
+                std::string line = pending.substr(start, pos - start);
+                start = pos + 1;
+                if (!in_result && line == result_marker) {
+                    in_result = true;
+                    if (start < pending.length() && pending[start] == '\n') start++;
+                    g_task_registry.append_result(task_id, pending.substr(start));
+                    start = pending.length();
+                    break;
+                }
+                if (!line.empty()) {
+                    last_line = line;
+                    g_task_registry.update(task_id, TaskState::Running, parse_progress_percent(line), line);
+                }
+            }
+            pending.erase(0, start);
+        }
+        if (!pending.empty() && !in_result) {
+            last_line = pending;
+        }
+
+#ifdef _WIN32
+        int status = _pclose(pipe);
+#else
+        int status = pclose(pipe);
+#endif
+        bool ok = (status == 0) && in_result;
+        g_task_registry.finish(task_id, ok, ok ? "" : (last_line.empty() ? "命令退出码: " + std::to_string(status) : last_line));
+    }).detach();
+}
+
+// ==================== 数据集预分词 ====================
+// 在C++中完成process_data()的分词工作：读取模型目录下的tokenizer.json（或vocab.json + merges.txt），
+// 用字节级BPE对"Human: ...\n\nAssistant: "模板和回答分别编码，多线程处理后写成紧凑的二进制分片。
+// 训练脚本用numpy内存映射直接读取分片，不必每次启动训练都在Python中重新分词。
+// 分片文件名包含数据集内容哈希和分词器哈希，相同的数据集和分词器重复提交时直接复用。
+
+const uint32_t TOKEN_SHARD_VERSION = 1;
+const uint32_t TOKEN_SHARD_IGNORE_LABEL = 0xFFFFFFFFu; // 对应Python中的-100
+const uint32_t TOKEN_SHARD_PACKED = 1u;                // flags: 多个样本打包到定长序列中
+const uint32_t PROMPT_TEMPLATE_TOKENS = 6;             // "Human: "和"\n\nAssistant: "的大致token数，用于估算
+const char TOKEN_SHARD_MAGIC[8] = {'E', 'L', 'S', 'H', 'A', 'R', 'D', '1'};
+
+// 分片文件格式（小端）：
+//   header(64字节) | offsets u64[num_samples + 1] | input_ids u32[num_tokens] | labels u32[num_tokens]
+// 第i个样本的token位于[offsets[i], offsets[i + 1])，labels中不参与损失的位置为TOKEN_SHARD_IGNORE_LABEL。
+// 打包的分片中每个"样本"是一条不超过max_seq_length的定长序列，之后追加：
+//   row_segments u64[num_samples + 1] | segment_lengths u32[row_segments[num_samples]]
+// 第i条序列由segment_lengths[row_segments[i] .. row_segments[i + 1])这些原始样本依次拼接而成，
+// 训练时据此重置position_ids并构造块对角注意力掩码，避免样本之间互相可见
+struct TokenShardHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_samples;
+    uint64_t num_tokens;
+    uint32_t max_seq_length;
+    uint32_t eos_id;
+    uint64_t dataset_hash;
+    uint64_t tokenizer_hash;
+    uint32_t ignore_label;
+    uint32_t reserved;
+};
+static_assert(sizeof(TokenShardHeader) == 64, "TokenShardHeader必须为64字节");
+
+inline uint64_t hash_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 快速非加密64位哈希，用作缓存键；两路并行处理，每次读入16字节
+uint64_t hash_bytes64(const void* data, size_t length, uint64_t seed = 0) {
+    const uint64_t k1 = 0x9E3779B97F4A7C15ULL;
+    const uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h1 = seed ^ k1;
+    uint64_t h2 = seed ^ (static_cast<uint64_t>(length) * k2);
+
+    while (length >= 16) {
+        uint64_t a, b;
+        memcpy(&a, p, 8);
+        memcpy(&b, p + 8, 8);
+        h1 = (h1 ^ (a * k2)) * k1;
+        h1 = (h1 << 31) | (h1 >> 33);
+        h2 = (h2 ^ (b * k1)) * k2;
+        h2 = (h2 << 29) | (h2 >> 35);
+        p += 16;
+        length -= 16;
+    }
+    // 剩余不足16字节：前8字节和后面的部分分别读入两个字
+    uint64_t tail_lo = 0, tail_hi = 0;
+    memcpy(&tail_lo, p, std::min<size_t>(length, 8));
+    if (length > 8) memcpy(&tail_hi, p + 8, length - 8);
+    h1 ^= tail_lo * k2 + length;
+    h2 ^= tail_hi * k1;
+    return hash_mix64(h1 ^ hash_mix64(h2));
+}
+
+// 读取整个文件，失败返回false
+bool read_whole_file(const std::string& path, std::string& out) {
+    std::shared_ptr<MappedFile> mapped = map_file(path);
+    if (!mapped) return false;
+    out.assign(mapped->data ? mapped->data : "", mapped->size);
+    return true;
+}
+
+// 解码一个UTF-8码点，返回消耗的字节数；非法字节按U+FFFD处理并消耗1字节
+size_t decode_utf8(const char* p, const char* end, uint32_t& cp) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+    if (len == 0 || static_cast<size_t>(end - p) < len) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    if (len == 1) {
+        cp = c;
+        return 1;
+    }
+    cp = c & (0x7F >> len);
+    for (size_t i = 1; i < len; ++i) {
+        unsigned char cc = static_cast<unsigned char>(p[i]);
+        if ((cc & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+    return len;
+}
+
+// 预分词正则中用到的Unicode字符类。没有完整的Unicode属性表，
+// 按常见区段近似：标点、符号、空白和数字之外的非ASCII字符（包括中日韩文字）都视为字母。
+enum CharClass { CHAR_LETTER, CHAR_NUMBER, CHAR_SPACE, CHAR_OTHER };
+
+CharClass classify_codepoint(uint32_t cp) {
+    if (cp < 0x80) {
+        if ((cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z')) return CHAR_LETTER;
+        if (cp >= '0' && cp <= '9') return CHAR_NUMBER;
+        if (cp == ' ' || (cp >= 0x09 && cp <= 0x0D)) return CHAR_SPACE;
+        return CHAR_OTHER;
+    }
+    if (cp == 0x85 || cp == 0xA0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) ||
+        cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000) {
+        return CHAR_SPACE;
+    }
+    if ((cp >= 0xFF10 && cp <= 0xFF19) || (cp >= 0x0660 && cp <= 0x0669) || (cp >= 0x06F0 && cp <= 0x06F9) ||
+        (cp >= 0x0966 && cp <= 0x096F) || cp == 0xB2 || cp == 0xB3 || cp == 0xB9 || (cp >= 0xBC && cp <= 0xBE) ||
+        (cp >= 0x2070 && cp <= 0x2079) || (cp >= 0x2080 && cp <= 0x2089) || (cp >= 0x2150 && cp <= 0x218B) ||
+        (cp >= 0x2460 && cp <= 0x249B) || (cp >= 0x24EA && cp <= 0x24FF) || (cp >= 0x2776 && cp <= 0x2793) ||
+        cp == 0x3007 || (cp >= 0x3021 && cp <= 0x3029) || (cp >= 0x3192 && cp <= 0x3195) ||
+        (cp >= 0x3220 && cp <= 0x3229) || (cp >= 0x3280 && cp <= 0x3289)) {
+        return CHAR_NUMBER;
+    }
+    if (cp == 0xAA || cp == 0xB5 || cp == 0xBA) return CHAR_LETTER;
+    if ((cp >= 0x80 && cp <= 0xBF) || cp == 0xD7 || cp == 0xF7 ||
+        (cp >= 0x0300 && cp <= 0x036F) ||                          // 组合附加符号
+        (cp >= 0x2000 && cp <= 0x2BFF) ||                          // 通用标点、符号、箭头、数学符号等
+        (cp >= 0x2E00 && cp <= 0x2E7F) ||
+        (cp >= 0x3000 && cp <= 0x303F && cp != 0x3005 && cp != 0x3006) || // 中日韩标点
+        (cp >= 0xFE10 && cp <= 0xFE1F) || (cp >= 0xFE30 && cp <= 0xFE6F) ||
+        (cp >= 0xFF01 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20) ||
+        (cp >= 0xFF3B && cp <= 0xFF40) || (cp >= 0xFF5B && cp <= 0xFF65) ||
+        (cp >= 0xFFE0 && cp <= 0xFFFF) ||
+        (cp >= 0x1F000 && cp <= 0x1FAFF)) {                        // 表情符号
+        return CHAR_OTHER;
+    }
+    return CHAR_LETTER;
+}
+
+// 去掉首尾空白，对应Python的str.strip()
+std::string strip_text(const std::string& text) {
+    const char* begin = text.data();
+    const char* end = begin + text.length();
+    while (begin < end) {
+        uint32_t cp;
+        size_t len = decode_utf8(begin, end, cp);
+        if (classify_codepoint(cp) != CHAR_SPACE) break;
+        begin += len;
+    }
+    while (end > begin) {
+        const char* start = end - 1;
+        while (start > begin && (static_cast<unsigned char>(*start) & 0xC0) == 0x80) start--;
+        uint32_t cp;
+        decode_utf8(start, end, cp);
+        if (classify_codepoint(cp) != CHAR_SPACE) break;
+        end = start;
+    }
+    return std::string(begin, end);
+}
+
+// 预分词规则：
+//   Qwen2/Llama3: (?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,N}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+//   GPT-2:        's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+enum class PreTokenizerStyle { Gpt2, Qwen2 };
+
+// 按预分词规则切分text，把每段的字节范围[begin, end)追加到pieces
+void pre_tokenize(const std::string& text, PreTokenizerStyle style, size_t max_digits,
+                  std::vector<std::pair<size_t, size_t>>& pieces) {
+    std::vector<uint32_t> cps;
+    std::vector<unsigned char> cls;
+    std::vector<size_t> offs;
+    const char* data = text.data();
+    const char* end = data + text.length();
+    for (const char* p = data; p < end;) {
+        uint32_t cp;
+        size_t len = decode_utf8(p, end, cp);
+        cps.push_back(cp);
+        cls.push_back(static_cast<unsigned char>(classify_codepoint(cp)));
+        offs.push_back(static_cast<size_t>(p - data));
+        p += len;
+    }
+    offs.push_back(text.length());
+
+    size_t n = cps.size();
+    bool qwen = style == PreTokenizerStyle::Qwen2;
+    auto is_class = [&](size_t i, CharClass c) { return i < n && cls[i] == c; };
+    auto is_newline = [&](size_t i) { return i < n && (cps[i] == '\r' || cps[i] == '\n'); };
+    auto run_of = [&](size_t i, CharClass c) {
+        while (i < n && cls[i] == c) i++;
+        return i;
+    };
+    auto lower = [&](size_t i) -> uint32_t {
+        if (i >= n) return 0;
+        uint32_t cp = cps[i];
+        return (qwen && cp >= 'A' && cp <= 'Z') ? cp + 32 : cp;
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        size_t j = 0;
+        uint32_t c1 = lower(i + 1);
+        uint32_t c2 = lower(i + 2);
+        if (cps[i] == '\'' && (c1 == 's' || c1 == 't' || c1 == 'm' || c1 == 'd')) {
+            j = i + 2;
+        } else if (cps[i] == '\'' && ((c1 == 'r' && c2 == 'e') || (c1 == 'v' && c2 == 'e') || (c1 == 'l' && c2 == 'l'))) {
+            j = i + 3;
+        } else if (is_class(i, CHAR_LETTER)) {
+            j = run_of(i, CHAR_LETTER);
+        } else if (is_class(i + 1, CHAR_LETTER) &&
+                   (qwen ? (!is_newline(i) && !is_class(i, CHAR_NUMBER)) : cps[i] == ' ')) {
+            j = run_of(i + 1, CHAR_LETTER);
+        } else if (is_class(i, CHAR_NUMBER)) {
+            j = i + std::min(run_of(i, CHAR_NUMBER) - i, max_digits);
+        } else if (!qwen && cps[i] == ' ' && is_class(i + 1, CHAR_NUMBER)) {
+            j = run_of(i + 1, CHAR_NUMBER);
+        } else if (is_class(i, CHAR_OTHER) || (cps[i] == ' ' && is_class(i + 1, CHAR_OTHER))) {
+            j = run_of(is_class(i, CHAR_OTHER) ? i : i + 1, CHAR_OTHER);
+            if (qwen) {
+                while (is_newline(j)) j++;
+            }
+        } else {
+            // 空白串
+            size_t ws_end = run_of(i, CHAR_SPACE);
+            size_t last_newline = n;
+            if (qwen) {
+                for (size_t k = i; k < ws_end; ++k) {
+                    if (is_newline(k)) last_newline = k;
+                }
+            }
+            if (last_newline != n) {
+                j = last_newline + 1;
+            } else if (ws_end == n || ws_end - i == 1) {
+                j = ws_end;
+            } else {
+                j = ws_end - 1; // 留下最后一个空白与后面的词合并
+            }
+        }
+        pieces.emplace_back(offs[i], offs[j]);
+        i = j;
+    }
+}
+
+// 字节级BPE分词器，兼容HuggingFace tokenizer.json中BPE模型的常见配置
+class BpeTokenizer {
+public:
+    std::string source;       // 加载来源文件
+    uint64_t hash = 0;        // 分词器文件内容哈希
+    uint32_t eos_id = 0;
+    std::string eos_token;
+    PreTokenizerStyle style = PreTokenizerStyle::Qwen2;
+    size_t max_digits = 1;
+    bool ignore_merges = false;
+
+    // 从模型目录加载，失败时error返回原因
+    bool load(const std::string& model_dir, std::string& error) {
+        init_byte_table();
+        std::string config_text;
+        JsonValue config;
+        if (read_whole_file(model_dir + "/tokenizer_config.json", config_text) && !json_parse(config_text, config, nullptr)) {
+            config = JsonValue();
+        }
+
+        std::string text;
+        if (read_whole_file(model_dir + "/tokenizer.json", text)) {
+            source = model_dir + "/tokenizer.json";
+            if (!load_tokenizer_json(text, error)) return false;
+        } else {
+            std::string merges_text;
+            if (!read_whole_file(model_dir + "/vocab.json", text) || !read_whole_file(model_dir + "/merges.txt", merges_text)) {
+                error = "模型目录下没有tokenizer.json或vocab.json/merges.txt: " + model_dir;
+                return false;
+            }
+            source = model_dir + "/vocab.json";
+            if (!load_vocab_and_merges(text, merges_text, config, error)) return false;
+            text += merges_text;
+        }
+        hash = hash_bytes64(config_text.data(), config_text.length(), hash_bytes64(text.data(), text.length()));
+
+        // 结束符：优先取tokenizer_config.json中的eos_token
+        const JsonValue* eos = config.find("eos_token");
+        if (eos && eos->is_object()) eos = eos->find("content");
+        eos_token = (eos && eos->is_string()) ? eos->str : "<|endoftext|>";
+        if (!token_to_id(eos_token, eos_id)) {
+            error = "分词器中找不到结束符: " + eos_token;
+            return false;
+        }
+        return true;
+    }
+
+    bool token_to_id(const std::string& token, uint32_t& id) const {
+        auto added = added_tokens.find(token);
+        if (added != added_tokens.end()) {
+            id = added->second;
+            return true;
+        }
+        auto it = vocab.find(token);
+        if (it == vocab.end()) return false;
+        id = it->second;
+        return true;
+    }
+
+    // 编码一段文本（不添加特殊符号），结果追加到ids。
+    // cache为调用方持有的分词缓存，同一线程内重复出现的词不再重复合并
+    void encode(const std::string& text, std::vector<uint32_t>& ids,
+                std::unordered_map<std::string, std::vector<uint32_t>>& cache) const {
+        size_t pos = 0;
+        while (pos < text.length()) {
+            // 先切出文本中出现的特殊符号，它们不参与预分词和合并
+            size_t special_pos = text.length();
+            size_t special_len = 0;
+            uint32_t special_id = 0;
+            if (!added_tokens.empty()) {
+                for (size_t i = pos; i < text.length() && special_len == 0; ++i) {
+                    if (!added_first_bytes[static_cast<unsigned char>(text[i])]) continue;
+                    for (const auto& added : added_tokens) {
+                        if (added.first.length() > special_len && text.compare(i, added.first.length(), added.first) == 0) {
+                            special_pos = i;
+                            special_len = added.first.length();
+                            special_id = added.second;
+                        }
+                    }
+                }
+            }
+
+            std::string segment = text.substr(pos, special_pos - pos);
+            std::vector<std::pair<size_t, size_t>> pieces;
+            pre_tokenize(segment, style, max_digits, pieces);
+            for (const auto& piece : pieces) {
+                std::string word = segment.substr(piece.first, piece.second - piece.first);
+                auto cached = cache.find(word);
+                if (cached != cache.end()) {
+                    ids.insert(ids.end(), cached->second.begin(), cached->second.end());
+                    continue;
+                }
+                std::vector<uint32_t> word_ids;
+                encode_word(word, word_ids);
+                ids.insert(ids.end(), word_ids.begin(), word_ids.end());
+                if (cache.size() > 200000) cache.clear();
+                cache.emplace(std::move(word), std::move(word_ids));
+            }
+
+            if (special_len == 0) break;
+            ids.push_back(special_id);
+            pos = special_pos + special_len;
+        }
+    }
+
+private:
+    struct Merge {
+        uint32_t rank;
+        uint32_t result;
+    };
+
+    void init_byte_table() {
+        // GPT-2的bytes_to_unicode：可见字节映射为自身，其余字节映射到U+0100之后
+        int extra = 0;
+        for (int b = 0; b < 256; ++b) {
+            bool printable = (b >= 33 && b <= 126) || (b >= 161 && b <= 172) || (b >= 174 && b <= 255);
+            uint32_t cp = printable ? static_cast<uint32_t>(b) : static_cast<uint32_t>(256 + extra++);
+            byte_chars[b].clear();
+            JsonDomParser::append_utf8(byte_chars[b], cp);
+        }
+    }
+
+    void add_merge(const std::string& left, const std::string& right, uint32_t rank) {
+        auto l = vocab.find(left);
+        auto r = vocab.find(right);
+        auto m = vocab.find(left + right);
+        if (l == vocab.end() || r == vocab.end() || m == vocab.end()) return;
+        uint64_t key = (static_cast<uint64_t>(l->second) << 32) | r->second;
+        merges.emplace(key, Merge{rank, m->second});
+    }
+
+    void add_added_token(const std::string& content, uint32_t id) {
+        if (content.empty()) return;
+        added_tokens[content] = id;
+        added_first_bytes[static_cast<unsigned char>(content[0])] = true;
+    }
+
+    bool load_tokenizer_json(const std::string& text, std::string& error) {
+        JsonValue root;
+        std::string parse_error;
+        if (!json_parse(text, root, &parse_error)) {
+            error = "tokenizer.json解析失败: " + parse_error;
+            return false;
+        }
+        const JsonValue* model = root.find("model");
+        const JsonValue* type = model ? model->find("type") : nullptr;
+        const JsonValue* vocab_json = model ? model->find("vocab") : nullptr;
+        const JsonValue* merges_json = model ? model->find("merges") : nullptr;
+        if (!type || !type->is_string() || type->str != "BPE" || !vocab_json || !vocab_json->is_object() ||
+            !merges_json || !merges_json->is_array()) {
+            error = "只支持BPE类型的tokenizer.json";
+            return false;
+        }
+        for (const auto& entry : vocab_json->members) {
+            vocab[entry.first] = static_cast<uint32_t>(entry.second.number);
+        }
+        // merges有"a b"和["a", "b"]两种写法
+        for (size_t i = 0; i < merges_json->items.size(); ++i) {
+            const JsonValue& merge = merges_json->items[i];
+            if (merge.is_string()) {
+                size_t space = merge.str.find(' ');
+                if (space != std::string::npos) add_merge(merge.str.substr(0, space), merge.str.substr(space + 1), static_cast<uint32_t>(i));
+            } else if (merge.is_array() && merge.items.size() == 2) {
+                add_merge(merge.items[0].str, merge.items[1].str, static_cast<uint32_t>(i));
+            }
+        }
+        const JsonValue* ignore = model->find("ignore_merges");
+        ignore_merges = ignore && ignore->is_bool() && ignore->boolean;
+
+        const JsonValue* added = root.find("added_tokens");
+        if (added && added->is_array()) {
+            for (const auto& token : added->items) {
+                const JsonValue* content = token.find("content");
+                const JsonValue* id = token.find("id");
+                if (content && content->is_string() && id && id->is_number()) {
+                    add_added_token(content->str, static_cast<uint32_t>(id->number));
+                }
+            }
+        }
+
+        // 预分词器中带Split正则时按Qwen2/Llama3规则，否则按GPT-2规则
+        std::string regex;
+        find_split_regex(root.find("pre_tokenizer"), regex);
+        if (regex.empty()) {
+            style = PreTokenizerStyle::Gpt2;
+            max_digits = static_cast<size_t>(-1);
+        } else {
+            style = PreTokenizerStyle::Qwen2;
+            max_digits = regex.find("\\p{N}{1,3}") != std::string::npos ? 3 : 1;
+        }
+        return true;
+    }
+
+    static void find_split_regex(const JsonValue* node, std::string& regex) {
+        if (!node || !regex.empty()) return;
+        const JsonValue* pattern = node->find("pattern");
+        const JsonValue* value = pattern ? pattern->find("Regex") : nullptr;
+        if (value && value->is_string()) {
+            regex = value->str;
+            return;
+        }
+        for (const auto& item : node->items) find_split_regex(&item, regex);
+        for (const auto& member : node->members) find_split_regex(&member.second, regex);
+    }
+
+    bool load_vocab_and_merges(const std::string& vocab_text, const std::string& merges_text,
+                               const JsonValue& config, std::string& error) {
+        JsonValue vocab_json;
+        std::string parse_error;
+        if (!json_parse(vocab_text, vocab_json, &parse_error) || !vocab_json.is_object()) {
+            error = "vocab.json解析失败: " + parse_error;
+            return false;
+        }
+        for (const auto& entry : vocab_json.members) {
+            vocab[entry.first] = static_cast<uint32_t>(entry.second.number);
+        }
+        std::istringstream lines(merges_text);
+        std::string line;
+        uint32_t rank = 0;
+        while (std::getline(lines, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || starts_with(line, "#version")) continue;
+            size_t space = line.find(' ');
+            if (space == std::string::npos) continue;
+            add_merge(line.substr(0, space), line.substr(space + 1), rank++);
+        }
+
+        const JsonValue* decoder = config.find("added_tokens_decoder");
+        if (decoder && decoder->is_object()) {
+            for (const auto& entry : decoder->members) {
+                const JsonValue* content = entry.second.find("content");
+                if (content && content->is_string()) {
+                    add_added_token(content->str, static_cast<uint32_t>(std::strtoul(entry.first.c_str(), nullptr, 10)));
+                }
+            }
+        }
+        const JsonValue* tokenizer_class = config.find("tokenizer_class");
+        bool qwen = tokenizer_class && tokenizer_class->is_string() && tokenizer_class->str.find("Qwen") != std::string::npos;
+        style = qwen ? PreTokenizerStyle::Qwen2 : PreTokenizerStyle::Gpt2;
+        max_digits = qwen ? 1 : static_cast<size_t>(-1);
+        return true;
+    }
+
+    // 对一个预分词后的词做BPE合并：每轮找出排名最靠前的相邻对，合并它在词中的所有出现
+    void encode_word(const std::string& word, std::vector<uint32_t>& out) const {
+        std::string mapped;
+        for (unsigned char b : word) mapped += byte_chars[b];
+        if (ignore_merges) {
+            auto whole = vocab.find(mapped);
+            if (whole != vocab.end()) {
+                out.push_back(whole->second);
+                return;
+            }
+        }
+
+        std::vector<uint32_t> symbols;
+        symbols.reserve(word.length());
+        for (unsigned char b : word) {
+            auto it = vocab.find(byte_chars[b]);
+            if (it != vocab.end()) symbols.push_back(it->second);
+        }
+
+        while (symbols.size() > 1) {
+            uint32_t best_rank = UINT32_MAX;
+            uint64_t best_key = 0;
+            uint32_t best_result = 0;
+            for (size_t i = 0; i + 1 < symbols.size(); ++i) {
+                uint64_t key = (static_cast<uint64_t>(symbols[i]) << 32) | symbols[i + 1];
+                auto it = merges.find(key);
+                if (it != merges.end() && it->second.rank < best_rank) {
+                    best_rank = it->second.rank;
+                    best_key = key;
+                    best_result = it->second.result;
+                }
+            }
+            if (best_rank == UINT32_MAX) break;
+
+            uint32_t left = static_cast<uint32_t>(best_key >> 32);
+            uint32_t right = static_cast<uint32_t>(best_key & 0xFFFFFFFFu);
+            size_t write = 0;
+            for (size_t read = 0; read < symbols.size(); ++read) {
+                if (read + 1 < symbols.size() && symbols[read] == left && symbols[read + 1] == right) {
+                    symbols[write++] = best_result;
+                    read++;
+                } else {
+                    symbols[write++] = symbols[read];
+                }
+            }
+            symbols.resize(write);
+        }
+        out.insert(out.end(), symbols.begin(), symbols.end());
+    }
+
+    std::string byte_chars[256];
+    std::unordered_map<std::string, uint32_t> vocab;
+    std::unordered_map<uint64_t, Merge> merges;
+    std::map<std::string, uint32_t> added_tokens;
+    bool added_first_bytes[256] = {false};
+};
+
+class TokenizerCache {
+public:
+    // 按模型目录缓存已加载的分词器，分词器文件变化后重新加载
+    std::shared_ptr<const BpeTokenizer> get(const std::string& model_dir, std::string& error) {
+        FileStat st = stat_file(model_dir + "/tokenizer.json");
+        if (!st.exists) st = stat_file(model_dir + "/vocab.json");
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            auto it = entries.find(model_dir);
+            if (it != entries.end() && it->second.size == st.size && it->second.mtime == st.mtime) {
+                return it->second.tokenizer;
+            }
+        }
+
+        std::shared_ptr<BpeTokenizer> tokenizer = std::make_shared<BpeTokenizer>();
+        if (!tokenizer->load(model_dir, error)) return nullptr;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        entries[model_dir] = Entry{st.size, st.mtime, tokenizer};
+        return tokenizer;
+    }
+
+private:
+    struct Entry {
+        unsigned long long size;
+        long long mtime;
+        std::shared_ptr<const BpeTokenizer> tokenizer;
+    };
+
+    std::mutex mtx;
+    std::unordered_map<std::string, Entry> entries;
+};
+
+TokenizerCache g_tokenizers;
+
+// 按process_data()的规则把一行记录编码为一个训练样本：
+// input_ids = 模板编码(截断) + 回答编码(截断) + eos，labels中模板部分为忽略值
+bool encode_training_sample(const BpeTokenizer& tokenizer, const char* line_begin, const char* line_end,
+                            uint32_t max_seq_length, std::unordered_map<std::string, std::vector<uint32_t>>& cache,
+                            std::vector<uint32_t>& ids, size_t& prompt_length) {
+    JsonValue record;
+    if (!json_parse(line_begin, line_end, record, nullptr)) return false;
+    const JsonValue* conversation = record.find("conversation");
+    if (!conversation || !conversation->is_array() || conversation->items.empty()) return false;
+    const JsonValue* human = conversation->items[0].find("human");
+    const JsonValue* assistant = conversation->items[0].find("assistant");
+    if (!human || !human->is_string() || !assistant || !assistant->is_string()) return false;
+
+    ids.clear();
+    tokenizer.encode("Human: " + strip_text(human->str) + "\n\nAssistant: ", ids, cache);
+    if (ids.size() > max_seq_length) ids.resize(max_seq_length);
+    prompt_length = ids.size();
+
+    tokenizer.encode(strip_text(assistant->str), ids, cache);
+    if (ids.size() - prompt_length > max_seq_length) ids.resize(prompt_length + max_seq_length);
+    ids.push_back(tokenizer.eos_id);
+    return true;
+}
+
+// 一个样本的编码结果
+struct EncodedSample {
+    std::vector<uint32_t> ids;
+    uint32_t prompt_length;
+};
+
+struct TokenShard {
+    TokenShardHeader header;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> input_ids;
+    std::vector<uint32_t> labels;
+    std::vector<uint64_t> row_segments;     // 仅打包分片
+    std::vector<uint32_t> segment_lengths;  // 仅打包分片
+};
+
+// 序列打包方案：bins[k]为第k条定长序列中依次放入的样本下标
+struct PackingPlan {
+    uint32_t capacity;
+    std::vector<std::vector<uint32_t>> bins;
+    uint64_t tokens;     // 放入的token总数（超长样本按capacity截断后计）
+    size_t truncated;    // 超过capacity被截断的样本数
+
+    double efficiency() const {
+        return bins.empty() ? 0.0 : static_cast<double>(tokens) / (static_cast<double>(bins.size()) * capacity);
+    }
+};
+
+// First-Fit-Decreasing：样本按长度从长到短依次放入第一条剩余空间足够的序列。
+// 线段树维护各序列的剩余容量，查找最左侧可容纳的序列只需O(log n)
+PackingPlan plan_sequence_packing(const std::vector<uint32_t>& lengths, uint32_t capacity) {
+    PackingPlan plan;
+    plan.capacity = capacity;
+    plan.tokens = 0;
+    plan.truncated = 0;
+    size_t n = lengths.size();
+    if (n == 0 || capacity == 0) return plan;
+
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return lengths[a] > lengths[b]; });
+
+    size_t leaves = 1;
+    while (leaves < n) leaves <<= 1;
+    std::vector<uint32_t> tree(2 * leaves, capacity);
+    for (uint32_t sample : order) {
+        uint32_t length = std::min(lengths[sample], capacity);
+        if (lengths[sample] > capacity) plan.truncated++;
+
+        size_t node = 1;
+        while (node < leaves) {
+            node = tree[2 * node] >= length ? 2 * node : 2 * node + 1;
+        }
+        size_t bin = node - leaves;
+        if (bin >= plan.bins.size()) plan.bins.resize(bin + 1);
+        plan.bins[bin].push_back(sample);
+        plan.tokens += length;
+
+        tree[node] -= length;
+        for (node >>= 1; node > 0; node >>= 1) {
+            tree[node] = std::max(tree[2 * node], tree[2 * node + 1]);
+        }
+    }
+    return plan;
+}
+
+// 打包方案及打包前后定长序列利用率的JSON描述
+std::string packing_plan_to_json(const PackingPlan& plan, size_t samples, bool estimated) {
+    uint64_t unpacked_capacity = static_cast<uint64_t>(samples) * plan.capacity;
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(4);
+    json << "{";
+    json << "\"estimated\":" << (estimated ? "true" : "false") << ",";
+    json << "\"max_seq_length\":" << plan.capacity << ",";
+    json << "\"samples\":" << samples << ",";
+    json << "\"tokens\":" << plan.tokens << ",";
+    json << "\"truncated\":" << plan.truncated << ",";
+    json << "\"unpacked_sequences\":" << samples << ",";
+    json << "\"unpacked_efficiency\":" << (unpacked_capacity ? static_cast<double>(plan.tokens) / unpacked_capacity : 0.0) << ",";
+    json << "\"packed_sequences\":" << plan.bins.size() << ",";
+    json << "\"packing_efficiency\":" << plan.efficiency();
+    json << "}";
+    return json.str();
+}
+
+// 写入分片：先写临时文件再重命名，避免训练脚本读到写了一半的文件
+bool write_token_shard(const std::string& path, const TokenShard& shard) {
+    std::string tmp_path = path + ".tmp";
+    FILE* out = open_file_utf8(tmp_path, "wb");
+    if (!out) return false;
+    bool ok = fwrite(&shard.header, sizeof(shard.header), 1, out) == 1 &&
+              fwrite(shard.offsets.data(), sizeof(uint64_t), shard.offsets.size(), out) == shard.offsets.size() &&
+              fwrite(shard.input_ids.data(), sizeof(uint32_t), shard.input_ids.size(), out) == shard.input_ids.size() &&
+              fwrite(shard.labels.data(), sizeof(uint32_t), shard.labels.size(), out) == shard.labels.size();
+    if (ok && (shard.header.flags & TOKEN_SHARD_PACKED)) {
+        ok = fwrite(shard.row_segments.data(), sizeof(uint64_t), shard.row_segments.size(), out) == shard.row_segments.size() &&
+             fwrite(shard.segment_lengths.data(), sizeof(uint32_t), shard.segment_lengths.size(), out) == shard.segment_lengths.size();
+    }
+    ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    std::remove(path.c_str());
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+// 预分词与训练脚本分词的一致性：C++的BPE实现只近似Unicode字母/数字类别，也不执行HF的normalizer，
+// 遇到这类分词器时token id可能和transformers不同。写分片前抽样若干条记录，
+// 用llm/mydataloader/tokenizer_parity.py按process_data()再编码一遍逐个比对
+const size_t TOKENIZER_PARITY_SAMPLES = 32;
+
+enum class TokenizerParity { Match, Mismatch, Unavailable };
+
+// 抽样核对index中的记录，work_path为传给Python脚本的临时任务文件。
+// Mismatch时report说明第一处不一致；Unavailable（没有Python或transformers）时report为原因
+TokenizerParity check_tokenizer_parity(const BpeTokenizer& tokenizer, const DatasetIndex& index, const std::string& model_dir,
+                                       uint32_t max_seq_length, const std::string& work_path, std::string& report) {
+    // 在整个文件中均匀抽样，只取能编码的记录
+    std::vector<size_t> picked;
+    std::vector<std::vector<uint32_t>> expected;
+    std::unordered_map<std::string, std::vector<uint32_t>> cache;
+    size_t records = index.record_count();
+    size_t step = std::max<size_t>(1, records / TOKENIZER_PARITY_SAMPLES);
+    for (size_t i = 0; i < records && picked.size() < TOKENIZER_PARITY_SAMPLES; i += step) {
+        std::string_view line = index.record_view(i);
+        std::vector<uint32_t> ids;
+        size_t prompt_length = 0;
+        if (line.empty() || !encode_training_sample(tokenizer, line.data(), line.data() + line.size(), max_seq_length, cache, ids, prompt_length)) {
+            continue;
+        }
+        picked.push_back(i);
+        expected.push_back(std::move(ids));
+    }
+    if (picked.empty()) {
+        report = "0";
+        return TokenizerParity::Match;
+    }
+
+    std::string job = "{\"model_dir\":\"" + escape_json(model_dir) + "\",\"max_seq_length\":" + std::to_string(max_seq_length) + ",\"records\":[";
+    for (size_t k = 0; k < picked.size(); ++k) {
+        if (k > 0) job += ",";
+        job += "\"" + escape_json(index.record(picked[k])) + "\"";
+    }
+    job += "]}";
+    if (!atomic_write_file(work_path, job)) {
+        report = "无法写入临时文件: " + work_path;
+        return TokenizerParity::Unavailable;
+    }
+    std::string output = exec_command(quote_command_args({"python", "./llm/mydataloader/tokenizer_parity.py", work_path}) + " 2>&1");
+    std::remove(work_path.c_str());
+
+    // 每条记录一行JSON数组，其余行（警告等）忽略
+    std::vector<std::vector<uint32_t>> actual;
+    std::string last_line;
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (starts_with(line, "PARITY_UNAVAILABLE ")) {
+            report = line.substr(19);
+            return TokenizerParity::Unavailable;
+        }
+        if (line.empty() || line[0] != '[') {
+            if (!line.empty()) last_line = line;
+            continue;
+        }
+        std::vector<uint32_t> ids;
+        for (const char* p = line.c_str(); *p; ) {
+            if (*p < '0' || *p > '9') {
+                ++p;
+                continue;
+            }
+            char* end = nullptr;
+            ids.push_back(static_cast<uint32_t>(std::strtoul(p, &end, 10)));
+            p = end;
+        }
+        actual.push_back(std::move(ids));
+    }
+    if (actual.empty()) {
+        report = last_line.empty() ? "无法运行python" : last_line;
+        return TokenizerParity::Unavailable;
+    }
+    if (actual.size() != expected.size()) {
+        report = "校验脚本只输出了" + std::to_string(actual.size()) + "/" + std::to_string(expected.size()) + "条记录: " + last_line;
+        return TokenizerParity::Mismatch;
+    }
+    for (size_t k = 0; k < expected.size(); ++k) {
+        if (actual[k] == expected[k]) continue;
+        size_t at = 0;
+        while (at < expected[k].size() && at < actual[k].size() && expected[k][at] == actual[k][at]) ++at;
+        auto token_at = [at](const std::vector<uint32_t>& ids) { return at < ids.size() ? std::to_string(ids[at]) : std::string("无"); };
+        report = "第" + std::to_string(picked[k] + 1) + "条记录第" + std::to_string(at + 1) + "个token不同（预分词 " + token_at(expected[k]) +
+                 "，transformers " + token_at(actual[k]) + "，长度 " + std::to_string(expected[k].size()) + "/" + std::to_string(actual[k].size()) + "）";
+        return TokenizerParity::Mismatch;
+    }
+    report = std::to_string(expected.size());
+    return TokenizerParity::Match;
+}
+
+// 与/api/train相同的路径规则：带盘符的绝对路径保持不变，其余路径都相对于llm目录
+std::string resolve_llm_path(std::string path) {
+    if (path.size() > 1 && path[1] == ':') return path;
+    while (!path.empty() && (path[0] == '/' || path[0] == '\\')) path = path.substr(1);
+    return get_current_dir() + "/llm/" + path;
+}
+
+struct PrepareOptions {
+    std::string dataset_path;   // llm/data下的JSONL文件
+    std::string dataset_name;
+    std::string model_dir;
+    uint32_t max_seq_length;
+    bool pack;                  // 是否把样本打包到max_seq_length长度的序列中
+};
+
+// 预分词任务主体，在后台线程中执行，进度写入任务注册表
+void run_prepare_dataset(const std::string& task_id, const PrepareOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    g_task_registry.update(task_id, TaskState::Running, 0, "正在加载分词器");
+
+    std::string error;
+    std::shared_ptr<const BpeTokenizer> tokenizer = g_tokenizers.get(options.model_dir, error);
+    if (!tokenizer) {
+        g_task_registry.finish(task_id, false, error);
+        return;
+    }
+    std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(options.dataset_path);
+    if (!index) {
+        g_task_registry.finish(task_id, false, "数据文件不存在或无法读取");
+        return;
+    }
+
+    // 输出文件名: <数据集名>.<数据集哈希>.<分词器哈希>.L<最大长度>.bin
+    uint64_t dataset_hash = hash_bytes64(index->mapped->data ? index->mapped->data : "", index->mapped->size);
+    char hash_part[64];
+    snprintf(hash_part, sizeof(hash_part), ".%016llx.%016llx.L%u%s.bin",
+             static_cast<unsigned long long>(dataset_hash), static_cast<unsigned long long>(tokenizer->hash),
+             options.max_seq_length, options.pack ? ".packed" : "");
+    std::string stem = options.dataset_name.substr(0, options.dataset_name.find_last_of('.'));
+    std::string prepared_dir = get_current_dir() + "/llm/data/prepared";
+    std::string relative_path = "data/prepared/" + stem + hash_part;
+    std::string shard_path = get_current_dir() + "/llm/" + relative_path;
+
+    std::ostringstream result;
+    if (stat_file(shard_path).exists) {
+        result << "{\"cached\":true,\"train_file\":\"" << escape_json(relative_path) << "\"}";
+        g_task_registry.append_result(task_id, result.str());
+        g_task_registry.finish(task_id, true, "已存在相同数据集和分词器的预处理结果");
+        return;
+    }
+
+    g_task_registry.update(task_id, TaskState::Running, 1, "正在分词");
+    size_t records = index->record_count();
+    std::vector<EncodedSample> samples(records);
+    std::vector<unsigned char> valid(records, 0);
+    std::atomic<size_t> done(0);
+    std::atomic<bool> modified(false);
+    worker_pool().parallel_for(records, 64, [&](size_t begin, size_t end) {
+        if (modified.load(std::memory_order_relaxed) || !index->unchanged()) {
+            modified.store(true, std::memory_order_relaxed);
+            return;
+        }
+        std::unordered_map<std::string, std::vector<uint32_t>> cache;
+        for (size_t i = begin; i < end; ++i) {
+            const char* line_begin = index->mapped->data + index->offsets[i];
+            const char* line_end = index->mapped->data + index->offsets[i + 1];
+            while (line_end > line_begin && (line_end[-1] == '\n' || line_end[-1] == '\r')) line_end--;
+            size_t prompt_length = 0;
+            if (line_begin != line_end &&
+                encode_training_sample(*tokenizer, line_begin, line_end, options.max_seq_length, cache, samples[i].ids, prompt_length)) {
+                samples[i].prompt_length = static_cast<uint32_t>(prompt_length);
+                valid[i] = 1;
+            }
+            size_t finished = ++done;
+            if (finished % 1024 == 0) {
+                int percent = static_cast<int>(1 + finished * 98 / records);
+                g_task_registry.update(task_id, TaskState::Running, percent,
+                                       "正在分词: " + std::to_string(finished) + "/" + std::to_string(records));
+            }
+        }
+    });
+
+    if (modified.load() || !index->unchanged()) {
+        g_task_registry.finish(task_id, false, "数据集在预处理过程中被修改，请重试");
+        return;
+    }
+
+    // 抽样核对token id，与transformers不一致时不写分片，避免.bin和JSONL两条路径训练出不同的数据
+    g_task_registry.update(task_id, TaskState::Running, 99, "正在核对分词结果");
+    std::string parity_report;
+    TokenizerParity parity = TokenizerParity::Unavailable;
+    if (create_directory(prepared_dir)) {
+        parity = check_tokenizer_parity(*tokenizer, *index, options.model_dir, options.max_seq_length,
+                                        prepared_dir + "/." + task_id + ".parity.json", parity_report);
+    } else {
+        parity_report = "无法创建目录: " + prepared_dir;
+    }
+    if (parity == TokenizerParity::Mismatch) {
+        g_task_registry.finish(task_id, false, "预分词结果与训练脚本的分词器不一致，请直接使用JSONL训练: " + parity_report);
+        return;
+    }
+
+    TokenShard shard;
+    memset(&shard.header, 0, sizeof(shard.header));
+    memcpy(shard.header.magic, TOKEN_SHARD_MAGIC, sizeof(TOKEN_SHARD_MAGIC));
+    shard.header.version = TOKEN_SHARD_VERSION;
+    shard.header.max_seq_length = options.max_seq_length;
+    shard.header.eos_id = tokenizer->eos_id;
+    shard.header.dataset_hash = dataset_hash;
+    shard.header.tokenizer_hash = tokenizer->hash;
+    shard.header.ignore_label = TOKEN_SHARD_IGNORE_LABEL;
+
+    size_t skipped = 0;
+    uint64_t total_tokens = 0;
+    std::vector<uint32_t> kept;
+    std::vector<uint32_t> lengths;
+    for (size_t i = 0; i < records; ++i) {
+        if (!valid[i]) {
+            skipped++;
+            continue;
+        }
+        kept.push_back(static_cast<uint32_t>(i));
+        lengths.push_back(static_cast<uint32_t>(samples[i].ids.size()));
+        total_tokens += samples[i].ids.size();
+    }
+
+    // 不打包时每个样本单独成行；打包时按FFD方案把多个样本拼成一行
+    PackingPlan plan = {options.max_seq_length, {}, 0, 0};
+    if (options.pack) {
+        g_task_registry.update(task_id, TaskState::Running, 99, "正在计算打包方案");
+        plan = plan_sequence_packing(lengths, options.max_seq_length);
+        shard.header.flags |= TOKEN_SHARD_PACKED;
+        shard.row_segments.reserve(plan.bins.size() + 1);
+        shard.row_segments.push_back(0);
+        shard.segment_lengths.reserve(kept.size());
+    } else {
+        plan.bins.resize(kept.size());
+        for (size_t k = 0; k < kept.size(); ++k) plan.bins[k].push_back(static_cast<uint32_t>(k));
+    }
+
+    shard.offsets.reserve(plan.bins.size() + 1);
+    shard.input_ids.reserve(static_cast<size_t>(total_tokens));
+    shard.labels.reserve(static_cast<size_t>(total_tokens));
+    shard.offsets.push_back(0);
+    for (const auto& bin : plan.bins) {
+        for (uint32_t k : bin) {
+            EncodedSample& sample = samples[kept[k]];
+            size_t length = options.pack ? std::min<size_t>(sample.ids.size(), options.max_seq_length) : sample.ids.size();
+            size_t prompt_length = std::min<size_t>(sample.prompt_length, length);
+            shard.input_ids.insert(shard.input_ids.end(), sample.ids.begin(), sample.ids.begin() + length);
+            shard.labels.insert(shard.labels.end(), prompt_length, TOKEN_SHARD_IGNORE_LABEL);
+            shard.labels.insert(shard.labels.end(), sample.ids.begin() + prompt_length, sample.ids.begin() + length);
+            if (options.pack) shard.segment_lengths.push_back(static_cast<uint32_t>(length));
+            std::vector<uint32_t>().swap(sample.ids);
+        }
+        shard.offsets.push_back(shard.input_ids.size());
+        if (options.pack) shard.row_segments.push_back(shard.segment_lengths.size());
+    }
+    shard.header.num_samples = shard.offsets.size() - 1;
+    shard.header.num_tokens = shard.input_ids.size();
+
+    if (shard.header.num_samples == 0) {
+        g_task_registry.finish(task_id, false, "数据集中没有可用的记录");
+        return;
+    }
+    g_task_registry.update(task_id, TaskState::Running, 99, "正在写入预处理文件");
+    if (!create_directory(prepared_dir) || !write_token_shard(shard_path, shard)) {
+        g_task_registry.finish(task_id, false, "写入预处理文件失败: " + shard_path);
+        return;
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    result << "{\"cached\":false,"
+           << "\"train_file\":\"" << escape_json(relative_path) << "\","
+           << "\"samples\":" << kept.size() << ","
+           << "\"sequences\":" << shard.header.num_samples << ","
+           << "\"skipped\":" << skipped << ",";
+    if (options.pack) {
+        result << "\"packing\":" << packing_plan_to_json(plan, kept.size(), false) << ",";
+    }
+    if (parity == TokenizerParity::Match) {
+        result << "\"tokenizer_parity\":{\"status\":\"match\",\"checked\":" << parity_report << "},";
+    } else {
+        result << "\"tokenizer_parity\":{\"status\":\"unavailable\",\"reason\":\"" << escape_json(parity_report) << "\"},";
+    }
+    result << "\"tokens\":" << shard.header.num_tokens << ","
+           << "\"eos_token\":\"" << escape_json(tokenizer->eos_token) << "\","
+           << "\"elapsed_ms\":" << static_cast<long long>(elapsed_ms) << "}";
+    g_task_registry.append_result(task_id, result.str());
+    g_task_registry.finish(task_id, true, parity == TokenizerParity::Match ? "预处理完成" : "预处理完成，但未能与训练脚本的分词器核对: " + parity_report);
+}
+
+// ==================== 数据集去重与划分 ====================
+// 对一个或多个JSONL数据集做内容去重：每条记录的对话先规范化（去首尾空白、合并连续空白、
+// ASCII转小写），再计算64位哈希，按哈希高位分片后各分片并行查重，保留输入顺序中第一次出现的记录。
+// 可选用MinHash + LSH分桶检测近似重复。剩余记录按内容哈希确定性地划分训练集/测试集，
+// 同一份数据重复执行得到完全相同的结果。
+
+const size_t DEDUP_SHARDS = 64;
+const int MINHASH_PERMUTATIONS = 64;
+const int MINHASH_BANDS = 16;                 // 每个分桶由连续4个签名值组成
+const int MINHASH_SHINGLE = 4;                // 以4个码点为一个片段
+// 每个分桶最多保存的记录数。大量模板化记录落在同一个桶里时，每条记录要比较的候选不超过
+// MINHASH_BANDS * MINHASH_BUCKET_LIMIT个，避免退化成两两比较；桶满后的记录仍可经其他分桶找到
+const size_t MINHASH_BUCKET_LIMIT = 64;
+
+struct DedupOptions {
+    std::vector<std::string> files;           // llm/data下的文件名，按优先级排列
+    std::string output;                       // 输出文件名前缀
+    double test_ratio;
+    bool near_duplicates;
+    double threshold;                         // 近似重复的Jaccard相似度阈值
+    uint64_t seed;
+    bool dry_run;                             // 只统计不写文件
+};
+
+// 规范化对话文本：所有轮次的human/assistant依次拼接，空白合并为单个空格，ASCII字母转小写。
+// 记录不含对话时返回false
+bool normalize_conversation(const char* line_begin, const char* line_end, std::string& out) {
+    JsonValue record;
+    if (!json_parse(line_begin, line_end, record, nullptr)) return false;
+    const JsonValue* conversation = record.find("conversation");
+    if (!conversation || !conversation->is_array() || conversation->items.empty()) return false;
+
+    out.clear();
+    for (const auto& turn : conversation->items) {
+        const char* fields[2] = {"human", "assistant"};
+        for (const char* field : fields) {
+            const JsonValue* value = turn.find(field);
+            if (!value || !value->is_string()) return false;
+            std::string text = strip_text(value->str);
+            const char* p = text.data();
+            const char* end = p + text.length();
+            bool in_space = false;
+            while (p < end) {
+                uint32_t cp;
+                size_t len = decode_utf8(p, end, cp);
+                if (classify_codepoint(cp) == CHAR_SPACE) {
+                    in_space = true;
+                } else {
+                    if (in_space) out += ' ';
+                    in_space = false;
+                    if (cp >= 'A' && cp <= 'Z') out += static_cast<char>(cp + 32);
+                    else out.append(p, len);
+                }
+                p += len;
+            }
+            out += '\x1e'; // 字段分隔符，避免"ab"+"c"与"a"+"bc"相同
+        }
+    }
+    return true;
+}
+
+// 计算MinHash签名：对每个4码点片段的哈希做MINHASH_PERMUTATIONS次不同的混合，取各自最小值
+void compute_minhash(const std::string& text, uint32_t* signature) {
+    std::fill(signature, signature + MINHASH_PERMUTATIONS, UINT32_MAX);
+    std::vector<size_t> starts;
+    const char* data = text.data();
+    const char* end = data + text.length();
+    for (const char* p = data; p < end;) {
+        uint32_t cp;
+        starts.push_back(static_cast<size_t>(p - data));
+        p += decode_utf8(p, end, cp);
+    }
+    starts.push_back(text.length());
+
+    size_t count = starts.size() - 1;
+    size_t shingles = count > MINHASH_SHINGLE ? count - MINHASH_SHINGLE + 1 : 1;
+    for (size_t i = 0; i < shingles; ++i) {
+        size_t begin = starts[i];
+        size_t finish = starts[std::min(i + MINHASH_SHINGLE, count)];
+        uint64_t h = hash_bytes64(data + begin, finish - begin);
+        for (int k = 0; k < MINHASH_PERMUTATIONS; ++k) {
+            uint32_t value = static_cast<uint32_t>(hash_mix64(h + 0x9E3779B97F4A7C15ULL * (k + 1)) >> 32);
+            if (value < signature[k]) signature[k] = value;
+        }
+    }
+}
+
+// 每条输入记录的去重状态
+struct DedupRecord {
+    uint32_t file;
+    uint32_t line;            // 文件内的记录号
+    uint64_t hash;
+    int32_t duplicate_of;     // 重复时指向保留下来的记录，-1表示不重复
+    unsigned char status;     // 0有效 1无效 2完全重复 3近似重复
+};
+
+void run_dedup_dataset(const std::string& task_id, const DedupOptions& options) {
+    auto started = std::chrono::steady_clock::now();
+    g_task_registry.update(task_id, TaskState::Running, 0, "正在读取数据集");
+
+    std::string data_dir = get_current_dir() + "/llm/data/";
+    std::vector<std::shared_ptr<const DatasetIndex>> indexes;
+    std::vector<DedupRecord> records;
+    for (size_t f = 0; f < options.files.size(); ++f) {
+        std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(data_dir + options.files[f]);
+        if (!index) {
+            g_task_registry.finish(task_id, false, "数据文件不存在或无法读取: " + options.files[f]);
+            return;
+        }
+        indexes.push_back(index);
+        for (size_t i = 0; i < index->record_count(); ++i) {
+            records.push_back(DedupRecord{static_cast<uint32_t>(f), static_cast<uint32_t>(i), 0, -1, 0});
+        }
+    }
+    if (records.size() > static_cast<size_t>(INT32_MAX)) {
+        g_task_registry.finish(task_id, false, "记录数过多");
+        return;
+    }
+
+    // 1. 并行规范化并计算内容哈希，需要近似去重时同时计算MinHash签名
+    g_task_registry.update(task_id, TaskState::Running, 5, "正在计算内容哈希");
+    size_t n = records.size();
+    std::vector<uint32_t> signatures(options.near_duplicates ? n * MINHASH_PERMUTATIONS : 0);
+    std::atomic<bool> modified(false);
+    auto inputs_unchanged = [&indexes] {
+        for (const auto& index : indexes) {
+            if (!index->unchanged()) return false;
+        }
+        return true;
+    };
+    worker_pool().parallel_for(n, 256, [&](size_t begin, size_t end) {
+        if (modified.load(std::memory_order_relaxed) || !indexes[records[begin].file]->unchanged()) {
+            modified.store(true, std::memory_order_relaxed);
+            return;
+        }
+        std::string normalized;
+        for (size_t i = begin; i < end; ++i) {
+            DedupRecord& r = records[i];
+            const DatasetIndex& index = *indexes[r.file];
+            const char* line_begin = index.mapped->data + index.offsets[r.line];
+            const char* line_end = index.mapped->data + index.offsets[r.line + 1];
+            while (line_end > line_begin && (line_end[-1] == '\n' || line_end[-1] == '\r')) line_end--;
+            if (line_begin == line_end || !normalize_conversation(line_begin, line_end, normalized)) {
+                r.status = 1;
+                continue;
+            }
+            r.hash = hash_bytes64(normalized.data(), normalized.length(), options.seed);
+            if (options.near_duplicates) {
+                compute_minhash(normalized, &signatures[i * MINHASH_PERMUTATIONS]);
+            }
+        }
+    });
+
+    // 2. 按哈希高位分片，各分片独立查重；分片内按输入顺序处理，保证保留的总是第一次出现的记录
+    g_task_registry.update(task_id, TaskState::Running, 40, "正在查找完全重复");
+    std::vector<std::vector<uint32_t>> shards(DEDUP_SHARDS);
+    for (size_t i = 0; i < n; ++i) {
+        if (records[i].status == 0) shards[records[i].hash >> 58].push_back(static_cast<uint32_t>(i));
+    }
+    worker_pool().parallel_for(DEDUP_SHARDS, 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            std::unordered_map<uint64_t, uint32_t> seen;
+            seen.reserve(shards[s].size());
+            for (uint32_t i : shards[s]) {
+                auto inserted = seen.emplace(records[i].hash, i);
+                if (!inserted.second) {
+                    records[i].status = 2;
+                    records[i].duplicate_of = static_cast<int32_t>(inserted.first->second);
+                }
+            }
+            std::vector<uint32_t>().swap(shards[s]);
+        }
+    });
+
+    // 3. 近似重复：签名按MINHASH_BANDS段分桶，同桶的记录再比较签名估计Jaccard相似度
+    if (options.near_duplicates) {
+        g_task_registry.update(task_id, TaskState::Running, 60, "正在查找近似重复");
+        const int rows = MINHASH_PERMUTATIONS / MINHASH_BANDS;
+        std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> buckets(MINHASH_BANDS);
+        std::vector<uint32_t> candidates;
+        for (size_t i = 0; i < n; ++i) {
+            if (records[i].status != 0) continue;
+            const uint32_t* signature = &signatures[i * MINHASH_PERMUTATIONS];
+            uint64_t keys[MINHASH_BANDS];
+            candidates.clear();
+            for (int b = 0; b < MINHASH_BANDS; ++b) {
+                keys[b] = hash_bytes64(signature + b * rows, rows * sizeof(uint32_t), static_cast<uint64_t>(b));
+                auto it = buckets[b].find(keys[b]);
+                if (it != buckets[b].end()) candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+            }
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+            for (uint32_t c : candidates) {
+                const uint32_t* other = &signatures[static_cast<size_t>(c) * MINHASH_PERMUTATIONS];
+                int same = 0;
+                for (int k = 0; k < MINHASH_PERMUTATIONS; ++k) same += signature[k] == other[k];
+                if (same >= options.threshold * MINHASH_PERMUTATIONS) {
+                    records[i].status = 3;
+                    records[i].duplicate_of = static_cast<int32_t>(c);
+                    break;
+                }
+            }
+            if (records[i].status == 0) {
+                for (int b = 0; b < MINHASH_BANDS; ++b) {
+                    std::vector<uint32_t>& bucket = buckets[b][keys[b]];
+                    if (bucket.size() < MINHASH_BUCKET_LIMIT) bucket.push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+
+    // 4. 统计每个文件的重复情况，以及文件之间的重叠
+    size_t file_count = options.files.size();
+    std::vector<size_t> kept(file_count, 0), invalid(file_count, 0), exact(file_count, 0), near(file_count, 0);
+    std::vector<size_t> overlap(file_count * file_count, 0); // overlap[a * n + b]: b中与a已有记录重复的条数
+    size_t train_count = 0;
+    size_t test_count = 0;
+    uint64_t split_bound = static_cast<uint64_t>(options.test_ratio * 1000000.0);
+    std::vector<unsigned char> in_test(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const DedupRecord& r = records[i];
+        if (r.status == 1) {
+            invalid[r.file]++;
+        } else if (r.status == 0) {
+            kept[r.file]++;
+            // 按内容哈希划分，与记录顺序和所在文件无关
+            in_test[i] = hash_mix64(r.hash ^ options.seed) % 1000000 < split_bound;
+            if (in_test[i]) test_count++;
+            else train_count++;
+        } else {
+            (r.status == 2 ? exact : near)[r.file]++;
+            uint32_t origin = records[static_cast<size_t>(r.duplicate_of)].file;
+            if (origin != r.file) overlap[origin * file_count + r.file]++;
+        }
+    }
+
+    // 5. 写出去重后的训练集和测试集，保留原始行内容
+    if (modified.load() || !inputs_unchanged()) {
+        g_task_registry.finish(task_id, false, "数据集在去重过程中被修改，请重试");
+        return;
+    }
+    std::string train_name = options.output + "_train.jsonl";
+    std::string test_name = options.output + "_test.jsonl";
+    if (!options.dry_run) {
+        g_task_registry.update(task_id, TaskState::Running, 90, "正在写入结果");
+        const std::string names[2] = {train_name, test_name};
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1 && split_bound == 0) break;
+            std::string path = data_dir + names[part];
+            std::string tmp_path = path + ".tmp";
+            FILE* out = open_file_utf8(tmp_path, "wb");
+            bool ok = out != nullptr;
+            for (size_t i = 0; ok && i < n; ++i) {
+                if (records[i].status != 0 || in_test[i] != part) continue;
+                const DatasetIndex& index = *indexes[records[i].file];
+                const char* line_begin = index.mapped->data + index.offsets[records[i].line];
+                const char* line_end = index.mapped->data + index.offsets[records[i].line + 1];
+                while (line_end > line_begin && (line_end[-1] == '\n' || line_end[-1] == '\r')) line_end--;
+                size_t length = static_cast<size_t>(line_end - line_begin);
+                ok = fwrite(line_begin, 1, length, out) == length && fputc('\n', out) != EOF;
+            }
+            if (out) ok = (fclose(out) == 0) && ok;
+            if (!ok) {
+                std::remove(tmp_path.c_str());
+                g_task_registry.finish(task_id, false, "写入文件失败: " + path);
+                return;
+            }
+            std::remove(path.c_str());
+            std::rename(tmp_path.c_str(), path.c_str());
+        }
+    }
+
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    std::ostringstream result;
+    result << "{";
+    result << "\"dry_run\":" << (options.dry_run ? "true" : "false") << ",";
+    result << "\"records\":" << n << ",";
+    result << "\"train\":" << train_count << ",";
+    result << "\"test\":" << test_count << ",";
+    if (!options.dry_run) {
+        result << "\"train_file\":\"" << escape_json(train_name) << "\",";
+        result << "\"test_file\":";
+        if (split_bound == 0) result << "null,";
+        else result << "\"" << escape_json(test_name) << "\",";
+    }
+    result << "\"files\":[";
+    for (size_t f = 0; f < file_count; ++f) {
+        if (f > 0) result << ",";
+        result << "{\"name\":\"" << escape_json(options.files[f]) << "\","
+               << "\"records\":" << indexes[f]->record_count() << ","
+               << "\"kept\":" << kept[f] << ","
+               << "\"invalid\":" << invalid[f] << ","
+               << "\"exact_duplicates\":" << exact[f] << ","
+               << "\"near_duplicates\":" << near[f] << "}";
+    }
+    result << "],";
+    result << "\"overlap\":[";
+    bool first = true;
+    for (size_t a = 0; a < file_count; ++a) {
+        for (size_t b = 0; b < file_count; ++b) {
+            if (overlap[a * file_count + b] == 0) continue;
+            if (!first) result << ",";
+            first = false;
+            result << "{\"first_seen\":\"" << escape_json(options.files[a]) << "\","
+                   << "\"duplicated_in\":\"" << escape_json(options.files[b]) << "\","
+                   << "\"count\":" << overlap[a * file_count + b] << "}";
+        }
+    }
+    result << "],";
+    result << "\"elapsed_ms\":" << static_cast<long long>(elapsed_ms);
+    result << "}";
+    g_task_registry.append_result(task_id, result.str());
+    g_task_registry.finish(task_id, true, "去重完成");
+}
+
+// ==================== 训练参数校验 ====================
+// /api/default-config中每个训练参数的类型、取值范围和可选值。配置保存和提交训练时
+// 先在这里校验，参数错误直接返回，不必等到Python进程加载完模型后才报错。
+// 校验同时把参数规范化为字符串（数字按类型重新格式化，布尔值为true/false），
+// 拼接命令行时只使用规范化后的值。
+
+enum class ParamType { Integer, Number, Boolean, Enum, Path };
+
+struct ParamSpec {
+    const char* name;
+    ParamType type;
+    double min;
+    double max;
+    bool exclusive_min;           // 下界是否为开区间
+    bool exclusive_max;           // 上界是否为开区间
+    const char* const* choices;   // Enum可选值，以nullptr结尾
+    bool required;                // 提交训练时必须提供
+};
+
+// transformers的SchedulerType中训练脚本可用的部分。reduce_lr_on_plateau需要评估集，
+// main.py不做评估，不在可选范围内
+const char* const LR_SCHEDULER_CHOICES[] = {
+    "linear", "cosine", "cosine_with_restarts", "polynomial", "constant",
+    "constant_with_warmup", "inverse_sqrt", "cosine_with_min_lr", "warmup_stable_decay", nullptr
+};
+const char* const OPTIM_CHOICES[] = {
+    "adamw_torch", "adamw_torch_fused", "adamw_hf", "adamw_apex_fused", "adafactor",
+    "adamw_bnb_8bit", "adamw_8bit", "paged_adamw_8bit", "paged_adamw_32bit",
+    "lion_8bit", "lion_32bit", "paged_lion_8bit", "paged_lion_32bit",
+    "sgd", "adagrad", "rmsprop", nullptr
+};
+// 与transformers_model.find_all_linear_names中的断言一致
+const char* const TRAIN_MODE_CHOICES[] = { "lora", "qlora", nullptr };
+
+const ParamSpec TRAINING_PARAM_SPECS[] = {
+    {"model_name_or_path",          ParamType::Path,    0, 0, false, false, nullptr, true},
+    {"output_dir",                  ParamType::Path,    0, 0, false, false, nullptr, true},
+    {"train_file",                  ParamType::Path,    0, 0, false, false, nullptr, true},
+    {"num_train_epochs",            ParamType::Integer, 1, 10000, false, false, nullptr, false},
+    {"per_device_train_batch_size", ParamType::Integer, 1, 4096, false, false, nullptr, false},
+    {"gradient_accumulation_steps", ParamType::Integer, 1, 65536, false, false, nullptr, false},
+    {"learning_rate",               ParamType::Number,  0, 1, true, false, nullptr, false},
+    {"max_seq_length",              ParamType::Integer, 8, 1048576, false, false, nullptr, false},
+    {"logging_steps",               ParamType::Integer, 1, 1e9, false, false, nullptr, false},
+    {"save_steps",                  ParamType::Integer, 1, 1e9, false, false, nullptr, false},
+    {"save_total_limit",            ParamType::Integer, 1, 10000, false, false, nullptr, false},
+    {"lr_scheduler_type",           ParamType::Enum,    0, 0, false, false, LR_SCHEDULER_CHOICES, false},
+    {"warmup_steps",                ParamType::Integer, 0, 1e9, false, false, nullptr, false},
+    {"lora_rank",                   ParamType::Integer, 1, 4096, false, false, nullptr, false},
+    {"lora_alpha",                  ParamType::Integer, 1, 65536, false, false, nullptr, false},
+    {"lora_dropout",                ParamType::Number,  0, 1, false, true, nullptr, false},
+    {"gradient_checkpointing",      ParamType::Boolean, 0, 0, false, false, nullptr, false},
+    {"optim",                       ParamType::Enum,    0, 0, false, false, OPTIM_CHOICES, false},
+    {"train_mode",                  ParamType::Enum,    0, 0, false, false, TRAIN_MODE_CHOICES, false},
+    {"seed",                        ParamType::Integer, 0, 4294967295.0, false, false, nullptr, false},
+    {"fp16",                        ParamType::Boolean, 0, 0, false, false, nullptr, false},
+    {"distributed",                 ParamType::Boolean, 0, 0, false, false, nullptr, false},
+};
+
+struct ConfigIssue {
+    std::string field;
+    std::string message;
+};
+
+struct ValidatedConfig {
+    std::map<std::string, std::string> values;   // 规范化后的参数
+    std::vector<ConfigIssue> issues;
+    bool ok() const { return issues.empty(); }
+};
+
+const char* param_type_name(ParamType type) {
+    switch (type) {
+    case ParamType::Integer: return "integer";
+    case ParamType::Number: return "number";
+    case ParamType::Boolean: return "boolean";
+    case ParamType::Enum: return "enum";
+    case ParamType::Path: return "path";
+    }
+    return "";
+}
+
+std::string format_param_number(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.10g", value);
+    return buffer;
+}
+
+// 数字参数同时接受JSON数字和数字字符串（旧配置文件里的值可能是字符串）
+bool param_as_number(const JsonValue& value, double& out) {
+    if (value.is_number()) {
+        out = value.number;
+        return true;
+    }
+    if (!value.is_string() || value.str.empty()) return false;
+    char* end = nullptr;
+    out = std::strtod(value.str.c_str(), &end);
+    return end && *end == '\0' && std::isfinite(out);
+}
+
+void check_param(const ParamSpec& spec, const JsonValue& value, ValidatedConfig& result) {
+    std::string field = spec.name;
+    switch (spec.type) {
+    case ParamType::Integer:
+    case ParamType::Number: {
+        double number = 0;
+        if (!param_as_number(value, number)) {
+            result.issues.push_back({field, "必须是数字"});
+            return;
+        }
+        if (spec.type == ParamType::Integer && number != std::floor(number)) {
+            result.issues.push_back({field, "必须是整数"});
+            return;
+        }
+        bool below = spec.exclusive_min ? number <= spec.min : number < spec.min;
+        bool above = spec.exclusive_max ? number >= spec.max : number > spec.max;
+        if (below || above) {
+            result.issues.push_back({field, std::string("取值范围为") + (spec.exclusive_min ? "(" : "[") +
+                format_param_number(spec.min) + ", " + format_param_number(spec.max) + (spec.exclusive_max ? ")" : "]")});
+            return;
+        }
+        result.values[field] = spec.type == ParamType::Integer
+            ? std::to_string(static_cast<long long>(number)) : format_param_number(number);
+        return;
+    }
+    case ParamType::Boolean:
+        if (value.is_bool()) {
+            result.values[field] = value.boolean ? "true" : "false";
+        } else if (value.is_string() && (value.str == "true" || value.str == "false")) {
+            result.values[field] = value.str;
+        } else {
+            result.issues.push_back({field, "必须是true或false"});
+        }
+        return;
+    case ParamType::Enum:
+        if (value.is_string()) {
+            for (const char* const* choice = spec.choices; *choice; ++choice) {
+                if (value.str == *choice) {
+                    result.values[field] = value.str;
+                    return;
+                }
+            }
+        }
+        {
+            std::string message = "可选值为";
+            for (const char* const* choice = spec.choices; *choice; ++choice) {
+                message += (choice == spec.choices ? " " : ", ") + std::string(*choice);
+            }
+            result.issues.push_back({field, message});
+        }
+        return;
+    case ParamType::Path:
+        if (!value.is_string() || value.str.empty()) {
+            result.issues.push_back({field, "必须是非空路径"});
+            return;
+        }
+        // 路径作为训练进程的参数（Windows下在cmd命令行的双引号中），只允许字母、数字、._-/、
+        // 非ASCII字符（中文目录名），Windows风格的反斜杠分隔符和开头的盘符；反斜杠不能在末尾，否则会转义后面的引号
+        for (size_t i = 0; i < value.str.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(value.str[i]);
+            bool letter = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+            bool allowed = c >= 0x80 || letter || (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-' || c == '/' ||
+                           (c == '\\' && i + 1 < value.str.size()) ||
+                           (c == ':' && i == 1 && ((value.str[0] >= 'A' && value.str[0] <= 'Z') || (value.str[0] >= 'a' && value.str[0] <= 'z')));
+            if (!allowed) {
+                std::string shown = c < 0x20 ? "控制字符" : c == '\\' ? "末尾的\\" : std::string(1, static_cast<char>(c));
+                result.issues.push_back({field, "路径中不能包含字符 " + shown + "，只允许字母、数字和._-/"});
+                return;
+            }
+        }
+        // 不允许..路径段，训练输出和数据文件不能借此跳出所在目录
+        for (size_t begin = 0; begin <= value.str.size();) {
+            size_t end = value.str.find_first_of("/\\", begin);
+            if (end == std::string::npos) end = value.str.size();
+            if (end - begin == 2 && value.str.compare(begin, 2, "..") == 0) {
+                result.issues.push_back({field, "路径中不能包含..路径段"});
+                return;
+            }
+            begin = end + 1;
+        }
+        result.values[field] = value.str;
+        return;
+    }
+}
+
+// 参数之间的约束，只检查单项校验已通过的参数
+void check_param_rules(ValidatedConfig& result) {
+    auto& values = result.values;
+    auto has = [&](const char* name) { return values.find(name) != values.end(); };
+
+    // constant调度会忽略warmup_steps
+    if (has("lr_scheduler_type") && has("warmup_steps") && values["lr_scheduler_type"] == "constant" && values["warmup_steps"] != "0") {
+        result.issues.push_back({"warmup_steps", "constant调度不使用预热，请改用constant_with_warmup或将warmup_steps设为0"});
+    }
+    // 预分词文件名中的.L<n>是生成时的最大长度，训练时必须一致
+    if (has("train_file") && has("max_seq_length") && ends_with(values["train_file"], ".bin")) {
+        const std::string& file = values["train_file"];
+        size_t pos = file.rfind(".L");
+        if (pos != std::string::npos) {
+            unsigned long length = std::strtoul(file.c_str() + pos + 2, nullptr, 10);
+            if (length > 0 && std::to_string(length) != values["max_seq_length"]) {
+                result.issues.push_back({"max_seq_length", "预分词文件按最大长度" + std::to_string(length) + "生成，max_seq_length必须与之一致"});
+            }
+        }
+    }
+}
+
+// 校验训练配置。require_all为true时（提交训练）必填参数缺失也算错误；
+// 保存配置时允许只保存部分参数，缺省的参数由main.py使用默认值
+ValidatedConfig validate_training_config(const JsonValue& config, bool require_all) {
+    ValidatedConfig result;
+    if (!config.is_object()) {
+        result.issues.push_back({"", "配置必须是JSON对象"});
+        return result;
+    }
+    for (const ParamSpec& spec : TRAINING_PARAM_SPECS) {
+        const JsonValue* value = config.find(spec.name);
+        if (!value || value->is_null()) {
+            if (require_all && spec.required) result.issues.push_back({spec.name, "缺少必要参数"});
+            continue;
+        }
+        check_param(spec, *value, result);
+    }
+    check_param_rules(result);
+    return result;
+}
+
+void config_issues_to_json(std::ostringstream& json, const std::vector<ConfigIssue>& issues) {
+    json << "[";
+    for (size_t i = 0; i < issues.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"field\":\"" << escape_json(issues[i].field) << "\",\"message\":\"" << escape_json(issues[i].message) << "\"}";
+    }
+    json << "]";
+}
+
+std::string config_issues_to_text(const std::vector<ConfigIssue>& issues) {
+    std::string text;
+    for (const auto& issue : issues) {
+        if (!text.empty()) text += "；";
+        text += issue.field.empty() ? issue.message : issue.field + ": " + issue.message;
+    }
+    return text;
+}
+
+std::string training_schema_json() {
+    std::ostringstream json;
+    json << "{\"success\":true,\"params\":[";
+    bool first = true;
+    for (const ParamSpec& spec : TRAINING_PARAM_SPECS) {
+        if (!first) json << ",";
+        first = false;
+        json << "{\"name\":\"" << spec.name << "\",\"type\":\"" << param_type_name(spec.type) << "\"";
+        if (spec.type == ParamType::Integer || spec.type == ParamType::Number) {
+            json << ",\"min\":" << format_param_number(spec.min) << ",\"max\":" << format_param_number(spec.max);
+            json << ",\"exclusive_min\":" << (spec.exclusive_min ? "true" : "false");
+            json << ",\"exclusive_max\":" << (spec.exclusive_max ? "true" : "false");
+        }
+        if (spec.choices) {
+            json << ",\"choices\":[";
+            for (const char* const* choice = spec.choices; *choice; ++choice) {
+                json << (choice == spec.choices ? "" : ",") << "\"" << *choice << "\"";
+            }
+            json << "]";
+        }
+        json << ",\"required\":" << (spec.required ? "true" : "false") << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+// ==================== 配置存储 ====================
+// llm/configs下的命名配置。每次保存生成一个新版本，历史版本保存在
+// llm/configs/.versions/<名称>/<版本号>.json，最多保留CONFIG_HISTORY_LIMIT个。
+// 所有写入都经过atomic_write_file，并由存储内部的锁串行化，并发保存不会互相覆盖出半截文件；
+// 保存时可带上读取时拿到的ETag（If-Match），配置已被他人修改时返回冲突。
+// 配置解析后缓存在内存中，按文件大小和修改时间发现外部修改；ETag为内容哈希。
+
+const size_t CONFIG_HISTORY_LIMIT = 20;
+
+struct ConfigEntry {
+    std::string name;
+    unsigned long long version;
+    std::string etag;                          // 带引号的强ETag
+    std::string content;                       // 文件内容
+    std::shared_ptr<const JsonValue> value;    // 解析结果，文件不是合法JSON时为空
+    unsigned long long size;
+    long long mtime;
+};
+
+// 配置名只允许字母、数字、下划线和连字符，其余字符替换为下划线
+std::string sanitize_config_name(std::string name) {
+    for (char& c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-') c = '_';
+    }
+    return name;
+}
+
+std::string content_etag(const std::string& content) {
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%016llx\"", static_cast<unsigned long long>(hash_bytes64(content.data(), content.length())));
+    return etag;
+}
+
+class ConfigStore {
+public:
+    enum SaveStatus { Saved, Unchanged, Conflict, Failed };
+
+    std::string directory() const {
+        return get_current_dir() + "/llm/configs";
+    }
+
+    std::string path_of(const std::string& name) const {
+        return directory() + "/" + name + ".json";
+    }
+
+    // 所有配置的当前版本，按名称排序
+    std::vector<ConfigEntry> list() {
+        std::lock_guard<std::mutex> lock(mtx);
+        refresh_all();
+        std::vector<ConfigEntry> result;
+        for (const auto& item : entries) result.push_back(item.second);
+        return result;
+    }
+
+    // 读取配置，version为0时取当前版本
+    bool get(const std::string& name, unsigned long long version, ConfigEntry& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!refresh_one(name)) return false;
+        if (version == 0 || version == entries[name].version) {
+            out = entries[name];
+            return true;
+        }
+        return load_file(version_path(name, version), name, version, out);
+    }
+
+    // 历史版本号（升序）
+    std::vector<unsigned long long> versions(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return list_versions(name);
+    }
+
+    // 保存新版本。expected_etag非空时，只有当前版本的ETag与之相同才写入
+    SaveStatus save(const std::string& name, const JsonValue& config, const std::string& expected_etag,
+                    ConfigEntry& out, std::string& error) {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool exists = refresh_one(name);
+        if (!expected_etag.empty() && expected_etag != "*" && (!exists || entries[name].etag != expected_etag)) {
+            if (exists) out = entries[name];
+            error = "配置已被修改，请重新加载后再保存";
+            return Conflict;
+        }
+
+        std::string content;
+        json_serialize(config, content, 2);
+        content += "\n";
+        if (exists && entries[name].content == content) {
+            out = entries[name];
+            return Unchanged;
+        }
+
+        std::string history_dir = directory() + "/.versions";
+        if (!create_directory(directory()) || !create_directory(history_dir) || !create_directory(history_dir + "/" + name)) {
+            error = "无法创建配置目录: " + history_dir;
+            return Failed;
+        }
+        // 引入版本管理之前保存的配置没有历史记录，先把它记为第一个版本
+        std::vector<unsigned long long> history = list_versions(name);
+        if (exists && history.empty()) {
+            atomic_write_file(version_path(name, entries[name].version), entries[name].content);
+            history.push_back(entries[name].version);
+        }
+
+        unsigned long long version = exists ? entries[name].version + 1 : (history.empty() ? 1 : history.back() + 1);
+        if (!atomic_write_file(version_path(name, version), content) || !atomic_write_file(path_of(name), content)) {
+            error = "写入配置文件失败: " + path_of(name);
+            return Failed;
+        }
+        history.push_back(version);
+        while (history.size() > CONFIG_HISTORY_LIMIT) {
+            std::remove(version_path(name, history.front()).c_str());
+            history.erase(history.begin());
+        }
+
+        FileStat st = stat_file(path_of(name));
+        ConfigEntry entry;
+        entry.name = name;
+        entry.version = version;
+        entry.etag = content_etag(content);
+        entry.content = content;
+        entry.value = std::make_shared<JsonValue>(config);
+        entry.size = st.size;
+        entry.mtime = st.mtime;
+        entries[name] = entry;
+        out = entry;
+        notify_state_changed(TOPIC_CONFIG);
+        return Saved;
+    }
+
+    // 删除配置及其历史版本
+    bool remove(const std::string& name, std::string& error) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (std::remove(path_of(name).c_str()) != 0) {
+            error = file_exists(path_of(name)) ? "删除文件失败" : "配置文件不存在";
+            return false;
+        }
+        for (unsigned long long version : list_versions(name)) {
+            std::remove(version_path(name, version).c_str());
+        }
+        std::remove((directory() + "/.versions/" + name).c_str());
+        entries.erase(name);
+        notify_state_changed(TOPIC_CONFIG);
+        return true;
+    }
+
+private:
+    std::string version_path(const std::string& name, unsigned long long version) const {
+        return directory() + "/.versions/" + name + "/" + std::to_string(version) + ".json";
+    }
+
+    std::vector<unsigned long long> list_versions(const std::string& name) const {
+        std::vector<unsigned long long> result;
+        for (const auto& file : list_files_in_directory(directory() + "/.versions/" + name, ".json")) {
+            char* end = nullptr;
+            unsigned long long version = std::strtoull(file.c_str(), &end, 10);
+            if (version > 0 && end && std::string(end) == ".json") result.push_back(version);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    bool load_file(const std::string& path, const std::string& name, unsigned long long version, ConfigEntry& out) const {
+        FileStat st = stat_file(path);
+        std::string content;
+        if (!st.exists || !read_whole_file(path, content)) return false;
+        out.name = name;
+        out.version = version;
+        out.etag = content_etag(content);
+        out.content = content;
+        std::shared_ptr<JsonValue> value = std::make_shared<JsonValue>();
+        out.value = json_parse(content, *value, nullptr) ? value : nullptr;
+        out.size = st.size;
+        out.mtime = st.mtime;
+        return true;
+    }
+
+    // 检查单个配置文件是否变化，需要时重新加载；文件不存在返回false
+    bool refresh_one(const std::string& name) {
+        FileStat st = stat_file(path_of(name));
+        auto it = entries.find(name);
+        if (!st.exists) {
+            if (it != entries.end()) entries.erase(it);
+            return false;
+        }
+        if (it != entries.end() && it->second.size == st.size && it->second.mtime == st.mtime) return true;
+
+        std::vector<unsigned long long> history = list_versions(name);
+        ConfigEntry entry;
+        if (!load_file(path_of(name), name, history.empty() ? 1 : history.back(), entry)) return false;
+        // 文件在存储之外被修改过，视为一个新版本
+        if (it != entries.end() && entry.etag != it->second.etag && entry.version <= it->second.version) {
+            entry.version = it->second.version + 1;
+        }
+        entries[name] = entry;
+        return true;
+    }
+
+    // 目录内容变化（文件增删或重命名）时重新扫描
+    void refresh_all() {
+        FileStat dir_stat = stat_file(directory());
+        bool recent = dir_stat.mtime >= static_cast<long long>(std::time(nullptr)) - 1; // 修改时间只精确到秒
+        if (scanned && dir_stat.mtime == dir_mtime && !recent) {
+            for (auto it = entries.begin(); it != entries.end();) {
+                std::string name = (it++)->first;
+                refresh_one(name);
+            }
+            return;
+        }
+        std::map<std::string, ConfigEntry> old_entries;
+        old_entries.swap(entries);
+        for (const auto& file : list_files_in_directory(directory(), ".json")) {
+            std::string name = file.substr(0, file.length() - 5);
+            auto old = old_entries.find(name);
+            if (old != old_entries.end()) entries[name] = old->second;
+            refresh_one(name);
+        }
+        dir_mtime = dir_stat.mtime;
+        scanned = true;
+    }
+
+    std::mutex mtx;
+    std::map<std::string, ConfigEntry> entries;
+    long long dir_mtime = 0;
+    bool scanned = false;
+};
+
+ConfigStore g_config_store;
+
+// ==================== 模拟训练后端 ====================
+// 没有GPU和conda环境时用来压测训练启动、日志读取和指标链路。设置环境变量ELIAN_FAKE_TRAINER后，
+// /api/train不再启动main.py，而是以--fake-trainer参数启动本程序，按main.py和transformers Trainer的
+// 格式输出配置、tqdm进度和loss日志，也可以在指定步数崩溃或模拟显存不足。
+// ELIAN_FAKE_TRAINER的取值为逗号分隔的key=value（也可以为1，全部使用默认值）:
+//   steps=200      总步数
+//   rate=20        每秒步数
+//   volume=1       每步刷新几次进度条（控制日志量）
+//   fail=crash|oom 失败方式，crash直接abort，oom输出CUDA OOM的Traceback后以1退出
+//   fail_at=0      在第几步失败，默认在一半处
+
+struct FakeTrainerOptions {
+    long steps = 200;
+    double rate = 20;
+    long volume = 1;
+    std::string fail;
+    long fail_at = 0;
+};
+
+bool parse_fake_trainer_options(std::string_view spec, FakeTrainerOptions& options, std::string& error) {
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string_view::npos) end = spec.size();
+        std::string_view item = spec.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty() || item == "1") continue;
+        size_t eq = item.find('=');
+        std::string key(item.substr(0, eq));
+        std::string value(eq == std::string_view::npos ? "" : item.substr(eq + 1));
+        char* parse_end = nullptr;
+        if (key == "steps") {
+            options.steps = std::strtol(value.c_str(), &parse_end, 10);
+        } else if (key == "rate") {
+            options.rate = std::strtod(value.c_str(), &parse_end);
+        } else if (key == "volume") {
+            options.volume = std::strtol(value.c_str(), &parse_end, 10);
+        } else if (key == "fail_at") {
+            options.fail_at = std::strtol(value.c_str(), &parse_end, 10);
+        } else if (key == "fail") {
+            if (value != "crash" && value != "oom") {
+                error = "fail只能是crash或oom";
+                return false;
+            }
+            options.fail = value;
+            continue;
+        } else {
+            error = "未知的模拟训练参数: " + key;
+            return false;
+        }
+        if (value.empty() || *parse_end != '\0') {
+            error = "模拟训练参数" + key + "的值无效: " + value;
+            return false;
+        }
+    }
+    if (options.steps <= 0 || options.rate <= 0 || options.volume <= 0 || options.fail_at < 0) {
+        error = "steps、rate、volume必须大于0";
+        return false;
+    }
+    if (!options.fail.empty() && options.fail_at == 0) options.fail_at = std::max(1L, options.steps / 2);
+    return true;
+}
+
+const std::string& fake_trainer_spec() {
+    static const std::string spec = [] {
+        const char* value = std::getenv("ELIAN_FAKE_TRAINER");
+        return std::string(value ? value : "");
+    }();
+    return spec;
+}
+
+// 启动模拟训练用的可执行文件路径
+std::string self_executable_path() {
+#ifdef _WIN32
+    wchar_t buffer[MAX_PATH];
+    DWORD length = GetModuleFileNameW(NULL, buffer, MAX_PATH);
+    return ws2s(std::wstring(buffer, length));
+#else
+    char buffer[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+    return length > 0 ? std::string(buffer, static_cast<size_t>(length)) : std::string("./llm_trainer_server");
+#endif
+}
+
+std::string format_tqdm_time(double seconds) {
+    long total = static_cast<long>(seconds);
+    char buffer[32];
+    if (total >= 3600) {
+        snprintf(buffer, sizeof(buffer), "%ld:%02ld:%02ld", total / 3600, total / 60 % 60, total % 60);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%02ld:%02ld", total / 60, total % 60);
+    }
+    return buffer;
+}
+
+// --fake-trainer <选项> [--参数名 值 ...]：参数与main.py相同，只用于打印配置和计算学习率、日志间隔
+int run_fake_trainer(int argc, char** argv) {
+    FakeTrainerOptions options;
+    std::string error;
+    if (argc < 3 || !parse_fake_trainer_options(argv[2], options, error)) {
+        fprintf(stderr, "模拟训练参数错误: %s\n", error.c_str());
+        return 2;
+    }
+    std::map<std::string, std::string> args;
+    for (int i = 3; i < argc; ++i) {
+        std::string key = argv[i];
+        if (!starts_with(key, "--")) continue;
+        key = key.substr(2);
+        if (i + 1 < argc && !starts_with(argv[i + 1], "--")) {
+            args[key] = argv[++i];
+        } else {
+            args[key] = "True";
+        }
+    }
+    auto arg_number = [&args](const char* key, double fallback) {
+        auto it = args.find(key);
+        return it == args.end() ? fallback : std::strtod(it->second.c_str(), nullptr);
+    };
+    double learning_rate = arg_number("learning_rate", 2e-4);
+    long warmup_steps = static_cast<long>(arg_number("warmup_steps", 0));
+    long logging_steps = std::max(1L, static_cast<long>(arg_number("logging_steps", 1)));
+    double epochs = std::max(1.0, arg_number("num_train_epochs", 1));
+
+    std::string out;
+    out += "🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟Elian-Factory开始训练，训练配置参数如下:🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟🌟\n";
+    for (const auto& kv : args) out += "  " + kv.first + ": " + kv.second + "\n";
+    out += "  simulated: True\n";
+    out += "加载完毕!~...@Elian\n";
+    out += "☀️☀️☀️训练数据共" + std::to_string(options.steps) + "条☀️☀️☀️\n";
+    out += "🌟🌟数据集处理完毕!~...@Elian\n";
+    out += "🌟🌟开始训练!~...@Elian\n";
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+
+    std::mt19937 rng(static_cast<unsigned>(options.steps * 31 + options.volume));
+    std::normal_distribution<double> noise(0.0, 0.05);
+    auto started = std::chrono::steady_clock::now();
+    auto step_interval = std::chrono::duration<double>(1.0 / options.rate);
+    double loss_sum = 0;
+    long loss_count = 0;
+    char line[256];
+    for (long step = 1; step <= options.steps; ++step) {
+        std::this_thread::sleep_until(started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(step_interval * static_cast<double>(step)));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        out.clear();
+
+        if (step == options.fail_at && options.fail == "oom") {
+            out += "\nTraceback (most recent call last):\n";
+            out += "  File \"./llm/main.py\", line 196, in main\n    trainer.train()\n";
+            out += "torch.OutOfMemoryError: CUDA out of memory. Tried to allocate 2.00 GiB. GPU 0 has a total capacity of 23.64 GiB "
+                   "of which 1.12 GiB is free. Of the allocated memory 20.87 GiB is allocated by PyTorch, and 1.21 GiB is reserved "
+                   "by PyTorch but unallocated.\n";
+            fwrite(out.data(), 1, out.size(), stdout);
+            fflush(stdout);
+            return 1;
+        }
+        if (step == options.fail_at && options.fail == "crash") {
+            fflush(stdout);
+            std::abort();
+        }
+
+        // tqdm写到stderr，重定向到文件后以\r分隔
+        double speed = step / std::max(elapsed, 1e-6);
+        int percent = static_cast<int>(step * 100 / options.steps);
+        int filled = percent / 10;
+        std::string bar;
+        for (int i = 0; i < 10; ++i) bar += i < filled ? "█" : " ";
+        snprintf(line, sizeof(line), "\r%3d%%|%s| %ld/%ld [%s<%s, %.2fit/s]", percent, bar.c_str(), step, options.steps,
+                 format_tqdm_time(elapsed).c_str(), format_tqdm_time((options.steps - step) / speed).c_str(), speed);
+        for (long v = 0; v < options.volume; ++v) out += line;
+
+        double progress = static_cast<double>(step) / options.steps;
+        double loss = 0.35 + 2.2 * std::exp(-4.0 * progress) + noise(rng);
+        loss_sum += loss;
+        loss_count++;
+        if (step % logging_steps == 0) {
+            double lr = step < warmup_steps ? learning_rate * step / warmup_steps : learning_rate;
+            snprintf(line, sizeof(line), "\n{'loss': %.4f, 'grad_norm': %.4f, 'learning_rate': %g, 'epoch': %.2f}\n",
+                     loss, 0.8 + std::fabs(noise(rng)) * 10, lr, epochs * progress);
+            out += line;
+        }
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+
+    double runtime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    snprintf(line, sizeof(line),
+             "\n{'train_runtime': %.4f, 'train_samples_per_second': %.3f, 'train_steps_per_second': %.3f, 'train_loss': %.4f, 'epoch': %.1f}\n",
+             runtime, options.steps / runtime, options.steps / runtime, loss_sum / std::max(1L, loss_count), epochs);
+    out = line;
+    out += "🌟🌟训练完毕!开始合并权重文件到(simulated)...@Elian\n";
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    return 0;
+}
+
+// ==================== 合并请求缓存 ====================
+// 多个标签页可能同时轮询GPU状态、系统信息和数据集列表，每次都要启动nvidia-smi/python或遍历目录。
+// 同一个键的并发请求只计算一次，其余请求等待并共享结果；结果在TTL内直接复用，
+// 探测的开销与轮询的客户端数量无关。
+
+const size_t SINGLE_FLIGHT_MAX_ENTRIES = 64;     // 超过时先清掉过期的键，仍然超过则不再缓存新键
+
+template <typename T>
+class SingleFlightCache {
+public:
+    // 结果不超过ttl秒时直接返回；已有线程在计算时等待其结果，否则由当前线程计算。
+    // age返回结果距今的秒数
+    template <typename Fn>
+    T get(const std::string& key, double ttl, Fn compute, double* age = nullptr) {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            if (entries.size() >= SINGLE_FLIGHT_MAX_ENTRIES) evict_expired();
+            if (entries.size() >= SINGLE_FLIGHT_MAX_ENTRIES) {
+                lock.unlock();
+                if (age) *age = 0;
+                return compute();
+            }
+            it = entries.emplace(key, Entry()).first;
+        }
+        Entry& entry = it->second;
+        while (true) {
+            if (entry.valid) {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - entry.computed_at).count();
+                if (elapsed <= ttl) {
+                    if (age) *age = elapsed;
+                    return entry.value;
+                }
+            }
+            if (!entry.computing) break;
+            // 等待期间条目不会被清理
+            entry.waiters++;
+            cv.wait(lock);
+            entry.waiters--;
+        }
+        entry.computing = true;
+        uint64_t generation = entry.generation;
+        lock.unlock();
+
+        T value;
+        try {
+            value = compute();
+        } catch (...) {
+            lock.lock();
+            entry.computing = false;
+            cv.notify_all();
+            throw;
+        }
+
+        lock.lock();
+        entry.computing = false;
+        // 计算期间被invalidate时结果不写入缓存，后来的请求重新计算
+        if (entry.generation == generation) {
+            entry.value = value;
+            entry.computed_at = std::chrono::steady_clock::now();
+            entry.expires_at = entry.computed_at + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(ttl));
+            entry.valid = true;
+        }
+        cv.notify_all();
+        if (age) *age = 0;
+        return value;
+    }
+
+    // 是否有不超过ttl秒的结果，不等待也不计算
+    bool fresh(const std::string& key, double ttl) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = entries.find(key);
+        return it != entries.end() && it->second.valid &&
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - it->second.computed_at).count() <= ttl;
+    }
+
+    // 丢弃键以prefix开头的缓存结果
+    void invalidate(const std::string& prefix) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto it = entries.lower_bound(prefix); it != entries.end() && starts_with(it->first, prefix); ++it) {
+            it->second.valid = false;
+            it->second.generation++;
+        }
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        T value;
+        std::chrono::steady_clock::time_point computed_at;
+        std::chrono::steady_clock::time_point expires_at;
+        uint64_t generation = 0;
+        size_t waiters = 0;
+        bool valid = false;
+        bool computing = false;
+    };
+
+    // 删除已过期（或已失效）且没有线程在计算、等待的条目，调用方持有锁
+    void evict_expired() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = entries.begin(); it != entries.end();) {
+            const Entry& entry = it->second;
+            if (!entry.computing && entry.waiters == 0 && (!entry.valid || entry.expires_at < now)) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::map<std::string, Entry> entries;   // 节点地址稳定，等待期间可以持有引用
+};
+
+// 缓存整个响应的端点、各自的TTL（秒）和处理函数读取的查询参数。
+// 键只由路径和这些参数组成，防缓存的时间戳等其他参数不会产生新条目
+struct CachedRoute {
+    std::string_view path;
+    double ttl;
+    std::string_view params[4];     // 未用的位置为空
+};
+
+const CachedRoute CACHED_ROUTES[] = {
+    {"/api/gpu/status", 1.0, {}},
+    {"/api/gpus", 1.0, {}},
+    {"/api/system/info", 10.0, {}},     // 版本信息要启动4个子进程，内存和磁盘余量不需要实时
+    {"/api/data/files", 1.0, {"sort", "order", "offset", "limit"}},   // 目录内容本身已有监听缓存，这里省去排序和序列化
+};
+
+// 不缓存的请求返回nullptr
+const CachedRoute* find_cached_route(std::string_view method, std::string_view url) {
+    if (method != "GET") return nullptr;
+    std::string_view path = url.substr(0, url.find('?'));
+    for (const CachedRoute& route : CACHED_ROUTES) {
+        if (route.path == path) return &route;
+    }
+    return nullptr;
+}
+
+// 缓存键，同时作为交给处理函数的URL：路径加上route.params中出现的参数（按固定顺序）
+std::string response_cache_key(std::string_view url, const CachedRoute& route) {
+    std::string key(route.path);
+    char separator = '?';
+    for (std::string_view name : route.params) {
+        std::string_view value = name.empty() ? std::string_view() : get_query_param_raw(url, name);
+        if (value.empty()) continue;
+        key += separator;
+        key.append(name.data(), name.size()).append("=").append(value.data(), value.size());
+        separator = '&';
+    }
+    return key;
+}
+
+SingleFlightCache<std::string> g_response_cache;
+
+// ==================== /metrics ====================
+// Prometheus文本格式（0.0.4）。除请求计数和耗时直方图外，还导出后台任务状态、
+// 线程池队列深度和GPU采样值。GPU采样复用最近一次nvidia-smi的结果，
+// 超过GPU_SAMPLE_MAX_AGE秒才重新采样，抓取不会频繁启动子进程。
+
+const double GPU_SAMPLE_MAX_AGE = 10.0;
+
+// /api/gpu/status可接受的采样间隔
+const double GPU_STATUS_MAX_AGE = 1.0;
+
+class GpuSampler {
+public:
+    // 取不超过max_age秒的采样，过期时重新执行detect_gpus，同时到达的调用共享一次执行；
+    // age返回采样距今的秒数
+    std::vector<GPUInfo> sample(double max_age, double& age) {
+        return samples.get("", max_age, detect_gpus, &age);
+    }
+
+    // 不超过max_age秒的采样是否已经有了，有时sample不会执行nvidia-smi
+    bool fresh(double max_age) {
+        return samples.fresh("", max_age);
+    }
+
+private:
+    SingleFlightCache<std::vector<GPUInfo>> samples;
+};
+
+GpuSampler g_gpu_sampler;
+
+const std::time_t g_process_start_time = std::time(nullptr);
+
+// Prometheus标签值转义：反斜杠、双引号和换行
+std::string metric_label(const std::string& value) {
+    std::string out;
+    for (char c : value) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+std::string metrics_text() {
+    std::unique_ptr<ThreadMetrics> total(new ThreadMetrics());
+    metrics_registry().snapshot(*total);
+
+    std::ostringstream out;
+    out << std::setprecision(10);
+    out << "# HELP elian_http_requests_total HTTP requests by route and status class.\n";
+    out << "# TYPE elian_http_requests_total counter\n";
+    for (size_t r = 0; r < METRIC_ROUTE_COUNT; ++r) {
+        for (size_t c = 0; c < STATUS_CLASS_COUNT; ++c) {
+            uint64_t value = total->requests[r][c].load(std::memory_order_relaxed);
+            if (value == 0) continue;
+            out << "elian_http_requests_total{route=\"" << METRIC_ROUTES[r] << "\",code=\"" << STATUS_CLASSES[c] << "\"} " << value << "\n";
+        }
+    }
+
+    out << "# HELP elian_http_request_duration_seconds Time from reading the request head to sending the response.\n";
+    out << "# TYPE elian_http_request_duration_seconds histogram\n";
+    for (size_t r = 0; r < METRIC_ROUTE_COUNT; ++r) {
+        uint64_t count = 0;
+        for (size_t b = 0; b <= LATENCY_BUCKET_COUNT; ++b) count += total->latency_buckets[r][b].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= LATENCY_BUCKET_COUNT; ++b) {
+            cumulative += total->latency_buckets[r][b].load(std::memory_order_relaxed);
+            out << "elian_http_request_duration_seconds_bucket{route=\"" << METRIC_ROUTES[r] << "\",le=\"";
+            if (b < LATENCY_BUCKET_COUNT) out << LATENCY_BUCKETS[b]; else out << "+Inf";
+            out << "\"} " << cumulative << "\n";
+        }
+        out << "elian_http_request_duration_seconds_sum{route=\"" << METRIC_ROUTES[r] << "\"} "
+            << total->latency_sum_us[r].load(std::memory_order_relaxed) / 1e6 << "\n";
+        out << "elian_http_request_duration_seconds_count{route=\"" << METRIC_ROUTES[r] << "\"} " << count << "\n";
+    }
+
+    auto counter = [&](const char* name, const char* help, MetricCounter index) {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " counter\n";
+        out << name << " " << total->counters[index].load(std::memory_order_relaxed) << "\n";
+    };
+    counter("elian_http_connections_total", "Accepted connections.", COUNTER_CONNECTIONS);
+    counter("elian_http_bad_requests_total", "Connections whose request head could not be read.", COUNTER_BAD_REQUESTS);
+    counter("elian_http_response_bytes_total", "Bytes of HTTP responses sent.", COUNTER_BYTES_SENT);
+    counter("elian_socket_syscalls_total", "Socket and event-loop system calls issued while serving connections.", COUNTER_SOCKET_SYSCALLS);
+    counter("elian_handoff_rejected_total", "Connections answered with 503 because every hand-off worker was busy.", COUNTER_HANDOFF_REJECTED);
+    out << "# HELP elian_io_backend Connection I/O backend in use.\n";
+    out << "# TYPE elian_io_backend gauge\n";
+    out << "elian_io_backend{backend=\"" << g_io_backend.load() << "\"} 1\n";
+
+    out << "# HELP elian_process_spawns_total Child processes started by the server.\n";
+    out << "# TYPE elian_process_spawns_total counter\n";
+    out << "elian_process_spawns_total{kind=\"command\"} " << total->counters[COUNTER_SPAWN_COMMAND].load(std::memory_order_relaxed) << "\n";
+    out << "elian_process_spawns_total{kind=\"task\"} " << total->counters[COUNTER_SPAWN_TASK].load(std::memory_order_relaxed) << "\n";
+    out << "elian_process_spawns_total{kind=\"train\"} " << total->counters[COUNTER_SPAWN_TRAIN].load(std::memory_order_relaxed) << "\n";
+
+    out << "# HELP elian_tasks Background tasks kept in the registry by kind and state.\n";
+    out << "# TYPE elian_tasks gauge\n";
+    const char* const kinds[] = {"inference", "ollama", "prepare", "dedup"};
+    const TaskState states[] = {TaskState::Pending, TaskState::Running, TaskState::Completed, TaskState::Failed};
+    std::map<std::pair<std::string, TaskState>, size_t> task_counts = g_task_registry.count_by_state();
+    for (const char* kind : kinds) {
+        for (TaskState state : states) {
+            auto it = task_counts.find({kind, state});
+            out << "elian_tasks{kind=\"" << kind << "\",state=\"" << task_state_name(state) << "\"} "
+                << (it == task_counts.end() ? 0 : it->second) << "\n";
+        }
+    }
+
+    out << "# HELP elian_worker_pool_threads Worker threads for CPU-bound dataset jobs.\n";
+    out << "# TYPE elian_worker_pool_threads gauge\n";
+    out << "elian_worker_pool_threads " << worker_pool().size() << "\n";
+    out << "# HELP elian_worker_pool_queue_depth Jobs waiting for a worker thread.\n";
+    out << "# TYPE elian_worker_pool_queue_depth gauge\n";
+    out << "elian_worker_pool_queue_depth " << worker_pool().queue_depth() << "\n";
+
+    double gpu_age = 0;
+    std::vector<GPUInfo> gpus = g_gpu_sampler.sample(GPU_SAMPLE_MAX_AGE, gpu_age);
+    out << "# HELP elian_gpu_memory_total_mib Total GPU memory reported by nvidia-smi.\n";
+    out << "# TYPE elian_gpu_memory_total_mib gauge\n";
+    for (size_t i = 0; i < gpus.size(); ++i) {
+        out << "elian_gpu_memory_total_mib{gpu=\"" << i << "\",name=\"" << metric_label(gpus[i].name) << "\"} " << gpus[i].memory_total << "\n";
+    }
+    out << "# HELP elian_gpu_memory_free_mib Free GPU memory reported by nvidia-smi.\n";
+    out << "# TYPE elian_gpu_memory_free_mib gauge\n";
+    for (size_t i = 0; i < gpus.size(); ++i) {
+        out << "elian_gpu_memory_free_mib{gpu=\"" << i << "\",name=\"" << metric_label(gpus[i].name) << "\"} " << gpus[i].memory_free << "\n";
+    }
+    out << "# HELP elian_gpu_utilization_percent GPU utilization reported by nvidia-smi.\n";
+    out << "# TYPE elian_gpu_utilization_percent gauge\n";
+    for (size_t i = 0; i < gpus.size(); ++i) {
+        out << "elian_gpu_utilization_percent{gpu=\"" << i << "\",name=\"" << metric_label(gpus[i].name) << "\"} " << gpus[i].utilization << "\n";
+    }
+    out << "# HELP elian_gpu_sample_age_seconds Age of the GPU sample exported above.\n";
+    out << "# TYPE elian_gpu_sample_age_seconds gauge\n";
+    out << "elian_gpu_sample_age_seconds " << gpu_age << "\n";
+
+    out << "# HELP process_start_time_seconds Start time of the process since unix epoch in seconds.\n";
+    out << "# TYPE process_start_time_seconds gauge\n";
+    out << "process_start_time_seconds " << static_cast<long long>(g_process_start_time) << "\n";
+    return out.str();
+}
+
+std::string metrics_response() {
+    std::string body = metrics_text();
+    std::ostringstream response;
+    response << "HTTP/1.1 200 OK\r\n";
+    response << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+    response << "Content-Length: " << body.length() << "\r\n";
+    response << "Cache-Control: no-cache\r\n";
+    response << "\r\n";
+    response << body;
+    return response.str();
+}
+
+// Chrome trace-event JSON，最多导出最近的limit个区间
+std::string traces_to_json(size_t limit) {
+    struct Entry {
+        uint32_t thread_id;
+        TraceEvent event;
+    };
+    std::vector<Entry> entries;
+    std::vector<uint32_t> thread_ids;
+    for (const auto& ring : trace_registry().all()) {
+        std::lock_guard<std::mutex> lock(ring->mtx);
+        if (ring->count == 0) continue;
+        thread_ids.push_back(ring->thread_id);
+        size_t size = ring->events.size();
+        for (size_t i = 0; i < ring->count; ++i) {
+            entries.push_back({ring->thread_id, ring->events[(ring->next + size - ring->count + i) % size]});
+        }
+    }
+    // 按结束时间保留最近的limit个
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.event.start_ns + a.event.duration_ns < b.event.start_ns + b.event.duration_ns;
+    });
+    if (entries.size() > limit) entries.erase(entries.begin(), entries.end() - static_cast<std::ptrdiff_t>(limit));
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (uint32_t thread_id : thread_ids) {
+        json << (first ? "" : ",") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_id
+             << ",\"args\":{\"name\":\"thread-" << thread_id << "\"}}";
+        first = false;
+    }
+    for (const Entry& entry : entries) {
+        json << (first ? "" : ",") << "{\"name\":\"" << escape_json(entry.event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << entry.thread_id
+             << ",\"ts\":" << entry.event.start_ns / 1000.0 << ",\"dur\":" << entry.event.duration_ns / 1000.0;
+        if (entry.event.detail[0] != '\0') {
+            json << ",\"args\":{\"detail\":\"" << escape_json(entry.event.detail) << "\"}";
+        }
+        json << "}";
+        first = false;
+    }
+    json << "]}";
+    return json.str();
+}
+
+// ==================== 任务状态轮询 ====================
+// 前端按固定间隔轮询的任务状态端点。响应体写入Out（std::string或ArenaString），
+// 服务线程直接在请求内存池中构建这些响应，稳态下不再分配堆内存。
+
+// 取查询参数中的任务ID，结果放在线程内复用的缓冲区里
+const std::string& task_id_param(std::string_view url, std::string_view key) {
+    thread_local std::string task_id;
+    std::string_view raw = get_query_param_raw(url, key);
+    if (raw.find_first_of("%+") == std::string_view::npos) {
+        task_id.assign(raw.data(), raw.size());
+    } else {
+        task_id = url_decode(std::string(raw));
+    }
+    return task_id;
+}
+
+// GET /api/task/status?task_id=  通用的任务状态查询，适用于所有后台任务
+template <typename Out>
+void task_status_body(Out& json, std::string_view url) {
+    json.append("{\"success\":true,\"task\":");
+    bool found = g_task_registry.visit(task_id_param(url, "task_id"), [&json](const AsyncTask& task) {
+        append_task_json(json, task, true);
+    });
+    if (found) {
+        json.append("}");
+    } else {
+        json.clear();
+        json.append("{\"success\":false,\"message\":\"任务不存在或已过期\"}");
+    }
+}
+
+// GET /api/inference/result?task_id=  兼容旧版前端的file参数，其值即为任务ID
+template <typename Out>
+void inference_result_body(Out& json, std::string_view url) {
+    const std::string* task_id = &task_id_param(url, "task_id");
+    if (task_id->empty()) task_id = &task_id_param(url, "file");
+
+    bool found = !task_id->empty() && g_task_registry.visit(*task_id, [&json](const AsyncTask& task) {
+        json.append("{");
+        if (task.state == TaskState::Completed) {
+            json.append("\"success\":true,");
+            json.append("\"status\":\"completed\",");
+            json.append("\"result\":\"");
+            append_json_escaped(json, task.result);
+            json.append("\"");
+        } else if (task.state == TaskState::Failed) {
+            json.append("\"success\":false,");
+            json.append("\"status\":\"failed\",");
+            json.append("\"message\":\"推理失败\",");
+            json.append("\"error\":\"");
+            append_json_escaped(json, task.message);
+            json.append("\"");
+        } else {
+            json.append("\"success\":false,");
+            json.append("\"status\":\"").append(task_state_name(task.state)).append("\",");
+            json.append("\"progress\":");
+            append_integer(json, task.progress);
+            json.append(",\"message\":\"推理结果尚未生成，请稍后再试\"");
+        }
+        json.append("}");
+    });
+    if (!found) {
+        json.append("{\"success\":false,\"status\":\"failed\",\"message\":\"推理任务不存在或已过期\"}");
+    }
+}
+
+// GET /api/ollama/status?task_id=
+template <typename Out>
+void ollama_status_body(Out& json, std::string_view url) {
+    const std::string& task_id = task_id_param(url, "task_id");
+    if (task_id.empty()) {
+        json.append("{\"success\":false,\"message\":\"缺少任务ID参数\"}");
+        return;
+    }
+    bool found = g_task_registry.visit(task_id, [&json](const AsyncTask& task) {
+        if (task.state == TaskState::Completed) {
+            json.append("{\"success\":true,\"status\":\"completed\",\"message\":\"模型部署成功\"}");
+        } else if (task.state == TaskState::Failed) {
+            json.append("{\"success\":true,\"status\":\"failed\",\"message\":\"");
+            append_json_escaped(json, task.result.empty() ? task.message : task.result);
+            json.append("\"}");
+        } else {
+            json.append("{\"success\":true,\"status\":\"running\",\"message\":\"任务正在进行中\",\"progress\":");
+            append_integer(json, task.progress);
+            json.append(",\"detail\":\"");
+            append_json_escaped(json, task.message);
+            json.append("\"}");
+        }
+    });
+    if (!found) {
+        json.append("{\"success\":true,\"status\":\"failed\",\"message\":\"部署任务不存在或已过期\"}");
+    }
+}
+
+// 按URL选择轮询端点写入响应体，不是这些端点时返回false。
+// handle_arena_request和handle_api_request共用，两条路径的响应体不会不一致
+template <typename Out>
+bool task_polling_body(Out& json, std::string_view url) {
+    if (starts_with(url, "/api/task/status?")) {
+        task_status_body(json, url);
+    } else if (starts_with(url, "/api/inference/result?")) {
+        inference_result_body(json, url);
+    } else if (starts_with(url, "/api/ollama/status")) {
+        ollama_status_body(json, url);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 在请求内存池中处理轮询端点，不是这些端点时返回空
+std::string_view handle_arena_request(std::string_view method, std::string_view url) {
+    if (method != "GET") return std::string_view();
+    ArenaString json;
+    json.reserve(1024);
+    if (!task_polling_body(json, url)) return std::string_view();
+    return arena_json_response(std::string_view(json.data(), json.size()));
+}
+
+// /api/gpu/status的响应体，WebSocket推送也用它
+std::string gpu_status_body(const std::vector<GPUInfo>& gpus) {
+    std::ostringstream json;
+    json << "{";
+    
+    if (gpus.empty()) {
+        json << "\"success\": false, \"message\": \"没有检测到GPU\", \"data\": []";
+    } else {
+        json << "\"success\": true, \"data\": [";
+        
+        for (size_t i = 0; i < gpus.size(); ++i) {
+            const auto& gpu = gpus[i];
+            json << "{";
+            json << "\"name\": \"" << gpu.name << "\", ";
+            json << "\"memory_total\": " << gpu.memory_total << ", ";
+            json << "\"memory_free\": " << gpu.memory_free << ", ";
+            json << "\"utilization\": " << gpu.utilization << ", ";
+            json << "\"status\": \"" << gpu.status << "\"";
+            json << "}";
+            
+            if (i < gpus.size() - 1) {
+                json << ", ";
+            }
+        }
+        
+        json << "]";
+    }
+    json << "}";
+    return json.str();
+}
+
+// 处理API请求
+std::string handle_api_request(const std::string& url, const std::string& request, const std::string& method) {
+    // 处理OPTIONS请求（CORS预检请求）
+    if (method == "OPTIONS") {
+        return std::string(CORS_PREFLIGHT_RESPONSE.view());
+    }
+
+    std::string polling;
+    if (task_polling_body(polling, url)) {
+        return json_response(polling);
+    }
+
+    if (url == "/api/gpu/status" || url == "/api/gpus") {
+        double gpu_age = 0;
+        std::vector<GPUInfo> gpus = g_gpu_sampler.sample(GPU_STATUS_MAX_AGE, gpu_age);
+        return json_response(gpu_status_body(gpus));
+    } 
+    else if (url == "/api/system/info") {
+        // 获取实际系统信息
+        std::string python_version = get_python_version();
+        std::string pytorch_version = get_pytorch_version();
+        std::string transformers_version = get_transformers_version();
+        std::string cuda_version = get_cuda_version();
+        
+        std::pair<int, int> memory_info = get_system_memory();
+        int total_memory = memory_info.first;
+        int available_memory = memory_info.second;
+        
+        int disk_space = get_disk_space();
+        
+        // 清理版本字符串中的换行符
+        pytorch_version.erase(std::remove(pytorch_version.begin(), pytorch_version.end(), '\n'), pytorch_version.end());
+        pytorch_version.erase(std::remove(pytorch_version.begin(), pytorch_version.end(), '\r'), pytorch_version.end());
+        transformers_version.erase(std::remove(transformers_version.begin(), transformers_version.end(), '\n'), transformers_version.end());
+        transformers_version.erase(std::remove(transformers_version.begin(), transformers_version.end(), '\r'), transformers_version.end());
+        cuda_version.erase(std::remove(cuda_version.begin(), cuda_version.end(), '\n'), cuda_version.end());
+        cuda_version.erase(std::remove(cuda_version.begin(), cuda_version.end(), '\r'), cuda_version.end());
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\": true, ";
+        json << "\"data\": {";
+        
+        // 操作系统信息
+        #ifdef _WIN32
+        json << "\"os\": \"Windows\", ";
+        #else
+        json << "\"os\": \"Linux/Unix\", ";
+        #endif
+        
+        // 实际检测到的信息
+        json << "\"python_version\": \"" << python_version << "\", ";
+        json << "\"pytorch_version\": \"" << pytorch_version << "\", ";
+        json << "\"transformers_version\": \"" << transformers_version << "\", ";
+        json << "\"cuda_version\": \"" << cuda_version << "\", ";
+        json << "\"cudnn_version\": \"自动随PyTorch安装\", ";
+        
+        // 系统资源信息
+        json << "\"memory_total\": " << total_memory << ", ";
+        json << "\"memory_available\": " << available_memory << ", ";
+        json << "\"disk_space\": " << disk_space;
+        
+        json << "}";
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/default-config") {
+        // 返回默认配置（编译期生成的静态响应）
+        return std::string(DEFAULT_CONFIG_RESPONSE.view());
+    }
+    else if (url == "/api/config/schema") {
+        // 训练参数的类型、范围和可选值
+        return json_response(training_schema_json());
+    }
+    else if (url == "/api/data/files" || starts_with(url, "/api/data/files?")) {
+        // 列出data目录下的所有JSONL文件（来自目录缓存）
+        std::string data_dir = get_current_dir() + "/llm/data";
+        std::vector<DatasetFileEntry> files = g_dataset_directory.snapshot(data_dir);
+        
+        // 排序：sort=name|size|mtime|records，order=asc|desc
+        std::string sort_key = get_query_param(url, "sort");
+        bool descending = get_query_param(url, "order") == "desc";
+        std::sort(files.begin(), files.end(), [&](const DatasetFileEntry& a, const DatasetFileEntry& b) {
+            if (sort_key == "size" && a.size != b.size) return descending ? a.size > b.size : a.size < b.size;
+            if (sort_key == "mtime" && a.mtime != b.mtime) return descending ? a.mtime > b.mtime : a.mtime < b.mtime;
+            if (sort_key == "records" && a.records != b.records) return descending ? a.records > b.records : a.records < b.records;
+            return descending && (sort_key.empty() || sort_key == "name") ? a.name > b.name : a.name < b.name;
+        });
+        
+        // 分页：offset/limit，limit缺省时返回全部
+        size_t offset = 0;
+        size_t limit = files.size();
+        try {
+            std::string offset_param = get_query_param(url, "offset");
+            std::string limit_param = get_query_param(url, "limit");
+            if (!offset_param.empty()) offset = static_cast<size_t>(std::stoull(offset_param));
+            if (!limit_param.empty()) limit = static_cast<size_t>(std::stoull(limit_param));
+        } catch (...) {
+            return json_response("{\"success\":false,\"message\":\"offset或limit参数无效\"}");
+        }
+        size_t begin = std::min(offset, files.size());
+        size_t end = begin + std::min(limit, files.size() - begin);
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"total\":" << files.size() << ",";
+        json << "\"files\":[";
+        for (size_t i = begin; i < end; ++i) {
+            if (i > begin) json << ",";
+            json << "\"" << escape_json(files[i].name) << "\"";
+        }
+        json << "],";
+        json << "\"entries\":[";
+        for (size_t i = begin; i < end; ++i) {
+            if (i > begin) json << ",";
+            json << "{\"name\":\"" << escape_json(files[i].name) << "\","
+                 << "\"size\":" << files[i].size << ","
+                 << "\"mtime\":" << files[i].mtime << ","
+                 << "\"records\":";
+            if (files[i].records < 0) json << "null";
+            else json << files[i].records;
+            json << "}";
+        }
+        json << "]}";
+        return json_response(json.str());
+    }
+    else if (starts_with(url, "/api/data/preview?")) {
+        std::string filename = get_query_param(url, "file");
+        
+        // 安全检查，防止路径遍历攻击
+        if (filename.empty() || filename.find("..") != std::string::npos) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"Invalid filename\"}";
+            return json_response(json.str());
+        }
+        
+        // 分页参数：offset为起始记录号(从0开始)，limit为返回条数
+        long long offset = 0;
+        long long limit = 20;
+        try {
+            std::string offset_param = get_query_param(url, "offset");
+            std::string limit_param = get_query_param(url, "limit");
+            if (!offset_param.empty()) offset = std::stoll(offset_param);
+            if (!limit_param.empty()) limit = std::stoll(limit_param);
+        } catch (...) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"offset或limit参数无效\"}";
+            return json_response(json.str());
+        }
+        if (offset < 0) offset = 0;
+        if (limit < 1) limit = 1;
+        if (limit > 1000) limit = 1000;
+        
+        std::string file_path = get_current_dir() + "/llm/data/" + filename;
+        std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(file_path);
+        if (!index) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"数据文件不存在或无法读取\"}";
+            return json_response(json.str());
+        }
+        
+        size_t total = index->record_count();
+        size_t begin = std::min(static_cast<size_t>(offset), total);
+        size_t end = std::min(begin + static_cast<size_t>(limit), total);
+        
+        std::string preview;
+        for (size_t i = begin; i < end; ++i) {
+            preview += index->record_view(i);
+            preview += "\n";
+        }
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"total\":" << total << ",";
+        json << "\"offset\":" << begin << ",";
+        json << "\"limit\":" << limit << ",";
+        json << "\"content\":\"" << escape_json(preview) << "\"";
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (starts_with(url, "/api/data/stats?")) {
+        std::string filename = get_query_param(url, "file");
+        
+        // 安全检查，防止路径遍历攻击
+        if (filename.empty() || filename.find("..") != std::string::npos) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"Invalid filename\"}";
+            return json_response(json.str());
+        }
+        
+        // 打包效率按给定的max_seq_length估算，默认与训练配置一致为1024
+        uint32_t max_seq_length = 1024;
+        std::string max_seq_length_param = get_query_param(url, "max_seq_length");
+        if (!max_seq_length_param.empty()) {
+            max_seq_length = static_cast<uint32_t>(std::strtoul(max_seq_length_param.c_str(), nullptr, 10));
+        }
+        if (max_seq_length == 0) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"max_seq_length参数无效\"}";
+            return json_response(json.str());
+        }
+        
+        std::string file_path = get_current_dir() + "/llm/data/" + filename;
+        bool cached = false;
+        std::shared_ptr<const DatasetStats> stats = g_dataset_stats.get(file_path, &cached);
+        if (!stats) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"数据文件不存在或无法读取\"}";
+            return json_response(json.str());
+        }
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"file\":\"" << escape_json(filename) << "\",";
+        json << "\"cached\":" << (cached ? "true" : "false") << ",";
+        json << "\"elapsed_ms\":" << stats->elapsed_ms << ",";
+        json << "\"file_size\":" << stats->file_size << ",";
+        json << "\"records\":" << stats->records << ",";
+        json << "\"valid\":" << stats->valid << ",";
+        json << "\"invalid_count\":" << stats->invalid_count << ",";
+        json << "\"invalid_lines\":[";
+        for (size_t i = 0; i < stats->invalid_lines.size(); ++i) {
+            if (i > 0) json << ",";
+            json << "{\"line\":" << stats->invalid_lines[i].first
+                 << ",\"error\":\"" << escape_json(stats->invalid_lines[i].second) << "\"}";
+        }
+        json << "],";
+        json << "\"human\":" << text_length_stats_to_json(stats->human) << ",";
+        json << "\"assistant\":" << text_length_stats_to_json(stats->assistant) << ",";
+        
+        // 按process_data()的截断规则估算每条样本长度：模板+问题、回答各自截断，再加eos
+        std::vector<uint32_t> lengths;
+        lengths.reserve(stats->sample_tokens.size());
+        for (const auto& sample : stats->sample_tokens) {
+            uint64_t prompt = std::min<uint64_t>(static_cast<uint64_t>(sample.first) + PROMPT_TEMPLATE_TOKENS, max_seq_length);
+            uint64_t answer = std::min<uint64_t>(sample.second, max_seq_length);
+            lengths.push_back(static_cast<uint32_t>(prompt + answer + 1));
+        }
+        json << "\"packing\":" << packing_plan_to_json(plan_sequence_packing(lengths, max_seq_length), lengths.size(), true);
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url.find("/api/training/") == 0) {
+        // 训练API
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"message\":\"训练请求已接收\",";
+        json << "\"data\":{";
+        json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
+        json << "\"status\":\"pending\"";
+        json << "}";
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/data/prepared") {
+        // 列出预处理生成的分片，可以直接作为/api/train的train_file
+        std::string prepared_dir = get_current_dir() + "/llm/data/prepared";
+        std::vector<std::string> files = list_files_in_directory(prepared_dir, ".bin");
+        std::sort(files.begin(), files.end());
+        
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(4);
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"files\":[";
+        bool first = true;
+        for (const auto& name : files) {
+            TokenShardHeader header;
+            FILE* in = open_file_utf8(prepared_dir + "/" + name, "rb");
+            if (!in) continue;
+            bool ok = fread(&header, sizeof(header), 1, in) == 1 &&
+                      memcmp(header.magic, TOKEN_SHARD_MAGIC, sizeof(TOKEN_SHARD_MAGIC)) == 0;
+            fclose(in);
+            if (!ok) continue;
+            
+            bool packed = (header.flags & TOKEN_SHARD_PACKED) != 0;
+            if (!first) json << ",";
+            first = false;
+            json << "{\"name\":\"" << escape_json(name) << "\","
+                 << "\"train_file\":\"data/prepared/" << escape_json(name) << "\","
+                 << "\"size\":" << stat_file(prepared_dir + "/" + name).size << ","
+                 << "\"packed\":" << (packed ? "true" : "false") << ","
+                 << "\"sequences\":" << header.num_samples << ","
+                 << "\"tokens\":" << header.num_tokens << ","
+                 << "\"max_seq_length\":" << header.max_seq_length << ","
+                 << "\"efficiency\":";
+            if (packed && header.num_samples > 0) {
+                json << static_cast<double>(header.num_tokens) / (static_cast<double>(header.num_samples) * header.max_seq_length);
+            } else {
+                json << "null";
+            }
+            json << "}";
+        }
+        json << "]}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/data/prepare" && method == "POST") {
+        // 预分词：把JSONL数据集编码为二进制分片，之后可以直接作为/api/train的train_file
+        std::map<std::string, std::string> formData = parse_json(extract_post_data(request));
+        std::string filename = formData["file"];
+        std::string model_path = formData["model_name_or_path"];
+        
+        // 安全检查，防止路径遍历攻击
+        if (filename.empty() || filename.find("..") != std::string::npos || model_path.empty()) {
+            return json_response("{\"success\":false,\"message\":\"缺少必要参数或文件名无效\"}");
+        }
+        
+        PrepareOptions options;
+        options.dataset_name = filename;
+        options.dataset_path = get_current_dir() + "/llm/data/" + filename;
+        options.model_dir = resolve_llm_path(model_path);
+        options.max_seq_length = 1024;
+        if (!formData["max_seq_length"].empty()) {
+            options.max_seq_length = static_cast<uint32_t>(std::strtoul(formData["max_seq_length"].c_str(), nullptr, 10));
+        }
+        options.pack = formData["pack"] == "true";
+        if (options.max_seq_length == 0) {
+            return json_response("{\"success\":false,\"message\":\"max_seq_length参数无效\"}");
+        }
+        if (!file_exists(options.dataset_path)) {
+            return json_response("{\"success\":false,\"message\":\"数据文件不存在\"}");
+        }
+        if (!file_exists(options.model_dir)) {
+            return json_response("{\"success\":false,\"message\":\"模型路径不存在: " + escape_json(options.model_dir) + "\"}");
+        }
+        
+        std::string task_id = g_task_registry.create("prepare");
+        std::thread([task_id, options]() { run_prepare_dataset(task_id, options); }).detach();
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"message\":\"预处理任务已启动\",";
+        json << "\"task_id\":\"" << escape_json(task_id) << "\"";
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/data/dedup" && method == "POST") {
+        // 数据集去重与训练/测试划分，参数含数组和小数，用JsonValue解析
+        JsonValue body;
+        std::string parse_error;
+        if (!json_parse(extract_post_data(request), body, &parse_error) || !body.is_object()) {
+            return json_response("{\"success\":false,\"message\":\"请求体不是有效的JSON: " + escape_json(parse_error) + "\"}");
+        }
+        
+        DedupOptions options;
+        const JsonValue* files = body.find("files");
+        const JsonValue* file = body.find("file");
+        if (files && files->is_array()) {
+            for (const auto& item : files->items) {
+                if (item.is_string()) options.files.push_back(item.str);
+            }
+        } else if (file && file->is_string()) {
+            options.files.push_back(file->str);
+        }
+        const JsonValue* output = body.find("output");
+        const JsonValue* test_ratio = body.find("test_ratio");
+        const JsonValue* near_duplicates = body.find("near_duplicates");
+        const JsonValue* threshold = body.find("threshold");
+        const JsonValue* seed = body.find("seed");
+        const JsonValue* dry_run = body.find("dry_run");
+        options.output = (output && output->is_string()) ? output->str : "dedup";
+        options.test_ratio = (test_ratio && test_ratio->is_number()) ? test_ratio->number : 0.1;
+        options.near_duplicates = near_duplicates && near_duplicates->is_bool() && near_duplicates->boolean;
+        options.threshold = (threshold && threshold->is_number()) ? threshold->number : 0.85;
+        options.seed = (seed && seed->is_number()) ? static_cast<uint64_t>(seed->number) : 42;
+        options.dry_run = dry_run && dry_run->is_bool() && dry_run->boolean;
+        
+        // 安全检查，防止路径遍历攻击；输出文件不能覆盖输入文件
+        std::string error_message;
+        if (options.files.empty()) error_message = "缺少必要参数: files";
+        for (const auto& name : options.files) {
+            if (name.empty() || name.find("..") != std::string::npos || name.find_first_of("/\\") != std::string::npos) {
+                error_message = "Invalid filename";
+            }
+        }
+        if (options.output.empty() || options.output.find("..") != std::string::npos ||
+            options.output.find_first_of("/\\:*?\"<>|") != std::string::npos) {
+            error_message = "输出文件名无效";
+        }
+        for (const auto& name : options.files) {
+            if (name == options.output + "_train.jsonl" || name == options.output + "_test.jsonl") {
+                error_message = "输出文件不能与输入文件同名: " + name;
+            }
+        }
+        if (options.test_ratio < 0 || options.test_ratio >= 1) error_message = "test_ratio应在[0, 1)范围内";
+        if (options.threshold <= 0 || options.threshold > 1) error_message = "threshold应在(0, 1]范围内";
+        if (!error_message.empty()) {
+            return json_response("{\"success\":false,\"message\":\"" + escape_json(error_message) + "\"}");
+        }
+        
+        std::string task_id = g_task_registry.create("dedup");
+        std::thread([task_id, options]() { run_dedup_dataset(task_id, options); }).detach();
+        
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"message\":\"去重任务已启动\",";
+        json << "\"task_id\":\"" << escape_json(task_id) << "\"";
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/train") {
+        // 读取POST数据体
+        std::string request_body = extract_post_data(request);
+        log_event(LogLevel::Info, "train.request").num("bytes", static_cast<long long>(request_body.size()));
+        log_event(LogLevel::Debug, "train.request.body").str("body", request_body);
+        
+        // 解析并校验训练参数，后续只使用规范化后的值拼接命令行
+        TraceSpan validate_span("train.validate");
+        JsonValue body;
+        std::string parse_error;
+        if (!json_parse(request_body, body, &parse_error)) {
+            return json_response("{\"success\":false,\"message\":\"参数验证失败\",\"error\":\"请求体不是有效的JSON: " + escape_json(parse_error) + "\"}");
+        }
+        ValidatedConfig validated = validate_training_config(body, true);
+        // main.py启动后还会读取默认配置并覆盖命令行参数，一并校验
+        ConfigEntry default_entry;
+        if (g_config_store.get("default_config", 0, default_entry)) {
+            ValidatedConfig stored = default_entry.value ? validate_training_config(*default_entry.value, false) : ValidatedConfig();
+            if (!default_entry.value) stored.issues.push_back({"", "不是有效的JSON"});
+            for (auto& issue : stored.issues) {
+                issue.field = "default_config" + (issue.field.empty() ? "" : "." + issue.field);
+                validated.issues.push_back(issue);
+            }
+        }
+        if (!validated.ok()) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"参数验证失败\",";
+            json << "\"error\":\"" << escape_json(config_issues_to_text(validated.issues)) << "\",";
+            json << "\"errors\":";
+            config_issues_to_json(json, validated.issues);
+            json << "}";
+            return json_response(json.str());
+        }
+        std::map<std::string, std::string> formData = validated.values;
+        validate_span.finish();
+        
+        // 获取当前工作目录（程序运行的目录）
+        std::string current_dir;
+#ifdef _WIN32
+        // 使用宽字符函数处理可能包含中文的路径
+        wchar_t wbuffer[MAX_PATH];
+        GetCurrentDirectoryW(MAX_PATH, wbuffer);
+        
+        // 将宽字符转换为UTF-8编码的字符串
+        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
+        std::vector<char> utf8_buffer(size_needed);
+        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
+        
+        current_dir = std::string(utf8_buffer.data());
+#else
+        char buffer[PATH_MAX];
+        if (getcwd(buffer, PATH_MAX) != NULL) {
+            current_dir = buffer;
+        } else {
+            current_dir = ".";
+        }
+#endif
+
+        // 构建Python命令 开启训练脚本，训练参数逐个放在args中，不拼接成shell命令
+        std::wstring cmdCommand;
+        std::vector<std::string> args;
+        std::string error_message = "";
+        std::wstring main_py_path = L"./llm/main.py";
+        // 检查分布式设置
+        bool use_distributed = false;
+        if (formData.find("distributed") != formData.end()) {
+            use_distributed = (formData["distributed"] == "true");
+        }
+
+        // 根据distributed 构建不同的启动main.py的命令
+        if (use_distributed) {
+            // 获取GPU数量
+            std::vector<GPUInfo> gpus = detect_gpus();
+            int gpu_count = static_cast<int>(gpus.size());
+            if (gpu_count == 0) gpu_count = 1;
+            
+            // 使用torchrun启动分布式训练
+            #ifdef _WIN32
+            std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
+            std::string main_path = current_dir + "\\llm\\main.py";
+            std::replace(main_path.begin(), main_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
+            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set TORCHRUN_USE_LIBUV=0 && set PYTHONIOENCODING=utf-8 && chcp 65001 && torchrun --nproc_per_node="
+             + std::to_wstring(gpu_count) + L" " +  main_py_path + L" " + L" > ./train_log.txt 2>&1\"";
+            #else
+            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set TORCHRUN_USE_LIBUV=0 && set PYTHONIOENCODING=utf-8 && chcp 65001 && torchrun --nproc_per_node="
+             + std::to_wstring(gpu_count) + L" " +  main_py_path + L"\"";
+            #endif
+        } else {
+            // 使用普通python命令
+            #ifdef _WIN32
+            std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
+            std::string main_path = current_dir + "\\llm\\main.py";
+            std::replace(main_path.begin(), main_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
+            cmdCommand = L"start /B cmd.exe /C \""
+             L"conda activate elianfactory && "
+             L"set PYTHONIOENCODING=utf-8 && "
+             L"chcp 65001 > nul && "
+             L"python " + main_py_path + L" > \"./train_log.txt\" 2>&1\"";
+            #else
+            cmdCommand = L"start /B cmd.exe /C \"conda activate elianfactory && set PYTHONIOENCODING=utf-8 && chcp 65001 && python ./llm/main.py \"";
+            #endif
+        }
+        
+        // 添加训练参数
+        // 基础模型路径
+        if (formData.find("model_name_or_path") != formData.end()) {
+            std::string model_path = formData["model_name_or_path"];
+            if (model_path.size() > 2 && model_path[0] == '"' && model_path[model_path.size() - 1] == '"') {
+                model_path = model_path.substr(1, model_path.size() - 2);
+            }
+            
+            // 处理路径：添加基础目录
+            if (model_path.size() <= 1 || model_path[1] != ':') { // 非绝对路径
+                if (model_path[0] == '/' || model_path[0] == '\\') {
+                    model_path = model_path.substr(1);
+                }
+                #ifdef _WIN32
+                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
+                model_path = current_dir + "\\llm\\" + model_path;
+                std::replace(model_path.begin(), model_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
+                
+                // 创建模型路径目录
+                std::string model_dir = model_path.substr(0, model_path.find_last_of('\\'));
+                if (!file_exists(model_dir)) {
+                    TraceSpan span("train.create_directory", model_dir);
+                    log_event(LogLevel::Info, "train.create_directory").str("path", model_dir);
+                    // 递归创建目录
+                    std::string path_so_far;
+                    std::istringstream path_stream(model_dir);
+                    std::string folder;
+                    while (std::getline(path_stream, folder, '\\')) {
+                        if (path_so_far.empty()) {
+                            path_so_far = folder;
+                        } else {
+                            path_so_far += "\\" + folder;
+                        }
+                        if (!path_so_far.empty() && !file_exists(path_so_far)) {
+                            if (!CreateDirectoryA(path_so_far.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+                                error_message = "无法创建模型目录: " + path_so_far + ", 错误码: " + std::to_string(GetLastError());
+                                break;
+                            }
+                        }
+                    }
+                }
+                #else
+                model_path = current_dir + "/llm/" + model_path;
+                #endif
+            }
+            
+            // 检查模型路径是否存在
+            if (!file_exists(model_path) && error_message.empty()) {
+                error_message = "模型路径不存在: " + model_path;
+            }
+            
+            args.push_back("--model_name_or_path");
+            args.push_back(model_path);
+        } else {
+            error_message = "缺少必要参数: model_name_or_path";
+        }
+        
+        // 微调输出权重路径
+        if (formData.find("output_dir") != formData.end() && error_message.empty()) {
+            std::string output_path = formData["output_dir"];
+            if (output_path.size() > 2 && output_path[0] == '"' && output_path[output_path.size() - 1] == '"') {
+                output_path = output_path.substr(1, output_path.size() - 2);
+            }
+            
+            // 处理路径：添加基础目录
+            if (output_path.size() <= 1 || output_path[1] != ':') { // 非绝对路径
+                if (output_path[0] == '/' || output_path[0] == '\\') {
+                    output_path = output_path.substr(1);
+                }
+                #ifdef _WIN32
+                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
+                output_path = current_dir + "\\llm\\" + output_path;
+                std::replace(output_path.begin(), output_path.end(), '/', '\\'); // 确保Windows下使用反斜杠
+                
+                // 创建输出目录
+                std::string output_dir = output_path;
+                #else
+                output_path = current_dir + "/llm/" + output_path;
+                #endif
+            }
+            
+            args.push_back("--output_dir");
+            args.push_back(output_path);
+        } else if (error_message.empty()) {
+            error_message = "缺少必要参数: output_dir";
+        }
+        
+        // 训练文件路径
+        if (formData.find("train_file") != formData.end() && error_message.empty()) {
+            std::string train_file = formData["train_file"];
+            if (train_file.size() > 2 && train_file[0] == '"' && train_file[train_file.size() - 1] == '"') {
+                train_file = train_file.substr(1, train_file.size() - 2);
+            }
+            
+            // 处理路径：添加基础目录
+            if (train_file.size() <= 1 || train_file[1] != ':') { // 非绝对路径
+                if (train_file[0] == '/' || train_file[0] == '\\') {
+                    train_file = train_file.substr(1);
+                }
+                #ifdef _WIN32
+                std::replace(current_dir.begin(), current_dir.end(), '/', '\\'); // 确保Windows下使用反斜杠
                 train_file = current_dir + "\\llm\\" + train_file;
                 std::replace(train_file.begin(), train_file.end(), '/', '\\'); // 确保Windows下使用反斜杠
                 
                 // 创建数据目录
                 std::string data_dir = train_file.substr(0, train_file.find_last_of('\\'));
                 if (!file_exists(data_dir)) {
-                    std::cout << "创建数据目录: " << data_dir << std::endl;
+                    TraceSpan span("train.create_directory", data_dir);
+                    log_event(LogLevel::Info, "train.create_directory").str("path", data_dir);
                     // 递归创建目录
                     std::string path_so_far;
                     std::istringstream path_stream(data_dir);
@@ -1172,1222 +6466,4559 @@ std::string handle_api_request(const std::string& url, const std::string& reques
                         }
                     }
                 }
-                #else
-                train_file = current_dir + "/llm/" + train_file;
-                #endif
+                #else
+                train_file = current_dir + "/llm/" + train_file;
+                #endif
+            }
+            
+            // 检查文件是否存在
+            if (!file_exists(train_file) && error_message.empty()) {
+                error_message = "训练数据文件不存在: " + train_file;
+            }
+            
+            // 启动GPU任务前先校验数据集，结果按文件大小和修改时间缓存
+            if (error_message.empty() && ends_with(train_file, ".jsonl")) {
+                TraceSpan span("train.dataset_stats", train_file);
+                std::shared_ptr<const DatasetStats> stats = g_dataset_stats.get(train_file, nullptr);
+                if (stats && stats->invalid_count > 0) {
+                    error_message = "训练数据校验失败: 共" + std::to_string(stats->invalid_count) + "条无效记录";
+                    if (!stats->invalid_lines.empty()) {
+                        error_message += "，第" + std::to_string(stats->invalid_lines[0].first) + "行: " + stats->invalid_lines[0].second;
+                    }
+                } else if (stats && stats->valid == 0) {
+                    error_message = "训练数据文件中没有有效记录: " + train_file;
+                }
+            }
+            
+            args.push_back("--train_file");
+            args.push_back(train_file);
+        } else if (error_message.empty()) {
+            error_message = "缺少必要参数: train_file";
+        }
+        
+        // 添加其他参数
+        if (error_message.empty()) {
+            // 非布尔参数直接添加
+            if (formData.find("num_train_epochs") != formData.end())
+                args.insert(args.end(), {"--num_train_epochs", formData["num_train_epochs"]});
+            
+            if (formData.find("per_device_train_batch_size") != formData.end())
+                args.insert(args.end(), {"--per_device_train_batch_size", formData["per_device_train_batch_size"]});
+            
+            if (formData.find("gradient_accumulation_steps") != formData.end())
+                args.insert(args.end(), {"--gradient_accumulation_steps", formData["gradient_accumulation_steps"]});
+            
+            if (formData.find("learning_rate") != formData.end())
+                args.insert(args.end(), {"--learning_rate", formData["learning_rate"]});
+            
+            if (formData.find("max_seq_length") != formData.end())
+                args.insert(args.end(), {"--max_seq_length", formData["max_seq_length"]});
+            
+            if (formData.find("logging_steps") != formData.end())
+                args.insert(args.end(), {"--logging_steps", formData["logging_steps"]});
+            
+            if (formData.find("save_steps") != formData.end())
+                args.insert(args.end(), {"--save_steps", formData["save_steps"]});
+            
+            if (formData.find("save_total_limit") != formData.end())
+                args.insert(args.end(), {"--save_total_limit", formData["save_total_limit"]});
+            
+            if (formData.find("lr_scheduler_type") != formData.end())
+                args.insert(args.end(), {"--lr_scheduler_type", formData["lr_scheduler_type"]});
+            
+            if (formData.find("warmup_steps") != formData.end())
+                args.insert(args.end(), {"--warmup_steps", formData["warmup_steps"]});
+            
+            if (formData.find("lora_rank") != formData.end())
+                args.insert(args.end(), {"--lora_rank", formData["lora_rank"]});
+            
+            if (formData.find("lora_alpha") != formData.end())
+                args.insert(args.end(), {"--lora_alpha", formData["lora_alpha"]});
+            
+            if (formData.find("lora_dropout") != formData.end())
+                args.insert(args.end(), {"--lora_dropout", formData["lora_dropout"]});
+            
+            // 布尔参数 - 只有为true时才添加参数，为false时不传递
+            if (formData.find("gradient_checkpointing") != formData.end()) {
+                bool is_enabled = (formData["gradient_checkpointing"] == "true");
+                if (is_enabled) {
+                    args.push_back("--gradient_checkpointing");
+                }
+            }
+            
+            if (formData.find("fp16") != formData.end()) {
+                bool is_enabled = (formData["fp16"] == "true");
+                if (is_enabled) {
+                    args.push_back("--fp16");
+                }
+            }
+            
+            // 其他非布尔参数
+            if (formData.find("optim") != formData.end())
+                args.insert(args.end(), {"--optim", formData["optim"]});
+            
+            if (formData.find("train_mode") != formData.end())
+                args.insert(args.end(), {"--train_mode", formData["train_mode"]});
+            
+            if (formData.find("seed") != formData.end())
+                args.insert(args.end(), {"--seed", formData["seed"]});
+            
+            // 分布式参数处理，只有为true时才添加
+            if (use_distributed) {
+                args.push_back("--distributed"); // 分布式模式下添加标志
+            }
+        }
+
+        // 如果有错误，直接返回错误信息
+        if (!error_message.empty()) {
+            std::ostringstream json;
+            json << "{";
+            json << "\"success\":false,";
+            json << "\"message\":\"参数验证失败\",";
+            json << "\"error\":\"" << escape_json(error_message) << "\"";
+            json << "}";
+            return json_response(json.str());
+        }
+
+        // 模拟训练：以本程序的--fake-trainer模式代替main.py，输出同样写到train_log.txt
+        if (!fake_trainer_spec().empty()) {
+            FakeTrainerOptions fake_options;
+            std::string fake_error;
+            if (!parse_fake_trainer_options(fake_trainer_spec(), fake_options, fake_error)) {
+                return json_response("{\"success\":false,\"message\":\"启动训练任务失败\",\"error\":\"" + escape_json(fake_error) + "\"}");
+            }
+            std::vector<std::string> fake_argv = {self_executable_path(), "--fake-trainer", fake_trainer_spec()};
+            fake_argv.insert(fake_argv.end(), args.begin(), args.end());
+            log_event(LogLevel::Info, "train.simulated").str("options", fake_trainer_spec());
+            metrics_count(COUNTER_SPAWN_TRAIN);
+            int result;
+            {
+                TraceSpan span("train.system");
+#ifdef _WIN32
+                std::wstring launch = L"start /B cmd.exe /C \"" + s2ws(quote_command_args(fake_argv)) + L" > \"./train_log.txt\" 2>&1\"";
+                result = _wsystem(launch.c_str());
+#else
+                int spawn_error = 0;
+                result = spawn_detached({fake_argv}, current_dir + "/train_log.txt", spawn_error) ? 0 : spawn_error;
+#endif
+            }
+            log_event(LogLevel::Info, "train.launch").num("exit_code", result);
+            std::ostringstream json;
+            if (result == 0) {
+                json << "{\"success\":true,\"message\":\"模拟训练任务已启动\",\"data\":{\"task_id\":\"task_" << std::rand() % 1000
+                     << "\",\"status\":\"running\",\"simulated\":true}}";
+            } else {
+                json << "{\"success\":false,\"message\":\"启动训练任务失败\",\"error\":\"命令执行结果: " << result << "\"}";
+            }
+            return json_response(json.str());
+        }
+
+        bool success = false;
+        std::string cmd_output;
+        
+#ifdef _WIN32
+        // 使用宽字符版本获取路径
+        wchar_t buffer[MAX_PATH];
+        GetModuleFileNameW(NULL, buffer, MAX_PATH);
+        
+        // 转换为宽字符串并提取目录部分
+        std::wstring fullPath(buffer);
+        size_t lastSlash = fullPath.find_last_of(L"\\/");
+        std::wstring currentDir = fullPath.substr(0, lastSlash);
+        
+        // 配置文件路径 - 使用配置存储中的默认配置，main.py读取同一文件
+        std::wstring configFilePathW = s2ws(g_config_store.path_of("default_config"));
+
+        // 检查配置文件是否存在
+        DWORD configFileAttrs = GetFileAttributesW(configFilePathW.c_str());
+        if (configFileAttrs == INVALID_FILE_ATTRIBUTES) {
+            log_event(LogLevel::Warn, "train.default_config_missing").str("path", g_config_store.path_of("default_config"));
+        } else {
+            // 输出配置文件路径
+            log_event(LogLevel::Info, "train.config").str("path", g_config_store.path_of("default_config"));
+            
+            // 修改命令为使用配置文件
+            std::wstring configFileArgW = L"--config \"" + configFilePathW + L"\"";
+            system("chcp 65001 > nul");
+            log_event(LogLevel::Debug, "train.cwd").str("path", ws2s(currentDir));
+            // cmdCommand += fullPath.substr(0, lastSlash + 1); // 保留末尾分隔符
+            // cmdCommand += L"llm\\main.py\"";
+            // cmdCommand += L" " + configFileArgW;
+            // 添加输出重定向
+
+            
+            // 执行命令
+            log_event(LogLevel::Debug, "train.command").str("command", ws2s(cmdCommand));
+            metrics_count(COUNTER_SPAWN_TRAIN);
+            int result;
+            {
+                TraceSpan span("train.system");
+                result = _wsystem(cmdCommand.c_str());
+            }
+            log_event(LogLevel::Info, "train.launch").num("exit_code", result);
+            success = (result == 0);
+            
+            // 构建响应
+            std::ostringstream json;
+            json << "{";
+            if (success) {
+                json << "\"success\":true,";
+                json << "\"message\":\"训练任务已成功启动，正在后台运行\",";
+                json << "\"data\":{";
+                json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
+                json << "\"status\":\"running\"";
+                json << "}";
+            } else {
+                json << "\"success\":false,";
+                json << "\"message\":\"启动训练任务失败\",";
+                json << "\"error\":\"" << escape_json(cmd_output) << "\"";
+            }
+            json << "}";
+            return json_response(json.str());
+        }
+#else
+        // Linux下在后台运行，日志与Windows一致写到工作目录下的train_log.txt，/api/train/logs从这里读取。
+        // 参数直接传给execvp，不经过shell；有conda时在elianfactory环境中运行，否则用PATH中的python
+        std::vector<std::string> python_argv = {"python", "./llm/main.py"};
+        python_argv.insert(python_argv.end(), args.begin(), args.end());
+        std::vector<std::string> conda_argv = {"conda", "run", "--no-capture-output", "-n", "elianfactory"};
+        conda_argv.insert(conda_argv.end(), python_argv.begin(), python_argv.end());
+        log_event(LogLevel::Debug, "train.command").str("command", quote_command_args(conda_argv));
+        metrics_count(COUNTER_SPAWN_TRAIN);
+        int spawn_error = 0;
+        {
+            TraceSpan span("train.system");
+            success = spawn_detached({conda_argv, python_argv}, current_dir + "/train_log.txt", spawn_error);
+        }
+        log_event(LogLevel::Info, "train.launch").num("exit_code", success ? 0 : spawn_error);
+        cmd_output = success ? "" : "无法启动训练进程: " + std::string(std::strerror(spawn_error));
+#endif
+        
+        // 构建响应
+        std::ostringstream json;
+        json << "{";
+        if (success) {
+            json << "\"success\":true,";
+            json << "\"message\":\"训练任务已成功启动，正在后台运行。\",";
+            json << "\"data\":{";
+            json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
+            json << "\"status\":\"running\"";
+            json << "}";
+        } else {
+            json << "\"success\":false,";
+            json << "\"message\":\"启动训练任务失败，请您重新尝试。\",";
+            json << "\"error\":\"" << escape_json(cmd_output) << "\"";
+        }
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/train/logs") {
+    std::string log_content;
+    std::string debug_info;  // 用于收集调试信息
+    
+    try {
+        // 获取当前工作目录（改进版本）
+        std::string current_dir;
+#ifdef _WIN32
+        wchar_t wbuffer[MAX_PATH];
+        if (GetCurrentDirectoryW(MAX_PATH, wbuffer)) {
+            char utf8_buffer[MAX_PATH * 4];
+            WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer, sizeof(utf8_buffer), NULL, NULL);
+            current_dir = utf8_buffer;
+            std::replace(current_dir.begin(), current_dir.end(), '\\', '/');
+            debug_info += "Current dir: " + current_dir + "\n";
+        }
+#else
+        char buffer[PATH_MAX];
+        if (getcwd(buffer, sizeof(buffer))) {
+            current_dir = buffer;
+            debug_info += "Current dir: " + current_dir + "\n";
+        }
+#endif
+
+        // 构建日志文件路径（统一使用正斜杠）
+        std::string log_path = current_dir + "/train_log.txt";
+        debug_info += "Log path: " + log_path + "\n";
+
+        // 尝试打开文件（改进的文件打开方式）
+#ifdef _WIN32
+        // Windows下更可靠的文件打开方式
+        std::wstring wlog_path;
+        int size_needed = MultiByteToWideChar(CP_UTF8, 0, log_path.c_str(), -1, NULL, 0);
+        if (size_needed > 0) {
+            wlog_path.resize(size_needed);
+            MultiByteToWideChar(CP_UTF8, 0, log_path.c_str(), -1, &wlog_path[0], size_needed);
+        }
+        
+        FILE* file = _wfopen(wlog_path.c_str(), L"rb");
+#else
+        FILE* file = fopen(log_path.c_str(), "rb");
+#endif
+
+        if (file) {
+            debug_info += "File opened successfully\n";
+            
+            // 获取文件大小
+            fseek(file, 0, SEEK_END);
+            long file_size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            
+            debug_info += "File size: " + std::to_string(file_size) + " bytes\n";
+            
+            if (file_size > 0) {
+                // 读取整个文件内容
+                std::vector<char> buffer(file_size + 1);
+                size_t bytes_read = fread(buffer.data(), 1, file_size, file);
+                if (bytes_read > 0) {
+                    buffer[bytes_read] = '\0';
+                    log_content.assign(buffer.data(), bytes_read);
+                    debug_info += "Read " + std::to_string(bytes_read) + " bytes\n";
+                } else {
+                    debug_info += "Failed to read file content\n";
+                }
+            } else {
+                debug_info += "File is empty\n";
+            }
+            
+            fclose(file);
+        } else {
+            debug_info += "Failed to open file\n";
+#ifdef _WIN32
+            debug_info += "Error code: " + std::to_string(GetLastError()) + "\n";
+#else
+            debug_info += "Error: " + std::string(strerror(errno)) + "\n";
+#endif
+        }
+    } catch (const std::exception& e) {
+        debug_info += "Exception: " + std::string(e.what()) + "\n";
+    }
+
+    // 如果没有读取到内容，返回调试信息（开发阶段）
+    if (log_content.empty()) {
+        log_content = "暂无训练日志或训练尚未开始...\n\n调试信息:\n" + debug_info;
+    }
+
+    // 构建JSON响应
+    std::ostringstream json;
+    json << "{";
+    json << "\"success\":" << (log_content.find("暂无训练日志") == std::string::npos ? "true" : "false") << ",";
+    json << "\"timestamp\":" << std::time(nullptr) << ",";
+    json << "\"logs\":\"" << escape_json(log_content) << "\"";
+    json << "}";
+    
+    return json_response(json.str());
+}
+    
+    // 配置相关API
+    else if (url == "/api/config/save" && method == "POST") {
+        // 请求体: {"config_name":"...","config_data":{...},"expected_etag":"..."}
+        JsonValue body;
+        std::string parse_error;
+        if (!json_parse(extract_post_data(request), body, &parse_error) || !body.is_object()) {
+            return json_response("{\"success\":false,\"message\":\"保存配置失败\",\"error\":\"请求体不是有效的JSON: " + escape_json(parse_error) + "\"}", "400 Bad Request");
+        }
+        const JsonValue* name = body.find("config_name");
+        const JsonValue* data = body.find("config_data");
+        const JsonValue* expected = body.find("expected_etag");
+        if (!data || !data->is_object()) {
+            return json_response("{\"success\":false,\"message\":\"保存配置失败\",\"error\":\"缺少config_data对象\"}", "400 Bad Request");
+        }
+        std::string config_name = (name && name->is_string() && !name->str.empty()) ? name->str : "default_config";
+        config_name = sanitize_config_name(config_name);
+        ValidatedConfig validated = validate_training_config(*data, false);
+        if (!validated.ok()) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"配置校验失败\",";
+            json << "\"error\":\"" << escape_json(config_issues_to_text(validated.issues)) << "\",";
+            json << "\"errors\":";
+            config_issues_to_json(json, validated.issues);
+            json << "}";
+            return json_response(json.str());
+        }
+        // If-Match优先，其次是请求体里的expected_etag
+        std::string expected_etag = get_header(request, "If-Match");
+        if (expected_etag.empty() && expected && expected->is_string()) expected_etag = expected->str;
+
+        ConfigEntry entry;
+        std::string error_msg;
+        ConfigStore::SaveStatus status = g_config_store.save(config_name, *data, expected_etag, entry, error_msg);
+        if (status == ConfigStore::Failed) {
+            log_event(LogLevel::Error, "config.save_failed").str("name", config_name).str("error", error_msg);
+            return json_response("{\"success\":false,\"message\":\"保存配置失败\",\"error\":\"" + escape_json(error_msg) + "\"}", "500 Internal Server Error");
+        }
+        if (status == ConfigStore::Conflict) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"保存配置失败\",\"error\":\"" << escape_json(error_msg) << "\"";
+            if (!entry.etag.empty()) json << ",\"version\":" << entry.version << ",\"etag\":\"" << escape_json(entry.etag) << "\"";
+            json << "}";
+            return json_response(json.str(), "409 Conflict");
+        }
+        log_event(LogLevel::Info, "config.saved").str("name", config_name).num("version", static_cast<long long>(entry.version))
+            .num("changed", status == ConfigStore::Unchanged ? 0 : 1);
+
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true";
+        json << ",\"message\":\"" << (status == ConfigStore::Unchanged ? "配置未变化" : "配置已成功保存") << "\"";
+        json << ",\"name\":\"" << escape_json(config_name) << "\"";
+        json << ",\"version\":" << entry.version;
+        json << ",\"etag\":\"" << escape_json(entry.etag) << "\"";
+        json << ",\"path\":\"" << escape_json(g_config_store.path_of(config_name)) << "\"";
+        json << "}";
+        return json_response(json.str(), "200 OK", "ETag: " + entry.etag + "\r\n");
+    }
+    else if (url == "/api/config/list") {
+        std::vector<ConfigEntry> entries = g_config_store.list();
+
+        // configs保持原来的名称数组，entries附带版本信息
+        std::ostringstream json;
+        json << "{\"success\":true,\"configs\":[";
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0) json << ",";
+            json << "\"" << escape_json(entries[i].name) << "\"";
+        }
+        json << "],\"entries\":[";
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0) json << ",";
+            json << "{\"name\":\"" << escape_json(entries[i].name) << "\"";
+            json << ",\"version\":" << entries[i].version;
+            json << ",\"etag\":\"" << escape_json(entries[i].etag) << "\"";
+            json << ",\"size\":" << entries[i].size;
+            json << ",\"mtime\":" << entries[i].mtime;
+            json << ",\"valid\":" << (entries[i].value ? "true" : "false") << "}";
+        }
+        json << "]}";
+        return json_response(json.str());
+    }
+    else if (starts_with(url, "/api/config/load")) {
+        std::string config_name = get_query_param(url, "name");
+        if (config_name.empty()) {
+            return json_response("{\"success\":false,\"message\":\"缺少配置名称参数\"}");
+        }
+        config_name = sanitize_config_name(config_name);
+        std::string version_param = get_query_param(url, "version");
+        unsigned long long version = version_param.empty() ? 0 : std::strtoull(version_param.c_str(), nullptr, 10);
+
+        ConfigEntry entry;
+        if (!g_config_store.get(config_name, version, entry)) {
+            return json_response("{\"success\":false,\"message\":\"配置文件不存在或无法读取\"}");
+        }
+        std::string etag_header = "ETag: " + entry.etag + "\r\n";
+        if (get_header(request, "If-None-Match") == entry.etag) {
+            return json_response("", "304 Not Modified", etag_header);
+        }
+        if (!entry.value) {
+            return json_response("{\"success\":false,\"message\":\"配置文件不存在或无法读取\",\"error\":\"配置文件不是有效的JSON\"}");
+        }
+
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true";
+        json << ",\"name\":\"" << escape_json(entry.name) << "\"";
+        json << ",\"version\":" << entry.version;
+        json << ",\"etag\":\"" << escape_json(entry.etag) << "\"";
+        json << ",\"config\":" << entry.content;
+        json << "}";
+        return json_response(json.str(), "200 OK", etag_header);
+    }
+    else if (starts_with(url, "/api/config/versions")) {
+        std::string config_name = sanitize_config_name(get_query_param(url, "name"));
+        if (config_name.empty()) {
+            return json_response("{\"success\":false,\"message\":\"缺少配置名称参数\"}");
+        }
+        ConfigEntry current;
+        bool exists = g_config_store.get(config_name, 0, current);
+        std::vector<unsigned long long> versions = g_config_store.versions(config_name);
+
+        std::ostringstream json;
+        json << "{\"success\":true,\"name\":\"" << escape_json(config_name) << "\"";
+        json << ",\"current\":" << (exists ? current.version : 0);
+        json << ",\"versions\":[";
+        for (size_t i = 0; i < versions.size(); ++i) {
+            if (i > 0) json << ",";
+            json << versions[i];
+        }
+        json << "]}";
+        return json_response(json.str());
+    }
+    // GET /api/debug/traces?limit=  导出最近的追踪区间（Chrome trace-event格式）
+    else if (starts_with(url, "/api/debug/traces")) {
+        size_t limit = TRACE_RING_SIZE;
+        std::string limit_param = get_query_param(url, "limit");
+        if (!limit_param.empty()) {
+            limit = static_cast<size_t>(std::max(1L, std::strtol(limit_param.c_str(), nullptr, 10)));
+        }
+        return json_response(traces_to_json(limit));
+    }
+    else if (starts_with(url, "/api/config/delete") && method == "DELETE") {
+        std::string config_name = get_query_param(url, "name");
+        if (config_name.empty()) {
+            return json_response("{\"success\":false,\"message\":\"缺少配置名称参数\"}");
+        }
+        config_name = sanitize_config_name(config_name);
+
+        std::string error_msg;
+        bool success = g_config_store.remove(config_name, error_msg);
+
+        // 返回结果
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":" << (success ? "true" : "false");
+        if (success) {
+            json << ",\"message\":\"配置已成功删除\"";
+        } else {
+            json << ",\"message\":\"删除配置失败\"";
+            json << ",\"error\":\"" << escape_json(error_msg) << "\"";
+        }
+        json << "}";
+        return json_response(json.str());
+    }
+    else if (url == "/api/inference" && method == "POST") {
+        // 读取POST数据体
+        std::string request_body = extract_post_data(request);
+        // 提示词只在debug级别输出
+        log_event(LogLevel::Info, "inference.request").num("bytes", static_cast<long long>(request_body.size()));
+        log_event(LogLevel::Debug, "inference.request.body").str("body", request_body);
+        
+        // 解析JSON配置
+        std::map<std::string, std::string> inferenceData = parse_json(request_body);
+        
+        // 获取参数
+        std::string model_path = inferenceData["model_path"];
+        std::string prompt = inferenceData["prompt"];
+        std::string max_new_tokens = inferenceData["max_new_tokens"];
+        
+        // 参数验证
+        if (model_path.empty() || prompt.empty()) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"缺少必要参数\"}";
+            return json_response(json.str());
+        }
+        
+        // 如果max_new_tokens为空，设置默认值
+        if (max_new_tokens.empty()) {
+            max_new_tokens = "2048";
+        }
+        
+        // 获取当前工作目录
+        std::string current_dir;
+#ifdef _WIN32
+        wchar_t wbuffer[MAX_PATH];
+        GetCurrentDirectoryW(MAX_PATH, wbuffer);
+        
+        // 将宽字符转换为UTF-8编码的字符串
+        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
+        std::vector<char> utf8_buffer(size_needed);
+        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
+        
+        current_dir = std::string(utf8_buffer.data());
+        
+        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
+        for (char &c : current_dir) {
+            if (c == '\\') c = '/';
+        }
+#else
+        char buffer[PATH_MAX];
+        if (getcwd(buffer, PATH_MAX) != NULL) {
+            current_dir = buffer;
+        } else {
+            current_dir = ".";
+        }
+#endif
+
+        // 处理模型路径：如果是相对路径，添加基础目录
+        if (model_path.size() > 0 && model_path[0] == '.') {
+            model_path = current_dir + "/llm" + model_path.substr(1);
+        } else if (model_path.size() > 0 && model_path[0] == '/') {
+            model_path = current_dir + "/llm" + model_path;
+        } else if (model_path.size() > 0 && model_path[0] != '/' && model_path[1] != ':') {
+            model_path = current_dir + "/llm/" + model_path;
+        }
+        
+        // 转义引号和反斜杠，以便在命令行中使用
+        std::string escaped_prompt = prompt;
+        for (size_t i = 0; i < escaped_prompt.length(); ++i) {
+            if (escaped_prompt[i] == '"') {
+                escaped_prompt.replace(i, 1, "\\\"");
+                ++i;
+            } else if (escaped_prompt[i] == '\\') {
+                escaped_prompt.replace(i, 1, "\\\\");
+                ++i;
+            }
+        }
+        
+        // 推理结果通过标准输出返回，标记行之后的内容即为模型回复
+        const std::string result_marker = "<<<ELIAN_RESULT>>>";
+        std::string emit_result = "sys.stdout.write('\\n" + result_marker + "\\n' + result); sys.stdout.flush()";
+
+        // 构建Python命令（在后台线程中通过管道执行）
+        std::string cmd;
+#ifdef _WIN32
+        std::replace(model_path.begin(), model_path.end(), '/', '\\');
+        
+        cmd = "conda activate elianfactory && "
+              "set PYTHONIOENCODING=utf-8 && "
+              "chcp 65001 > nul && "
+              "python -c \"import sys; sys.path.append('" + current_dir + "\\\\llm'); "
+              "from inference import model_reasoning; "
+              "result = model_reasoning('" + model_path + "', '" + escaped_prompt + "', " + max_new_tokens + "); "
+              + emit_result + "\" 2>&1";
+#else
+        cmd = "conda activate elianfactory && "
+              "python -c \"import sys; sys.path.append('" + current_dir + "/llm'); "
+              "from inference import model_reasoning; "
+              "result = model_reasoning('" + model_path + "', '" + escaped_prompt + "', " + max_new_tokens + "); "
+              + emit_result + "\" 2>&1";
+#endif
+        
+        std::string task_id = g_task_registry.create("inference");
+        log_event(LogLevel::Info, "inference.submitted").str("task_id", task_id);
+        log_event(LogLevel::Debug, "inference.command").str("task_id", task_id).str("command", cmd);
+        run_task_command(task_id, cmd, result_marker);
+        
+        // 构建轮询响应（output_file保留给旧版前端，取值与task_id相同）
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+        json << "\"message\":\"推理请求已提交\",";
+        json << "\"task_id\":\"" << escape_json(task_id) << "\",";
+        json << "\"output_file\":\"" << escape_json(task_id) << "\"";
+        json << "}";
+        
+        return json_response(json.str());
+    }
+    else if (url == "/api/ollama/deploy" && method == "POST") {
+        // 读取POST数据体
+        std::string request_body = extract_post_data(request);
+        log_event(LogLevel::Info, "ollama.request").num("bytes", static_cast<long long>(request_body.size()));
+        log_event(LogLevel::Debug, "ollama.request.body").str("body", request_body);
+        
+        // 解析JSON配置
+        std::map<std::string, std::string> deployData = parse_json(request_body);
+        
+        // 获取参数
+        std::string model_path = deployData["model_path"];
+        std::string model_name = deployData["model_name"];
+        
+        // 参数验证
+        if (model_path.empty() || model_name.empty()) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"缺少必要参数\"}";
+            return json_response(json.str());
+        }
+        
+        // 验证模型名称格式
+        std::regex model_name_regex("^[a-zA-Z0-9_-]+$");
+        if (!std::regex_match(model_name, model_name_regex)) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"模型名称只能包含字母、数字、连字符和下划线\"}";
+            return json_response(json.str());
+        }
+        
+        // 获取当前工作目录
+        std::string current_dir;
+#ifdef _WIN32
+        wchar_t wbuffer[MAX_PATH];
+        GetCurrentDirectoryW(MAX_PATH, wbuffer);
+        
+        // 将宽字符转换为UTF-8编码的字符串
+        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
+        std::vector<char> utf8_buffer(size_needed);
+        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
+        
+        current_dir = std::string(utf8_buffer.data());
+        
+        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
+        for (char &c : current_dir) {
+            if (c == '\\') c = '/';
+        }
+#else
+        char buffer[PATH_MAX];
+        if (getcwd(buffer, PATH_MAX) != NULL) {
+            current_dir = buffer;
+        } else {
+            current_dir = ".";
+        }
+#endif
+
+        // 处理模型路径：如果是相对路径，添加基础目录
+        if (model_path.size() > 0 && model_path[0] == '.') {
+            model_path = current_dir + "/llm" + model_path.substr(1);
+        } else if (model_path.size() > 0 && model_path[0] == '/') {
+            model_path = current_dir + "/llm" + model_path;
+        } else if (model_path.size() > 0 && model_path[0] != '/' && model_path[1] != ':') {
+            model_path = current_dir + "/llm/" + model_path;
+        }
+        
+        // 检查模型路径是否存在
+        if (!file_exists(model_path)) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"模型路径不存在: " << escape_json(model_path) << "\"}";
+            return json_response(json.str());
+        }
+        
+        // 创建Modelfile
+        std::string modelfile_path = model_path + "/Modelfile";
+        // 定义Modelfile内容
+        std::string modelfile_content = "# ollama modelfile auto-generated by llamafactory\n\n"
+                                       "FROM .\n\n"
+                                       "TEMPLATE \"\"\"<|begin_of_sentence|>{{ if .System }}{{ .System }}{{ end }}{{ range .Messages }}{{ if eq .Role \"user\" }}<|User|>{{ .Content }}<|Assistant|>{{ else if eq .Role \"assistant\" }}{{ .Content }}<|end_of_sentence|>{{ end }}{{ end }}\"\"\"\n\n"
+                                       "PARAMETER stop \"<|end_of_sentence|>\"\n"
+                                       "PARAMETER num_ctx 4096";
+        
+        try {
+            // 创建Modelfile
+            std::ofstream modelfile(modelfile_path);
+            if (!modelfile.is_open()) {
+                std::ostringstream json;
+                json << "{\"success\":false,\"message\":\"无法创建Modelfile: " << escape_json(modelfile_path) << "\"}";
+                return json_response(json.str());
+            }
+            
+            modelfile << modelfile_content;
+            modelfile.close();
+            
+            // 构建Ollama命令（在后台线程中通过管道执行，输出直接进入任务注册表）
+            std::string cmd;
+#ifdef _WIN32
+            std::string windows_model_path = model_path;
+            std::replace(windows_model_path.begin(), windows_model_path.end(), '/', '\\');
+            
+            cmd = "cd /d \"" + windows_model_path + "\" && "
+                  "ollama create " + model_name + " -f ./Modelfile 2>&1";
+#else
+            cmd = "cd \"" + model_path + "\" && "
+                  "ollama create " + model_name + " -f ./Modelfile 2>&1";
+#endif
+            
+            std::string task_id = g_task_registry.create("ollama");
+            log_event(LogLevel::Info, "ollama.submitted").str("task_id", task_id).str("model", model_name);
+            log_event(LogLevel::Debug, "ollama.command").str("task_id", task_id).str("command", cmd);
+            run_task_command(task_id, cmd, "");
+            
+            // 返回成功响应
+            std::ostringstream json;
+            json << "{";
+            json << "\"success\":true,";
+            json << "\"message\":\"Ollama部署任务已提交\",";
+            json << "\"task_id\":\"" << task_id << "\"";
+            json << "}";
+            
+            return json_response(json.str());
+            
+        } catch (const std::exception& e) {
+            std::ostringstream json;
+            json << "{\"success\":false,\"message\":\"创建Modelfile时出错: " << escape_json(e.what()) << "\"}";
+            return json_response(json.str());
+        }
+    }
+    
+    // 其他API返回404
+    std::ostringstream json;
+    json << "{\"success\": false, \"message\": \"API端点不存在\", \"error\": \"not_found\"}";
+    std::ostringstream response;
+    response << "HTTP/1.1 404 Not Found\r\n";
+    response << "Content-Type: application/json\r\n";
+    response << "Content-Length: " << json.str().length() << "\r\n";
+    response << "Access-Control-Allow-Origin: *\r\n";
+    response << "\r\n";
+    response << json.str();
+    return response.str();
+}
+
+// 简单的HTTP响应处理
+std::string handle_request(const std::string& request) {
+    // 解析HTTP请求的第一行来获取URL和方法
+    std::istringstream req_stream(request);
+    std::string method, url, version;
+    req_stream >> method >> url >> version;
+
+    
+    // 处理API请求
+    if (starts_with(url, API_PREFIX)) {
+        const CachedRoute* cached = find_cached_route(method, url);
+        if (cached) {
+            std::string key = response_cache_key(url, *cached);
+            return g_response_cache.get(key, cached->ttl, [&] { return handle_api_request(key, request, method); });
+        }
+        return handle_api_request(url, request, method);
+    }
+
+    // Prometheus抓取
+    if (url == "/metrics") {
+        return metrics_response();
+    }
+    
+    if (url == "/") {
+        url = "/index.html";
+        // std::cout << "重定向到: " << url << std::endl;
+    }
+    
+    // 读取请求的文件
+    std::string file_path = WEB_DIR + url;
+    // std::cout << "尝试读取文件: " << file_path << std::endl;
+    
+    std::ifstream file(file_path, std::ios::binary);
+    
+    if (!file) {
+        log_event(LogLevel::Warn, "static.not_found").str("path", file_path);
+        
+        // 检查文件系统，查看web目录下有哪些文件
+        if (log_enabled(LogLevel::Debug)) {
+            std::string listing;
+            for (const auto& f : list_files_in_directory(WEB_DIR, "")) {
+                if (!listing.empty()) listing += ", ";
+                listing += f;
+            }
+            log_event(LogLevel::Debug, "static.web_dir").str("files", listing);
+        }
+        
+        // 文件不存在，返回404错误
+        return "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\n\r\n<html><body><h1>404 Not Found</h1><p>The requested resource was not found on this server.</p><p>Requested: " + url + "</p></body></html>";
+    }
+    
+    // 读取文件内容
+    std::ostringstream content_stream;
+    content_stream << file.rdbuf();
+    std::string content = content_stream.str();
+    // std::cout << "文件读取成功，大小: " << content.length() << " 字节" << std::endl;
+    
+    // 确定内容类型
+    std::string content_type = "text/plain";
+    if (ends_with(url, ".html") || ends_with(url, ".htm")) {
+        content_type = "text/html";
+    } else if (ends_with(url, ".css")) {
+        content_type = "text/css";
+    } else if (ends_with(url, ".js")) {
+        content_type = "application/javascript";
+    } else if (ends_with(url, ".json")) {
+        content_type = "application/json";
+    } else if (ends_with(url, ".png")) {
+        content_type = "image/png";
+    } else if (ends_with(url, ".jpg") || ends_with(url, ".jpeg")) {
+        content_type = "image/jpeg";
+    }
+    
+    // 构建HTTP响应
+    std::ostringstream response;
+    response << "HTTP/1.1 200 OK\r\n";
+    response << "Content-Type: " << content_type << "\r\n";
+    response << "Content-Length: " << content.length() << "\r\n";
+    response << "\r\n";
+    response << content;
+    
+    return response.str();
+}
+
+// ==================== 网络I/O ====================
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+#else
+typedef int socket_t;
+#endif
+
+const size_t MAX_HEADER_SIZE = 64 * 1024;          // 请求头上限
+const size_t MAX_BODY_SIZE = 16 * 1024 * 1024;     // 普通请求体上限，上传接口不受此限制
+const size_t UPLOAD_CHUNK_SIZE = 1024 * 1024;      // 上传时每次读写磁盘的块大小
+const size_t MAX_UPLOAD_LINE = 64 * 1024 * 1024;   // 上传校验时单条记录的长度上限
+const int SOCKET_TIMEOUT_SECONDS = 30;
+
+// 读取数据，返回读取的字节数，连接关闭返回0，出错返回-1
+long sock_recv(socket_t sock, char* buffer, size_t length) {
+#ifdef _WIN32
+    metrics_count(COUNTER_SOCKET_SYSCALLS);
+    int n = recv(sock, buffer, static_cast<int>(std::min<size_t>(length, 1 << 30)), 0);
+    return n == SOCKET_ERROR ? -1 : n;
+#else
+    while (true) {
+        metrics_count(COUNTER_SOCKET_SYSCALLS);
+        ssize_t n = recv(sock, buffer, length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        return static_cast<long>(n);
+    }
+#endif
+}
+
+// 循环发送直到全部写完（send可能只写出一部分）
+bool send_all(socket_t sock, const char* data, size_t length) {
+    while (length > 0) {
+        metrics_count(COUNTER_SOCKET_SYSCALLS);
+#ifdef _WIN32
+        int n = send(sock, data, static_cast<int>(std::min<size_t>(length, 1 << 30)), 0);
+        if (n == SOCKET_ERROR) return false;
+#else
+        ssize_t n = send(sock, data, length, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+#endif
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void close_socket(socket_t sock) {
+    metrics_count(COUNTER_SOCKET_SYSCALLS);
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+}
+
+void set_socket_timeout(socket_t sock, int seconds) {
+    metrics_count(COUNTER_SOCKET_SYSCALLS, 2);
+#ifdef _WIN32
+    DWORD timeout = static_cast<DWORD>(seconds * 1000);
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#else
+    struct timeval timeout;
+    timeout.tv_sec = seconds;
+    timeout.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#endif
+}
+
+// 请求行和请求头
+struct HttpRequestHead {
+    std::string_view method;
+    std::string_view url;
+    std::string_view head;          // 原始请求头，包含结尾的空行
+    size_t content_length;
+    std::string_view body_prefix;   // 读请求头时顺带读到的请求体开头部分
+};
+
+// 解析data中已经完整的请求头（header_end为空行的位置），req中的各字段指向data
+bool parse_request_head(std::string_view data, size_t header_end, HttpRequestHead& req) {
+    req.head = data.substr(0, header_end + 4);
+    req.body_prefix = data.substr(header_end + 4);
+
+    // 请求行: 方法 URL 版本
+    std::string_view line = req.head.substr(0, req.head.find("\r\n"));
+    size_t method_end = line.find(' ');
+    if (method_end == std::string::npos) return false;
+    size_t url_start = line.find_first_not_of(' ', method_end);
+    if (url_start == std::string::npos) return false;
+    size_t url_end = line.find(' ', url_start);
+    req.method = line.substr(0, method_end);
+    req.url = line.substr(url_start, url_end == std::string::npos ? std::string::npos : url_end - url_start);
+
+    req.content_length = 0;
+    std::string length_header = get_header(req.head, "Content-Length");
+    if (!length_header.empty()) {
+        try {
+            req.content_length = static_cast<size_t>(std::stoull(length_header));
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 读取请求头（直到空行），失败返回false。数据放在当前线程的请求内存池中，
+// req中的各字段在内存池复位前有效
+bool read_request_head(socket_t sock, HttpRequestHead& req) {
+    const size_t capacity = MAX_HEADER_SIZE + 16 * 1024;
+    char* data = static_cast<char*>(request_arena().allocate(capacity, 1));
+    size_t length = 0;
+    size_t header_end = std::string::npos;
+
+    while (header_end == std::string::npos) {
+        if (length == capacity) return false;
+        long n = sock_recv(sock, data + length, capacity - length);
+        if (n <= 0) return false;
+        size_t search_from = length >= 3 ? length - 3 : 0;
+        length += static_cast<size_t>(n);
+        header_end = std::string_view(data, length).find("\r\n\r\n", search_from);
+        if (header_end == std::string::npos && length > MAX_HEADER_SIZE) return false;
+    }
+
+    return parse_request_head(std::string_view(data, length), header_end, req);
+}
+
+// 读取剩余请求体，拼成完整请求文本交给handle_request
+bool read_request_body(socket_t sock, HttpRequestHead& req, std::string& request) {
+    request = req.head;
+    request += req.body_prefix;
+    size_t body_read = req.body_prefix.length();
+    request.reserve(req.head.length() + req.content_length);
+
+    char buffer[16384];
+    while (body_read < req.content_length) {
+        long n = sock_recv(sock, buffer, std::min(sizeof(buffer), req.content_length - body_read));
+        if (n <= 0) return false;
+        request.append(buffer, static_cast<size_t>(n));
+        body_read += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// ==================== 响应压缩 ====================
+// 客户端带Accept-Encoding: gzip时压缩较大的JSON/文本响应（训练日志、数据预览等重复内容很多）。
+// 每个线程复用一个deflate状态，每次响应只做deflateReset；压缩结果放在请求内存池中。
+// 编译时没有找到zlib（未定义ELIAN_HAVE_ZLIB）则原样发送。
+
+const size_t GZIP_MIN_SIZE = 1024;   // 小于该大小的响应体不压缩
+const int GZIP_LEVEL = 6;
+
+// Accept-Encoding中包含gzip且q不为0
+bool accepts_gzip(std::string_view head) {
+#ifdef ELIAN_HAVE_ZLIB
+    std::string_view value = get_header_view(head, "Accept-Encoding");
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t end = value.find(',', pos);
+        if (end == std::string_view::npos) end = value.size();
+        std::string_view item = value.substr(pos, end - pos);
+        pos = end + 1;
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        std::string_view coding = item.substr(0, item.find(';'));
+        while (!coding.empty() && coding.back() == ' ') coding.remove_suffix(1);
+        if (coding != "gzip" && coding != "*") continue;
+        // q=0表示明确拒绝，其余q值都接受
+        size_t q = item.find("q=");
+        if (q == std::string_view::npos) return true;
+        std::string_view weight = item.substr(q + 2);
+        return weight.find_first_not_of("0. ") != std::string_view::npos;
+    }
+#else
+    (void)head;
+#endif
+    return false;
+}
+
+#ifdef ELIAN_HAVE_ZLIB
+class GzipCompressor {
+public:
+    GzipCompressor() {
+        std::memset(&stream, 0, sizeof(stream));
+        ready = deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~GzipCompressor() {
+        if (ready) deflateEnd(&stream);
+    }
+
+    bool reset() {
+        return ready && deflateReset(&stream) == Z_OK;
+    }
+
+    // 压缩input，输出交给sink(const char*, size_t)；finish为true时写出gzip尾部
+    template <typename Sink>
+    bool write(std::string_view input, bool finish, Sink&& sink) {
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream.avail_in = static_cast<uInt>(input.size());
+        while (true) {
+            stream.next_out = reinterpret_cast<Bytef*>(output);
+            stream.avail_out = sizeof(output);
+            int status = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (status == Z_STREAM_ERROR) return false;
+            size_t produced = sizeof(output) - stream.avail_out;
+            if (produced > 0) sink(output, produced);
+            if (finish ? status == Z_STREAM_END : stream.avail_in == 0 && stream.avail_out != 0) return true;
+        }
+    }
+
+    uLong bound(size_t size) {
+        return deflateBound(&stream, static_cast<uLong>(size));
+    }
+
+private:
+    z_stream stream;
+    bool ready = false;
+    char output[16 * 1024];
+};
+
+GzipCompressor& gzip_compressor() {
+    thread_local GzipCompressor compressor;
+    return compressor;
+}
+#endif
+
+// 压缩一个完整的HTTP响应，不需要压缩时原样返回；返回的响应在请求内存池复位前有效
+std::string_view gzip_response(std::string_view response) {
+#ifdef ELIAN_HAVE_ZLIB
+    size_t header_end = response.find("\r\n\r\n");
+    if (header_end == std::string_view::npos || response.size() - header_end - 4 < GZIP_MIN_SIZE) return response;
+    std::string_view head = response.substr(0, header_end + 2);
+    std::string_view body = response.substr(header_end + 4);
+    if (!starts_with(head, "HTTP/1.1 200") && !starts_with(head, "HTTP/1.1 4")) return response;
+    std::string_view content_type = get_header_view(head, "Content-Type");
+    if (!starts_with(content_type, "application/json") && !starts_with(content_type, "text/")) return response;
+    if (!get_header_view(head, "Content-Encoding").empty()) return response;
+
+    GzipCompressor& compressor = gzip_compressor();
+    if (!compressor.reset()) return response;
+    size_t capacity = head.size() + 96 + compressor.bound(body.size());
+    char* data = static_cast<char*>(request_arena().allocate(capacity, 1));
+    // 先留出响应头的位置，压缩完成后再回填Content-Length
+    size_t body_offset = head.size() + 96;
+    size_t body_size = 0;
+    bool overflow = false;
+    bool ok = compressor.write(body, true, [&](const char* bytes, size_t n) {
+        if (body_offset + body_size + n > capacity) {
+            overflow = true;
+            return;
+        }
+        std::memcpy(data + body_offset + body_size, bytes, n);
+        body_size += n;
+    });
+    if (!ok || overflow || body_size >= body.size()) return response;
+
+    // 去掉原来的Content-Length，加上压缩后的长度和编码
+    std::string_view rest = head;
+    size_t out = 0;
+    char* rebuilt = static_cast<char*>(request_arena().allocate(head.size() + 96, 1));
+    while (!rest.empty()) {
+        size_t line_end = rest.find("\r\n");
+        std::string_view line = rest.substr(0, line_end + 2);
+        rest.remove_prefix(line.size());
+        if (starts_with(line, "Content-Length:")) continue;
+        std::memcpy(rebuilt + out, line.data(), line.size());
+        out += line.size();
+    }
+    int extra = snprintf(rebuilt + out, 96, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\nContent-Length: %zu\r\n\r\n", body_size);
+    out += static_cast<size_t>(extra);
+    // 响应头紧贴在压缩数据之前
+    char* start = data + body_offset - out;
+    std::memcpy(start, rebuilt, out);
+    return std::string_view(start, out + body_size);
+#else
+    return response;
+#endif
+}
+
+// ==================== 分块响应 ====================
+// 训练日志、数据预览和较大的推理结果以Transfer-Encoding: chunked发送：按固定大小的分片读取、转义并发出，
+// 每个请求占用的内存与分片大小相关，而与train_log.txt等文件的大小无关。
+// 只有HTTP/1.1的GET请求走这条路径，其余情况（以及文件不存在等错误）仍由handle_api_request处理。
+
+const size_t CHUNK_SIZE = 16 * 1024;
+
+// 写入JSON响应头；etag非空时用ETag和Cache-Control: no-cache代替禁止缓存的几行
+template <typename Out>
+void append_json_headers(Out& out, std::string_view etag) {
+    std::string_view rest = JSON_RESPONSE_HEADERS;
+    while (!rest.empty()) {
+        std::string_view line = rest.substr(0, rest.find("\r\n") + 2);
+        rest.remove_prefix(line.size());
+        if (!etag.empty() && (starts_with(line, "Cache-Control:") || starts_with(line, "Pragma:") || starts_with(line, "Expires:"))) continue;
+        out.append(line.data(), line.size());
+    }
+    if (!etag.empty()) {
+        out.append("Cache-Control: no-cache\r\nAccess-Control-Expose-Headers: ETag\r\nETag: ");
+        out.append(etag.data(), etag.size());
+        out.append("\r\n");
+    }
+}
+
+// gzip为true时响应体先经过线程内的deflate状态压缩，再按分块发送
+class ChunkedWriter {
+public:
+    explicit ChunkedWriter(socket_t sock, bool gzip = false) : sock(sock), gzip(gzip) {}
+
+    // etag非空时带上ETag，并把禁止缓存改为每次重新验证，浏览器会自动带If-None-Match
+    bool begin(std::string_view status = "200 OK", std::string_view etag = std::string_view()) {
+#ifdef ELIAN_HAVE_ZLIB
+        if (gzip) gzip = gzip_compressor().reset();
+#else
+        gzip = false;
+#endif
+        std::string head;
+        head.reserve(128 + JSON_RESPONSE_HEADERS.size());
+        head.append("HTTP/1.1 ").append(status.data(), status.size()).append("\r\n");
+        head.append("Transfer-Encoding: chunked\r\n");
+        if (gzip) head.append("Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n");
+        append_json_headers(head, etag);
+        head.append("\r\n");
+        return write_raw(head.data(), head.size());
+    }
+
+    void append(const char* s, size_t n) {
+        while (n > 0 && !failed) {
+            size_t room = CHUNK_SIZE - size;
+            size_t take = std::min(room, n);
+            std::memcpy(buffer + CHUNK_PREFIX + size, s, take);
+            size += take;
+            s += take;
+            n -= take;
+            if (size == CHUNK_SIZE) flush_chunk();
+        }
+    }
+
+    void append(const char* s) { append(s, std::strlen(s)); }
+
+    // 发出剩余数据和结束块
+    bool finish() {
+        flush_chunk(true);
+        return write_raw("0\r\n\r\n", 5);
+    }
+
+    size_t bytes_sent() const { return sent; }
+    bool ok() const { return !failed; }
+
+private:
+    // 分块头写在数据前预留的位置，分块尾紧跟数据，整个分块一次发送（send_all会重试部分写入）
+    static const size_t CHUNK_PREFIX = 10;
+
+    void flush_chunk(bool last = false) {
+        if (failed) return;
+#ifdef ELIAN_HAVE_ZLIB
+        if (gzip) {
+            bool ok = gzip_compressor().write(std::string_view(buffer + CHUNK_PREFIX, size), last, [this](const char* bytes, size_t n) {
+                std::memcpy(packet + CHUNK_PREFIX, bytes, n);
+                send_chunk(packet, n);
+            });
+            if (!ok) failed = true;
+            size = 0;
+            return;
+        }
+#endif
+        (void)last;
+        send_chunk(buffer, size);
+        size = 0;
+    }
+
+    // data的前CHUNK_PREFIX字节留给分块头，其后是n字节数据和2字节分块尾的位置
+    void send_chunk(char* data, size_t n) {
+        if (n == 0) return;
+        char header[CHUNK_PREFIX];
+        int header_size = snprintf(header, sizeof(header), "%zx\r\n", n);
+        char* start = data + CHUNK_PREFIX - header_size;
+        std::memcpy(start, header, static_cast<size_t>(header_size));
+        data[CHUNK_PREFIX + n] = '\r';
+        data[CHUNK_PREFIX + n + 1] = '\n';
+        write_raw(start, static_cast<size_t>(header_size) + n + 2);
+    }
+
+    bool write_raw(const char* data, size_t length) {
+        if (failed) return false;
+        if (!send_all(sock, data, length)) {
+            failed = true;
+            return false;
+        }
+        sent += length;
+        return true;
+    }
+
+    socket_t sock;
+    bool gzip;
+    char buffer[CHUNK_PREFIX + CHUNK_SIZE + 2];
+#ifdef ELIAN_HAVE_ZLIB
+    char packet[CHUNK_PREFIX + CHUNK_SIZE + 2];   // 压缩后的分块
+#endif
+    size_t size = 0;
+    size_t sent = 0;
+    bool failed = false;
+};
+
+// 请求行以HTTP/1.1结尾时客户端才能接收分块编码
+bool accepts_chunked(const HttpRequestHead& req) {
+    std::string_view line = req.head.substr(0, req.head.find("\r\n"));
+    return ends_with(line, "HTTP/1.1");
+}
+
+// GET /api/train/logs：文件为空或不存在时返回false，由原有逻辑返回提示信息
+size_t stream_train_logs(socket_t client, bool gzip, std::string_view etag) {
+    FILE* file = open_file_utf8(get_current_dir() + "/train_log.txt", "rb");
+    if (!file) return 0;
+    char slice[CHUNK_SIZE];
+    size_t n = fread(slice, 1, sizeof(slice), file);
+    if (n == 0) {
+        fclose(file);
+        return 0;
+    }
+    ChunkedWriter out(client, gzip);
+    out.begin("200 OK", etag);
+    out.append("{\"success\":true,\"timestamp\":");
+    append_integer(out, static_cast<long long>(std::time(nullptr)));
+    out.append(",\"logs\":\"");
+    // 转义逐字节进行，UTF-8多字节字符被分片切开也不影响结果
+    while (n > 0 && out.ok()) {
+        append_json_escaped(out, std::string_view(slice, n));
+        n = fread(slice, 1, sizeof(slice), file);
+    }
+    fclose(file);
+    out.append("\"}");
+    out.finish();
+    return std::max<size_t>(out.bytes_sent(), 1);
+}
+
+// GET /api/data/preview?file=&offset=&limit=：直接从内存映射的数据文件中转义发送
+size_t stream_data_preview(socket_t client, std::string_view url, bool gzip) {
+    std::string filename = get_query_param(url, "file");
+    if (filename.empty() || filename.find("..") != std::string::npos) return 0;
+    char* end = nullptr;
+    long long offset = 0;
+    long long limit = 20;
+    std::string offset_param = get_query_param(url, "offset");
+    std::string limit_param = get_query_param(url, "limit");
+    if (!offset_param.empty()) {
+        offset = std::strtoll(offset_param.c_str(), &end, 10);
+        if (*end != '\0') return 0;
+    }
+    if (!limit_param.empty()) {
+        limit = std::strtoll(limit_param.c_str(), &end, 10);
+        if (*end != '\0') return 0;
+    }
+    offset = std::max(0LL, offset);
+    limit = std::min(1000LL, std::max(1LL, limit));
+
+    std::shared_ptr<const DatasetIndex> index = g_dataset_indexes.get(get_current_dir() + "/llm/data/" + filename);
+    if (!index) return 0;
+    size_t total = index->record_count();
+    size_t begin = std::min(static_cast<size_t>(offset), total);
+    size_t finish = std::min(begin + static_cast<size_t>(limit), total);
+
+    ChunkedWriter out(client, gzip);
+    out.begin();
+    out.append("{\"success\":true,\"total\":");
+    append_integer(out, static_cast<long long>(total));
+    out.append(",\"offset\":");
+    append_integer(out, static_cast<long long>(begin));
+    out.append(",\"limit\":");
+    append_integer(out, limit);
+    out.append(",\"content\":\"");
+    for (size_t i = begin; i < finish && out.ok(); ++i) {
+        append_json_escaped(out, index->record_view(i));
+        out.append("\\n");
+    }
+    out.append("\"}");
+    out.finish();
+    return std::max<size_t>(out.bytes_sent(), 1);
+}
+
+// GET /api/inference/result?task_id=：只有已完成且结果超过一个分片时才流式发送，
+// 结果在任务表的锁内复制一份，发送时不持有锁
+size_t stream_inference_result(socket_t client, std::string_view url, bool gzip) {
+    const std::string* task_id = &task_id_param(url, "task_id");
+    if (task_id->empty()) task_id = &task_id_param(url, "file");
+    if (task_id->empty()) return 0;
+    std::string result;
+    g_task_registry.visit(*task_id, [&result](const AsyncTask& task) {
+        if (task.state == TaskState::Completed && task.result.size() > CHUNK_SIZE) result = task.result;
+    });
+    if (result.empty()) return 0;
+
+    ChunkedWriter out(client, gzip);
+    out.begin();
+    out.append("{\"success\":true,\"status\":\"completed\",\"result\":\"");
+    for (size_t pos = 0; pos < result.size() && out.ok(); pos += CHUNK_SIZE) {
+        append_json_escaped(out, std::string_view(result).substr(pos, CHUNK_SIZE));
+    }
+    out.append("\"}");
+    out.finish();
+    return std::max<size_t>(out.bytes_sent(), 1);
+}
+
+// 可以流式发送的端点，已处理时返回发送的字节数，否则返回0。训练日志支持条件请求，由serve_conditional处理
+size_t stream_api_request(socket_t client, const HttpRequestHead& req) {
+    if (req.method != "GET" || !starts_with(req.url, "/api/")) return 0;
+    if (starts_with(req.url, "/api/data/preview?")) {
+        return accepts_chunked(req) ? stream_data_preview(client, req.url, accepts_gzip(req.head)) : 0;
+    }
+    if (starts_with(req.url, "/api/inference/result?")) {
+        return accepts_chunked(req) ? stream_inference_result(client, req.url, accepts_gzip(req.head)) : 0;
+    }
+    return 0;
+}
+
+// ==================== 条件请求与长轮询 ====================
+// 前端轮询的状态端点带弱ETag，If-None-Match相同时返回304，不必重复传输和解析。
+// 带wait=秒数且If-None-Match与当前内容相同时请求被挂起，直到状态版本变化或超时；
+// 挂起的请求交给单独的等待线程，不占用顺序处理连接的主循环。
+
+const long LONG_POLL_MAX_SECONDS = 60;
+const size_t LONG_POLL_MAX_PARKED = 256;
+
+struct ConditionalRoute {
+    std::string_view path;      // 与请求路径（不含查询参数）完全相等
+    StateTopic topic;
+    int poll_ms;                // 没有变化通知的状态按此间隔重新计算
+    bool keep_query;            // 处理函数需要查询参数；否则去掉wait等参数后再交给处理函数
+};
+
+const ConditionalRoute CONDITIONAL_ROUTES[] = {
+    {"/api/gpu/status", TOPIC_GPU, 1000, false},
+    {"/api/gpus", TOPIC_GPU, 1000, false},
+    {"/api/config/list", TOPIC_CONFIG, 2000, false},
+    {"/api/task/status", TOPIC_TASKS, 5000, true},
+    {"/api/ollama/status", TOPIC_TASKS, 5000, true},
+    {"/api/train/logs", TOPIC_LOGS, 250, false},
+};
+
+const ConditionalRoute* find_conditional_route(std::string_view method, std::string_view url) {
+    if (method != "GET") return nullptr;
+    std::string_view path = url.substr(0, url.find('?'));
+    for (const ConditionalRoute& route : CONDITIONAL_ROUTES) {
+        if (route.path == path) return &route;
+    }
+    return nullptr;
+}
+
+// If-None-Match可能是逗号分隔的列表或*，弱比较时忽略W/前缀
+bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+    auto opaque = [](std::string_view tag) {
+        while (!tag.empty() && tag.front() == ' ') tag.remove_prefix(1);
+        while (!tag.empty() && tag.back() == ' ') tag.remove_suffix(1);
+        if (starts_with(tag, "W/")) tag.remove_prefix(2);
+        return tag;
+    };
+    std::string_view target = opaque(etag);
+    while (!if_none_match.empty()) {
+        size_t comma = if_none_match.find(',');
+        std::string_view item = opaque(if_none_match.substr(0, comma));
+        if (item == "*" || (!item.empty() && item == target)) return true;
+        if (comma == std::string_view::npos) break;
+        if_none_match.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// 训练日志按文件大小和修改时间生成ETag，未变化时不必读取文件
+std::string_view train_log_etag() {
+    FileStat st = stat_file(get_current_dir() + "/train_log.txt");
+    char* buffer = static_cast<char*>(request_arena().allocate(48, 1));
+    int length = st.exists
+        ? std::snprintf(buffer, 48, "W/\"%llx-%llx\"", st.size, static_cast<unsigned long long>(st.mtime))
+        : std::snprintf(buffer, 48, "W/\"0\"");
+    return std::string_view(buffer, static_cast<size_t>(length));
+}
+
+std::string_view body_etag(std::string_view response) {
+    size_t header_end = response.find("\r\n\r\n");
+    std::string_view body = header_end == std::string_view::npos ? std::string_view() : response.substr(header_end + 4);
+    char* buffer = static_cast<char*>(request_arena().allocate(24, 1));
+    int length = std::snprintf(buffer, 24, "W/\"%016llx\"", static_cast<unsigned long long>(hash_bytes64(body.data(), body.size())));
+    return std::string_view(buffer, static_cast<size_t>(length));
+}
+
+std::string_view not_modified_response(std::string_view etag) {
+    ArenaString out;
+    out.reserve(160 + etag.size());
+    out.append("HTTP/1.1 304 Not Modified\r\nETag: ");
+    out.append(etag.data(), etag.size());
+    out.append("\r\nCache-Control: no-cache\r\nAccess-Control-Allow-Origin: *\r\nAccess-Control-Expose-Headers: ETag\r\n\r\n");
+    return std::string_view(out.data(), out.size());
+}
+
+// 给200响应加上ETag，并把禁止缓存改为每次重新验证
+std::string_view with_etag(std::string_view response, std::string_view etag) {
+    if (!starts_with(response, "HTTP/1.1 200")) return response;
+    size_t header_end = response.find("\r\n\r\n");
+    if (header_end == std::string_view::npos) return response;
+    ArenaString out;
+    out.reserve(response.size() + 96 + etag.size());
+    std::string_view rest = response.substr(0, header_end + 2);
+    while (!rest.empty()) {
+        std::string_view line = rest.substr(0, rest.find("\r\n") + 2);
+        rest.remove_prefix(line.size());
+        if (starts_with(line, "Cache-Control:") || starts_with(line, "Pragma:") || starts_with(line, "Expires:")) continue;
+        out.append(line.data(), line.size());
+    }
+    out.append("Cache-Control: no-cache\r\nAccess-Control-Expose-Headers: ETag\r\nETag: ");
+    out.append(etag.data(), etag.size());
+    out.append("\r\n");
+    out.append(response.data() + header_end + 2, response.size() - header_end - 2);
+    return std::string_view(out.data(), out.size());
+}
+
+// 交给原有处理函数的请求文本，去掉了处理函数不认识的查询参数
+std::string conditional_request_text(const HttpRequestHead& req, const ConditionalRoute& route) {
+    std::string_view url = route.keep_query ? req.url : req.url.substr(0, req.url.find('?'));
+    size_t line_end = req.head.find("\r\n");
+    std::string request;
+    request.reserve(req.head.size() + 16);
+    request.append(req.method.data(), req.method.size());
+    request.append(" ");
+    request.append(url.data(), url.size());
+    request.append(" HTTP/1.1");
+    if (line_end != std::string_view::npos) request.append(req.head.data() + line_end, req.head.size() - line_end);
+    return request;
+}
+
+struct ConditionalResult {
+    bool sent;                  // false表示内容与If-None-Match相同且请求需要继续等待
+    std::string_view status_line;
+    size_t bytes;
+};
+
+// 计算条件请求的完整响应（未压缩）；hold为true且内容未变化时返回空。
+// 响应在请求内存池或owned中
+std::string_view conditional_response(const HttpRequestHead& req, const ConditionalRoute& route, bool hold, std::string& owned) {
+    std::string_view if_none_match = get_header_view(req.head, "If-None-Match");
+    if (route.topic == TOPIC_LOGS) {
+        std::string_view etag = train_log_etag();
+        if (etag_matches(if_none_match, etag)) return hold ? std::string_view() : not_modified_response(etag);
+        owned = handle_request(conditional_request_text(req, route));
+        return with_etag(owned, etag);
+    }
+
+    std::string_view out = route.keep_query ? handle_arena_request(req.method, req.url) : std::string_view();
+    if (out.empty()) {
+        owned = handle_request(conditional_request_text(req, route));
+        out = owned;
+    }
+    if (!starts_with(out, "HTTP/1.1 200")) return out;
+    std::string_view etag = body_etag(out);
+    if (etag_matches(if_none_match, etag)) return hold ? std::string_view() : not_modified_response(etag);
+    return with_etag(out, etag);
+}
+
+// 计算当前内容并发送响应；hold为true且内容未变化时不发送
+ConditionalResult respond_conditional(socket_t client, const HttpRequestHead& req, const ConditionalRoute& route, bool hold) {
+    bool gzip = accepts_gzip(req.head);
+    // 训练日志有变化时分块发送，不必读入内存
+    if (route.topic == TOPIC_LOGS && accepts_chunked(req)) {
+        std::string_view etag = train_log_etag();
+        if (!etag_matches(get_header_view(req.head, "If-None-Match"), etag)) {
+            size_t streamed = stream_train_logs(client, gzip, etag);
+            if (streamed > 0) return {true, "HTTP/1.1 200", streamed};
+        }
+    }
+
+    std::string owned;
+    std::string_view out = conditional_response(req, route, hold, owned);
+    if (out.empty()) return {false, std::string_view(), 0};
+    if (gzip) out = gzip_response(out);
+    send_all(client, out.data(), out.size());
+    // 状态行复制到请求内存池，owned释放后仍可用于统计
+    size_t status_length = std::min<size_t>(out.size(), 12);
+    char* status = static_cast<char*>(request_arena().allocate(status_length, 1));
+    std::memcpy(status, out.data(), status_length);
+    return {true, std::string_view(status, status_length), out.size()};
+}
+
+// 挂起的长轮询请求。请求头复制出来保存，请求内存池在每次处理后复位
+struct ParkedRequest {
+    socket_t client;
+    std::string head;
+    const ConditionalRoute* route;
+    uint64_t version;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point next_poll;
+    bool done;
+};
+
+class LongPollParker {
+public:
+    // 等待的请求过多时返回false，由调用方立即响应
+    bool park(socket_t client, const HttpRequestHead& req, const ConditionalRoute& route, uint64_t version,
+              std::chrono::steady_clock::time_point started, std::chrono::steady_clock::time_point deadline) {
+        std::lock_guard<std::mutex> lock(g_state_mutex);
+        if (parked.size() >= LONG_POLL_MAX_PARKED) return false;
+        if (!running) {
+            running = true;
+            std::thread([this] { run(); }).detach();
+        }
+        auto now = std::chrono::steady_clock::now();
+        parked.push_back({client, std::string(req.head), &route, version, started, deadline,
+                          now + std::chrono::milliseconds(route.poll_ms), false});
+        g_state_waiters.fetch_add(1, std::memory_order_release);
+        g_state_cv.notify_all();
+        return true;
+    }
+
+private:
+    std::vector<ParkedRequest> parked;
+    bool running = false;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(g_state_mutex);
+        std::vector<ParkedRequest> due;
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            auto wake = now + std::chrono::seconds(LONG_POLL_MAX_SECONDS);
+            for (size_t i = 0; i < parked.size();) {
+                ParkedRequest& p = parked[i];
+                bool changed = g_state_versions[p.route->topic].load(std::memory_order_acquire) != p.version;
+                if (changed || now >= p.next_poll || now >= p.deadline) {
+                    due.push_back(std::move(p));
+                    parked[i] = std::move(parked.back());
+                    parked.pop_back();
+                    continue;
+                }
+                wake = std::min(wake, std::min(p.next_poll, p.deadline));
+                ++i;
             }
-            
-            // 检查文件是否存在
-            if (!file_exists(train_file) && error_message.empty()) {
-                error_message = "训练数据文件不存在: " + train_file;
+            if (due.empty()) {
+                g_state_cv.wait_until(lock, wake);
+                continue;
+            }
+
+            // 处理时不持有锁，任务线程可以继续更新状态
+            lock.unlock();
+            for (ParkedRequest& p : due) evaluate(p);
+            lock.lock();
+            for (ParkedRequest& p : due) {
+                if (!p.done) parked.push_back(std::move(p));
+            }
+            due.clear();
+        }
+    }
+
+    // 已响应时关闭连接并标记done，否则更新版本和下次检查时间
+    void evaluate(ParkedRequest& p) {
+        struct ArenaReset {
+            ~ArenaReset() { request_arena().reset(); }
+        } arena_reset;
+        size_t first_space = p.head.find(' ');
+        size_t second_space = p.head.find(' ', first_space + 1);
+        HttpRequestHead req;
+        req.method = std::string_view(p.head).substr(0, first_space);
+        req.url = std::string_view(p.head).substr(first_space + 1, second_space - first_space - 1);
+        req.head = p.head;
+        req.content_length = 0;
+
+        auto now = std::chrono::steady_clock::now();
+        uint64_t version = g_state_versions[p.route->topic].load(std::memory_order_acquire);
+        ConditionalResult result = respond_conditional(p.client, req, *p.route, now < p.deadline);
+        if (!result.sent) {
+            p.version = version;
+            p.next_poll = now + std::chrono::milliseconds(p.route->poll_ms);
+            return;
+        }
+        close_socket(p.client);
+        p.done = true;
+        g_state_waiters.fetch_sub(1, std::memory_order_release);
+        metrics_observe_request(req.url, result.status_line, result.bytes,
+                                std::chrono::duration<double>(std::chrono::steady_clock::now() - p.started).count());
+    }
+};
+
+LongPollParker g_long_poll;
+
+// 处理条件请求。wait=秒数且If-None-Match与当前内容相同时挂起请求，否则立即响应
+void serve_conditional(socket_t client, const HttpRequestHead& req, const ConditionalRoute& route,
+                       std::chrono::steady_clock::time_point started) {
+    long wait = std::strtol(get_query_param(req.url, "wait").c_str(), nullptr, 10);
+    wait = std::max(0L, std::min(wait, LONG_POLL_MAX_SECONDS));
+    bool hold = wait > 0 && !get_header_view(req.head, "If-None-Match").empty();
+
+    // 先取版本再计算内容，计算期间发生的变化会让等待线程立即重新检查
+    uint64_t version = g_state_versions[route.topic].load(std::memory_order_acquire);
+    ConditionalResult result = respond_conditional(client, req, route, hold);
+    if (!result.sent) {
+        if (g_long_poll.park(client, req, route, version, started, started + std::chrono::seconds(wait))) return;
+        result = respond_conditional(client, req, route, false);
+    }
+    close_socket(client);
+    metrics_observe_request(req.url, result.status_line, result.bytes,
+                            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+}
+
+// ==================== WebSocket推送 ====================
+// GET /api/ws 升级为WebSocket后，一个连接上可以订阅多个主题，服务端只在内容变化时推送。
+// 客户端消息：
+//   {"op":"subscribe","topic":"gpu|logs|job|inference|deploy","task_id":"..."}
+//   {"op":"unsubscribe","topic":"...","task_id":"..."}
+// 推送 {"topic":"job","task_id":"...","data":{...}}，data与对应轮询端点的响应体相同；
+// 训练日志只推送新增部分 {"topic":"logs","offset":N,"reset":false,"append":"..."}，
+// reset为true时客户端丢弃已有内容。所有连接由一个线程处理，不占用顺序处理连接的主循环。
+// 发送不阻塞：写不完的帧留在连接的输出缓冲里，等可写时再发；缓冲超过WS_MAX_PENDING
+// 或ping之后WS_PONG_TIMEOUT_SECONDS内没有收到pong的连接直接断开，不拖慢其他连接。
+// 同一周期内相同端点的内容只计算一次，由订阅它的所有连接共享。
+
+const size_t WS_MAX_CONNECTIONS = 128;
+const size_t WS_MAX_SUBSCRIPTIONS = 32;         // 每个连接
+const size_t WS_MAX_MESSAGE = 64 * 1024;        // 客户端消息上限
+const long long WS_LOG_PUSH_LIMIT = 256 * 1024; // 每次推送的日志增量上限，首次订阅只发送日志末尾
+const int WS_TICK_MS = 100;
+const int WS_PING_SECONDS = 30;
+const int WS_PONG_TIMEOUT_SECONDS = 10;
+const size_t WS_MAX_PENDING = 4 * 1024 * 1024;  // 每个连接尚未发出的数据上限
+
+struct WsTopic {
+    std::string_view name;
+    StateTopic state;
+    int poll_ms;                // 没有变化通知时的重新检查间隔
+    std::string_view url;       // 内容来自的轮询端点，task_id拼接在后面；logs单独处理
+    bool needs_task;
+};
+
+const WsTopic WS_TOPICS[] = {
+    {"gpu", TOPIC_GPU, 1000, "/api/gpu/status", false},
+    {"logs", TOPIC_LOGS, 250, "", false},
+    {"job", TOPIC_TASKS, 5000, "/api/task/status?task_id=", true},
+    {"inference", TOPIC_TASKS, 5000, "/api/inference/result?task_id=", true},
+    {"deploy", TOPIC_TASKS, 5000, "/api/ollama/status?task_id=", true},
+};
+
+// SHA-1，只用于计算Sec-WebSocket-Accept
+void sha1_digest(const std::string& input, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = input;
+    uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+    data += '\x80';
+    while (data.size() % 64 != 56) data += '\0';
+    for (int i = 7; i >= 0; --i) data += static_cast<char>((bit_length >> (i * 8)) & 0xFF);
+
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+    for (size_t block = 0; block < data.size(); block += 64) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + block;
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (uint32_t(p[i * 4]) << 24) | (uint32_t(p[i * 4 + 1]) << 16) | (uint32_t(p[i * 4 + 2]) << 8) | p[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rotl(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 4; ++j) digest[i * 4 + j] = static_cast<unsigned char>(h[i] >> (24 - j * 8));
+    }
+}
+
+std::string base64_encode(const unsigned char* data, size_t length) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((length + 2) / 3 * 4);
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = uint32_t(data[i]) << 16;
+        if (i + 1 < length) chunk |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+        out += alphabet[(chunk >> 18) & 63];
+        out += alphabet[(chunk >> 12) & 63];
+        out += i + 1 < length ? alphabet[(chunk >> 6) & 63] : '=';
+        out += i + 2 < length ? alphabet[chunk & 63] : '=';
+    }
+    return out;
+}
+
+// 逗号分隔的头部值中是否包含token（不区分大小写）
+bool header_has_token(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+        while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+        if (item.size() == token.size() && std::equal(item.begin(), item.end(), token.begin(),
+                [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); })) {
+            return true;
+        }
+        if (comma == std::string_view::npos) break;
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// 校验升级请求并发送101响应；不是有效的升级请求时返回错误响应，由调用方发送
+std::string websocket_handshake(socket_t client, const HttpRequestHead& req) {
+    std::string_view key = get_header_view(req.head, "Sec-WebSocket-Key");
+    if (req.method != "GET" || !header_has_token(get_header_view(req.head, "Upgrade"), "websocket") ||
+        !header_has_token(get_header_view(req.head, "Connection"), "upgrade") || key.empty()) {
+        return json_response("{\"success\":false,\"message\":\"需要WebSocket升级请求\"}", "426 Upgrade Required",
+                             "Upgrade: websocket\r\nConnection: Upgrade\r\n");
+    }
+    if (get_header_view(req.head, "Sec-WebSocket-Version") != "13") {
+        return json_response("{\"success\":false,\"message\":\"不支持的WebSocket版本\"}", "426 Upgrade Required",
+                             "Sec-WebSocket-Version: 13\r\n");
+    }
+    unsigned char digest[20];
+    sha1_digest(std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    response += base64_encode(digest, sizeof(digest));
+    response += "\r\n\r\n";
+    send_all(client, response.data(), response.size());
+    return std::string();
+}
+
+// 服务端发出的帧不加掩码
+void append_ws_frame(std::string& out, unsigned char opcode, std::string_view payload) {
+    out += static_cast<char>(0x80 | opcode);
+    if (payload.size() < 126) {
+        out += static_cast<char>(payload.size());
+    } else if (payload.size() <= 0xFFFF) {
+        out += static_cast<char>(126);
+        out += static_cast<char>((payload.size() >> 8) & 0xFF);
+        out += static_cast<char>(payload.size() & 0xFF);
+    } else {
+        out += static_cast<char>(127);
+        for (int i = 7; i >= 0; --i) out += static_cast<char>((static_cast<uint64_t>(payload.size()) >> (i * 8)) & 0xFF);
+    }
+    out.append(payload.data(), payload.size());
+}
+
+// 去掉末尾不完整的UTF-8字符，返回可以发送的长度
+size_t utf8_complete_length(const char* data, size_t length) {
+    size_t start = length;
+    while (start > 0 && length - start < 4 && (static_cast<unsigned char>(data[start - 1]) & 0xC0) == 0x80) start--;
+    if (start == 0) return length;
+    unsigned char lead = static_cast<unsigned char>(data[start - 1]);
+    size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    return length - (start - 1) >= need ? length : start - 1;
+}
+
+struct WsSubscription {
+    const WsTopic* topic;
+    std::string task_id;
+    uint64_t version;
+    uint64_t last_hash;
+    bool sent;
+    long long log_offset;       // logs：已推送到的文件位置
+    std::chrono::steady_clock::time_point next_poll;
+};
+
+struct WsConnection {
+    socket_t sock;
+    std::string input;          // 尚未解析的帧数据
+    std::string message;        // 分片消息的已收到部分
+    std::string output;         // 尚未发出的帧
+    size_t output_sent;         // output中已经发出的字节数
+    std::vector<WsSubscription> subscriptions;
+    std::chrono::steady_clock::time_point last_ping;
+    bool awaiting_pong;
+    bool closed;
+};
+
+// 一个周期内计算出的端点内容
+struct WsBody {
+    std::string url;
+    std::string body;
+    uint64_t hash;
+};
+
+class WebSocketHub {
+public:
+    // 接管已完成握手的连接；连接数已满时返回false
+    bool adopt(socket_t sock) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (pending.size() + active.load(std::memory_order_relaxed) >= WS_MAX_CONNECTIONS) return false;
+#ifdef _WIN32
+        u_long nonblocking = 1;
+        ioctlsocket(sock, FIONBIO, &nonblocking);
+#else
+        int flags = fcntl(sock, F_GETFL, 0);
+        fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+        pending.push_back(sock);
+        if (!running) {
+            running = true;
+            std::thread([this] { run(); }).detach();
+        }
+        return true;
+    }
+
+private:
+    std::mutex mtx;
+    std::vector<socket_t> pending;
+    std::atomic<size_t> active{0};
+    bool running = false;
+    std::atomic<bool> gpu_refreshing{false};
+    std::vector<WsConnection> connections;   // 以下只在推送线程中访问
+    std::vector<WsBody> bodies;              // 本周期已计算的端点内容
+
+    void run() {
+        std::vector<char> buffer(16 * 1024);
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto now = std::chrono::steady_clock::now();
+                for (socket_t sock : pending) {
+                    connections.push_back({sock, std::string(), std::string(), std::string(), 0, {}, now, false, false});
+                }
+                pending.clear();
+            }
+            active.store(connections.size(), std::memory_order_relaxed);
+            wait_ready(buffer);
+            auto now = std::chrono::steady_clock::now();
+            bodies.clear();
+            for (WsConnection& conn : connections) {
+                if (!conn.closed) push_updates(conn, now);
+                if (conn.closed) continue;
+                if (conn.awaiting_pong && now - conn.last_ping >= std::chrono::seconds(WS_PONG_TIMEOUT_SECONDS)) {
+                    conn.closed = true;
+                } else if (now - conn.last_ping >= std::chrono::seconds(WS_PING_SECONDS)) {
+                    conn.last_ping = now;
+                    conn.awaiting_pong = true;
+                    send_frame(conn, 0x9, std::string_view());
+                }
+            }
+            for (size_t i = 0; i < connections.size();) {
+                if (!connections[i].closed) {
+                    ++i;
+                    continue;
+                }
+                // 关闭帧等还没发出的数据尽量发出，发不出去就放弃
+                flush(connections[i]);
+                close_socket(connections[i].sock);
+                connections[i] = std::move(connections.back());
+                connections.pop_back();
+            }
+        }
+    }
+
+    // 等待最多一个周期，读取并处理可读连接上的帧，继续发送可写连接上积压的数据
+    void wait_ready(std::vector<char>& buffer) {
+        if (connections.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WS_TICK_MS));
+            return;
+        }
+        std::vector<pollfd> fds(connections.size());
+        for (size_t i = 0; i < connections.size(); ++i) {
+            fds[i].fd = connections[i].sock;
+            fds[i].events = connections[i].output.empty() ? POLLIN : POLLIN | POLLOUT;
+            fds[i].revents = 0;
+        }
+#ifdef _WIN32
+        int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), WS_TICK_MS);
+#else
+        int ready = poll(fds.data(), fds.size(), WS_TICK_MS);
+#endif
+        if (ready <= 0) return;
+        for (size_t i = 0; i < connections.size(); ++i) {
+            WsConnection& conn = connections[i];
+            if (fds[i].revents & POLLOUT) flush(conn);
+            if ((fds[i].revents & (POLLIN | POLLERR | POLLHUP)) == 0) continue;
+            int n = recv(conn.sock, buffer.data(), static_cast<int>(buffer.size()), 0);
+            if (n <= 0) {
+                conn.closed = true;
+                continue;
+            }
+            conn.input.append(buffer.data(), static_cast<size_t>(n));
+            read_frames(conn);
+        }
+    }
+
+    void read_frames(WsConnection& conn) {
+        while (!conn.closed && conn.input.size() >= 2) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(conn.input.data());
+            bool fin = (p[0] & 0x80) != 0;
+            unsigned char opcode = p[0] & 0x0F;
+            uint64_t length = p[1] & 0x7F;
+            size_t pos = 2;
+            if (length == 126) {
+                if (conn.input.size() < 4) return;
+                length = (uint64_t(p[2]) << 8) | p[3];
+                pos = 4;
+            } else if (length == 127) {
+                if (conn.input.size() < 10) return;
+                length = 0;
+                for (int i = 0; i < 8; ++i) length = (length << 8) | p[2 + i];
+                pos = 10;
+            }
+            // 客户端帧必须加掩码
+            if ((p[1] & 0x80) == 0) return close_with(conn, 1002);
+            if (length > WS_MAX_MESSAGE) return close_with(conn, 1009);
+            if (conn.input.size() < pos + 4 + length) return;
+
+            const unsigned char* mask = p + pos;
+            std::string payload(conn.input.data() + pos + 4, static_cast<size_t>(length));
+            for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+            conn.input.erase(0, pos + 4 + static_cast<size_t>(length));
+
+            if (opcode == 0x8) {
+                send_frame(conn, 0x8, payload.substr(0, 2));
+                conn.closed = true;
+            } else if (opcode == 0x9) {
+                send_frame(conn, 0xA, payload);
+            } else if (opcode == 0xA) {
+                conn.awaiting_pong = false;
+            } else if (opcode == 0x1 || opcode == 0x0) {
+                conn.message += payload;
+                if (conn.message.size() > WS_MAX_MESSAGE) return close_with(conn, 1009);
+                if (fin) {
+                    handle_message(conn, conn.message);
+                    conn.message.clear();
+                }
+            } else {
+                return close_with(conn, 1003);
+            }
+        }
+    }
+
+    void close_with(WsConnection& conn, int code) {
+        char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code & 0xFF)};
+        send_frame(conn, 0x8, std::string_view(payload, 2));
+        conn.closed = true;
+    }
+
+    // 帧先追加到输出缓冲，再尽量发出；对方不读取导致积压过多时断开
+    void send_frame(WsConnection& conn, unsigned char opcode, std::string_view payload) {
+        if (conn.output.size() - conn.output_sent + payload.size() > WS_MAX_PENDING) {
+            conn.closed = true;
+            return;
+        }
+        append_ws_frame(conn.output, opcode, payload);
+        flush(conn);
+    }
+
+    void flush(WsConnection& conn) {
+        while (conn.output_sent < conn.output.size()) {
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            const char* data = conn.output.data() + conn.output_sent;
+            size_t length = conn.output.size() - conn.output_sent;
+#ifdef _WIN32
+            int n = send(conn.sock, data, static_cast<int>(std::min<size_t>(length, 1 << 30)), 0);
+            if (n == SOCKET_ERROR) {
+                if (WSAGetLastError() != WSAEWOULDBLOCK) conn.closed = true;
+                break;
+            }
+#else
+            ssize_t n = send(conn.sock, data, length, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) conn.closed = true;
+                break;
+            }
+#endif
+            conn.output_sent += static_cast<size_t>(n);
+        }
+        // 发完后清空；只发出一部分时，已发出的部分超过一半再移走，避免每次都搬动剩余数据
+        if (conn.output_sent == conn.output.size()) {
+            conn.output.clear();
+            conn.output_sent = 0;
+        } else if (conn.output_sent > conn.output.size() / 2) {
+            conn.output.erase(0, conn.output_sent);
+            conn.output_sent = 0;
+        }
+    }
+
+    void send_error(WsConnection& conn, const std::string& message) {
+        send_frame(conn, 0x1, "{\"type\":\"error\",\"message\":\"" + escape_json(message) + "\"}");
+    }
+
+    void handle_message(WsConnection& conn, const std::string& text) {
+        JsonValue msg;
+        if (!json_parse(text.data(), text.data() + text.size(), msg, nullptr) || !msg.is_object()) {
+            return send_error(conn, "消息不是有效的JSON对象");
+        }
+        const JsonValue* op = msg.find("op");
+        const JsonValue* topic_name = msg.find("topic");
+        const JsonValue* task = msg.find("task_id");
+        std::string task_id = task && task->is_string() ? task->str : std::string();
+        const WsTopic* topic = nullptr;
+        for (const WsTopic& candidate : WS_TOPICS) {
+            if (topic_name && topic_name->is_string() && candidate.name == topic_name->str) topic = &candidate;
+        }
+        if (!op || !op->is_string() || !topic) return send_error(conn, "缺少op或topic无效");
+        if (topic->needs_task && (task_id.empty() || task_id.find_first_not_of(
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-") != std::string::npos)) {
+            return send_error(conn, "task_id无效");
+        }
+        if (!topic->needs_task) task_id.clear();
+
+        auto existing = std::find_if(conn.subscriptions.begin(), conn.subscriptions.end(),
+            [&](const WsSubscription& s) { return s.topic == topic && s.task_id == task_id; });
+        if (op->str == "unsubscribe") {
+            if (existing != conn.subscriptions.end()) conn.subscriptions.erase(existing);
+        } else if (op->str == "subscribe") {
+            // 重复订阅时重新推送完整内容
+            if (existing != conn.subscriptions.end()) {
+                existing->sent = false;
+            } else if (conn.subscriptions.size() >= WS_MAX_SUBSCRIPTIONS) {
+                send_error(conn, "订阅数量超过上限");
+            } else {
+                conn.subscriptions.push_back({topic, task_id, 0, 0, false, 0, std::chrono::steady_clock::now()});
             }
-            
-            cmd += " --train_file \"" + train_file + "\"";
-        } else if (error_message.empty()) {
-            error_message = "缺少必要参数: train_file";
+        } else {
+            send_error(conn, "未知的op: " + op->str);
         }
-        
-        // 添加其他参数
-        if (error_message.empty()) {
-            // 非布尔参数直接添加
-            if (formData.find("num_train_epochs") != formData.end())
-                cmd += " --num_train_epochs " + formData["num_train_epochs"];
-            
-            if (formData.find("per_device_train_batch_size") != formData.end())
-                cmd += " --per_device_train_batch_size " + formData["per_device_train_batch_size"];
-            
-            if (formData.find("gradient_accumulation_steps") != formData.end())
-                cmd += " --gradient_accumulation_steps " + formData["gradient_accumulation_steps"];
-            
-            if (formData.find("learning_rate") != formData.end())
-                cmd += " --learning_rate " + formData["learning_rate"];
-            
-            if (formData.find("max_seq_length") != formData.end())
-                cmd += " --max_seq_length " + formData["max_seq_length"];
-            
-            if (formData.find("logging_steps") != formData.end())
-                cmd += " --logging_steps " + formData["logging_steps"];
-            
-            if (formData.find("save_steps") != formData.end())
-                cmd += " --save_steps " + formData["save_steps"];
-            
-            if (formData.find("save_total_limit") != formData.end())
-                cmd += " --save_total_limit " + formData["save_total_limit"];
-            
-            if (formData.find("lr_scheduler_type") != formData.end())
-                cmd += " --lr_scheduler_type " + formData["lr_scheduler_type"];
-            
-            if (formData.find("warmup_steps") != formData.end())
-                cmd += " --warmup_steps " + formData["warmup_steps"];
-            
-            if (formData.find("lora_rank") != formData.end())
-                cmd += " --lora_rank " + formData["lora_rank"];
-            
-            if (formData.find("lora_alpha") != formData.end())
-                cmd += " --lora_alpha " + formData["lora_alpha"];
-            
-            if (formData.find("lora_dropout") != formData.end())
-                cmd += " --lora_dropout " + formData["lora_dropout"];
-            
-            // 布尔参数 - 只有为true时才添加参数，为false时不传递
-            if (formData.find("gradient_checkpointing") != formData.end()) {
-                bool is_enabled = (formData["gradient_checkpointing"] == "true");
-                if (is_enabled) {
-                    cmd += " --gradient_checkpointing";
-                }
+    }
+
+    void push_updates(WsConnection& conn, std::chrono::steady_clock::time_point now) {
+        for (WsSubscription& sub : conn.subscriptions) {
+            uint64_t version = g_state_versions[sub.topic->state].load(std::memory_order_acquire);
+            if (sub.sent && version == sub.version && now < sub.next_poll) continue;
+            if (sub.topic->url.empty()) {
+                sub.version = version;
+                sub.next_poll = now + std::chrono::milliseconds(sub.topic->poll_ms);
+                push_logs(conn, sub);
+            } else {
+                const WsBody* body = topic_body(sub);
+                // GPU采样还在后台刷新时下个周期再试
+                if (!body) continue;
+                sub.version = version;
+                sub.next_poll = now + std::chrono::milliseconds(sub.topic->poll_ms);
+                push_body(conn, sub, *body);
             }
-            
-            if (formData.find("fp16") != formData.end()) {
-                bool is_enabled = (formData["fp16"] == "true");
-                if (is_enabled) {
-                    cmd += " --fp16";
+            if (conn.closed) return;
+        }
+    }
+
+    // 本周期内同一端点只计算一次。GPU采样过期时交给线程池重新执行nvidia-smi，推送线程不等待
+    const WsBody* topic_body(const WsSubscription& sub) {
+        std::string url(sub.topic->url);
+        url += sub.task_id;
+        for (const WsBody& cached : bodies) {
+            if (cached.url == url) return &cached;
+        }
+        std::string body;
+        if (sub.topic->state == TOPIC_GPU) {
+            if (!g_gpu_sampler.fresh(GPU_STATUS_MAX_AGE)) {
+                if (!gpu_refreshing.exchange(true)) {
+                    worker_pool().submit([this] {
+                        double age = 0;
+                        g_gpu_sampler.sample(GPU_STATUS_MAX_AGE, age);
+                        gpu_refreshing.store(false);
+                    });
                 }
+                return nullptr;
             }
-            
-            // 其他非布尔参数
-            if (formData.find("optim") != formData.end())
-                cmd += " --optim " + formData["optim"];
-            
-            if (formData.find("train_mode") != formData.end())
-                cmd += " --train_mode " + formData["train_mode"];
-            
-            if (formData.find("seed") != formData.end())
-                cmd += " --seed " + formData["seed"];
-            
-            // 分布式参数处理，只有为true时才添加
-            if (use_distributed) {
-                cmd += " --distributed"; // 分布式模式下添加标志
+            double age = 0;
+            body = gpu_status_body(g_gpu_sampler.sample(GPU_STATUS_MAX_AGE, age));
+        } else {
+            std::string_view response = handle_arena_request("GET", url);
+            size_t header_end = response.find("\r\n\r\n");
+            if (header_end != std::string_view::npos) body.assign(response.substr(header_end + 4));
+            request_arena().reset();
+        }
+        uint64_t hash = hash_bytes64(body.data(), body.size());
+        bodies.push_back({std::move(url), std::move(body), hash});
+        return &bodies.back();
+    }
+
+    // 内容和上次推送的不同时才发送
+    void push_body(WsConnection& conn, WsSubscription& sub, const WsBody& current) {
+        std::string_view body = current.body;
+        if (sub.sent && current.hash == sub.last_hash) return;
+        sub.last_hash = current.hash;
+        sub.sent = true;
+
+        std::string message = "{\"topic\":\"";
+        message.append(sub.topic->name.data(), sub.topic->name.size());
+        message += "\"";
+        if (!sub.task_id.empty()) message += ",\"task_id\":\"" + sub.task_id + "\"";
+        message += ",\"data\":";
+        message.append(body.data(), body.size());
+        message += "}";
+        send_frame(conn, 0x1, message);
+    }
+
+    // 只读取并推送上次之后新增的日志；文件变短说明开始了新的训练，从头推送
+    void push_logs(WsConnection& conn, WsSubscription& sub) {
+        FileStat st = stat_file(get_current_dir() + "/train_log.txt");
+        long long size = st.exists ? static_cast<long long>(st.size) : 0;
+        if (sub.sent && size == sub.log_offset) return;
+        bool reset = !sub.sent || size < sub.log_offset;
+        long long start = reset ? std::max(0LL, size - WS_LOG_PUSH_LIMIT) : sub.log_offset;
+        long long end = std::min(size, start + WS_LOG_PUSH_LIMIT);
+
+        std::string text;
+        if (end > start) {
+            FILE* file = open_file_utf8(get_current_dir() + "/train_log.txt", "rb");
+            if (!file) return;
+#ifdef _WIN32
+            _fseeki64(file, start, SEEK_SET);
+#else
+            fseeko(file, static_cast<off_t>(start), SEEK_SET);
+#endif
+            text.resize(static_cast<size_t>(end - start));
+            text.resize(fread(&text[0], 1, text.size(), file));
+            fclose(file);
+        }
+        // 从中间开始时跳过被截断的字符，末尾不完整的字符留到下次
+        size_t skip = 0;
+        if (reset && start > 0) {
+            while (skip < text.size() && (static_cast<unsigned char>(text[skip]) & 0xC0) == 0x80) skip++;
+        }
+        size_t used = utf8_complete_length(text.data(), text.size());
+        if (used < skip) used = skip;
+        sub.log_offset = start + static_cast<long long>(used);
+        sub.sent = true;
+        // 还没追上文件末尾时下个周期继续推送
+        if (sub.log_offset < size) sub.next_poll = std::chrono::steady_clock::now();
+
+        std::string message = "{\"topic\":\"logs\",\"offset\":";
+        message += std::to_string(start + static_cast<long long>(skip));
+        message += reset ? ",\"reset\":true" : ",\"reset\":false";
+        message += ",\"append\":\"";
+        append_json_escaped(message, std::string_view(text.data() + skip, used - skip));
+        message += "\"}";
+        send_frame(conn, 0x1, message);
+    }
+};
+
+WebSocketHub g_websocket_hub;
+
+// GET /api/ws：握手成功后连接交给推送线程
+void serve_websocket(socket_t client, const HttpRequestHead& req, std::chrono::steady_clock::time_point started) {
+    std::string error = websocket_handshake(client, req);
+    if (error.empty() && g_websocket_hub.adopt(client)) {
+        metrics_observe_request(req.url, "HTTP/1.1 101", 0, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        return;
+    }
+    if (error.empty()) {
+        // 握手已完成，用关闭帧说明服务端过载
+        std::string frame;
+        append_ws_frame(frame, 0x8, std::string_view("\x03\xF5", 2));
+        send_all(client, frame.data(), frame.size());
+    } else {
+        send_all(client, error.data(), error.size());
+    }
+    close_socket(client);
+    metrics_observe_request(req.url, error.empty() ? "HTTP/1.1 101" : error, error.size(),
+                            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+}
+
+// ==================== 数据集流式上传 ====================
+// POST /api/data/upload?file=xxx.jsonl&offset=N&total=T
+// 请求体按固定大小的块直接写入 llm/data/.xxx.jsonl.part，内存占用与文件大小无关；
+// 同时按行增量建立偏移索引并校验记录。offset必须等于已接收的字节数，
+// 断线后先用 GET /api/data/upload?file= 查询已接收字节数再续传。
+// 收齐total字节后改名为正式文件，并直接写入索引旁路文件和统计缓存。
+// 超过UPLOAD_SESSION_IDLE_SECONDS没有续传的会话连同.part文件一起删除，服务重启后遗留的.part文件按修改时间处理。
+
+const long long UPLOAD_SESSION_IDLE_SECONDS = 6 * 3600;
+const int UPLOAD_SWEEP_INTERVAL_SECONDS = 60;
+
+struct UploadSession {
+    std::mutex mtx;
+    std::string final_path;
+    std::string part_path;
+    std::chrono::steady_clock::time_point last_active;  // 在g_upload_sessions_mtx下读写
+    unsigned long long received;
+    std::string pending;            // 最后一行尚未收到换行符的部分
+    bool pending_too_long;
+    std::vector<unsigned long long> offsets;
+    DatasetStats stats;
+
+    UploadSession() {
+        reset();
+    }
+
+    // 清空已接收的状态，从头开始上传
+    void reset() {
+        received = 0;
+        pending.clear();
+        pending_too_long = false;
+        offsets.assign(1, 0);
+        stats = DatasetStats();
+        stats.file_size = 0;
+        stats.mtime = 0;
+        stats.records = 0;
+        stats.valid = 0;
+        stats.invalid_count = 0;
+        stats.elapsed_ms = 0;
+    }
+
+    void finish_line(const char* begin, const char* end) {
+        if (pending_too_long) {
+            stats.records++;
+            stats.invalid_count++;
+            if (stats.invalid_lines.size() < DATASET_STATS_MAX_INVALID) {
+                stats.invalid_lines.emplace_back(stats.records, "记录过长");
             }
+            pending_too_long = false;
+            pending.clear();
+            return;
+        }
+        if (pending.empty()) {
+            validate_dataset_line(begin, end, stats.records + 1, stats);
+        } else {
+            pending.append(begin, end);
+            validate_dataset_line(pending.data(), pending.data() + pending.length(), stats.records + 1, stats);
+            pending.clear();
         }
+    }
 
-        // 如果有错误，直接返回错误信息
-        if (!error_message.empty()) {
-            std::ostringstream json;
-            json << "{";
-            json << "\"success\":false,";
-            json << "\"message\":\"参数验证失败\",";
-            json << "\"error\":\"" << escape_json(error_message) << "\"";
-            json << "}";
-            return json_response(json.str());
+    // 处理新收到的一块数据：记录换行位置并校验完整的行
+    void feed(const char* data, size_t length) {
+        size_t first_new = offsets.size();
+        scan_newlines(data, length, received, offsets);
+
+        const char* line_begin = data;
+        for (size_t i = first_new; i < offsets.size(); ++i) {
+            const char* line_end = data + (offsets[i] - received);
+            finish_line(line_begin, line_end);
+            line_begin = line_end;
         }
 
-        bool success = false;
-        std::string cmd_output;
-        
+        const char* tail_end = data + length;
+        if (!pending_too_long && pending.length() + static_cast<size_t>(tail_end - line_begin) > MAX_UPLOAD_LINE) {
+            pending_too_long = true;
+            pending.clear();
+            pending.shrink_to_fit();
+        }
+        if (!pending_too_long) {
+            pending.append(line_begin, tail_end);
+        }
+        received += length;
+    }
+
+    // 文件收齐后处理最后一行（没有换行结尾的情况）
+    void finish() {
+        if (!pending.empty() || pending_too_long) {
+            finish_line(pending.data(), pending.data());
+            offsets.push_back(received);
+        }
+    }
+};
+
+std::mutex g_upload_sessions_mtx;
+std::map<std::string, std::shared_ptr<UploadSession>> g_upload_sessions;
+std::chrono::steady_clock::time_point g_upload_last_sweep;
+
+// 删除data_dir下空闲超过idle_seconds的上传会话和.part文件。正在处理请求的会话不删除；
+// 会话空闲但.part刚被写过（一次上传持续很久）时也保留。调用方持有g_upload_sessions_mtx
+void expire_upload_sessions(const std::string& data_dir, long long idle_seconds) {
+    auto now = std::chrono::steady_clock::now();
+    long long wall_now = static_cast<long long>(std::time(nullptr));
+    auto part_idle = [&](const std::string& part_path) {
+        FileStat st = stat_file(part_path);
+        return !st.exists || wall_now - st.mtime >= idle_seconds;
+    };
+    for (auto it = g_upload_sessions.begin(); it != g_upload_sessions.end();) {
+        const UploadSession& session = *it->second;
+        if (it->second.use_count() == 1 && now - session.last_active >= std::chrono::seconds(idle_seconds) &&
+            part_idle(session.part_path)) {
+            std::remove(session.part_path.c_str());
+            it = g_upload_sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // 内存中没有会话的.part文件（服务重启前留下的）
+    for (const std::string& name : list_files_in_directory(data_dir, ".part")) {
+        if (name.size() <= 6 || name[0] != '.') continue;
+        std::string final_path = data_dir + "/" + name.substr(1, name.size() - 6);
+        std::string part_path = data_dir + "/" + name;
+        if (g_upload_sessions.count(final_path) == 0 && part_idle(part_path)) std::remove(part_path.c_str());
+    }
+}
+
+// 获取上传会话；服务重启后内存中没有会话时，从已有的.part文件恢复校验状态
+std::shared_ptr<UploadSession> get_upload_session(const std::string& final_path) {
+    std::lock_guard<std::mutex> lock(g_upload_sessions_mtx);
+    size_t slash = final_path.find_last_of('/');
+    auto now = std::chrono::steady_clock::now();
+    if (now - g_upload_last_sweep >= std::chrono::seconds(UPLOAD_SWEEP_INTERVAL_SECONDS)) {
+        g_upload_last_sweep = now;
+        expire_upload_sessions(final_path.substr(0, slash), UPLOAD_SESSION_IDLE_SECONDS);
+    }
+    auto it = g_upload_sessions.find(final_path);
+    if (it != g_upload_sessions.end()) {
+        it->second->last_active = now;
+        return it->second;
+    }
+
+    std::shared_ptr<UploadSession> session = std::make_shared<UploadSession>();
+    session->final_path = final_path;
+    session->last_active = now;
+    session->part_path = final_path.substr(0, slash + 1) + "." + final_path.substr(slash + 1) + ".part";
+
+    FILE* part = open_file_utf8(session->part_path, "rb");
+    if (part) {
+        std::vector<char> buffer(UPLOAD_CHUNK_SIZE);
+        size_t n;
+        while ((n = fread(buffer.data(), 1, buffer.size(), part)) > 0) {
+            session->feed(buffer.data(), n);
+        }
+        fclose(part);
+    }
+    g_upload_sessions[final_path] = session;
+    return session;
+}
+
+void drop_upload_session(const std::string& final_path) {
+    std::lock_guard<std::mutex> lock(g_upload_sessions_mtx);
+    g_upload_sessions.erase(final_path);
+}
+
+std::string upload_status_json(const UploadSession& session, unsigned long long total, bool complete) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"success\":true,";
+    json << "\"received\":" << session.received << ",";
+    json << "\"total\":" << total << ",";
+    json << "\"complete\":" << (complete ? "true" : "false") << ",";
+    json << "\"records\":" << session.stats.records << ",";
+    json << "\"valid\":" << session.stats.valid << ",";
+    json << "\"invalid_count\":" << session.stats.invalid_count << ",";
+    json << "\"invalid_lines\":[";
+    for (size_t i = 0; i < session.stats.invalid_lines.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"line\":" << session.stats.invalid_lines[i].first
+             << ",\"error\":\"" << escape_json(session.stats.invalid_lines[i].second) << "\"}";
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
+
+// 上传文件名只允许字母、数字、._-和非ASCII字符（中文文件名），且不能以.开头（与.part/.idx旁路文件区分）。
+// 文件名之后会出现在训练配置和命令行参数里，不能带引号、分号、空格等字符
+bool valid_upload_filename(const std::string& filename) {
+    if (filename.empty() || filename[0] == '.' || filename.find("..") != std::string::npos || !ends_with(filename, ".jsonl")) {
+        return false;
+    }
+    for (unsigned char c : filename) {
+        bool alnum = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+        if (c >= 0x80 || alnum || c == '.' || c == '_' || c == '-') continue;
+        return false;
+    }
+    return true;
+}
+
+// 处理上传请求，直接从socket读取请求体。同名数据集已存在时返回409，带overwrite=1才替换
+std::string handle_upload(socket_t sock, HttpRequestHead& req) {
+    std::string filename = get_query_param(req.url, "file");
+    if (!valid_upload_filename(filename)) {
+        return json_response("{\"success\":false,\"message\":\"文件名无效，仅支持字母、数字、._-组成的.jsonl文件名\"}", "400 Bad Request");
+    }
+    bool overwrite = get_query_param(req.url, "overwrite") == "1";
+
+    std::string final_path = get_current_dir() + "/llm/data/" + filename;
+    std::shared_ptr<UploadSession> session = get_upload_session(final_path);
+    std::lock_guard<std::mutex> lock(session->mtx);
+
+    // GET查询续传位置
+    if (req.method == "GET") {
+        return json_response(upload_status_json(*session, 0, false));
+    }
+
+    unsigned long long offset = 0;
+    unsigned long long total = 0;
+    try {
+        std::string offset_param = get_query_param(req.url, "offset");
+        std::string total_param = get_query_param(req.url, "total");
+        if (!offset_param.empty()) offset = std::stoull(offset_param);
+        total = total_param.empty() ? offset + req.content_length : std::stoull(total_param);
+    } catch (...) {
+        return json_response("{\"success\":false,\"message\":\"offset或total参数无效\"}", "400 Bad Request");
+    }
+
+    // offset为0表示重新上传，其余情况必须从已接收的位置续传
+    if (offset != 0 && offset != session->received) {
+        std::ostringstream json;
+        json << "{\"success\":false,\"message\":\"上传偏移不匹配，请从received处续传\",\"received\":" << session->received << "}";
+        return json_response(json.str(), "409 Conflict");
+    }
+    if (offset + req.content_length > total) {
+        return json_response("{\"success\":false,\"message\":\"请求体超出total声明的文件大小\"}", "400 Bad Request");
+    }
+    if (!overwrite && stat_file(final_path).exists) {
+        return json_response("{\"success\":false,\"message\":\"同名数据集已存在，确认覆盖请带overwrite=1\"}", "409 Conflict");
+    }
+
+    if (offset == 0) {
+        session->reset();
+    }
+    FILE* part = open_file_utf8(session->part_path, offset == 0 ? "wb" : "ab");
+    if (!part) {
+        return json_response("{\"success\":false,\"message\":\"无法写入上传文件\"}", "500 Internal Server Error");
+    }
+
+    // 按固定大小的块接收并落盘，先处理读请求头时多读到的部分
+    std::vector<char> buffer(UPLOAD_CHUNK_SIZE);
+    size_t remaining = req.content_length;
+    bool write_failed = false;
+    std::string prefix(req.body_prefix);
+    if (!prefix.empty()) {
+        size_t n = std::min(prefix.length(), remaining);
+        write_failed = fwrite(prefix.data(), 1, n, part) != n;
+        if (!write_failed) {
+            session->feed(prefix.data(), n);
+            remaining -= n;
+        }
+    }
+    while (remaining > 0 && !write_failed) {
+        size_t filled = 0;
+        while (filled < buffer.size() && filled < remaining) {
+            long n = sock_recv(sock, buffer.data() + filled, std::min(buffer.size(), remaining) - filled);
+            if (n <= 0) break;
+            filled += static_cast<size_t>(n);
+        }
+        if (filled == 0) break; // 客户端断开，已写入的部分可以续传
+        if (fwrite(buffer.data(), 1, filled, part) != filled) {
+            write_failed = true;
+            break;
+        }
+        session->feed(buffer.data(), filled);
+        remaining -= filled;
+    }
+    fclose(part);
+
+    if (write_failed) {
+        drop_upload_session(final_path); // 下次请求从磁盘上的.part重新恢复
+        return json_response("{\"success\":false,\"message\":\"写入上传文件失败\"}", "500 Internal Server Error");
+    }
+
+    bool complete = session->received == total;
+    if (complete) {
+        session->finish();
 #ifdef _WIN32
-        // 使用宽字符版本获取路径
-        wchar_t buffer[MAX_PATH];
-        GetModuleFileNameW(NULL, buffer, MAX_PATH);
-        
-        // 转换为宽字符串并提取目录部分
-        std::wstring fullPath(buffer);
-        size_t lastSlash = fullPath.find_last_of(L"\\/");
-        std::wstring currentDir = fullPath.substr(0, lastSlash);
-        
-        // 配置文件路径 - 使用默认配置文件
-        std::wstring configFilePathW = L"C:\\Windows\\elianfactory\\default_config.json";
+        // Windows下rename不会替换已有文件；走到这里说明不存在同名文件或请求带了overwrite=1
+        std::remove(final_path.c_str());
+#endif
+        if (std::rename(session->part_path.c_str(), final_path.c_str()) != 0) {
+            return json_response("{\"success\":false,\"message\":\"上传完成但重命名文件失败\"}", "500 Internal Server Error");
+        }
 
-        // 检查配置文件是否存在
-        DWORD configFileAttrs = GetFileAttributesW(configFilePathW.c_str());
-        if (configFileAttrs == INVALID_FILE_ATTRIBUTES) {
-            std::cout << "警告: 默认配置文件不存在，使用命令行参数" << std::endl;
+        // 上传过程中已经得到完整的行偏移和校验结果，直接写入索引和统计缓存
+        FileStat st = stat_file(final_path);
+        if (st.exists && st.size == session->received) {
+            DatasetIndex index;
+            index.path = final_path;
+            index.file_size = st.size;
+            index.mtime = st.mtime;
+            index.offsets = session->offsets;
+            save_dataset_index_sidecar(index);
+
+            session->stats.file_size = st.size;
+            session->stats.mtime = st.mtime;
+            std::sort(session->stats.invalid_lines.begin(), session->stats.invalid_lines.end());
+            g_dataset_stats.put(final_path, session->stats);
+        }
+        // 上传完成后前端会立即刷新列表，不等缓存过期
+        g_response_cache.invalidate("/api/data/files");
+        log_event(LogLevel::Info, "upload.complete").str("file", filename)
+            .num("bytes", static_cast<long long>(session->received)).num("records", static_cast<long long>(session->stats.records));
+    }
+
+    std::string response = json_response(upload_status_json(*session, total, complete));
+    if (complete) {
+        drop_upload_session(final_path);
+    }
+    return response;
+}
+
+// 请求（含请求体）已经全部在内存中时生成响应，HTTP/2的流和事件驱动I/O共用。
+// 响应在请求内存池或owned中，按Accept-Encoding压缩
+std::string_view buffered_response(socket_t sock, HttpRequestHead& req, std::string_view request, std::string& owned) {
+    std::string_view response;
+    if (req.content_length == 0) {
+        response = find_static_response(req.method, req.url);
+        const ConditionalRoute* route = response.empty() ? find_conditional_route(req.method, req.url) : nullptr;
+        if (route) response = conditional_response(req, *route, false, owned);
+        if (response.empty()) response = handle_arena_request(req.method, req.url);
+    }
+    if (response.empty()) {
+        // 请求体已全部在内存中，上传处理不会再从连接读取
+        if (starts_with(req.url, "/api/data/upload?") && (req.method == "POST" || req.method == "PUT" || req.method == "GET")) {
+            owned = handle_upload(sock, req);
         } else {
-            // 输出配置文件路径
-            std::wcout << L"使用配置文件: " << configFilePathW << std::endl;
-            
-            // 修改命令为使用配置文件
-            std::wstring configFileArgW = L"--config \"" + configFilePathW + L"\"";
-            system("chcp 65001 > nul");
-            std::wcout << L"当前目录：" << currentDir << std::endl;
-            // cmdCommand += fullPath.substr(0, lastSlash + 1); // 保留末尾分隔符
-            // cmdCommand += L"llm\\main.py\"";
-            // cmdCommand += L" " + configFileArgW;
-            // 添加输出重定向
+            owned = handle_request(std::string(request));
+        }
+        response = owned;
+    }
+    if (accepts_gzip(req.head)) response = gzip_response(response);
+    return response;
+}
+
+// ==================== HTTP/2（h2c） ====================
+// 明文HTTP/2，客户端直接发送连接前言（prior knowledge）或在HTTP/1.1请求中带Upgrade: h2c。
+// 一个连接上的多个流按帧轮流发送响应，头部用HPACK压缩（动态表和Huffman编码），
+// 收发两个方向都按窗口做流量控制。每个HTTP/2连接由单独的线程处理，请求仍交给原有的处理函数；
+// 长轮询的wait=参数和分块流式响应在HTTP/2上按普通请求处理。
+// 浏览器只在TLS上使用HTTP/2，前端经反向代理以h2c连到本服务时才能复用连接。
+
+const std::string_view H2_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t H2_MAX_CONNECTIONS = 32;
+const uint32_t H2_MAX_CONCURRENT_STREAMS = 100;
+const uint32_t H2_MAX_FRAME_SIZE = 16384;           // 接收的帧上限，即协议默认值
+const int64_t H2_DEFAULT_WINDOW = 65535;
+const int64_t H2_RECV_WINDOW = 1 << 20;             // 接收窗口，较大的请求体不必频繁等待WINDOW_UPDATE
+// 窗口在收到DATA时就归还，真正限制缓冲的是这个上限：一个连接上各流已收到、尚未处理的请求体总量，
+// 超过时以ENHANCE_YOUR_CALM重置数据所在的流。单个请求体仍可以达到MAX_BODY_SIZE
+const size_t H2_MAX_BUFFERED_BODY = MAX_BODY_SIZE;
+const int64_t H2_MAX_WINDOW = 0x7FFFFFFF;
+const size_t H2_HEADER_TABLE_SIZE = 4096;
+
+enum H2FrameType {
+    H2_DATA = 0x0, H2_HEADERS = 0x1, H2_PRIORITY = 0x2, H2_RST_STREAM = 0x3, H2_SETTINGS = 0x4,
+    H2_PUSH_PROMISE = 0x5, H2_PING = 0x6, H2_GOAWAY = 0x7, H2_WINDOW_UPDATE = 0x8, H2_CONTINUATION = 0x9
+};
+
+enum H2ErrorCode {
+    H2_NO_ERROR = 0x0, H2_PROTOCOL_ERROR = 0x1, H2_INTERNAL_ERROR = 0x2, H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_STREAM_CLOSED = 0x5, H2_FRAME_SIZE_ERROR = 0x6, H2_REFUSED_STREAM = 0x7, H2_COMPRESSION_ERROR = 0x9,
+    H2_ENHANCE_YOUR_CALM = 0xb
+};
+
+const uint8_t H2_FLAG_END_STREAM = 0x1;
+const uint8_t H2_FLAG_ACK = 0x1;
+const uint8_t H2_FLAG_END_HEADERS = 0x4;
+const uint8_t H2_FLAG_PADDED = 0x8;
+const uint8_t H2_FLAG_PRIORITY = 0x20;
+
+// RFC 7541 附录A
+const std::pair<std::string_view, std::string_view> HPACK_STATIC_TABLE[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+const size_t HPACK_STATIC_COUNT = sizeof(HPACK_STATIC_TABLE) / sizeof(HPACK_STATIC_TABLE[0]);
+
+// RFC 7541 附录B，下标为符号，256为EOS
+struct HuffmanCode {
+    uint32_t code;
+    uint8_t bits;
+};
+
+const HuffmanCode HPACK_HUFFMAN_CODES[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28}, {0xfffffe4, 28}, {0xfffffe5, 28},
+    {0xfffffe6, 28}, {0xfffffe7, 28}, {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28}, {0xfffffed, 28}, {0xfffffee, 28},
+    {0xfffffef, 28}, {0xffffff0, 28}, {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28}, {0xffffff8, 28}, {0xffffff9, 28},
+    {0xffffffa, 28}, {0xffffffb, 28}, {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10},
+    {0xf9, 8}, {0x7fb, 11}, {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6}, {0x1a, 6}, {0x1b, 6},
+    {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6},
+    {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7}, {0x68, 7},
+    {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7},
+    {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5},
+    {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7},
+    {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+};
+
+// Huffman解码树，按码表逐位构建，叶子保存符号
+class HuffmanDecoder {
+public:
+    HuffmanDecoder() {
+        nodes.push_back(Node());
+        for (int symbol = 0; symbol < 257; ++symbol) {
+            const HuffmanCode& c = HPACK_HUFFMAN_CODES[symbol];
+            int node = 0;
+            for (int bit = c.bits - 1; bit >= 0; --bit) {
+                int b = (c.code >> bit) & 1;
+                if (nodes[node].child[b] < 0) {
+                    nodes[node].child[b] = static_cast<int>(nodes.size());
+                    nodes.push_back(Node());
+                }
+                node = nodes[node].child[b];
+            }
+            nodes[node].symbol = symbol;
+        }
+    }
+
+    bool decode(const uint8_t* p, size_t length, std::string& out) const {
+        int node = 0;
+        int depth = 0;
+        bool all_ones = true;
+        for (size_t i = 0; i < length; ++i) {
+            for (int bit = 7; bit >= 0; --bit) {
+                int b = (p[i] >> bit) & 1;
+                node = nodes[node].child[b];
+                if (node < 0) return false;
+                depth++;
+                all_ones = all_ones && b == 1;
+                int symbol = nodes[node].symbol;
+                if (symbol < 0) continue;
+                if (symbol == 256) return false;
+                out += static_cast<char>(symbol);
+                node = 0;
+                depth = 0;
+                all_ones = true;
+            }
+        }
+        // 末尾填充必须是EOS编码的前缀（全1）且不超过7位
+        return depth <= 7 && all_ones;
+    }
+
+private:
+    struct Node {
+        int child[2] = {-1, -1};
+        int symbol = -1;
+    };
+    std::vector<Node> nodes;
+};
+
+const HuffmanDecoder& huffman_decoder() {
+    static const HuffmanDecoder decoder;
+    return decoder;
+}
+
+size_t huffman_encoded_length(std::string_view text) {
+    size_t bits = 0;
+    for (unsigned char c : text) bits += HPACK_HUFFMAN_CODES[c].bits;
+    return (bits + 7) / 8;
+}
+
+void huffman_encode(std::string_view text, std::string& out) {
+    uint64_t pending = 0;
+    int pending_bits = 0;
+    for (unsigned char c : text) {
+        const HuffmanCode& code = HPACK_HUFFMAN_CODES[c];
+        pending = (pending << code.bits) | code.code;
+        pending_bits += code.bits;
+        while (pending_bits >= 8) {
+            pending_bits -= 8;
+            out += static_cast<char>((pending >> pending_bits) & 0xFF);
+        }
+        pending &= (uint64_t(1) << pending_bits) - 1;
+    }
+    if (pending_bits > 0) out += static_cast<char>((pending << (8 - pending_bits)) | (0xFF >> pending_bits));
+}
+
+void hpack_encode_integer(std::string& out, uint8_t first_byte, int prefix_bits, uint64_t value) {
+    uint64_t limit = (uint64_t(1) << prefix_bits) - 1;
+    if (value < limit) {
+        out += static_cast<char>(first_byte | value);
+        return;
+    }
+    out += static_cast<char>(first_byte | limit);
+    value -= limit;
+    while (value >= 128) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool hpack_decode_integer(const uint8_t*& p, const uint8_t* end, int prefix_bits, uint64_t& value) {
+    if (p >= end) return false;
+    uint64_t limit = (uint64_t(1) << prefix_bits) - 1;
+    value = *p++ & limit;
+    if (value < limit) return true;
+    for (int shift = 0; p < end && shift <= 56; shift += 7) {
+        uint8_t b = *p++;
+        value += uint64_t(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+// 静态表加动态表，索引从1开始，动态表中最新的条目索引最小
+class HpackTable {
+public:
+    bool get(uint64_t index, std::string_view& name, std::string_view& value) const {
+        if (index == 0) return false;
+        if (index <= HPACK_STATIC_COUNT) {
+            name = HPACK_STATIC_TABLE[index - 1].first;
+            value = HPACK_STATIC_TABLE[index - 1].second;
+            return true;
+        }
+        index -= HPACK_STATIC_COUNT + 1;
+        if (index >= entries.size()) return false;
+        name = entries[index].first;
+        value = entries[index].second;
+        return true;
+    }
+
+    // 名字和值都相同时返回索引；否则name_index返回名字相同的条目（没有为0）
+    uint64_t find(std::string_view name, std::string_view value, uint64_t& name_index) const {
+        name_index = 0;
+        for (size_t i = 0; i < HPACK_STATIC_COUNT; ++i) {
+            if (HPACK_STATIC_TABLE[i].first != name) continue;
+            if (HPACK_STATIC_TABLE[i].second == value) return i + 1;
+            if (name_index == 0) name_index = i + 1;
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].first != name) continue;
+            if (entries[i].second == value) return HPACK_STATIC_COUNT + 1 + i;
+            if (name_index == 0) name_index = HPACK_STATIC_COUNT + 1 + i;
+        }
+        return 0;
+    }
+
+    void add(std::string_view name, std::string_view value) {
+        size_t size = entry_size(name, value);
+        while (!entries.empty() && used + size > max_size) evict();
+        if (size > max_size) return;   // 比整个表还大的条目只会清空表
+        entries.emplace_front(std::string(name), std::string(value));
+        used += size;
+    }
+
+    void resize(size_t size) {
+        max_size = size;
+        while (!entries.empty() && used > max_size) evict();
+    }
 
-            
-            // 执行命令
-            std::wcout << L"执行命令: " << cmdCommand << std::endl;
-            int result = _wsystem(cmdCommand.c_str());
-            success = (result == 0);
-            
-            // 构建响应
-            std::ostringstream json;
-            json << "{";
-            if (success) {
-                json << "\"success\":true,";
-                json << "\"message\":\"训练任务已成功启动，正在后台运行\",";
-                json << "\"data\":{";
-                json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
-                json << "\"status\":\"running\"";
-                json << "}";
+    size_t capacity() const { return max_size; }
+
+private:
+    std::deque<std::pair<std::string, std::string>> entries;
+    size_t used = 0;
+    size_t max_size = H2_HEADER_TABLE_SIZE;
+
+    static size_t entry_size(std::string_view name, std::string_view value) { return name.size() + value.size() + 32; }
+
+    void evict() {
+        used -= entry_size(entries.back().first, entries.back().second);
+        entries.pop_back();
+    }
+};
+
+typedef std::vector<std::pair<std::string, std::string>> H2HeaderList;
+
+class HpackDecoder {
+public:
+    // 解码一个完整的头部块；失败表示压缩状态已不可用，连接必须关闭
+    bool decode(std::string_view block, H2HeaderList& headers) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(block.data());
+        const uint8_t* end = p + block.size();
+        while (p < end) {
+            uint8_t first = *p;
+            uint64_t index = 0;
+            std::string_view name;
+            std::string_view value;
+            if (first & 0x80) {
+                // 索引的头部字段
+                if (!hpack_decode_integer(p, end, 7, index) || !table.get(index, name, value)) return false;
+                headers.emplace_back(std::string(name), std::string(value));
+                continue;
+            }
+            if ((first & 0xE0) == 0x20) {
+                // 动态表大小更新，不能超过我们在SETTINGS中声明的大小
+                if (!hpack_decode_integer(p, end, 5, index) || index > H2_HEADER_TABLE_SIZE) return false;
+                table.resize(static_cast<size_t>(index));
+                continue;
+            }
+            bool indexing = (first & 0x40) != 0;
+            if (!hpack_decode_integer(p, end, indexing ? 6 : 4, index)) return false;
+            std::string literal_name;
+            std::string literal_value;
+            if (index == 0) {
+                if (!read_string(p, end, literal_name)) return false;
             } else {
-                json << "\"success\":false,";
-                json << "\"message\":\"启动训练任务失败\",";
-                json << "\"error\":\"" << escape_json(cmd_output) << "\"";
+                if (!table.get(index, name, value)) return false;
+                literal_name.assign(name.data(), name.size());
             }
-            json << "}";
-            return json_response(json.str());
+            if (!read_string(p, end, literal_value)) return false;
+            if (indexing) table.add(literal_name, literal_value);
+            headers.emplace_back(std::move(literal_name), std::move(literal_value));
         }
-#else
-        // Linux下使用后台运行
-        std::string full_cmd = "conda activate elianfactory && " + cmd + " > \"" + current_dir + "/llm/train_log.txt\" 2>&1 &";
-        int result = system(full_cmd.c_str());
-        success = (result == 0);
-        cmd_output = "命令执行结果: " + std::to_string(result);
-#endif
-        
-        // 构建响应
-        std::ostringstream json;
-        json << "{";
-        if (success) {
-            json << "\"success\":true,";
-            json << "\"message\":\"训练任务已成功启动，正在后台运行。\",";
-            json << "\"data\":{";
-            json << "\"task_id\":\"task_" << std::rand() % 1000 << "\",";
-            json << "\"status\":\"running\"";
-            json << "}";
+        return true;
+    }
+
+private:
+    HpackTable table;
+
+    static bool read_string(const uint8_t*& p, const uint8_t* end, std::string& out) {
+        if (p >= end) return false;
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t length = 0;
+        if (!hpack_decode_integer(p, end, 7, length) || length > static_cast<uint64_t>(end - p)) return false;
+        if (huffman) {
+            if (!huffman_decoder().decode(p, static_cast<size_t>(length), out)) return false;
         } else {
-            json << "\"success\":false,";
-            json << "\"message\":\"启动训练任务失败，请您重新尝试。\",";
-            json << "\"error\":\"" << escape_json(cmd_output) << "\"";
+            out.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
         }
-        json << "}";
-        return json_response(json.str());
+        p += length;
+        return true;
     }
-    else if (url == "/api/train/logs") {
-    std::string log_content;
-    std::string debug_info;  // 用于收集调试信息
-    
-    try {
-        // 获取当前工作目录（改进版本）
-        std::string current_dir;
-#ifdef _WIN32
-        wchar_t wbuffer[MAX_PATH];
-        if (GetCurrentDirectoryW(MAX_PATH, wbuffer)) {
-            char utf8_buffer[MAX_PATH * 4];
-            WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer, sizeof(utf8_buffer), NULL, NULL);
-            current_dir = utf8_buffer;
-            std::replace(current_dir.begin(), current_dir.end(), '\\', '/');
-            debug_info += "Current dir: " + current_dir + "\n";
+};
+
+class HpackEncoder {
+public:
+    // 对端SETTINGS_HEADER_TABLE_SIZE变化时调用，下一个头部块开头发送大小更新
+    void set_peer_table_size(size_t size) {
+        table.resize(std::min(size, H2_HEADER_TABLE_SIZE));
+        size_update = true;
+    }
+
+    void begin_block(std::string& out) {
+        if (!size_update) return;
+        hpack_encode_integer(out, 0x20, 5, table.capacity());
+        size_update = false;
+    }
+
+    void encode(std::string_view name, std::string_view value, std::string& out) {
+        uint64_t name_index = 0;
+        uint64_t index = table.find(name, value, name_index);
+        if (index != 0) {
+            hpack_encode_integer(out, 0x80, 7, index);
+            return;
         }
-#else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, sizeof(buffer))) {
-            current_dir = buffer;
-            debug_info += "Current dir: " + current_dir + "\n";
+        // 每个响应都不同的值不进入动态表，免得把跨响应重复的头部挤出去
+        bool indexing = name != "content-length" && name != "etag" && name != "date";
+        hpack_encode_integer(out, indexing ? 0x40 : 0x00, indexing ? 6 : 4, name_index);
+        if (name_index == 0) encode_string(name, out);
+        encode_string(value, out);
+        if (indexing) table.add(name, value);
+    }
+
+private:
+    HpackTable table;
+    bool size_update = false;
+
+    static void encode_string(std::string_view text, std::string& out) {
+        size_t huffman_length = huffman_encoded_length(text);
+        if (huffman_length < text.size()) {
+            hpack_encode_integer(out, 0x80, 7, huffman_length);
+            huffman_encode(text, out);
+        } else {
+            hpack_encode_integer(out, 0x00, 7, text.size());
+            out.append(text.data(), text.size());
         }
-#endif
+    }
+};
 
-        // 构建日志文件路径（统一使用正斜杠）
-        std::string log_path = current_dir + "/train_log.txt";
-        debug_info += "Log path: " + log_path + "\n";
+uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
 
-        // 尝试打开文件（改进的文件打开方式）
-#ifdef _WIN32
-        // Windows下更可靠的文件打开方式
-        std::wstring wlog_path;
-        int size_needed = MultiByteToWideChar(CP_UTF8, 0, log_path.c_str(), -1, NULL, 0);
-        if (size_needed > 0) {
-            wlog_path.resize(size_needed);
-            MultiByteToWideChar(CP_UTF8, 0, log_path.c_str(), -1, &wlog_path[0], size_needed);
+void append_u32(std::string& out, uint32_t value) {
+    out += static_cast<char>(value >> 24);
+    out += static_cast<char>((value >> 16) & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+    out += static_cast<char>(value & 0xFF);
+}
+
+void append_h2_frame(std::string& out, uint8_t type, uint8_t flags, uint32_t stream_id, std::string_view payload) {
+    out += static_cast<char>((payload.size() >> 16) & 0xFF);
+    out += static_cast<char>((payload.size() >> 8) & 0xFF);
+    out += static_cast<char>(payload.size() & 0xFF);
+    out += static_cast<char>(type);
+    out += static_cast<char>(flags);
+    append_u32(out, stream_id & 0x7FFFFFFF);
+    out.append(payload.data(), payload.size());
+}
+
+// base64url（不带填充），用于HTTP2-Settings头
+bool base64url_decode(std::string_view text, std::string& out) {
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (char c : text) {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-' || c == '+') v = 62;
+        else if (c == '_' || c == '/') v = 63;
+        else if (c == '=') break;
+        else return false;
+        buffer = (buffer << 6) | static_cast<uint32_t>(v);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out += static_cast<char>((buffer >> bits) & 0xFF);
         }
-        
-        FILE* file = _wfopen(wlog_path.c_str(), L"rb");
-#else
-        FILE* file = fopen(log_path.c_str(), "rb");
-#endif
+    }
+    return true;
+}
 
-        if (file) {
-            debug_info += "File opened successfully\n";
-            
-            // 获取文件大小
-            fseek(file, 0, SEEK_END);
-            long file_size = ftell(file);
-            fseek(file, 0, SEEK_SET);
-            
-            debug_info += "File size: " + std::to_string(file_size) + " bytes\n";
-            
-            if (file_size > 0) {
-                // 读取整个文件内容
-                std::vector<char> buffer(file_size + 1);
-                size_t bytes_read = fread(buffer.data(), 1, file_size, file);
-                if (bytes_read > 0) {
-                    buffer[bytes_read] = '\0';
-                    log_content.assign(buffer.data(), bytes_read);
-                    debug_info += "Read " + std::to_string(bytes_read) + " bytes\n";
-                } else {
-                    debug_info += "Failed to read file content\n";
-                }
-            } else {
-                debug_info += "File is empty\n";
+struct H2Stream {
+    std::string header_block;       // 尚未收齐的HEADERS/CONTINUATION片段
+    H2HeaderList headers;
+    std::string body;
+    bool remote_closed = false;     // 已收到END_STREAM
+    bool too_large = false;         // 请求体超过上限，丢弃剩余数据并返回413
+    int64_t send_window = H2_DEFAULT_WINDOW;
+    int64_t recv_window = H2_RECV_WINDOW;
+    std::string response;           // HTTP/1.1格式的完整响应
+    size_t body_offset = 0;         // 下一个要发送的响应体位置
+    bool responding = false;
+    bool headers_sent = false;
+    std::string url;                // 用于统计
+    std::chrono::steady_clock::time_point started;
+};
+
+std::atomic<size_t> g_http2_connections{0};
+
+class Http2Connection {
+public:
+    Http2Connection(socket_t sock) : sock(sock) {}
+
+    // 从HTTP/1.1升级时，原请求作为流1，先应用HTTP2-Settings中的设置
+    bool upgrade(const std::string& head, std::string_view settings_header) {
+        std::string settings;
+        if (!base64url_decode(settings_header, settings) || settings.size() % 6 != 0) return false;
+        if (apply_settings(reinterpret_cast<const uint8_t*>(settings.data()), settings.size()) != H2_NO_ERROR) return false;
+
+        H2Stream& stream = streams[1];
+        stream.send_window = peer_initial_window;
+        stream.started = std::chrono::steady_clock::now();
+        stream.remote_closed = true;
+        std::string_view line = std::string_view(head).substr(0, head.find("\r\n"));
+        size_t method_end = line.find(' ');
+        size_t url_end = line.find(' ', method_end + 1);
+        stream.headers.emplace_back(":method", std::string(line.substr(0, method_end)));
+        stream.headers.emplace_back(":path", std::string(line.substr(method_end + 1, url_end - method_end - 1)));
+        std::string_view rest = std::string_view(head).substr(line.size() + 2);
+        while (!rest.empty()) {
+            std::string_view header = rest.substr(0, rest.find("\r\n"));
+            rest.remove_prefix(std::min(rest.size(), header.size() + 2));
+            size_t colon = header.find(':');
+            if (colon == std::string_view::npos) continue;
+            std::string name(header.substr(0, colon));
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string_view value = header.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            stream.headers.emplace_back(std::move(name), std::string(value));
+        }
+        last_stream_id = 1;
+        pending.push_back(1);
+        preface_remaining = H2_PREFACE.size();
+        return true;
+    }
+
+    // input为读请求头时已收到的字节；直接发送前言时请求行"PRI * HTTP/2.0"已被读走
+    void run(std::string_view input, bool prior_knowledge) {
+        if (prior_knowledge) preface_remaining = H2_PREFACE.size() - 18;
+        buffer.assign(input.data(), input.size());
+
+        std::string settings;
+        append_setting(settings, 0x3, H2_MAX_CONCURRENT_STREAMS);
+        append_setting(settings, 0x4, static_cast<uint32_t>(H2_RECV_WINDOW));
+        append_setting(settings, 0x6, static_cast<uint32_t>(MAX_HEADER_SIZE));
+        append_h2_frame(out, H2_SETTINGS, 0, 0, settings);
+        std::string increment;
+        append_u32(increment, static_cast<uint32_t>(H2_RECV_WINDOW - H2_DEFAULT_WINDOW));
+        append_h2_frame(out, H2_WINDOW_UPDATE, 0, 0, increment);
+
+        std::vector<char> chunk(64 * 1024);
+        while (!closed) {
+            // 收齐客户端的连接前言之后才开始解析帧
+            if (!check_preface()) break;
+            if (preface_remaining == 0 && !process_frames()) break;
+            dispatch_pending();
+            flush_streams();
+            if (!send_output()) break;
+            if (goaway_received && streams.empty()) break;
+            long n = sock_recv(sock, chunk.data(), chunk.size());
+            if (n <= 0) {
+                // 空闲超时或对端关闭
+                send_goaway(H2_NO_ERROR);
+                send_output();
+                break;
             }
-            
-            fclose(file);
-        } else {
-            debug_info += "Failed to open file\n";
-#ifdef _WIN32
-            debug_info += "Error code: " + std::to_string(GetLastError()) + "\n";
-#else
-            debug_info += "Error: " + std::string(strerror(errno)) + "\n";
-#endif
+            buffer.append(chunk.data(), static_cast<size_t>(n));
         }
-    } catch (const std::exception& e) {
-        debug_info += "Exception: " + std::string(e.what()) + "\n";
+        send_output();
     }
 
-    // 如果没有读取到内容，返回调试信息（开发阶段）
-    if (log_content.empty()) {
-        log_content = "暂无训练日志或训练尚未开始...\n\n调试信息:\n" + debug_info;
+private:
+    socket_t sock;
+    std::string buffer;                 // 尚未解析的输入
+    std::string out;                    // 待发送的帧，每轮处理后一次写出
+    size_t preface_remaining = 0;
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    std::map<uint32_t, H2Stream> streams;
+    std::deque<uint32_t> pending;       // 请求已完整、等待处理的流
+    uint32_t last_stream_id = 0;
+    uint32_t continuation_stream = 0;   // 正在接收CONTINUATION的流
+    int64_t conn_send_window = H2_DEFAULT_WINDOW;
+    int64_t conn_recv_window = H2_RECV_WINDOW;
+    int64_t peer_initial_window = H2_DEFAULT_WINDOW;
+    uint32_t peer_max_frame = 16384;
+    size_t buffered_body = 0;           // 各流body的字节数之和，见H2_MAX_BUFFERED_BODY
+    bool goaway_received = false;
+    bool closed = false;
+
+    static void append_setting(std::string& payload, uint16_t id, uint32_t value) {
+        payload += static_cast<char>(id >> 8);
+        payload += static_cast<char>(id & 0xFF);
+        append_u32(payload, value);
     }
 
-    // 构建JSON响应
-    std::ostringstream json;
-    json << "{";
-    json << "\"success\":" << (log_content.find("暂无训练日志") == std::string::npos ? "true" : "false") << ",";
-    json << "\"timestamp\":" << std::time(nullptr) << ",";
-    json << "\"logs\":\"" << escape_json(log_content) << "\"";
-    json << "}";
-    
-    return json_response(json.str());
-}
-    
-    // 配置相关API
-    else if (url == "/api/config/save" && method == "POST") {
-        // 解析POST数据
-        std::string post_data = extract_post_data_config(request);
-        std::cout << "收到配置保存请求: " << post_data << std::endl;
-        
-        auto params = parse_config_json(post_data);
-        
-        std::string config_name = "default_config";
-        std::string config_data = params["config_data"];
-        std::cout << "原始数据: " << config_data << std::endl;
-        
-        // 获取当前工作目录
-        std::string current_dir;
-#ifdef _WIN32
-        // 使用宽字符函数处理可能包含中文的路径
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-        
-        // 替换Windows路径中的反斜杠为正斜杠以适应JSON格式
-        std::string json_dir = current_dir;
-        std::replace(json_dir.begin(), json_dir.end(), '\\', '/');
-        
-        // 使用简单的正则表达式查找和替换路径
-        // 为模型路径添加前缀 - 匹配以/开头但不是完整绝对路径的路径
-        std::regex model_path_regex("\"model_name_or_path\"\\s*:\\s*\"(/[^:\"]+)\"");
-        config_data = std::regex_replace(config_data, model_path_regex, "\"model_name_or_path\":\"" + json_dir + "/llm$1\"");
-        
-        // 为输出目录添加前缀 - 匹配以/开头但不是完整绝对路径的路径
-        std::regex output_dir_regex("\"output_dir\"\\s*:\\s*\"(/[^:\"]+)\"");
-        config_data = std::regex_replace(config_data, output_dir_regex, "\"output_dir\":\"" + json_dir + "/llm$1\"");
-        
-        // 为训练数据文件添加前缀 - 原来的逻辑已经可以正确工作
-        std::regex train_file_regex("\"train_file\"\\s*:\\s*\"([^/\\\"][^\"]+)\"");
-        config_data = std::regex_replace(config_data, train_file_regex, "\"train_file\":\"" + json_dir + "/llm/$1\"");
-        
-        std::cout << "修改后的数据: " << config_data << std::endl;
-#else
-        // Linux实现
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-            
-            // 修改路径
-            std::regex model_path_regex("\"model_name_or_path\"\\s*:\\s*\"([^/][^\"]+)\"");
-            config_data = std::regex_replace(config_data, model_path_regex, "\"model_name_or_path\":\"" + current_dir + "/llm/$1\"");
-            
-            std::regex output_dir_regex("\"output_dir\"\\s*:\\s*\"([^/][^\"]+)\"");
-            config_data = std::regex_replace(config_data, output_dir_regex, "\"output_dir\":\"" + current_dir + "/llm/$1\"");
-            
-            std::regex train_file_regex("\"train_file\"\\s*:\\s*\"([^/][^\"]+)\"");
-            config_data = std::regex_replace(config_data, train_file_regex, "\"train_file\":\"" + current_dir + "/llm/$1\"");
+    bool check_preface() {
+        if (preface_remaining == 0) return true;
+        size_t n = std::min(preface_remaining, buffer.size());
+        std::string_view expected = H2_PREFACE.substr(H2_PREFACE.size() - preface_remaining, n);
+        if (std::string_view(buffer).substr(0, n) != expected) {
+            closed = true;
+            return false;
         }
-#endif
-        
-        std::cout << "配置名称: " << config_name << std::endl;
-        
-        // 防止路径遍历攻击
-        config_name = std::regex_replace(config_name, std::regex("[^a-zA-Z0-9_\\-]"), "_");
+        buffer.erase(0, n);
+        preface_remaining -= n;
+        return true;
+    }
 
-#ifdef _WIN32
-        // 使用宽字符版本获取路径
-        wchar_t buffer[MAX_PATH];
-        GetModuleFileNameW(NULL, buffer, MAX_PATH);
-        
-        // 转换为宽字符串并提取目录部分
-        std::wstring fullPath(buffer);
-        size_t lastSlash = fullPath.find_last_of(L"\\/");
-        std::wstring current_config_dir = fullPath.substr(0, lastSlash);
-        // 转换宽字符串到UTF-8字符串
-        std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
-        std::string current_config_dir_str = converter.to_bytes(current_config_dir);
-        std::cout << "当前目录: " << current_config_dir_str << std::endl;
-        
-        // 构建配置目录路径 (使用正斜杠以避免转义问题)
-        std::wstring configs_dir_w = current_config_dir + L"\\llm\\configs";
-        std::string configs_dir = converter.to_bytes(configs_dir_w);
-#else
-        // Linux实现
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            configs_dir = std::string(buffer) + "/llm/configs";
-            // 确保目录存在
-            mkdir(configs_dir.c_str(), 0755);
-        } else {
-            configs_dir = "./llm/configs";
-            mkdir(configs_dir.c_str(), 0755);
-        }
-#endif
+    bool send_output() {
+        if (out.empty()) return true;
+        bool ok = send_all(sock, out.data(), out.size());
+        out.clear();
+        if (!ok) closed = true;
+        return ok;
+    }
 
-        // 日志记录，便于调试
-        //std::cout << "保存配置: " << config_name << " 到目录: " << configs_dir << std::endl;
-        
-        // 保存配置文件
-        // std::string config_path = configs_dir + "\\" + config_name + ".json";
-        // 使用固定的非中文路径
-        std::string config_path = "C:\\Windows\\elianfactory\\default_config.json";
-        // std::cout << "完整配置路径: " << config_path << std::endl;
-        
-        bool success = false;
-        std::string error_msg = "";
-        
-        try {
-            // 使用独占写入模式打开文件
-            std::ofstream config_file(config_path, std::ios::out | std::ios::trunc);
-            if (config_file.is_open()) {
-                config_file << config_data;
-                config_file.flush(); // 确保数据刷新到磁盘
-                config_file.close();
-                
-                // 验证文件是否真的被写入
-                std::ifstream verify_file(config_path);
-                std::string content;
-                if (verify_file.is_open()) {
-                    std::stringstream buffer;
-                    buffer << verify_file.rdbuf();
-                    content = buffer.str();
-                    verify_file.close();
-                    
-                    if (content.find(config_data) != std::string::npos) {
-                        success = true;
-                        std::cout << "配置保存成功并已验证: " << config_path << std::endl;
-                    } else {
-                        error_msg = "文件写入验证失败，内容不匹配";
-                        std::cerr << error_msg << std::endl;
-                    }
-                } else {
-                    error_msg = "无法打开文件进行验证";
-                    std::cerr << error_msg << std::endl;
+    void send_goaway(H2ErrorCode code) {
+        std::string payload;
+        append_u32(payload, last_stream_id);
+        append_u32(payload, code);
+        append_h2_frame(out, H2_GOAWAY, 0, 0, payload);
+    }
+
+    bool connection_error(H2ErrorCode code) {
+        send_goaway(code);
+        send_output();
+        closed = true;
+        return false;
+    }
+
+    void reset_stream(uint32_t id, H2ErrorCode code) {
+        std::string payload;
+        append_u32(payload, code);
+        append_h2_frame(out, H2_RST_STREAM, 0, id, payload);
+        erase_stream(id);
+    }
+
+    void erase_stream(uint32_t id) {
+        auto it = streams.find(id);
+        if (it == streams.end()) return;
+        release_body(it->second);
+        streams.erase(it);
+    }
+
+    // 请求体已交给处理流程或流已结束，释放缓冲
+    void release_body(H2Stream& stream) {
+        buffered_body -= stream.body.size();
+        std::string().swap(stream.body);
+    }
+
+    // 返回错误码；窗口调整对已有的流同样生效
+    H2ErrorCode apply_settings(const uint8_t* p, size_t length) {
+        for (size_t i = 0; i + 6 <= length; i += 6) {
+            uint16_t id = static_cast<uint16_t>((p[i] << 8) | p[i + 1]);
+            uint32_t value = read_u32(p + i + 2);
+            if (id == 0x1) {
+                encoder.set_peer_table_size(value);
+            } else if (id == 0x2 && value > 1) {
+                return H2_PROTOCOL_ERROR;
+            } else if (id == 0x4) {
+                if (value > H2_MAX_WINDOW) return H2_FLOW_CONTROL_ERROR;
+                int64_t delta = static_cast<int64_t>(value) - peer_initial_window;
+                peer_initial_window = value;
+                for (auto& item : streams) {
+                    item.second.send_window += delta;
+                    if (item.second.send_window > H2_MAX_WINDOW) return H2_FLOW_CONTROL_ERROR;
                 }
-            } else {
-                error_msg = "无法打开文件进行写入: " + config_path;
-                std::cerr << error_msg << std::endl;
+            } else if (id == 0x5) {
+                if (value < 16384 || value > 16777215) return H2_PROTOCOL_ERROR;
+                peer_max_frame = value;
+            }
+        }
+        return H2_NO_ERROR;
+    }
+
+    // 处理缓冲区中所有完整的帧，连接错误时返回false
+    bool process_frames() {
+        size_t pos = 0;
+        while (!closed && buffer.size() - pos >= 9) {
+            const uint8_t* h = reinterpret_cast<const uint8_t*>(buffer.data() + pos);
+            uint32_t length = (uint32_t(h[0]) << 16) | (uint32_t(h[1]) << 8) | h[2];
+            if (length > H2_MAX_FRAME_SIZE) return connection_error(H2_FRAME_SIZE_ERROR);
+            if (buffer.size() - pos < 9 + length) break;
+            uint8_t type = h[3];
+            uint8_t flags = h[4];
+            uint32_t stream_id = read_u32(h + 5) & 0x7FFFFFFF;
+            std::string_view payload(buffer.data() + pos + 9, length);
+            pos += 9 + length;
+            if (continuation_stream != 0 && (type != H2_CONTINUATION || stream_id != continuation_stream)) {
+                return connection_error(H2_PROTOCOL_ERROR);
+            }
+            if (!handle_frame(type, flags, stream_id, payload)) return false;
+        }
+        buffer.erase(0, pos);
+        return !closed;
+    }
+
+    bool handle_frame(uint8_t type, uint8_t flags, uint32_t stream_id, std::string_view payload) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data());
+        switch (type) {
+        case H2_DATA:
+            return handle_data(flags, stream_id, payload);
+        case H2_HEADERS:
+            return handle_headers(flags, stream_id, payload);
+        case H2_CONTINUATION: {
+            auto it = streams.find(stream_id);
+            if (stream_id == 0 || stream_id != continuation_stream || it == streams.end()) return connection_error(H2_PROTOCOL_ERROR);
+            it->second.header_block.append(payload.data(), payload.size());
+            if (it->second.header_block.size() > MAX_HEADER_SIZE) return connection_error(H2_ENHANCE_YOUR_CALM);
+            if (flags & H2_FLAG_END_HEADERS) {
+                continuation_stream = 0;
+                return finish_headers(stream_id);
+            }
+            return true;
+        }
+        case H2_PRIORITY:
+            if (stream_id == 0) return connection_error(H2_PROTOCOL_ERROR);
+            if (payload.size() != 5) return connection_error(H2_FRAME_SIZE_ERROR);
+            return true;
+        case H2_RST_STREAM:
+            if (stream_id == 0) return connection_error(H2_PROTOCOL_ERROR);
+            if (payload.size() != 4) return connection_error(H2_FRAME_SIZE_ERROR);
+            if (stream_id > last_stream_id) return connection_error(H2_PROTOCOL_ERROR);
+            erase_stream(stream_id);
+            pending.erase(std::remove(pending.begin(), pending.end(), stream_id), pending.end());
+            return true;
+        case H2_SETTINGS: {
+            if (stream_id != 0) return connection_error(H2_PROTOCOL_ERROR);
+            if (flags & H2_FLAG_ACK) return payload.empty() ? true : connection_error(H2_FRAME_SIZE_ERROR);
+            if (payload.size() % 6 != 0) return connection_error(H2_FRAME_SIZE_ERROR);
+            H2ErrorCode code = apply_settings(p, payload.size());
+            if (code != H2_NO_ERROR) return connection_error(code);
+            append_h2_frame(out, H2_SETTINGS, H2_FLAG_ACK, 0, std::string_view());
+            return true;
+        }
+        case H2_PUSH_PROMISE:
+            return connection_error(H2_PROTOCOL_ERROR);
+        case H2_PING:
+            if (stream_id != 0) return connection_error(H2_PROTOCOL_ERROR);
+            if (payload.size() != 8) return connection_error(H2_FRAME_SIZE_ERROR);
+            if (!(flags & H2_FLAG_ACK)) append_h2_frame(out, H2_PING, H2_FLAG_ACK, 0, payload);
+            return true;
+        case H2_GOAWAY:
+            if (stream_id != 0) return connection_error(H2_PROTOCOL_ERROR);
+            goaway_received = true;
+            return true;
+        case H2_WINDOW_UPDATE: {
+            if (payload.size() != 4) return connection_error(H2_FRAME_SIZE_ERROR);
+            uint32_t increment = read_u32(p) & 0x7FFFFFFF;
+            if (stream_id == 0) {
+                if (increment == 0) return connection_error(H2_PROTOCOL_ERROR);
+                conn_send_window += increment;
+                if (conn_send_window > H2_MAX_WINDOW) return connection_error(H2_FLOW_CONTROL_ERROR);
+                return true;
+            }
+            auto it = streams.find(stream_id);
+            if (it == streams.end()) return true;   // 已关闭的流可能还会收到WINDOW_UPDATE
+            if (increment == 0) {
+                reset_stream(stream_id, H2_PROTOCOL_ERROR);
+                return true;
+            }
+            it->second.send_window += increment;
+            if (it->second.send_window > H2_MAX_WINDOW) reset_stream(stream_id, H2_FLOW_CONTROL_ERROR);
+            return true;
+        }
+        default:
+            return true;   // 未知类型的帧按协议忽略
+        }
+    }
+
+    // 去掉填充，失败时返回false
+    static bool strip_padding(uint8_t flags, std::string_view& payload) {
+        if (!(flags & H2_FLAG_PADDED)) return true;
+        if (payload.empty()) return false;
+        size_t padding = static_cast<uint8_t>(payload[0]);
+        if (padding >= payload.size()) return false;
+        payload = payload.substr(1, payload.size() - 1 - padding);
+        return true;
+    }
+
+    bool handle_data(uint8_t flags, uint32_t stream_id, std::string_view payload) {
+        if (stream_id == 0) return connection_error(H2_PROTOCOL_ERROR);
+        // 流量控制按整个帧的长度（含填充）计算，收到后立即归还窗口
+        int64_t length = static_cast<int64_t>(payload.size());
+        conn_recv_window -= length;
+        if (conn_recv_window < 0) return connection_error(H2_FLOW_CONTROL_ERROR);
+        if (length > 0) {
+            std::string increment;
+            append_u32(increment, static_cast<uint32_t>(length));
+            append_h2_frame(out, H2_WINDOW_UPDATE, 0, 0, increment);
+            conn_recv_window += length;
+        }
+        if (!strip_padding(flags, payload)) return connection_error(H2_PROTOCOL_ERROR);
+
+        auto it = streams.find(stream_id);
+        if (it == streams.end() || it->second.remote_closed) {
+            if (stream_id > last_stream_id) return connection_error(H2_PROTOCOL_ERROR);
+            std::string code;
+            append_u32(code, H2_STREAM_CLOSED);
+            append_h2_frame(out, H2_RST_STREAM, 0, stream_id, code);
+            return true;
+        }
+        H2Stream& stream = it->second;
+        stream.recv_window -= length;
+        if (stream.recv_window < 0) {
+            reset_stream(stream_id, H2_FLOW_CONTROL_ERROR);
+            return true;
+        }
+        if (stream.body.size() + payload.size() > MAX_BODY_SIZE) {
+            stream.too_large = true;
+            release_body(stream);
+        }
+        if (!stream.too_large) {
+            if (buffered_body + payload.size() > H2_MAX_BUFFERED_BODY) {
+                reset_stream(stream_id, H2_ENHANCE_YOUR_CALM);
+                return true;
             }
-        } catch (const std::exception& e) {
-            error_msg = e.what();
-            std::cerr << "保存配置文件异常: " << error_msg << std::endl;
+            stream.body.append(payload.data(), payload.size());
+            buffered_body += payload.size();
         }
-        
-        // 返回结果
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":" << (success ? "true" : "false");
-        if (!success) {
-            json << ",\"message\":\"保存配置失败\"";
-            json << ",\"error\":\"" << escape_json(error_msg) << "\"";
-        } else {
-            json << ",\"message\":\"配置已成功保存\"";
-            json << ",\"path\":\"" << escape_json(config_path) << "\"";
+        if (flags & H2_FLAG_END_STREAM) {
+            stream.remote_closed = true;
+            pending.push_back(stream_id);
+        } else if (length > 0) {
+            std::string increment;
+            append_u32(increment, static_cast<uint32_t>(length));
+            append_h2_frame(out, H2_WINDOW_UPDATE, 0, stream_id, increment);
+            stream.recv_window += length;
         }
-        json << "}";
-        
-        return json_response(json.str());
+        return true;
     }
-    else if (url == "/api/config/list") {
-        std::vector<std::string> configs;
-        std::string error = "";
-        
-        // 获取configs目录路径
-        std::string configs_dir;
-#ifdef _WIN32
-        wchar_t buffer[MAX_PATH];
-        GetModuleFileNameW(NULL, buffer, MAX_PATH);
-        std::wstring fullPath(buffer);
-        size_t lastSlash = fullPath.find_last_of(L"\\/");
-        std::wstring configsDirW = fullPath.substr(0, lastSlash) + L"\\llm\\configs";
-        
-        // 确保目录存在
-        CreateDirectoryW(configsDirW.c_str(), NULL);
-        
-        // 列出所有配置文件
-        WIN32_FIND_DATAW ffd;
-        HANDLE hFind = FindFirstFileW((configsDirW + L"\\*.json").c_str(), &ffd);
-        
-        if (hFind != INVALID_HANDLE_VALUE) {
-            do {
-                if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-                    // 将文件名转换为UTF-8
-                    int size_needed = WideCharToMultiByte(CP_UTF8, 0, ffd.cFileName, -1, NULL, 0, NULL, NULL);
-                    std::vector<char> nameBuffer(size_needed);
-                    WideCharToMultiByte(CP_UTF8, 0, ffd.cFileName, -1, nameBuffer.data(), size_needed, NULL, NULL);
-                    
-                    std::string fileName(nameBuffer.data());
-                    
-                    // 移除.json后缀
-                    if (ends_with(fileName, ".json")) {
-                        fileName = fileName.substr(0, fileName.length() - 5);
-                        configs.push_back(fileName);
-                    }
-                }
-            } while (FindNextFileW(hFind, &ffd) != 0);
-            
-            FindClose(hFind);
+
+    bool handle_headers(uint8_t flags, uint32_t stream_id, std::string_view payload) {
+        if (stream_id == 0 || (stream_id & 1) == 0) return connection_error(H2_PROTOCOL_ERROR);
+        if (!strip_padding(flags, payload)) return connection_error(H2_PROTOCOL_ERROR);
+        if (flags & H2_FLAG_PRIORITY) {
+            if (payload.size() < 5) return connection_error(H2_FRAME_SIZE_ERROR);
+            payload.remove_prefix(5);
         }
-#else
-        // Linux实现
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            configs_dir = std::string(buffer) + "/llm/configs";
-        } else {
-            configs_dir = "./llm/configs";
+
+        auto it = streams.find(stream_id);
+        if (it == streams.end()) {
+            if (stream_id <= last_stream_id) return connection_error(H2_STREAM_CLOSED);
+            last_stream_id = stream_id;
+            it = streams.emplace(stream_id, H2Stream()).first;
+            it->second.send_window = peer_initial_window;
+            it->second.started = std::chrono::steady_clock::now();
+        } else if (it->second.remote_closed) {
+            return connection_error(H2_STREAM_CLOSED);
         }
-        
-        // 确保目录存在
-        mkdir(configs_dir.c_str(), 0755);
-        
-        DIR* dir = opendir(configs_dir.c_str());
-        if (dir != NULL) {
-            struct dirent* entry;
-            while ((entry = readdir(dir)) != NULL) {
-                std::string fileName = entry->d_name;
-                if (ends_with(fileName, ".json")) {
-                    fileName = fileName.substr(0, fileName.length() - 5);
-                    configs.push_back(fileName);
-                }
-            }
-            closedir(dir);
+        H2Stream& stream = it->second;
+        stream.header_block.append(payload.data(), payload.size());
+        if (flags & H2_FLAG_END_STREAM) stream.remote_closed = true;
+        if (!(flags & H2_FLAG_END_HEADERS)) {
+            continuation_stream = stream_id;
+            return true;
         }
-#endif
+        return finish_headers(stream_id);
+    }
 
-        // 构建JSON响应
-        std::ostringstream json;
-        json << "{\"success\":true,\"configs\":[";
-        
-        for (size_t i = 0; i < configs.size(); ++i) {
-            if (i > 0) json << ",";
-            json << "\"" << escape_json(configs[i]) << "\"";
+    // 头部块收齐后解码；即使流会被拒绝也要解码，保持HPACK状态一致
+    bool finish_headers(uint32_t stream_id) {
+        H2Stream& stream = streams[stream_id];
+        H2HeaderList headers;
+        if (!decoder.decode(stream.header_block, headers)) return connection_error(H2_COMPRESSION_ERROR);
+        stream.header_block.clear();
+        bool trailers = !stream.headers.empty();
+        if (!trailers) stream.headers = std::move(headers);
+
+        if (!trailers && (goaway_received || streams.size() > H2_MAX_CONCURRENT_STREAMS)) {
+            reset_stream(stream_id, H2_REFUSED_STREAM);
+            return true;
         }
-        
-        json << "]}";
-        return json_response(json.str());
+        if (stream.remote_closed) pending.push_back(stream_id);
+        return true;
     }
-    else if (starts_with(url, "/api/config/load")) {
-        // 解析查询参数
-        std::string config_name;
-        size_t query_start = url.find('?');
-        
-        if (query_start != std::string::npos) {
-            std::string query = url.substr(query_start + 1);
-            std::istringstream query_stream(query);
-            std::string param;
-            
-            while (std::getline(query_stream, param, '&')) {
-                size_t eq_pos = param.find('=');
-                if (eq_pos != std::string::npos) {
-                    std::string key = param.substr(0, eq_pos);
-                    std::string value = param.substr(eq_pos + 1);
-                    
-                    if (key == "name") {
-                        config_name = value;
-                        break;
-                    }
-                }
-            }
+
+    // 按请求头还原HTTP/1.1请求，交给原有的处理流程
+    void dispatch_pending() {
+        while (!pending.empty()) {
+            uint32_t id = pending.front();
+            pending.pop_front();
+            auto it = streams.find(id);
+            if (it == streams.end() || it->second.responding) continue;
+            dispatch(it->second);
+            release_body(it->second);
+            request_arena().reset();
         }
-        
-        if (config_name.empty()) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"缺少配置名称参数\"}";
-            return json_response(json.str());
+    }
+
+    void dispatch(H2Stream& stream) {
+        std::string method, path, authority;
+        std::string request;
+        std::string fields;
+        for (const auto& header : stream.headers) {
+            if (header.first == ":method") method = header.second;
+            else if (header.first == ":path") path = header.second;
+            else if (header.first == ":authority") authority = header.second;
+            else if (header.first.empty() || header.first[0] == ':') continue;
+            else if (header.first != "content-length" && header.first != "host") fields += header.first + ": " + header.second + "\r\n";
         }
-        
-        // 防止路径遍历攻击
-        config_name = std::regex_replace(config_name, std::regex("[^a-zA-Z0-9_\\-]"), "_");
-        
-        // 构建配置文件路径
-        std::string config_path;
-        std::string config_content;
-        bool success = false;
-        
-#ifdef _WIN32
-        // 构建配置路径
-        wchar_t buffer[MAX_PATH];
-        GetModuleFileNameW(NULL, buffer, MAX_PATH);
-        std::wstring fullPath(buffer);
-        size_t lastSlash = fullPath.find_last_of(L"\\/");
-        
-        // 先检查目录是否存在
-        std::wstring configDirW = fullPath.substr(0, lastSlash) + L"\\llm\\configs";
-        CreateDirectoryW(configDirW.c_str(), NULL); // 确保目录存在
-        
-        std::wstring configFileW = configDirW + L"\\" + s2ws(config_name) + L".json";
-        
-        // 转换为多字节字符串路径
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, configFileW.c_str(), -1, NULL, 0, NULL, NULL);
-        std::vector<char> configPathBuffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, configFileW.c_str(), -1, configPathBuffer.data(), size_needed, NULL, NULL);
-        config_path = std::string(configPathBuffer.data());
-#else
-        // Linux实现
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            std::string current_dir = buffer;
-            config_path = current_dir + "/llm/configs/" + config_name + ".json";
-        } else {
-            config_path = "./llm/configs/" + config_name + ".json";
+        stream.url = path;
+        stream.responding = true;
+        if (method.empty() || path.empty()) {
+            stream.response = json_response("{\"success\":false,\"message\":\"缺少:method或:path\"}", "400 Bad Request");
+            return;
         }
-#endif
-        
-        // 检查文件是否存在
-        if (file_exists(config_path)) {
-            try {
-                // 读取配置文件
-                std::ifstream config_file(config_path);
-                if (config_file.is_open()) {
-                    std::stringstream buffer;
-                    buffer << config_file.rdbuf();
-                    config_content = buffer.str();
-                    config_file.close();
-                    success = true;
-                }
-            } catch (const std::exception& e) {
-                // 读取出错
-                success = false;
-                config_content = std::string("读取配置文件出错: ") + e.what();
-            }
+        if (stream.too_large) {
+            stream.response = json_response("{\"success\":false,\"message\":\"请求体过大\"}", "413 Payload Too Large");
+            return;
         }
 
-        // 返回结果
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":" << (success ? "true" : "false");
-        
-        if (success) {
-            json << ",\"config\":" << config_content;
-        } else {
-            json << ",\"message\":\"配置文件不存在或无法读取\"";
-            if (!config_content.empty()) {
-                json << ",\"error\":\"" << escape_json(config_content) << "\"";
+        request = method + " " + path + " HTTP/1.1\r\n";
+        if (!authority.empty()) request += "Host: " + authority + "\r\n";
+        request += fields;
+        if (!stream.body.empty()) request += "Content-Length: " + std::to_string(stream.body.size()) + "\r\n";
+        request += "\r\n";
+        size_t head_size = request.size();
+        request += stream.body;
+
+        HttpRequestHead req;
+        req.method = std::string_view(request).substr(0, method.size());
+        req.url = std::string_view(request).substr(method.size() + 1, path.size());
+        req.head = std::string_view(request).substr(0, head_size);
+        req.content_length = stream.body.size();
+        req.body_prefix = std::string_view(request).substr(head_size);
+
+        TraceSpan request_span("request", req.url.substr(0, req.url.find('?')));
+        std::string owned;
+        std::string_view response = buffered_response(sock, req, request, owned);
+        stream.response.assign(response.data(), response.size());
+        size_t header_end = stream.response.find("\r\n\r\n");
+        if (method == "HEAD" && header_end != std::string::npos) stream.response.resize(header_end + 4);
+    }
+
+    // 转为HTTP/2的头部块：状态码作为:status，去掉连接相关的头部，名字改为小写
+    std::string encode_response_headers(const std::string& response, size_t header_end) {
+        std::string block;
+        encoder.begin_block(block);
+        encoder.encode(":status", std::string_view(response).substr(9, 3), block);
+        std::string_view rest = std::string_view(response).substr(0, header_end + 2);
+        rest.remove_prefix(rest.find("\r\n") + 2);
+        std::string name;
+        while (!rest.empty()) {
+            std::string_view line = rest.substr(0, rest.find("\r\n"));
+            rest.remove_prefix(line.size() + 2);
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos) continue;
+            name.assign(line.data(), colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+                name == "transfer-encoding" || name == "upgrade") {
+                continue;
             }
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+            encoder.encode(name, value, block);
         }
-        
-        json << "}";
-        return json_response(json.str());
+        return block;
     }
-    else if (starts_with(url, "/api/config/delete") && method == "DELETE") {
-        // 解析查询参数
-        std::string config_name;
-        size_t query_start = url.find('?');
-        
-        if (query_start != std::string::npos) {
-            std::string query = url.substr(query_start + 1);
-            std::istringstream query_stream(query);
-            std::string param;
-            
-            while (std::getline(query_stream, param, '&')) {
-                size_t eq_pos = param.find('=');
-                if (eq_pos != std::string::npos) {
-                    std::string key = param.substr(0, eq_pos);
-                    std::string value = param.substr(eq_pos + 1);
-                    
-                    if (key == "name") {
-                        config_name = value;
-                        break;
+
+    // 各流轮流发送一帧，直到全部发完或窗口用尽
+    void flush_streams() {
+        bool progress = true;
+        while (progress && !closed) {
+            progress = false;
+            for (auto it = streams.begin(); it != streams.end();) {
+                H2Stream& stream = it->second;
+                if (!stream.responding) {
+                    ++it;
+                    continue;
+                }
+                uint32_t id = it->first;
+                size_t header_end = stream.response.find("\r\n\r\n");
+                if (header_end == std::string::npos || stream.response.size() < 12) {
+                    stream.response = json_response("{\"success\":false,\"message\":\"内部错误\"}", "500 Internal Server Error");
+                    header_end = stream.response.find("\r\n\r\n");
+                }
+                size_t body_size = stream.response.size() - header_end - 4;
+                if (!stream.headers_sent) {
+                    send_headers(id, encode_response_headers(stream.response, header_end), body_size == 0);
+                    stream.headers_sent = true;
+                    stream.body_offset = 0;
+                    progress = true;
+                }
+                size_t remaining = body_size - stream.body_offset;
+                if (remaining > 0) {
+                    int64_t window = std::min(conn_send_window, stream.send_window);
+                    size_t n = std::min<size_t>(remaining, peer_max_frame);
+                    if (window <= 0) {
+                        ++it;
+                        continue;
                     }
+                    n = std::min<size_t>(n, static_cast<size_t>(window));
+                    bool last = n == remaining;
+                    append_h2_frame(out, H2_DATA, last ? H2_FLAG_END_STREAM : 0, id,
+                                    std::string_view(stream.response).substr(header_end + 4 + stream.body_offset, n));
+                    stream.body_offset += n;
+                    conn_send_window -= static_cast<int64_t>(n);
+                    stream.send_window -= static_cast<int64_t>(n);
+                    remaining -= n;
+                    progress = true;
+                    // 输出缓冲较大时先写出，避免整批响应都堆在内存里
+                    if (out.size() >= 256 * 1024 && !send_output()) return;
                 }
+                if (remaining == 0) {
+                    metrics_observe_request(stream.url, stream.response, std::chrono::duration<double>(std::chrono::steady_clock::now() - stream.started).count());
+                    it = streams.erase(it);
+                    continue;
+                }
+                ++it;
             }
         }
-        
-        if (config_name.empty()) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"缺少配置名称参数\"}";
-            return json_response(json.str());
-        }
-        
-        // 防止路径遍历攻击
-        config_name = std::regex_replace(config_name, std::regex("[^a-zA-Z0-9_\\-]"), "_");
-        
-        // 构建配置文件路径
-        std::string config_path;
-        bool success = false;
-        std::string error_msg;
-        
-#ifdef _WIN32
-        wchar_t buffer[MAX_PATH];
-        GetModuleFileNameW(NULL, buffer, MAX_PATH);
-        std::wstring fullPath(buffer);
-        size_t lastSlash = fullPath.find_last_of(L"\\/");
-        std::wstring configFileW = fullPath.substr(0, lastSlash) + L"\\llm\\configs\\" + s2ws(config_name) + L".json";
-        
-        // 删除文件
-        if (DeleteFileW(configFileW.c_str())) {
-            success = true;
-        } else {
-            DWORD error = GetLastError();
-            if (error == ERROR_FILE_NOT_FOUND) {
-                error_msg = "配置文件不存在";
-            } else {
-                error_msg = "删除文件失败，错误码: " + std::to_string(error);
-            }
-        }
-#else
-        // Linux实现
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            config_path = std::string(buffer) + "/llm/configs/" + config_name + ".json";
-        } else {
-            config_path = "./llm/configs/" + config_name + ".json";
-        }
-        
-        if (remove(config_path.c_str()) == 0) {
-            success = true;
-        } else {
-            error_msg = "删除文件失败: " + std::string(strerror(errno));
-        }
-#endif
-        
-        // 返回结果
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":" << (success ? "true" : "false");
-        
-        if (success) {
-            json << ",\"message\":\"配置已成功删除\"";
-        } else {
-            json << ",\"message\":\"删除配置失败\"";
-            json << ",\"error\":\"" << escape_json(error_msg) << "\"";
+    }
+
+    void send_headers(uint32_t id, const std::string& block, bool end_stream) {
+        size_t offset = 0;
+        bool first = true;
+        do {
+            size_t n = std::min<size_t>(block.size() - offset, peer_max_frame);
+            bool last = offset + n == block.size();
+            uint8_t flags = last ? H2_FLAG_END_HEADERS : 0;
+            if (first && end_stream) flags |= H2_FLAG_END_STREAM;
+            append_h2_frame(out, first ? H2_HEADERS : H2_CONTINUATION, flags, id, std::string_view(block).substr(offset, n));
+            offset += n;
+            first = false;
+        } while (offset < block.size());
+    }
+};
+
+// 在独立线程中处理HTTP/2连接，连接数已满时返回false
+bool start_http2_connection(socket_t client, const HttpRequestHead& req, bool upgrade) {
+    if (g_http2_connections.fetch_add(1) >= H2_MAX_CONNECTIONS) {
+        g_http2_connections.fetch_sub(1);
+        return false;
+    }
+    std::string head(req.head);
+    std::string input(req.body_prefix);
+    std::string settings(get_header_view(req.head, "HTTP2-Settings"));
+    if (upgrade) {
+        static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        send_all(client, switching, sizeof(switching) - 1);
+    }
+    std::thread([client, head, input, settings, upgrade]() {
+        {
+            Http2Connection connection(client);
+            if (!upgrade || connection.upgrade(head, settings)) connection.run(input, !upgrade);
         }
-        
-        json << "}";
-        return json_response(json.str());
+        close_socket(client);
+        request_arena().reset();
+        g_http2_connections.fetch_sub(1);
+    }).detach();
+    return true;
+}
+
+// HTTP/2连接前言或Upgrade: h2c时接管连接，返回true表示已处理
+bool serve_http2(socket_t client, const HttpRequestHead& req) {
+    if (req.method == "PRI" && req.url == "*") {
+        if (start_http2_connection(client, req, false)) return true;
+        // 连接数已满，按协议先发送SETTINGS再用GOAWAY拒绝
+        std::string frames;
+        append_h2_frame(frames, H2_SETTINGS, 0, 0, std::string_view());
+        std::string payload;
+        append_u32(payload, 0);
+        append_u32(payload, H2_ENHANCE_YOUR_CALM);
+        append_h2_frame(frames, H2_GOAWAY, 0, 0, payload);
+        send_all(client, frames.data(), frames.size());
+        close_socket(client);
+        return true;
     }
-    else if (url == "/api/inference" && method == "POST") {
-        // 读取POST数据体
-        std::string request_body = extract_post_data(request);
-        std::cout << "收到推理请求：" << request_body << std::endl;
-        
-        // 解析JSON配置
-        std::map<std::string, std::string> inferenceData = parse_json(request_body);
-        
-        // 获取参数
-        std::string model_path = inferenceData["model_path"];
-        std::string prompt = inferenceData["prompt"];
-        std::string max_new_tokens = inferenceData["max_new_tokens"];
-        
-        // 参数验证
-        if (model_path.empty() || prompt.empty()) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"缺少必要参数\"}";
-            return json_response(json.str());
+    // 带请求体的升级请求按HTTP/1.1处理；连接数已满时同样忽略升级
+    if (req.content_length != 0 || !header_has_token(get_header_view(req.head, "Upgrade"), "h2c") ||
+        !header_has_token(get_header_view(req.head, "Connection"), "upgrade") ||
+        get_header_view(req.head, "HTTP2-Settings").empty()) {
+        return false;
+    }
+    return start_http2_connection(client, req, true);
+}
+
+// 分发已读完请求头的请求并写回响应，返回前关闭连接（或交给HTTP/2、WebSocket、长轮询继续处理）
+void serve_request(socket_t client, HttpRequestHead& req, std::chrono::steady_clock::time_point started) {
+    TraceSpan request_span("request", req.url.substr(0, req.url.find('?')));
+
+    // 内容固定的端点直接发送静态响应，状态端点支持条件请求和长轮询，预览等大响应分块发送，轮询端点在请求内存池中构建响应
+    std::string_view fast;
+    if (req.content_length == 0) {
+        if (serve_http2(client, req)) return;
+        fast = find_static_response(req.method, req.url);
+        if (req.url.substr(0, req.url.find('?')) == "/api/ws") {
+            serve_websocket(client, req, started);
+            return;
         }
-        
-        // 如果max_new_tokens为空，设置默认值
-        if (max_new_tokens.empty()) {
-            max_new_tokens = "2048";
+        const ConditionalRoute* conditional = fast.empty() ? find_conditional_route(req.method, req.url) : nullptr;
+        if (conditional) {
+            serve_conditional(client, req, *conditional, started);
+            return;
         }
-        
-        // 获取当前工作目录
-        std::string current_dir;
-#ifdef _WIN32
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-        
-        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
-        for (char &c : current_dir) {
-            if (c == '\\') c = '/';
+        if (fast.empty()) {
+            size_t streamed = stream_api_request(client, req);
+            if (streamed > 0) {
+                close_socket(client);
+                metrics_observe_request(req.url, "HTTP/1.1 200", streamed, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+                return;
+            }
+            fast = handle_arena_request(req.method, req.url);
         }
-#else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
+    }
+    if (!fast.empty()) {
+        if (accepts_gzip(req.head)) fast = gzip_response(fast);
+        send_all(client, fast.data(), fast.size());
+        close_socket(client);
+        metrics_observe_request(req.url, fast, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        return;
+    }
+
+    std::string response;
+    if (starts_with(req.url, "/api/data/upload?") && (req.method == "POST" || req.method == "PUT" || req.method == "GET")) {
+        response = handle_upload(client, req);
+    } else if (req.content_length > MAX_BODY_SIZE) {
+        response = json_response("{\"success\":false,\"message\":\"请求体过大\"}", "413 Payload Too Large");
+    } else {
+        std::string request;
+        if (read_request_body(client, req, request)) {
+            response = handle_request(request);
         }
-#endif
+    }
+
+    std::string_view out = response;
+    if (!out.empty() && accepts_gzip(req.head)) out = gzip_response(out);
+    if (!out.empty()) {
+        send_all(client, out.data(), out.size());
+    }
+    close_socket(client);
+    metrics_observe_request(req.url, out, std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+}
+
+// 处理一个客户端连接：读取请求、分发、写回响应
+void serve_connection(socket_t client) {
+    set_socket_timeout(client, SOCKET_TIMEOUT_SECONDS);
+    // 无论从哪里返回，响应发出后都复位请求内存池
+    struct ArenaReset {
+        ~ArenaReset() { request_arena().reset(); }
+    } arena_reset;
+    metrics_count(COUNTER_CONNECTIONS);
+
+    HttpRequestHead req;
+    if (!read_request_head(client, req)) {
+        metrics_count(COUNTER_BAD_REQUESTS);
+        close_socket(client);
+        return;
+    }
+    serve_request(client, req, std::chrono::steady_clock::now());
+}
+
+// ==================== 事件驱动I/O ====================
+// Linux下不再逐个阻塞accept/recv：事件循环同时读取多个连接的请求，能在内存中完成的请求
+// （静态页面、状态查询、配置读写等）生成响应后异步发送；上传、分块流式响应、WebSocket、
+// HTTP/2、挂起的长轮询，以及会启动子进程或扫描整个数据集的端点（BLOCKING_ROUTES、缓存未命中）切回阻塞socket，交给HandoffPool的工作线程用serve_request按原来的方式处理，
+// 慢客户端只占住工作线程，不会卡住事件循环里的其他连接。工作线程都忙时回503。
+// 环境变量ELIAN_IO_BACKEND选择实现：
+//   uring     io_uring：多发accept，请求读入预先注册的缓冲区，accept/读/发送/关闭都作为提交项
+//             批量提交，每轮循环只有一次io_uring_enter
+//   epoll     epoll + 非阻塞socket，一次唤醒处理所有就绪连接
+//   blocking  原来的顺序accept循环
+// 缺省（auto）依次尝试uring、epoll。/metrics的elian_io_backend给出实际使用的实现。
+
+#ifdef __linux__
+
+const size_t EVENT_SLOT_SIZE = MAX_HEADER_SIZE + 16 * 1024;   // 每个连接的请求缓冲区：请求头加小请求体
+const size_t EVENT_MAX_CONNECTIONS = 128;                     // 缓冲区用完时新连接交给工作线程
+const size_t EVENT_ACCEPT_BATCH = 64;                         // epoll每次唤醒最多accept的连接数
+const size_t HANDOFF_THREADS_DEFAULT = 64;                    // 阻塞处理的工作线程上限，见HandoffPool
+
+// 连接缓冲区池：一次分配，io_uring下每个槽注册为一个固定缓冲区，槽号即连接下标
+class EventBufferPool {
+public:
+    EventBufferPool() : memory(new char[EVENT_SLOT_SIZE * EVENT_MAX_CONNECTIONS]) {
+        for (size_t i = EVENT_MAX_CONNECTIONS; i > 0; --i) free_slots.push_back(i - 1);
+    }
+
+    char* slot(size_t index) { return memory.get() + index * EVENT_SLOT_SIZE; }
+
+    bool acquire(size_t& index) {
+        if (free_slots.empty()) return false;
+        index = free_slots.back();
+        free_slots.pop_back();
+        return true;
+    }
+
+    void release(size_t index) { free_slots.push_back(index); }
+
+private:
+    std::unique_ptr<char[]> memory;
+    std::vector<size_t> free_slots;
+};
+
+enum class EventState { Free, Reading, Sending, Closing };
+
+struct EventConnection {
+    int fd = -1;
+    EventState state = EventState::Free;
+    size_t length = 0;              // 缓冲区中已读到的字节数
+    std::string response;
+    size_t sent = 0;
+    std::string url;                // 记录指标用
+    std::chrono::steady_clock::time_point started;
+    bool expired = false;
+};
+
+enum class EventAction { NeedMore, Respond, Handoff, Close };
+
+void set_nonblocking(int fd, bool enabled) {
+    metrics_count(COUNTER_SOCKET_SYSCALLS, 2);
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+}
+
+// 可能长时间占用线程的处理：启动子进程（训练、推理、部署）、扫描或改写整个数据集（冷缓存时建索引、
+// 统计、去重、预分词）、读取所有分片的头部。method为空表示不限方法
+struct BlockingRoute {
+    std::string_view method;
+    std::string_view path;
+};
+
+const BlockingRoute BLOCKING_ROUTES[] = {
+    {"", "/api/train"},
+    {"POST", "/api/data/prepare"},
+    {"POST", "/api/data/dedup"},
+    {"GET", "/api/data/stats"},
+    {"GET", "/api/data/preview"},
+    {"GET", "/api/data/prepared"},
+    {"POST", "/api/inference"},
+    {"POST", "/api/ollama/deploy"},
+};
+
+// 缓存结果的剩余有效期至少留这么多秒才在事件循环上取，检查之后、取结果之前不会过期而变成现场计算
+const double EVENT_CACHE_MARGIN = 0.25;
+
+// 需要在阻塞连接上处理的请求：协议升级、上传、分块发送的响应、会被挂起的长轮询，
+// 以及BLOCKING_ROUTES和缓存未命中时要启动nvidia-smi/python的端点
+bool needs_blocking_io(const HttpRequestHead& req) {
+    if (req.method == "PRI" || !get_header_view(req.head, "Upgrade").empty()) return true;
+    std::string_view path = req.url.substr(0, req.url.find('?'));
+    if (path == "/api/ws") return true;
+    if (starts_with(req.url, "/api/data/upload?")) return true;
+    for (const BlockingRoute& route : BLOCKING_ROUTES) {
+        if (route.path == path && (route.method.empty() || route.method == req.method)) return true;
+    }
+    if (const CachedRoute* cached = find_cached_route(req.method, req.url)) {
+        return !g_response_cache.fresh(response_cache_key(req.url, *cached), cached->ttl - EVENT_CACHE_MARGIN);
+    }
+    if (path == "/metrics") return !g_gpu_sampler.fresh(GPU_SAMPLE_MAX_AGE - EVENT_CACHE_MARGIN);
+    if (req.method == "GET" && starts_with(req.url, "/api/inference/result?")) return accepts_chunked(req);
+    const ConditionalRoute* route = find_conditional_route(req.method, req.url);
+    if (!route) return false;
+    std::string_view if_none_match = get_header_view(req.head, "If-None-Match");
+    if (!get_query_param(req.url, "wait").empty() && !if_none_match.empty()) return true;
+    // 日志有变化且要分块发送时才交出去，内容没变的轮询在事件循环上直接回304
+    if (route->topic == TOPIC_LOGS) return accepts_chunked(req) && !etag_matches(if_none_match, train_log_etag());
+    return false;
+}
+
+// 交给工作线程的连接：socket已切回阻塞模式，data为事件循环已读到的请求头和请求体开头，
+// 为空表示事件循环缓冲区用完、整个连接都交给serve_connection
+// 占住工作线程时间较长的请求分类限额：上传和分块流式响应的时长取决于客户端，各自最多占用
+// 总线程数的1/4，其余请求（接口处理、WebSocket/HTTP/2握手、长轮询挂起前的检查）至少留有一半线程
+enum HandoffClass { HANDOFF_GENERAL, HANDOFF_UPLOAD, HANDOFF_STREAM, HANDOFF_CLASS_COUNT };
 
-        // 处理模型路径：如果是相对路径，添加基础目录
-        if (model_path.size() > 0 && model_path[0] == '.') {
-            model_path = current_dir + "/llm" + model_path.substr(1);
-        } else if (model_path.size() > 0 && model_path[0] == '/') {
-            model_path = current_dir + "/llm" + model_path;
-        } else if (model_path.size() > 0 && model_path[0] != '/' && model_path[1] != ':') {
-            model_path = current_dir + "/llm/" + model_path;
-        }
-        
-        // 转义引号和反斜杠，以便在命令行中使用
-        std::string escaped_prompt = prompt;
-        for (size_t i = 0; i < escaped_prompt.length(); ++i) {
-            if (escaped_prompt[i] == '"') {
-                escaped_prompt.replace(i, 1, "\\\"");
-                ++i;
-            } else if (escaped_prompt[i] == '\\') {
-                escaped_prompt.replace(i, 1, "\\\\");
-                ++i;
+struct HandoffJob {
+    int fd;
+    std::string data;
+    std::chrono::steady_clock::time_point started;
+    HandoffClass cls;
+};
+
+void serve_handoff(HandoffJob& job) {
+    if (job.data.empty()) {
+        serve_connection(job.fd);
+        return;
+    }
+    set_socket_timeout(job.fd, SOCKET_TIMEOUT_SECONDS);
+    HttpRequestHead req;
+    parse_request_head(job.data, job.data.find("\r\n\r\n"), req);
+    serve_request(job.fd, req, job.started);
+    request_arena().reset();
+}
+
+// 阻塞处理的工作线程上限，ELIAN_HANDOFF_THREADS可调
+size_t handoff_thread_limit() {
+    const char* value = std::getenv("ELIAN_HANDOFF_THREADS");
+    long threads = value && *value ? std::strtol(value, nullptr, 10) : 0;
+    return threads > 0 ? static_cast<size_t>(std::min(threads, 1024L)) : HANDOFF_THREADS_DEFAULT;
+}
+
+size_t handoff_class_limit(HandoffClass cls) {
+    size_t total = handoff_thread_limit();
+    return cls == HANDOFF_GENERAL ? total : std::max<size_t>(1, total / 4);
+}
+
+HandoffClass handoff_class(const HttpRequestHead& req) {
+    if (starts_with(req.url, "/api/data/upload?")) return HANDOFF_UPLOAD;
+    if (req.method == "GET" && accepts_chunked(req) &&
+        (starts_with(req.url, "/api/data/preview?") || starts_with(req.url, "/api/inference/result?") ||
+         req.url.substr(0, req.url.find('?')) == "/api/train/logs")) {
+        return HANDOFF_STREAM;
+    }
+    return HANDOFF_GENERAL;
+}
+
+// 阻塞处理的工作线程池：各事件循环共用，线程按需创建、空闲后留着复用。
+// 上传等可能占住线程很久，所以不排队等待：没有空闲线程且已到上限，或该类请求已到限额时submit返回false
+class HandoffPool {
+public:
+    bool submit(HandoffJob job) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (active[job.cls] >= handoff_class_limit(job.cls)) return false;
+            if (jobs.size() >= idle) {
+                if (threads >= handoff_thread_limit()) return false;
+                ++threads;
+                ++idle;
+                std::thread([this]() { run(); }).detach();
             }
+            active[job.cls]++;
+            jobs.push_back(std::move(job));
         }
-        
-        // 构建临时文件路径用于存储输出
-        std::string output_file = current_dir + "/inference_result_" + std::to_string(std::time(nullptr)) + ".txt";
-        
-        // 构建Python命令
-        std::string cmd;
-#ifdef _WIN32
-        std::string inference_script = current_dir + "/llm/inference.py";
-        std::replace(inference_script.begin(), inference_script.end(), '/', '\\');
-        std::replace(model_path.begin(), model_path.end(), '/', '\\');
-        std::replace(output_file.begin(), output_file.end(), '/', '\\');
-        
-        cmd = "start /B cmd.exe /C \"conda activate elianfactory && "
-              "set PYTHONIOENCODING=utf-8 && "
-              "chcp 65001 > nul && "
-              "python -c \"import sys; sys.path.append('" + current_dir + "\\\\llm'); "
-              "from inference import model_reasoning; "
-              "result = model_reasoning('" + model_path + "', '" + escaped_prompt + "', " + max_new_tokens + "); "
-              "with open('" + output_file + "', 'w', encoding='utf-8') as f: f.write(result)\" > nul 2>&1\"";
-#else
-        std::string inference_script = current_dir + "/llm/inference.py";
-        cmd = "conda activate elianfactory && "
-              "python -c \"import sys; sys.path.append('" + current_dir + "/llm'); "
-              "from inference import model_reasoning; "
-              "result = model_reasoning('" + model_path + "', '" + escaped_prompt + "', " + max_new_tokens + "); "
-              "with open('" + output_file + "', 'w', encoding='utf-8') as f: f.write(result)\" > /dev/null 2>&1";
-#endif
-        
-        std::cout << "执行命令: " << cmd << std::endl;
-        
-        // 执行命令
-        int ret = std::system(cmd.c_str());
-        if (ret != 0) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"推理命令执行失败\",\"error\":\"" << ret << "\"}";
-            return json_response(json.str());
+        cv.notify_one();
+        return true;
+    }
+
+    size_t active_count(HandoffClass cls) {
+        std::lock_guard<std::mutex> lock(mtx);
+        return active[cls];
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            cv.wait(lock, [this]() { return !jobs.empty(); });
+            HandoffJob job = std::move(jobs.front());
+            jobs.pop_front();
+            --idle;
+            lock.unlock();
+            serve_handoff(job);
+            lock.lock();
+            ++idle;
+            active[job.cls]--;
         }
-        
-        // 等待一段时间，确保推理过程开始
-        std::this_thread::sleep_for(std::chrono::seconds(2));
-        
-        // 构建轮询响应
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":true,";
-        json << "\"message\":\"推理请求已提交\",";
-        json << "\"output_file\":\"" << escape_json(output_file) << "\"";
-        json << "}";
-        
-        return json_response(json.str());
     }
-    else if (url.find("/api/inference/result?file=") == 0) {
-        // 获取输出文件路径
-        std::string file_param = url.substr(url.find("=") + 1);
-        std::string output_file;
-        
-        // 进行URL解码
-        for (size_t i = 0; i < file_param.length(); ++i) {
-            if (file_param[i] == '%' && i + 2 < file_param.length()) {
-                int value = 0;
-                if (sscanf(file_param.substr(i + 1, 2).c_str(), "%x", &value) == 1) {
-                    output_file += static_cast<char>(value);
-                    i += 2;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<HandoffJob> jobs;
+    size_t threads = 0;
+    size_t idle = 0;            // 没有在处理连接的线程（含刚创建、还没取到任务的）
+    size_t active[HANDOFF_CLASS_COUNT] = {};   // 各类已提交、尚未处理完的连接
+};
+
+HandoffPool& handoff_pool() {
+    static HandoffPool* pool = new HandoffPool();   // 工作线程是detach的，进程退出时不析构
+    return *pool;
+}
+
+// 把连接交给工作线程。fd需已从事件循环中移除且没有挂起的读写；
+// 线程池满或该类请求已到限额时直接回503并关闭，不在事件循环线程上阻塞处理
+void event_handoff(int fd, bool nonblocking, std::string data, std::chrono::steady_clock::time_point started) {
+    if (nonblocking) set_nonblocking(fd, false);
+    HandoffClass cls = HANDOFF_GENERAL;
+    if (!data.empty()) {
+        HttpRequestHead req;
+        if (parse_request_head(data, data.find("\r\n\r\n"), req)) cls = handoff_class(req);
+    }
+    if (handoff_pool().submit(HandoffJob{fd, std::move(data), started, cls})) return;
+
+    metrics_count(COUNTER_HANDOFF_REJECTED);
+    static const std::string busy = json_response("{\"success\":false,\"message\":\"服务器繁忙，请稍后重试\"}",
+                                                  "503 Service Unavailable", "Retry-After: 1\r\n");
+    // 新连接的发送缓冲区是空的，一次非阻塞send足够
+    metrics_count(COUNTER_SOCKET_SYSCALLS);
+    send(fd, busy.data(), busy.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close_socket(fd);
+}
+
+// 缓冲区中读到新数据后推进请求。请求完整时生成响应放到conn.response；
+// 需要阻塞处理时返回Handoff，由事件循环摘下连接后调用event_handoff
+EventAction event_request_ready(EventConnection& conn, char* buffer) {
+    std::string_view data(buffer, conn.length);
+    size_t header_end = data.find("\r\n\r\n");
+    if (header_end == std::string::npos) return conn.length > MAX_HEADER_SIZE ? EventAction::Close : EventAction::NeedMore;
+
+    HttpRequestHead req;
+    if (!parse_request_head(data, header_end, req)) return EventAction::Close;
+    size_t head_size = header_end + 4;
+    if (needs_blocking_io(req) || req.content_length > EVENT_SLOT_SIZE - head_size) return EventAction::Handoff;
+    if (conn.length < head_size + req.content_length) return EventAction::NeedMore;
+
+    req.body_prefix = data.substr(head_size, req.content_length);
+    {
+        TraceSpan request_span("request", req.url.substr(0, req.url.find('?')));
+        std::string owned;
+        std::string_view response = buffered_response(conn.fd, req, data.substr(0, head_size + req.content_length), owned);
+        conn.response.assign(response.data(), response.size());
+        conn.url.assign(req.url.data(), req.url.size());
+    }
+    request_arena().reset();
+    return EventAction::Respond;
+}
+
+// 连接处理结束：记录指标（没有生成响应的记为坏请求）
+void event_connection_done(EventConnection& conn) {
+    if (conn.state == EventState::Sending && conn.sent == conn.response.size()) {
+        metrics_observe_request(conn.url, conn.response,
+                                std::chrono::duration<double>(std::chrono::steady_clock::now() - conn.started).count());
+    } else if (conn.state == EventState::Reading) {
+        metrics_count(COUNTER_BAD_REQUESTS);
+    }
+    conn.response.clear();
+    conn.url.clear();
+}
+
+bool event_connection_expired(const EventConnection& conn, std::chrono::steady_clock::time_point now) {
+    return conn.state != EventState::Free && conn.state != EventState::Closing && !conn.expired &&
+           now - conn.started > std::chrono::seconds(SOCKET_TIMEOUT_SECONDS);
+}
+
+class EpollLoop {
+public:
+    ~EpollLoop() {
+        if (epoll_fd >= 0) close(epoll_fd);
+    }
+
+    bool init(int fd) {
+        listen_fd = fd;
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) return false;
+        set_nonblocking(listen_fd, true);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = LISTENER;
+        return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == 0;
+    }
+
+    void run() {
+        epoll_event events[64];
+        auto next_sweep = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (true) {
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            int n = epoll_wait(epoll_fd, events, 64, 1000);
+            if (n < 0 && errno != EINTR) {
+                log_event(LogLevel::Error, "server.epoll_failed").num("errno", errno);
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.u64 == LISTENER) {
+                    accept_ready();
+                } else if (events[i].events & EPOLLOUT) {
+                    send_ready(static_cast<size_t>(events[i].data.u64));
                 } else {
-                    output_file += file_param[i];
+                    read_ready(static_cast<size_t>(events[i].data.u64));
                 }
-            } else if (file_param[i] == '+') {
-                output_file += ' ';
-            } else {
-                output_file += file_param[i];
             }
-        }
-        
-        // 安全检查，防止路径遍历攻击
-        if (output_file.find("..") != std::string::npos) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"无效的文件路径\"}";
-            return json_response(json.str());
-        }
-        
-        // 检查文件是否存在
-        if (!file_exists(output_file)) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"推理结果尚未生成，请稍后再试\"}";
-            return json_response(json.str());
-        }
-        
-        // 读取推理结果
-        std::string result;
-        try {
-            std::ifstream file(output_file);
-            if (file) {
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                result = buffer.str();
-                file.close();
-                
-                // 删除临时文件
-                std::remove(output_file.c_str());
-            } else {
-                std::ostringstream json;
-                json << "{\"success\":false,\"message\":\"无法读取推理结果\"}";
-                return json_response(json.str());
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_sweep) {
+                for (size_t i = 0; i < EVENT_MAX_CONNECTIONS; ++i) {
+                    if (event_connection_expired(conns[i], now)) finish(i);
+                }
+                next_sweep = now + std::chrono::seconds(1);
             }
-        } catch (const std::exception& e) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"读取推理结果时出错\",\"error\":\"" << escape_json(e.what()) << "\"}";
-            return json_response(json.str());
         }
-        
-        // 返回推理结果
-        std::ostringstream json;
-        json << "{";
-        json << "\"success\":true,";
-        json << "\"result\":\"" << escape_json(result) << "\"";
-        json << "}";
-        
-        return json_response(json.str());
     }
-    else if (url == "/api/ollama/deploy" && method == "POST") {
-        // 读取POST数据体
-        std::string request_body = extract_post_data(request);
-        std::cout << "收到Ollama部署请求：" << request_body << std::endl;
-        
-        // 解析JSON配置
-        std::map<std::string, std::string> deployData = parse_json(request_body);
-        
-        // 获取参数
-        std::string model_path = deployData["model_path"];
-        std::string model_name = deployData["model_name"];
-        
-        // 参数验证
-        if (model_path.empty() || model_name.empty()) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"缺少必要参数\"}";
-            return json_response(json.str());
-        }
-        
-        // 验证模型名称格式
-        std::regex model_name_regex("^[a-zA-Z0-9_-]+$");
-        if (!std::regex_match(model_name, model_name_regex)) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"模型名称只能包含字母、数字、连字符和下划线\"}";
-            return json_response(json.str());
-        }
-        
-        // 获取当前工作目录
-        std::string current_dir;
-#ifdef _WIN32
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-        
-        // 替换Windows路径中的反斜杠为正斜杠（统一处理）
-        for (char &c : current_dir) {
-            if (c == '\\') c = '/';
-        }
-#else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
-        }
-#endif
 
-        // 处理模型路径：如果是相对路径，添加基础目录
-        if (model_path.size() > 0 && model_path[0] == '.') {
-            model_path = current_dir + "/llm" + model_path.substr(1);
-        } else if (model_path.size() > 0 && model_path[0] == '/') {
-            model_path = current_dir + "/llm" + model_path;
-        } else if (model_path.size() > 0 && model_path[0] != '/' && model_path[1] != ':') {
-            model_path = current_dir + "/llm/" + model_path;
+private:
+    static const uint64_t LISTENER = ~0ULL;
+
+    void accept_ready() {
+        for (size_t accepted = 0; accepted < EVENT_ACCEPT_BATCH; ++accepted) {
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) log_event(LogLevel::Error, "server.accept_failed");
+                return;
+            }
+            size_t index;
+            if (!pool.acquire(index)) {
+                event_handoff(fd, true, std::string(), std::chrono::steady_clock::now());
+                continue;
+            }
+            metrics_count(COUNTER_CONNECTIONS);
+            EventConnection& conn = conns[index];
+            conn.fd = fd;
+            conn.state = EventState::Reading;
+            conn.length = 0;
+            conn.sent = 0;
+            conn.expired = false;
+            conn.started = std::chrono::steady_clock::now();
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = index;
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            // 请求通常随连接一起到达，先直接读一次，省掉一轮epoll_wait
+            read_ready(index);
         }
-        
-        // 检查模型路径是否存在
-        if (!file_exists(model_path)) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"模型路径不存在: " << escape_json(model_path) << "\"}";
-            return json_response(json.str());
+    }
+
+    void read_ready(size_t index) {
+        EventConnection& conn = conns[index];
+        if (conn.state != EventState::Reading) return;
+        char* buffer = pool.slot(index);
+        while (true) {
+            if (conn.length == EVENT_SLOT_SIZE) {
+                finish(index);
+                return;
+            }
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            ssize_t n = recv(conn.fd, buffer + conn.length, EVENT_SLOT_SIZE - conn.length, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            if (n <= 0) {
+                finish(index);
+                return;
+            }
+            conn.length += static_cast<size_t>(n);
+            switch (event_request_ready(conn, buffer)) {
+            case EventAction::NeedMore:
+                continue;
+            case EventAction::Close:
+                finish(index);
+                return;
+            case EventAction::Handoff:
+                // 先从epoll摘下，工作线程关闭fd后编号可能被新连接复用
+                metrics_count(COUNTER_SOCKET_SYSCALLS);
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                event_handoff(conn.fd, true, std::string(buffer, conn.length), conn.started);
+                conn.fd = -1;
+                conn.state = EventState::Free;
+                pool.release(index);
+                return;
+            case EventAction::Respond:
+                conn.state = EventState::Sending;
+                send_ready(index);
+                return;
+            }
         }
-        
-        // 创建Modelfile
-        std::string modelfile_path = model_path + "/Modelfile";
-        // 定义Modelfile内容
-        std::string modelfile_content = "# ollama modelfile auto-generated by llamafactory\n\n"
-                                       "FROM .\n\n"
-                                       "TEMPLATE \"\"\"<|begin_of_sentence|>{{ if .System }}{{ .System }}{{ end }}{{ range .Messages }}{{ if eq .Role \"user\" }}<|User|>{{ .Content }}<|Assistant|>{{ else if eq .Role \"assistant\" }}{{ .Content }}<|end_of_sentence|>{{ end }}{{ end }}\"\"\"\n\n"
-                                       "PARAMETER stop \"<|end_of_sentence|>\"\n"
-                                       "PARAMETER num_ctx 4096";
-        
-        try {
-            // 创建Modelfile
-            std::ofstream modelfile(modelfile_path);
-            if (!modelfile.is_open()) {
-                std::ostringstream json;
-                json << "{\"success\":false,\"message\":\"无法创建Modelfile: " << escape_json(modelfile_path) << "\"}";
-                return json_response(json.str());
+    }
+
+    void send_ready(size_t index) {
+        EventConnection& conn = conns[index];
+        if (conn.state != EventState::Sending) return;
+        while (conn.sent < conn.response.size()) {
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            ssize_t n = send(conn.fd, conn.response.data() + conn.sent, conn.response.size() - conn.sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                // 发送缓冲区满，等可写时继续
+                epoll_event event{};
+                event.events = EPOLLOUT;
+                event.data.u64 = index;
+                metrics_count(COUNTER_SOCKET_SYSCALLS);
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &event);
+                return;
             }
-            
-            modelfile << modelfile_content;
-            modelfile.close();
-            
-            // 生成任务ID
-            std::string task_id = "ollama_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(std::rand() % 1000);
-            std::string status_file = current_dir + "/ollama_status_" + task_id + ".txt";
-            
-            // 构建Ollama命令
-            std::string cmd;
-#ifdef _WIN32
-            std::string windows_model_path = model_path;
-            std::replace(windows_model_path.begin(), windows_model_path.end(), '/', '\\');
-            
-            cmd = "start /B cmd.exe /C \"cd " + windows_model_path + " && "
-                  "ollama create " + model_name + " -f ./Modelfile > \"" + status_file + "\" 2>&1 && "
-                  "echo SUCCESS >> \"" + status_file + "\" || echo FAILED >> \"" + status_file + "\"\"";
-#else
-            cmd = "cd " + model_path + " && "
-                  "ollama create " + model_name + " -f ./Modelfile > \"" + status_file + "\" 2>&1 && "
-                  "echo SUCCESS >> \"" + status_file + "\" || echo FAILED >> \"" + status_file + "\" &";
+            if (n < 0) break;
+            conn.sent += static_cast<size_t>(n);
+        }
+        finish(index);
+    }
+
+    void finish(size_t index) {
+        EventConnection& conn = conns[index];
+        event_connection_done(conn);
+        close_socket(conn.fd);
+        conn.fd = -1;
+        conn.state = EventState::Free;
+        pool.release(index);
+    }
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    EventBufferPool pool;
+    EventConnection conns[EVENT_MAX_CONNECTIONS];
+};
+
+#ifdef ELIAN_HAVE_IO_URING
+#ifndef IORING_ACCEPT_MULTISHOT
+#define IORING_ACCEPT_MULTISHOT (1U << 0)
 #endif
-            
-            std::cout << "执行命令: " << cmd << std::endl;
-            
-            // 执行命令
-            int ret = std::system(cmd.c_str());
-            if (ret != 0) {
-                std::ostringstream json;
-                json << "{\"success\":false,\"message\":\"启动Ollama命令失败，错误码: " << ret << "\"}";
-                return json_response(json.str());
-            }
-            
-            // 返回成功响应
-            std::ostringstream json;
-            json << "{";
-            json << "\"success\":true,";
-            json << "\"message\":\"Ollama部署任务已提交\",";
-            json << "\"task_id\":\"" << task_id << "\"";
-            json << "}";
-            
-            return json_response(json.str());
-            
-        } catch (const std::exception& e) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"创建Modelfile时出错: " << escape_json(e.what()) << "\"}";
-            return json_response(json.str());
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE (1U << 1)
+#endif
+
+// io_uring的最小封装：直接用系统调用建立提交/完成队列，不依赖liburing。
+// 只有事件循环线程访问，且不使用SQPOLL，内核只在io_uring_enter时读取提交项
+class IoUring {
+public:
+    ~IoUring() {
+        if (sqes) munmap(sqes, sqes_size);
+        if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_size);
+        if (sq_ring) munmap(sq_ring, sq_size);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd < 0) return false;
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) sq_size = cq_size = std::max(sq_size, cq_size);
+        sq_ring = map(sq_size, IORING_OFF_SQ_RING);
+        if (!sq_ring) return false;
+        cq_ring = single_mmap ? sq_ring : map(cq_size, IORING_OFF_CQ_RING);
+        if (!cq_ring) return false;
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+        if (!sqes) return false;
+
+        char* sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+        char* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool register_buffers(const iovec* buffers, unsigned count) {
+        return syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+    }
+
+    // 取一个清零的提交项，提交队列满时先把已有的提交掉
+    io_uring_sqe* next_sqe() {
+        unsigned tail = *sq_tail;
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) submit(0);
+        unsigned index = tail & sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++pending;
+        return sqe;
+    }
+
+    // 提交所有待提交项，并等待至少wait_count个完成事件
+    bool submit(unsigned wait_count) {
+        while (true) {
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            long n = syscall(__NR_io_uring_enter, ring_fd, pending, wait_count,
+                             wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (n >= 0) {
+                pending -= static_cast<unsigned>(n);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+            if (errno != EINTR) wait_count = 0;
         }
     }
-    else if (url.find("/api/ollama/status") == 0) {
-        // 获取任务ID
-        std::string task_id;
-        size_t query_start = url.find('?');
-        
-        if (query_start != std::string::npos) {
-            std::string query = url.substr(query_start + 1);
-            std::istringstream query_stream(query);
-            std::string param;
-            
-            while (std::getline(query_stream, param, '&')) {
-                size_t eq_pos = param.find('=');
-                if (eq_pos != std::string::npos) {
-                    std::string key = param.substr(0, eq_pos);
-                    std::string value = param.substr(eq_pos + 1);
-                    
-                    if (key == "task_id") {
-                        task_id = value;
-                        break;
-                    }
-                }
+
+    // 依次处理已完成的事件；处理函数里可以继续取提交项
+    template<typename F>
+    void drain(F&& handle) {
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe cqe = cqes[head & cq_mask];
+            __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+            handle(cqe);
+        }
+    }
+
+private:
+    void* map(size_t size, off_t offset) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    int ring_fd = -1;
+    void* sq_ring = nullptr;
+    void* cq_ring = nullptr;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned pending = 0;
+};
+
+class UringLoop {
+public:
+    bool init(int fd) {
+        listen_fd = fd;
+        if (!ring.init(EVENT_MAX_CONNECTIONS * 2)) return false;
+        std::vector<iovec> buffers(EVENT_MAX_CONNECTIONS);
+        for (size_t i = 0; i < EVENT_MAX_CONNECTIONS; ++i) {
+            buffers[i].iov_base = pool.slot(i);
+            buffers[i].iov_len = EVENT_SLOT_SIZE;
+        }
+        // 锁定内存受限等原因注册失败时改用普通recv
+        fixed_buffers = ring.register_buffers(buffers.data(), static_cast<unsigned>(buffers.size()));
+        if (!fixed_buffers) log_event(LogLevel::Warn, "server.io_uring_register_buffers_failed").num("errno", errno);
+        arm_accept();
+        arm_timeout();
+        return ring.submit(0);
+    }
+
+    void run() {
+        while (true) {
+            if (!ring.submit(1)) {
+                log_event(LogLevel::Error, "server.io_uring_failed").num("errno", errno);
+                return;
             }
+            ring.drain([this](const io_uring_cqe& cqe) { complete(cqe); });
         }
-        
-        if (task_id.empty()) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"缺少任务ID参数\"}";
-            return json_response(json.str());
+    }
+
+private:
+    enum Op : uint64_t { OP_ACCEPT = 1, OP_READ, OP_SEND, OP_CLOSE, OP_TIMEOUT };
+
+    static uint64_t tag(Op op, size_t index) { return (static_cast<uint64_t>(op) << 32) | index; }
+
+    void arm_accept() {
+        io_uring_sqe* sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = listen_fd;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        if (multishot_accept) sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = tag(OP_ACCEPT, 0);
+    }
+
+    void arm_timeout() {
+        sweep_interval.tv_sec = 1;
+        sweep_interval.tv_nsec = 0;
+        io_uring_sqe* sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_TIMEOUT;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(&sweep_interval);
+        sqe->len = 1;
+        sqe->user_data = tag(OP_TIMEOUT, 0);
+    }
+
+    void arm_read(size_t index) {
+        EventConnection& conn = conns[index];
+        io_uring_sqe* sqe = ring.next_sqe();
+        sqe->opcode = fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_RECV;
+        sqe->fd = conn.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(pool.slot(index) + conn.length);
+        sqe->len = static_cast<uint32_t>(EVENT_SLOT_SIZE - conn.length);
+        if (fixed_buffers) sqe->buf_index = static_cast<uint16_t>(index);
+        sqe->user_data = tag(OP_READ, index);
+    }
+
+    void arm_send(size_t index) {
+        EventConnection& conn = conns[index];
+        io_uring_sqe* sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = conn.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(conn.response.data() + conn.sent);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(conn.response.size() - conn.sent, 1u << 30));
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = tag(OP_SEND, index);
+    }
+
+    void arm_close(size_t index) {
+        EventConnection& conn = conns[index];
+        event_connection_done(conn);
+        conn.state = EventState::Closing;
+        io_uring_sqe* sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = conn.fd;
+        sqe->user_data = tag(OP_CLOSE, index);
+    }
+
+    void complete(const io_uring_cqe& cqe) {
+        Op op = static_cast<Op>(cqe.user_data >> 32);
+        size_t index = static_cast<size_t>(cqe.user_data & 0xffffffffu);
+        switch (op) {
+        case OP_ACCEPT:
+            accepted(cqe);
+            break;
+        case OP_READ:
+            read_done(index, cqe.res);
+            break;
+        case OP_SEND:
+            send_done(index, cqe.res);
+            break;
+        case OP_CLOSE:
+            conns[index].fd = -1;
+            conns[index].state = EventState::Free;
+            pool.release(index);
+            break;
+        case OP_TIMEOUT:
+            sweep();
+            arm_timeout();
+            break;
         }
-        
-        // 获取当前工作目录
-        std::string current_dir;
-#ifdef _WIN32
-        wchar_t wbuffer[MAX_PATH];
-        GetCurrentDirectoryW(MAX_PATH, wbuffer);
-        
-        // 将宽字符转换为UTF-8编码的字符串
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, NULL, 0, NULL, NULL);
-        std::vector<char> utf8_buffer(size_needed);
-        WideCharToMultiByte(CP_UTF8, 0, wbuffer, -1, utf8_buffer.data(), size_needed, NULL, NULL);
-        
-        current_dir = std::string(utf8_buffer.data());
-#else
-        char buffer[PATH_MAX];
-        if (getcwd(buffer, PATH_MAX) != NULL) {
-            current_dir = buffer;
-        } else {
-            current_dir = ".";
+    }
+
+    void accepted(const io_uring_cqe& cqe) {
+        bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        if (cqe.res == -EINVAL && multishot_accept) {
+            // 内核不支持多发accept，改为每次accept后重新提交
+            multishot_accept = false;
+            arm_accept();
+            return;
         }
-#endif
-        
-        // 构建状态文件路径
-        std::string status_file = current_dir + "/ollama_status_" + task_id + ".txt";
-        
-        // 检查状态文件是否存在
-        if (!file_exists(status_file)) {
-            std::ostringstream json;
-            json << "{\"success\":true,\"status\":\"running\",\"message\":\"任务正在进行中\"}";
-            return json_response(json.str());
+        if (!more) arm_accept();
+        if (cqe.res < 0) {
+            if (cqe.res != -EINTR && cqe.res != -EAGAIN) log_event(LogLevel::Error, "server.accept_failed");
+            return;
         }
-        
-        // 读取状态文件内容
-        std::string status_content;
-        try {
-            std::ifstream file(status_file);
-            if (file) {
-                std::stringstream buffer;
-                buffer << file.rdbuf();
-                status_content = buffer.str();
-                file.close();
-            }
-        } catch (const std::exception& e) {
-            std::ostringstream json;
-            json << "{\"success\":false,\"message\":\"读取状态文件出错: " << escape_json(e.what()) << "\"}";
-            return json_response(json.str());
+        size_t index;
+        if (!pool.acquire(index)) {
+            event_handoff(cqe.res, false, std::string(), std::chrono::steady_clock::now());
+            return;
         }
-        
-        // 检查任务是否完成
-        if (status_content.find("SUCCESS") != std::string::npos) {
-            // 删除状态文件
-            std::remove(status_file.c_str());
-            
-            std::ostringstream json;
-            json << "{\"success\":true,\"status\":\"completed\",\"message\":\"模型部署成功\"}";
-            return json_response(json.str());
-        } else if (status_content.find("FAILED") != std::string::npos) {
-            // 删除状态文件
-            std::remove(status_file.c_str());
-            
-            std::ostringstream json;
-            json << "{\"success\":true,\"status\":\"failed\",\"message\":\"" << escape_json(status_content) << "\"}";
-            return json_response(json.str());
-        } else {
-            std::ostringstream json;
-            json << "{\"success\":true,\"status\":\"running\",\"message\":\"任务正在进行中\"}";
-            return json_response(json.str());
+        metrics_count(COUNTER_CONNECTIONS);
+        EventConnection& conn = conns[index];
+        conn.fd = cqe.res;
+        conn.state = EventState::Reading;
+        conn.length = 0;
+        conn.sent = 0;
+        conn.expired = false;
+        conn.started = std::chrono::steady_clock::now();
+        arm_read(index);
+    }
+
+    void read_done(size_t index, int res) {
+        EventConnection& conn = conns[index];
+        if (res <= 0) {
+            arm_close(index);
+            return;
+        }
+        conn.length += static_cast<size_t>(res);
+        switch (event_request_ready(conn, pool.slot(index))) {
+        case EventAction::NeedMore:
+            if (conn.length == EVENT_SLOT_SIZE) arm_close(index);
+            else arm_read(index);
+            break;
+        case EventAction::Close:
+            arm_close(index);
+            break;
+        case EventAction::Handoff:
+            // 读已完成，连接上没有挂起的提交项，可以交出去
+            event_handoff(conn.fd, false, std::string(pool.slot(index), conn.length), conn.started);
+            conn.fd = -1;
+            conn.state = EventState::Free;
+            pool.release(index);
+            break;
+        case EventAction::Respond:
+            conn.state = EventState::Sending;
+            arm_send(index);
+            break;
         }
     }
-    
-    // 其他API返回404
-    std::ostringstream json;
-    json << "{\"success\": false, \"message\": \"API端点不存在\", \"error\": \"not_found\"}";
-    std::ostringstream response;
-    response << "HTTP/1.1 404 Not Found\r\n";
-    response << "Content-Type: application/json\r\n";
-    response << "Content-Length: " << json.str().length() << "\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";
-    response << "\r\n";
-    response << json.str();
-    return response.str();
+
+    void send_done(size_t index, int res) {
+        EventConnection& conn = conns[index];
+        if (res > 0) conn.sent += static_cast<size_t>(res);
+        if (res > 0 && conn.sent < conn.response.size()) arm_send(index);
+        else arm_close(index);
+    }
+
+    // 超时的连接直接shutdown，挂着的读或发送随即完成并走关闭流程
+    void sweep() {
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < EVENT_MAX_CONNECTIONS; ++i) {
+            if (!event_connection_expired(conns[i], now)) continue;
+            conns[i].expired = true;
+            metrics_count(COUNTER_SOCKET_SYSCALLS);
+            shutdown(conns[i].fd, SHUT_RDWR);
+        }
+    }
+
+    int listen_fd = -1;
+    IoUring ring;
+    EventBufferPool pool;
+    EventConnection conns[EVENT_MAX_CONNECTIONS];
+    bool fixed_buffers = false;
+    bool multishot_accept = true;
+    __kernel_timespec sweep_interval{};
+};
+#endif
+
+// 按ELIAN_IO_BACKEND运行事件循环，正常情况下不返回；选择了blocking、
+// 都不可用或事件循环出错时返回，由调用方改用顺序accept循环
+void run_event_loop(int listen_fd) {
+    const char* value = std::getenv("ELIAN_IO_BACKEND");
+    std::string backend = value && *value ? value : "auto";
+    if (backend == "blocking") return;
+#ifdef ELIAN_HAVE_IO_URING
+    if (backend == "auto" || backend == "uring") {
+        std::unique_ptr<UringLoop> loop(new UringLoop());
+        if (loop->init(listen_fd)) {
+            g_io_backend = "uring";
+            log_event(LogLevel::Info, "server.io_backend").str("backend", "uring");
+            loop->run();
+            g_io_backend = "blocking";
+            return;
+        }
+        log_event(LogLevel::Warn, "server.io_uring_unavailable").num("errno", errno);
+    }
+#endif
+    std::unique_ptr<EpollLoop> loop(new EpollLoop());
+    if (loop->init(listen_fd)) {
+        g_io_backend = "epoll";
+        log_event(LogLevel::Info, "server.io_backend").str("backend", "epoll");
+        loop->run();
+    }
+    set_nonblocking(listen_fd, false);
+    g_io_backend = "blocking";
 }
 
-// 简单的HTTP响应处理
-std::string handle_request(const std::string& request) {
-    // 解析HTTP请求的第一行来获取URL和方法
-    std::istringstream req_stream(request);
-    std::string method, url, version;
-    req_stream >> method >> url >> version;
+#endif
 
-    
-    // 处理API请求
-    if (starts_with(url, API_PREFIX)) {
-        return handle_api_request(url, request, method);
+// ==================== 监听socket ====================
+// ELIAN_LISTEN_BACKLOG设置监听队列长度，缺省SOMAXCONN（内核再按net.core.somaxconn截断）。
+// ELIAN_IO_WORKERS为N或auto（按CPU核数）时，N个线程各自打开一个SO_REUSEPORT监听socket，
+// 内核把新连接分散到各自的accept队列；每个线程运行自己的事件循环，连接表、缓冲区和
+// 请求内存池都不共享。缺省为1，只有一个监听socket。
+
+const long IO_WORKERS_MAX = 64;
+
+int listen_backlog() {
+    const char* value = std::getenv("ELIAN_LISTEN_BACKLOG");
+    long backlog = value && *value ? std::strtol(value, nullptr, 10) : 0;
+    return backlog > 0 ? static_cast<int>(std::min(backlog, 65535L)) : SOMAXCONN;
+}
+
+size_t io_worker_count() {
+    const char* value = std::getenv("ELIAN_IO_WORKERS");
+    if (!value || !*value) return 1;
+    long workers = std::strcmp(value, "auto") == 0 ? static_cast<long>(std::thread::hardware_concurrency())
+                                                   : std::strtol(value, nullptr, 10);
+    return static_cast<size_t>(std::max(1L, std::min(workers, IO_WORKERS_MAX)));
+}
+
+#ifndef _WIN32
+// 创建、绑定并监听port（0为临时端口，测试用），失败返回-1
+int open_listener(int port, bool reuse_port, int backlog) {
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        std::cerr << "Failed to create socket" << std::endl;
+        return -1;
     }
-    
-    if (url == "/") {
-        url = "/index.html";
-        // std::cout << "重定向到: " << url << std::endl;
+
+    int opt = 1;
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+        std::cerr << "Failed to set socket options" << std::endl;
+        close(server_fd);
+        return -1;
     }
-    
-    // 读取请求的文件
-    std::string file_path = WEB_DIR + url;
-    // std::cout << "尝试读取文件: " << file_path << std::endl;
-    
-    std::ifstream file(file_path, std::ios::binary);
-    
-    if (!file) {
-        std::cout << "文件不存在: " << file_path << std::endl;
-        
-        // 检查文件系统，查看web目录下有哪些文件
-        std::vector<std::string> files = list_files_in_directory(WEB_DIR, "");
-        std::cout << "Web目录内容:" << std::endl;
-        for (const auto& f : files) {
-            std::cout << " - " << f << std::endl;
-        }
-        
-        // 文件不存在，返回404错误
-        return "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\n\r\n<html><body><h1>404 Not Found</h1><p>The requested resource was not found on this server.</p><p>Requested: " + url + "</p></body></html>";
+#ifdef SO_REUSEPORT
+    if (reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))) {
+        std::cerr << "Failed to set SO_REUSEPORT" << std::endl;
+        close(server_fd);
+        return -1;
     }
-    
-    // 读取文件内容
-    std::ostringstream content_stream;
-    content_stream << file.rdbuf();
-    std::string content = content_stream.str();
-    // std::cout << "文件读取成功，大小: " << content.length() << " 字节" << std::endl;
-    
-    // 确定内容类型
-    std::string content_type = "text/plain";
-    if (ends_with(url, ".html") || ends_with(url, ".htm")) {
-        content_type = "text/html";
-    } else if (ends_with(url, ".css")) {
-        content_type = "text/css";
-    } else if (ends_with(url, ".js")) {
-        content_type = "application/javascript";
-    } else if (ends_with(url, ".json")) {
-        content_type = "application/json";
-    } else if (ends_with(url, ".png")) {
-        content_type = "image/png";
-    } else if (ends_with(url, ".jpg") || ends_with(url, ".jpeg")) {
-        content_type = "image/jpeg";
+#else
+    if (reuse_port) {
+        close(server_fd);
+        return -1;
     }
-    
-    // 构建HTTP响应
-    std::ostringstream response;
-    response << "HTTP/1.1 200 OK\r\n";
-    response << "Content-Type: " << content_type << "\r\n";
-    response << "Content-Length: " << content.length() << "\r\n";
-    response << "\r\n";
-    response << content;
-    
-    return response.str();
+#endif
+
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Bind failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+
+    if (listen(server_fd, backlog) < 0) {
+        std::cerr << "Listen failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    return server_fd;
 }
 
+// 处理一个监听socket上的连接：优先事件循环，不可用时顺序accept
+void serve_listener(int server_fd) {
+#ifdef __linux__
+    run_event_loop(server_fd);
+#endif
+    while (true) {
+        metrics_count(COUNTER_SOCKET_SYSCALLS);
+        int new_socket = accept(server_fd, nullptr, nullptr);
+        if (new_socket < 0) {
+            log_event(LogLevel::Error, "server.accept_failed");
+            continue;
+        }
+
+        serve_connection(new_socket);
+    }
+}
+#endif
+
 // 开启简单的HTTP服务器
 void start_server() {
 #ifdef _WIN32
@@ -2417,7 +11048,7 @@ void start_server() {
         return;
     }
     
-    if (listen(server_socket, SOMAXCONN) == SOCKET_ERROR) {
+    if (listen(server_socket, listen_backlog()) == SOCKET_ERROR) {
         std::cerr << "Listen failed" << std::endl;
         closesocket(server_socket);
         WSACleanup();
@@ -2429,81 +11060,55 @@ void start_server() {
     std::cout << "请在浏览器中输入：http://127.0.0.1:10171/进行使用 "  << std::endl;
     
     while (true) {
+        metrics_count(COUNTER_SOCKET_SYSCALLS);
         SOCKET client_socket = accept(server_socket, NULL, NULL);
         if (client_socket == INVALID_SOCKET) {
-            std::cerr << "Accept failed" << std::endl;
+            log_event(LogLevel::Error, "server.accept_failed");
             continue;
         }
         
-        char buffer[4096] = {0};
-        int bytes_received = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        
-        if (bytes_received > 0) {
-            buffer[bytes_received] = '\0';
-            std::string response = handle_request(buffer);
-            send(client_socket, response.c_str(), response.length(), 0);
-        }
-        
-        closesocket(client_socket);
+        serve_connection(client_socket);
     }
     
     closesocket(server_socket);
     WSACleanup();
 #else
     // UNIX/Linux平台的简单服务器实现
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        std::cerr << "Failed to create socket" << std::endl;
-        return;
+    int backlog = listen_backlog();
+    size_t workers = io_worker_count();
+    int server_fd = open_listener(PORT, workers > 1, backlog);
+    if (server_fd < 0 && workers > 1) {
+        // 不支持SO_REUSEPORT时退回单个监听socket
+        workers = 1;
+        server_fd = open_listener(PORT, false, backlog);
     }
-    
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        std::cerr << "Failed to set socket options" << std::endl;
-        return;
-    }
-    
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
-    
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "Bind failed" << std::endl;
-        return;
-    }
-    
-    if (listen(server_fd, 3) < 0) {
-        std::cerr << "Listen failed" << std::endl;
-        return;
+    if (server_fd < 0) return;
+    std::vector<int> listeners = {server_fd};
+    while (listeners.size() < workers) {
+        int fd = open_listener(PORT, true, backlog);
+        if (fd < 0) break;
+        listeners.push_back(fd);
     }
-    
+
     std::cout << "Server started on port " << PORT << std::endl;
     std::cout << "Serving files from " << WEB_DIR << std::endl;
-    
-    while (true) {
-        int new_socket;
-        int addrlen = sizeof(address);
-        if ((new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) < 0) {
-            std::cerr << "Accept failed" << std::endl;
-            continue;
-        }
-        
-        char buffer[4096] = {0};
-        int bytes_received = read(new_socket, buffer, sizeof(buffer) - 1);
-        
-        if (bytes_received > 0) {
-            buffer[bytes_received] = '\0';
-            std::string response = handle_request(buffer);
-            write(new_socket, response.c_str(), response.length());
-        }
-        
-        close(new_socket);
+    log_event(LogLevel::Info, "server.listen").num("workers", static_cast<long long>(listeners.size())).num("backlog", backlog);
+
+    for (size_t i = 1; i < listeners.size(); ++i) {
+        std::thread(serve_listener, listeners[i]).detach();
     }
+    serve_listener(server_fd);
 #endif
 }
 
-int main() {
+// 基准测试程序直接包含本文件，定义LLM_TRAINER_NO_MAIN以去掉main
+#ifndef LLM_TRAINER_NO_MAIN
+int main(int argc, char** argv) {
+    // 模拟训练后端，由/api/train在设置了ELIAN_FAKE_TRAINER时启动
+    if (argc >= 2 && std::strcmp(argv[1], "--fake-trainer") == 0) {
+        return run_fake_trainer(argc, argv);
+    }
+
     // 设置控制台输出编码为UTF-8以解决中文乱码问题
 #ifdef _WIN32
     // Windows平台设置控制台代码页为UTF-8
@@ -2612,25 +11217,8 @@ int main() {
     mkdir((llm_dir + "/data").c_str(), 0755);
 #endif
 
-    // 在Windows目录下创建elianfactory文件夹及配置文件
-    std::string windows_dir = "C:\\Windows";
-    std::string config_dir = windows_dir + "\\elianfactory";
-    std::string config_file = config_dir + "\\default_config.json";
-    
-    // 创建目录
-    if (!file_exists(config_dir)) {
-#ifdef _WIN32
-        // 创建目录并设置权限
-        if (!CreateDirectoryA(config_dir.c_str(), NULL)) {
-            std::cerr << "无法创建目录: " << config_dir << std::endl;
-        }
-#else
-        // Linux方式创建目录
-        mkdir(config_dir.c_str(), 0777);
-#endif
-    }
-    
-    // 创建默认配置文件
+    // 在llm/configs下创建默认配置，训练脚本读取同一文件
+    std::string config_file = g_config_store.path_of("default_config");
     if (!file_exists(config_file)) {
         std::string default_config = R"({
   "model_name_or_path": "/ckpt/ds",
@@ -2657,30 +11245,26 @@ int main() {
   "distributed": false
 })";
 
-        // 创建并写入配置文件
-        std::ofstream config_out(config_file);
-        if (config_out.is_open()) {
-            config_out << default_config;
-            config_out.close();
-            
-#ifdef _WIN32
-            // 设置文件权限为可读写
-            DWORD attributes = GetFileAttributesA(config_file.c_str());
-            if (attributes != INVALID_FILE_ATTRIBUTES) {
-                SetFileAttributesA(config_file.c_str(), attributes & ~FILE_ATTRIBUTE_READONLY);
-            }
-#else
-            // Linux设置权限
-            chmod(config_file.c_str(), 0666);
-#endif
+        JsonValue default_value;
+        ConfigEntry entry;
+        std::string error;
+        json_parse(default_config, default_value, nullptr);
+        if (g_config_store.save("default_config", default_value, "", entry, error) == ConfigStore::Saved) {
             std::cout << "已创建默认配置文件: " << config_file << std::endl;
         } else {
-            std::cerr << "无法创建配置文件: " << config_file << std::endl;
+            std::cerr << "无法创建配置文件: " << config_file << " " << error << std::endl;
         }
     }
 
+    // 异步任务可选写盘目录
+    const char* task_dir = std::getenv("ELIAN_TASK_DIR");
+    if (task_dir != nullptr && task_dir[0] != '\0') {
+        g_task_registry.set_persist_dir(task_dir);
+        std::cout << "异步任务状态写入目录: " << task_dir << std::endl;
+    }
+
     std::cout << "服务器准备启动..." << std::endl;
     start_server();
     return 0;
-} 
-
+}
+#endif
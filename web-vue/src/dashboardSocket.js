@@ -0,0 +1,69 @@
+// 仪表盘推送连接：每个标签页共用一个 /api/ws 连接，按主题订阅，服务端只在内容变化时推送。
+// 断开后自动重连并重新订阅；连接不可用期间 isSocketConnected() 为false，调用方继续HTTP轮询。
+
+const RECONNECT_DELAY = 3000
+
+let socket = null
+let connected = false
+const subscriptions = new Map() // 主题键 -> { message, handlers }
+
+function subscriptionKey(topic, taskId) {
+  return taskId ? `${topic}:${taskId}` : topic
+}
+
+function connect() {
+  if (socket || typeof WebSocket === 'undefined') return
+  const protocol = window.location.protocol === 'https:' ? 'wss:' : 'ws:'
+  socket = new WebSocket(`${protocol}//${window.location.host}/api/ws`)
+
+  socket.onopen = () => {
+    connected = true
+    subscriptions.forEach(sub => socket.send(JSON.stringify(sub.message)))
+  }
+
+  socket.onmessage = event => {
+    let message
+    try {
+      message = JSON.parse(event.data)
+    } catch (e) {
+      return
+    }
+    if (message.type === 'error') {
+      console.error('推送订阅失败:', message.message)
+      return
+    }
+    const sub = subscriptions.get(subscriptionKey(message.topic, message.task_id))
+    if (sub) sub.handlers.forEach(handler => handler(message))
+  }
+
+  socket.onclose = () => {
+    socket = null
+    connected = false
+    if (subscriptions.size > 0) setTimeout(connect, RECONNECT_DELAY)
+  }
+}
+
+export function isSocketConnected() {
+  return connected
+}
+
+// 订阅主题（gpu、logs、job、inference、deploy），返回取消订阅的函数
+export function subscribe(topic, handler, taskId) {
+  const key = subscriptionKey(topic, taskId)
+  let sub = subscriptions.get(key)
+  if (!sub) {
+    sub = { message: { op: 'subscribe', topic, task_id: taskId }, handlers: new Set() }
+    subscriptions.set(key, sub)
+  }
+  sub.handlers.add(handler)
+  // 重复订阅时服务端会重新推送完整内容，新的处理函数也能拿到当前状态
+  if (connected) socket.send(JSON.stringify(sub.message))
+  connect()
+
+  return () => {
+    sub.handlers.delete(handler)
+    if (sub.handlers.size > 0 || subscriptions.get(key) !== sub) return
+    subscriptions.delete(key)
+    if (connected) socket.send(JSON.stringify({ op: 'unsubscribe', topic, task_id: taskId }))
+  }
+}